@@ -0,0 +1,263 @@
+#include "audiobackends.h"
+#include <QDebug>
+#include <QtEndian>
+#include <cmath>
+
+namespace {
+
+constexpr double kTwoPi = 6.283185307179586;
+
+// Canonical 44 byte header for Int16 PCM
+struct WavHeader {
+    char riff[4];
+    quint32 riffSize;
+    char wave[4];
+    char fmt[4];
+    quint32 fmtSize;
+    quint16 audioFormat;
+    quint16 channelCount;
+    quint32 sampleRate;
+    quint32 byteRate;
+    quint16 blockAlign;
+    quint16 bitsPerSample;
+    char data[4];
+    quint32 dataSize;
+};
+static_assert(sizeof(WavHeader) == 44, "WAV header must be packed");
+
+} // namespace
+
+//---------- ToneAudioSource ----------
+
+ToneAudioSource::ToneAudioSource(Waveform waveform, double frequency, double amplitude)
+    : m_waveform(waveform), m_frequency(frequency), m_amplitude(qBound(0.0, amplitude, 1.0)) {
+}
+
+bool ToneAudioSource::open(const QAudioFormat& format) {
+    if (format.sampleFormat() != QAudioFormat::Int16 || format.sampleRate() <= 0) {
+        return false;
+    }
+    m_channelCount = format.channelCount();
+    m_phaseStep = kTwoPi * m_frequency / format.sampleRate();
+    m_phase = 0.0;
+    return true;
+}
+
+int ToneAudioSource::read(qint16* data, int frames) {
+    const double scale = m_amplitude * 32767.0;
+    for (int frame = 0; frame < frames; ++frame) {
+        double value = 0.0;
+        if (m_waveform == Sine) {
+            value = std::sin(m_phase);
+            m_phase += m_phaseStep;
+            if (m_phase >= kTwoPi) {
+                m_phase -= kTwoPi;
+            }
+        } else {
+            // xorshift32, uniform in [-1, 1)
+            m_noiseState ^= m_noiseState << 13;
+            m_noiseState ^= m_noiseState >> 17;
+            m_noiseState ^= m_noiseState << 5;
+            value = double(qint32(m_noiseState)) / 2147483648.0;
+        }
+
+        const qint16 sample = qint16(value * scale);
+        for (int channel = 0; channel < m_channelCount; ++channel) {
+            *data++ = sample;
+        }
+    }
+    return frames;
+}
+
+QString ToneAudioSource::description() const {
+    if (m_waveform == WhiteNoise) {
+        return QStringLiteral("white noise");
+    }
+    return QStringLiteral("%1 Hz sine").arg(m_frequency);
+}
+
+//---------- WavFileSource ----------
+
+WavFileSource::WavFileSource(const QString& fileName) : m_file(fileName) {
+}
+
+bool WavFileSource::open(const QAudioFormat& format) {
+    if (!m_file.open(QIODevice::ReadOnly)) {
+        qWarning() << "Cannot open" << m_file.fileName() << m_file.errorString();
+        return false;
+    }
+
+    char riff[12];
+    if (m_file.read(riff, 12) != 12 || memcmp(riff, "RIFF", 4) != 0 || memcmp(riff + 8, "WAVE", 4) != 0) {
+        qWarning() << m_file.fileName() << "is not a RIFF/WAVE file";
+        return false;
+    }
+
+    // Walk the chunks until the data chunk, picking up the format on the way
+    quint16 audioFormat = 0;
+    quint16 channelCount = 0;
+    quint32 sampleRate = 0;
+    quint16 bitsPerSample = 0;
+    char chunk[8];
+    while (m_file.read(chunk, 8) == 8) {
+        const quint32 chunkSize = qFromLittleEndian<quint32>(chunk + 4);
+        if (memcmp(chunk, "fmt ", 4) == 0) {
+            char fmt[16];
+            if (chunkSize < 16 || m_file.read(fmt, 16) != 16) {
+                break;
+            }
+            audioFormat = qFromLittleEndian<quint16>(fmt);
+            channelCount = qFromLittleEndian<quint16>(fmt + 2);
+            sampleRate = qFromLittleEndian<quint32>(fmt + 4);
+            bitsPerSample = qFromLittleEndian<quint16>(fmt + 14);
+            m_file.skip(qint64(chunkSize) - 16 + (chunkSize & 1));
+        } else if (memcmp(chunk, "data", 4) == 0) {
+            m_dataBytesLeft = chunkSize;
+            break;
+        } else {
+            m_file.skip(qint64(chunkSize) + (chunkSize & 1));
+        }
+    }
+
+    // 1 is PCM, 0xFFFE is WAVE_FORMAT_EXTENSIBLE
+    const bool isPcm16 = (audioFormat == 1 || audioFormat == 0xFFFE) && bitsPerSample == 16;
+    if (!isPcm16 || m_dataBytesLeft == 0) {
+        qWarning() << m_file.fileName() << "has no Int16 PCM data";
+        return false;
+    }
+    if (int(sampleRate) != format.sampleRate() || int(channelCount) != format.channelCount()) {
+        qWarning() << m_file.fileName() << "is" << sampleRate << "Hz" << channelCount
+                   << "ch, the capture format is" << format.sampleRate() << "Hz"
+                   << format.channelCount() << "ch";
+        return false;
+    }
+
+    m_bytesPerFrame = format.bytesPerFrame();
+    return true;
+}
+
+int WavFileSource::read(qint16* data, int frames) {
+    const qint64 wanted = qMin(qint64(frames) * m_bytesPerFrame, m_dataBytesLeft);
+    const qint64 bytesRead = m_file.read(reinterpret_cast<char*>(data), wanted);
+    if (bytesRead <= 0) {
+        return 0;
+    }
+    m_dataBytesLeft -= bytesRead;
+    return int(bytesRead / m_bytesPerFrame);
+}
+
+QString WavFileSource::description() const {
+    return m_file.fileName();
+}
+
+//---------- WavFileSink ----------
+
+WavFileSink::WavFileSink(const QString& fileName) : m_file(fileName) {
+}
+
+WavFileSink::~WavFileSink() {
+    close();
+}
+
+bool WavFileSink::open(const QAudioFormat& format) {
+    if (format.sampleFormat() != QAudioFormat::Int16) {
+        return false;
+    }
+    if (!m_file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        qWarning() << "Cannot write" << m_file.fileName() << m_file.errorString();
+        return false;
+    }
+    m_format = format;
+    m_dataBytes = 0;
+
+    // Placeholder, sizes are patched in close()
+    writeHeader();
+    return true;
+}
+
+void WavFileSink::write(const qint16* data, int frames) {
+    const qint64 bytes = qint64(frames) * m_format.bytesPerFrame();
+    m_dataBytes += m_file.write(reinterpret_cast<const char*>(data), bytes);
+}
+
+void WavFileSink::close() {
+    if (m_file.isOpen()) {
+        m_file.seek(0);
+        writeHeader();
+        m_file.close();
+    }
+}
+
+QString WavFileSink::description() const {
+    return m_file.fileName();
+}
+
+void WavFileSink::writeHeader() {
+    WavHeader header;
+    memcpy(header.riff, "RIFF", 4);
+    memcpy(header.wave, "WAVE", 4);
+    memcpy(header.fmt, "fmt ", 4);
+    memcpy(header.data, "data", 4);
+    header.riffSize = qToLittleEndian<quint32>(quint32(36 + m_dataBytes));
+    header.fmtSize = qToLittleEndian<quint32>(16);
+    header.audioFormat = qToLittleEndian<quint16>(1);
+    header.channelCount = qToLittleEndian<quint16>(quint16(m_format.channelCount()));
+    header.sampleRate = qToLittleEndian<quint32>(quint32(m_format.sampleRate()));
+    header.byteRate = qToLittleEndian<quint32>(quint32(m_format.sampleRate() * m_format.bytesPerFrame()));
+    header.blockAlign = qToLittleEndian<quint16>(quint16(m_format.bytesPerFrame()));
+    header.bitsPerSample = qToLittleEndian<quint16>(16);
+    header.dataSize = qToLittleEndian<quint32>(quint32(m_dataBytes));
+    m_file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+}
+
+//---------- NullAudioSink ----------
+
+bool NullAudioSink::open(const QAudioFormat& format) {
+    Q_UNUSED(format);
+    m_framesWritten = 0;
+    return true;
+}
+
+void NullAudioSink::write(const qint16* data, int frames) {
+    Q_UNUSED(data);
+    m_framesWritten += frames;
+}
+
+QString NullAudioSink::description() const {
+    return QStringLiteral("null sink");
+}
+
+//---------- Factories ----------
+
+std::unique_ptr<OfflineAudioSource> createOfflineAudioSource(const QString& spec) {
+    if (spec.startsWith(QLatin1String("tone"))) {
+        double frequency = 440.0;
+        if (spec.startsWith(QLatin1String("tone:"))) {
+            frequency = spec.mid(5).toDouble();
+        }
+        return std::make_unique<ToneAudioSource>(ToneAudioSource::Sine, frequency);
+    }
+    if (spec == QLatin1String("noise")) {
+        return std::make_unique<ToneAudioSource>(ToneAudioSource::WhiteNoise);
+    }
+    if (spec.startsWith(QLatin1String("wav:"))) {
+        return std::make_unique<WavFileSource>(spec.mid(4));
+    }
+    if (spec != QLatin1String("device")) {
+        qWarning() << "Unknown audio input" << spec;
+    }
+    return nullptr;
+}
+
+std::unique_ptr<OfflineAudioSink> createOfflineAudioSink(const QString& spec) {
+    if (spec == QLatin1String("null")) {
+        return std::make_unique<NullAudioSink>();
+    }
+    if (spec.startsWith(QLatin1String("wav:"))) {
+        return std::make_unique<WavFileSink>(spec.mid(4));
+    }
+    if (spec != QLatin1String("device")) {
+        qWarning() << "Unknown audio output" << spec;
+    }
+    return nullptr;
+}
@@ -0,0 +1,110 @@
+#ifndef AUDIOBACKENDS_H
+#define AUDIOBACKENDS_H
+
+#include <QAudioFormat>
+#include <QFile>
+#include <QString>
+#include <memory>
+
+// Capture backend that does not need sound hardware. It produces Int16 PCM
+// in the capture format on demand, so the pipeline can run at wall-clock
+// pace or as fast as the CPU allows.
+class OfflineAudioSource {
+public:
+    virtual ~OfflineAudioSource() = default;
+
+    // Prepare to produce audio in format, false if that is not possible
+    virtual bool open(const QAudioFormat& format) = 0;
+
+    // Fill up to frames frames; fewer than requested means end of stream
+    virtual int read(qint16* data, int frames) = 0;
+
+    virtual QString description() const = 0;
+};
+
+// Playback backend that does not need sound hardware
+class OfflineAudioSink {
+public:
+    virtual ~OfflineAudioSink() = default;
+
+    virtual bool open(const QAudioFormat& format) = 0;
+    virtual void write(const qint16* data, int frames) = 0;
+    virtual void close() {}
+
+    virtual QString description() const = 0;
+};
+
+// Synthetic test signal: a sine tone or white noise
+class ToneAudioSource : public OfflineAudioSource {
+public:
+    enum Waveform { Sine, WhiteNoise };
+
+    explicit ToneAudioSource(Waveform waveform, double frequency = 440.0, double amplitude = 0.5);
+
+    bool open(const QAudioFormat& format) override;
+    int read(qint16* data, int frames) override;
+    QString description() const override;
+
+private:
+    Waveform m_waveform;
+    double m_frequency;
+    double m_amplitude;
+    double m_phase = 0.0;
+    double m_phaseStep = 0.0;
+    quint32 m_noiseState = 0x12345678u;
+    int m_channelCount = 1;
+};
+
+// Int16 PCM RIFF/WAVE file played as the capture input
+class WavFileSource : public OfflineAudioSource {
+public:
+    explicit WavFileSource(const QString& fileName);
+
+    bool open(const QAudioFormat& format) override;
+    int read(qint16* data, int frames) override;
+    QString description() const override;
+
+private:
+    QFile m_file;
+    qint64 m_dataBytesLeft = 0;
+    int m_bytesPerFrame = 0;
+};
+
+// Writes the output mix to an Int16 PCM RIFF/WAVE file
+class WavFileSink : public OfflineAudioSink {
+public:
+    explicit WavFileSink(const QString& fileName);
+    ~WavFileSink();
+
+    bool open(const QAudioFormat& format) override;
+    void write(const qint16* data, int frames) override;
+    void close() override;
+    QString description() const override;
+
+private:
+    QFile m_file;
+    QAudioFormat m_format;
+    qint64 m_dataBytes = 0;
+
+    void writeHeader();
+};
+
+// Discards the output mix, counting frames only
+class NullAudioSink : public OfflineAudioSink {
+public:
+    bool open(const QAudioFormat& format) override;
+    void write(const qint16* data, int frames) override;
+    QString description() const override;
+
+    qint64 framesWritten() const { return m_framesWritten; }
+
+private:
+    qint64 m_framesWritten = 0;
+};
+
+// Build a backend from a command line spec, nullptr for "device" or errors.
+// Sources: "tone[:hz]", "noise", "wav:<file>". Sinks: "null", "wav:<file>".
+std::unique_ptr<OfflineAudioSource> createOfflineAudioSource(const QString& spec);
+std::unique_ptr<OfflineAudioSink> createOfflineAudioSink(const QString& spec);
+
+#endif // AUDIOBACKENDS_H
@@ -0,0 +1,529 @@
+#include "audiokernels.h"
+#include <cstdlib>
+#include <cstring>
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64)
+#define AUDIOKERNELS_X86 1
+#include <immintrin.h>
+#endif
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define AUDIOKERNELS_NEON 1
+#include <arm_neon.h>
+#endif
+
+// This file is built with -ffp-contract=off so the compiler cannot fuse the
+// scalar multiply-adds into FMAs, which would break bit-exactness.
+
+#if defined(__GNUC__) || defined(__clang__)
+#define AUDIOKERNELS_TARGET(isa) __attribute__((target(isa)))
+#else
+#define AUDIOKERNELS_TARGET(isa)
+#endif
+
+namespace AudioKernels {
+namespace {
+
+constexpr float kToFloat = 1.0f / 32768.0f;
+constexpr float kToInt16 = 32768.0f;
+constexpr float kInt16Min = -32768.0f;
+constexpr float kInt16Max = 32767.0f;
+
+//---------- Scalar ----------
+
+inline int16_t saturate(float value) {
+    // Comparisons written so NaN lands on the lower bound, like maxps
+    float v = value * kToInt16;
+    v = v > kInt16Min ? v : kInt16Min;
+    v = v < kInt16Max ? v : kInt16Max;
+    return static_cast<int16_t>(static_cast<int32_t>(v));
+}
+
+void int16ToFloatScalar(float* dst, const int16_t* src, int count) {
+    for (int i = 0; i < count; ++i) {
+        dst[i] = static_cast<float>(src[i]) * kToFloat;
+    }
+}
+
+void floatToInt16Scalar(int16_t* dst, const float* src, int count) {
+    for (int i = 0; i < count; ++i) {
+        dst[i] = saturate(src[i]);
+    }
+}
+
+void applyGainScalar(float* data, int count, float gain) {
+    for (int i = 0; i < count; ++i) {
+        data[i] *= gain;
+    }
+}
+
+void mixScalar(float* dst, const float* const* inputs, const float* gains, int inputCount, int count) {
+    for (int i = 0; i < count; ++i) {
+        float sum = 0.0f;
+        for (int k = 0; k < inputCount; ++k) {
+            sum += inputs[k][i] * gains[k];
+        }
+        dst[i] = sum;
+    }
+}
+
+void interleave2Scalar(float* dst, const float* left, const float* right, int frames) {
+    for (int i = 0; i < frames; ++i) {
+        dst[2 * i] = left[i];
+        dst[2 * i + 1] = right[i];
+    }
+}
+
+void deinterleave2Scalar(float* left, float* right, const float* src, int frames) {
+    for (int i = 0; i < frames; ++i) {
+        left[i] = src[2 * i];
+        right[i] = src[2 * i + 1];
+    }
+}
+
+// Products past the last whole group of 8, in order
+inline float dotTail(float sum, const float* a, const float* b, int from, int count) {
+    for (int i = from; i < count; ++i) {
+        sum += a[i] * b[i];
+    }
+    return sum;
+}
+
+float dotScalar(const float* a, const float* b, int count) {
+    float s[8] = {};
+    int i = 0;
+    for (; i + 8 <= count; i += 8) {
+        for (int lane = 0; lane < 8; ++lane) {
+            s[lane] += a[i + lane] * b[i + lane];
+        }
+    }
+    const float sum = ((s[0] + s[4]) + (s[2] + s[6])) + ((s[1] + s[5]) + (s[3] + s[7]));
+    return dotTail(sum, a, b, i, count);
+}
+
+const KernelSet kScalar = {
+    "scalar",
+    int16ToFloatScalar,
+    floatToInt16Scalar,
+    applyGainScalar,
+    mixScalar,
+    interleave2Scalar,
+    deinterleave2Scalar,
+    dotScalar,
+};
+
+#if AUDIOKERNELS_X86
+
+//---------- SSE2 ----------
+
+AUDIOKERNELS_TARGET("sse2")
+void int16ToFloatSse2(float* dst, const int16_t* src, int count) {
+    const __m128 scale = _mm_set1_ps(kToFloat);
+    int i = 0;
+    for (; i + 8 <= count; i += 8) {
+        const __m128i s = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+        // Sign-extend by unpacking into the high half and shifting down
+        const __m128i lo = _mm_srai_epi32(_mm_unpacklo_epi16(s, s), 16);
+        const __m128i hi = _mm_srai_epi32(_mm_unpackhi_epi16(s, s), 16);
+        _mm_storeu_ps(dst + i, _mm_mul_ps(_mm_cvtepi32_ps(lo), scale));
+        _mm_storeu_ps(dst + i + 4, _mm_mul_ps(_mm_cvtepi32_ps(hi), scale));
+    }
+    int16ToFloatScalar(dst + i, src + i, count - i);
+}
+
+AUDIOKERNELS_TARGET("sse2")
+void floatToInt16Sse2(int16_t* dst, const float* src, int count) {
+    const __m128 scale = _mm_set1_ps(kToInt16);
+    const __m128 lo = _mm_set1_ps(kInt16Min);
+    const __m128 hi = _mm_set1_ps(kInt16Max);
+    int i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m128 a = _mm_mul_ps(_mm_loadu_ps(src + i), scale);
+        __m128 b = _mm_mul_ps(_mm_loadu_ps(src + i + 4), scale);
+        a = _mm_min_ps(_mm_max_ps(a, lo), hi);
+        b = _mm_min_ps(_mm_max_ps(b, lo), hi);
+        const __m128i packed = _mm_packs_epi32(_mm_cvttps_epi32(a), _mm_cvttps_epi32(b));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), packed);
+    }
+    floatToInt16Scalar(dst + i, src + i, count - i);
+}
+
+AUDIOKERNELS_TARGET("sse2")
+void applyGainSse2(float* data, int count, float gain) {
+    const __m128 g = _mm_set1_ps(gain);
+    int i = 0;
+    for (; i + 4 <= count; i += 4) {
+        _mm_storeu_ps(data + i, _mm_mul_ps(_mm_loadu_ps(data + i), g));
+    }
+    applyGainScalar(data + i, count - i, gain);
+}
+
+AUDIOKERNELS_TARGET("sse2")
+void mixSse2(float* dst, const float* const* inputs, const float* gains, int inputCount, int count) {
+    int i = 0;
+    for (; i + 4 <= count; i += 4) {
+        __m128 sum = _mm_setzero_ps();
+        for (int k = 0; k < inputCount; ++k) {
+            sum = _mm_add_ps(sum, _mm_mul_ps(_mm_loadu_ps(inputs[k] + i), _mm_set1_ps(gains[k])));
+        }
+        _mm_storeu_ps(dst + i, sum);
+    }
+    for (; i < count; ++i) {
+        float sum = 0.0f;
+        for (int k = 0; k < inputCount; ++k) {
+            sum += inputs[k][i] * gains[k];
+        }
+        dst[i] = sum;
+    }
+}
+
+AUDIOKERNELS_TARGET("sse2")
+void interleave2Sse2(float* dst, const float* left, const float* right, int frames) {
+    int i = 0;
+    for (; i + 4 <= frames; i += 4) {
+        const __m128 l = _mm_loadu_ps(left + i);
+        const __m128 r = _mm_loadu_ps(right + i);
+        _mm_storeu_ps(dst + 2 * i, _mm_unpacklo_ps(l, r));
+        _mm_storeu_ps(dst + 2 * i + 4, _mm_unpackhi_ps(l, r));
+    }
+    interleave2Scalar(dst + 2 * i, left + i, right + i, frames - i);
+}
+
+AUDIOKERNELS_TARGET("sse2")
+void deinterleave2Sse2(float* left, float* right, const float* src, int frames) {
+    int i = 0;
+    for (; i + 4 <= frames; i += 4) {
+        const __m128 a = _mm_loadu_ps(src + 2 * i);
+        const __m128 b = _mm_loadu_ps(src + 2 * i + 4);
+        _mm_storeu_ps(left + i, _mm_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0)));
+        _mm_storeu_ps(right + i, _mm_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1)));
+    }
+    deinterleave2Scalar(left + i, right + i, src + 2 * i, frames - i);
+}
+
+AUDIOKERNELS_TARGET("sse2")
+float dotSse2(const float* a, const float* b, int count) {
+    __m128 low = _mm_setzero_ps();
+    __m128 high = _mm_setzero_ps();
+    int i = 0;
+    for (; i + 8 <= count; i += 8) {
+        low = _mm_add_ps(low, _mm_mul_ps(_mm_loadu_ps(a + i), _mm_loadu_ps(b + i)));
+        high = _mm_add_ps(high, _mm_mul_ps(_mm_loadu_ps(a + i + 4), _mm_loadu_ps(b + i + 4)));
+    }
+    // s0+s4 .. s3+s7, then lanes 0,1 plus lanes 2,3, then lane 0 plus lane 1
+    const __m128 quad = _mm_add_ps(low, high);
+    const __m128 pair = _mm_add_ps(quad, _mm_movehl_ps(quad, quad));
+    const __m128 single = _mm_add_ss(pair, _mm_shuffle_ps(pair, pair, _MM_SHUFFLE(1, 1, 1, 1)));
+    return dotTail(_mm_cvtss_f32(single), a, b, i, count);
+}
+
+const KernelSet kSse2 = {
+    "sse2",
+    int16ToFloatSse2,
+    floatToInt16Sse2,
+    applyGainSse2,
+    mixSse2,
+    interleave2Sse2,
+    deinterleave2Sse2,
+    dotSse2,
+};
+
+//---------- AVX2 ----------
+
+#if defined(__GNUC__) || defined(__clang__)
+#define AUDIOKERNELS_AVX2 1
+
+AUDIOKERNELS_TARGET("avx2")
+void int16ToFloatAvx2(float* dst, const int16_t* src, int count) {
+    const __m256 scale = _mm256_set1_ps(kToFloat);
+    int i = 0;
+    for (; i + 8 <= count; i += 8) {
+        const __m128i s = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+        _mm256_storeu_ps(dst + i, _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_cvtepi16_epi32(s)), scale));
+    }
+    int16ToFloatScalar(dst + i, src + i, count - i);
+}
+
+AUDIOKERNELS_TARGET("avx2")
+void floatToInt16Avx2(int16_t* dst, const float* src, int count) {
+    const __m256 scale = _mm256_set1_ps(kToInt16);
+    const __m256 lo = _mm256_set1_ps(kInt16Min);
+    const __m256 hi = _mm256_set1_ps(kInt16Max);
+    int i = 0;
+    for (; i + 16 <= count; i += 16) {
+        __m256 a = _mm256_mul_ps(_mm256_loadu_ps(src + i), scale);
+        __m256 b = _mm256_mul_ps(_mm256_loadu_ps(src + i + 8), scale);
+        a = _mm256_min_ps(_mm256_max_ps(a, lo), hi);
+        b = _mm256_min_ps(_mm256_max_ps(b, lo), hi);
+        // packs works per 128-bit lane, the permute restores sample order
+        const __m256i packed = _mm256_packs_epi32(_mm256_cvttps_epi32(a), _mm256_cvttps_epi32(b));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i), _mm256_permute4x64_epi64(packed, 0xD8));
+    }
+    floatToInt16Scalar(dst + i, src + i, count - i);
+}
+
+AUDIOKERNELS_TARGET("avx2")
+void applyGainAvx2(float* data, int count, float gain) {
+    const __m256 g = _mm256_set1_ps(gain);
+    int i = 0;
+    for (; i + 8 <= count; i += 8) {
+        _mm256_storeu_ps(data + i, _mm256_mul_ps(_mm256_loadu_ps(data + i), g));
+    }
+    applyGainScalar(data + i, count - i, gain);
+}
+
+AUDIOKERNELS_TARGET("avx2")
+void mixAvx2(float* dst, const float* const* inputs, const float* gains, int inputCount, int count) {
+    int i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m256 sum = _mm256_setzero_ps();
+        for (int k = 0; k < inputCount; ++k) {
+            sum = _mm256_add_ps(sum, _mm256_mul_ps(_mm256_loadu_ps(inputs[k] + i), _mm256_set1_ps(gains[k])));
+        }
+        _mm256_storeu_ps(dst + i, sum);
+    }
+    for (; i < count; ++i) {
+        float sum = 0.0f;
+        for (int k = 0; k < inputCount; ++k) {
+            sum += inputs[k][i] * gains[k];
+        }
+        dst[i] = sum;
+    }
+}
+
+AUDIOKERNELS_TARGET("avx2")
+void interleave2Avx2(float* dst, const float* left, const float* right, int frames) {
+    int i = 0;
+    for (; i + 8 <= frames; i += 8) {
+        const __m256 l = _mm256_loadu_ps(left + i);
+        const __m256 r = _mm256_loadu_ps(right + i);
+        const __m256 lo = _mm256_unpacklo_ps(l, r);
+        const __m256 hi = _mm256_unpackhi_ps(l, r);
+        _mm256_storeu_ps(dst + 2 * i, _mm256_permute2f128_ps(lo, hi, 0x20));
+        _mm256_storeu_ps(dst + 2 * i + 8, _mm256_permute2f128_ps(lo, hi, 0x31));
+    }
+    interleave2Scalar(dst + 2 * i, left + i, right + i, frames - i);
+}
+
+AUDIOKERNELS_TARGET("avx2")
+void deinterleave2Avx2(float* left, float* right, const float* src, int frames) {
+    int i = 0;
+    for (; i + 8 <= frames; i += 8) {
+        const __m256 a = _mm256_loadu_ps(src + 2 * i);
+        const __m256 b = _mm256_loadu_ps(src + 2 * i + 8);
+        const __m256 l = _mm256_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0));
+        const __m256 r = _mm256_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1));
+        _mm256_storeu_ps(left + i, _mm256_castpd_ps(_mm256_permute4x64_pd(_mm256_castps_pd(l), 0xD8)));
+        _mm256_storeu_ps(right + i, _mm256_castpd_ps(_mm256_permute4x64_pd(_mm256_castps_pd(r), 0xD8)));
+    }
+    deinterleave2Scalar(left + i, right + i, src + 2 * i, frames - i);
+}
+
+AUDIOKERNELS_TARGET("avx2")
+float dotAvx2(const float* a, const float* b, int count) {
+    __m256 sums = _mm256_setzero_ps();
+    int i = 0;
+    for (; i + 8 <= count; i += 8) {
+        // Multiply and add kept apart, an FMA would round differently
+        sums = _mm256_add_ps(sums, _mm256_mul_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i)));
+    }
+    const __m128 quad = _mm_add_ps(_mm256_castps256_ps128(sums), _mm256_extractf128_ps(sums, 1));
+    const __m128 pair = _mm_add_ps(quad, _mm_movehl_ps(quad, quad));
+    const __m128 single = _mm_add_ss(pair, _mm_shuffle_ps(pair, pair, _MM_SHUFFLE(1, 1, 1, 1)));
+    return dotTail(_mm_cvtss_f32(single), a, b, i, count);
+}
+
+const KernelSet kAvx2 = {
+    "avx2",
+    int16ToFloatAvx2,
+    floatToInt16Avx2,
+    applyGainAvx2,
+    mixAvx2,
+    interleave2Avx2,
+    deinterleave2Avx2,
+    dotAvx2,
+};
+
+#endif // __GNUC__ || __clang__
+#endif // AUDIOKERNELS_X86
+
+#if AUDIOKERNELS_NEON
+
+//---------- NEON ----------
+
+void int16ToFloatNeon(float* dst, const int16_t* src, int count) {
+    const float32x4_t scale = vdupq_n_f32(kToFloat);
+    int i = 0;
+    for (; i + 8 <= count; i += 8) {
+        const int16x8_t s = vld1q_s16(src + i);
+        vst1q_f32(dst + i, vmulq_f32(vcvtq_f32_s32(vmovl_s16(vget_low_s16(s))), scale));
+        vst1q_f32(dst + i + 4, vmulq_f32(vcvtq_f32_s32(vmovl_s16(vget_high_s16(s))), scale));
+    }
+    int16ToFloatScalar(dst + i, src + i, count - i);
+}
+
+void floatToInt16Neon(int16_t* dst, const float* src, int count) {
+    const float32x4_t scale = vdupq_n_f32(kToInt16);
+    const float32x4_t lo = vdupq_n_f32(kInt16Min);
+    const float32x4_t hi = vdupq_n_f32(kInt16Max);
+    int i = 0;
+    for (; i + 8 <= count; i += 8) {
+        float32x4_t a = vmulq_f32(vld1q_f32(src + i), scale);
+        float32x4_t b = vmulq_f32(vld1q_f32(src + i + 4), scale);
+        // Select instead of vmaxq so NaN behaves like the scalar path
+        a = vbslq_f32(vcgtq_f32(a, lo), a, lo);
+        b = vbslq_f32(vcgtq_f32(b, lo), b, lo);
+        a = vbslq_f32(vcltq_f32(a, hi), a, hi);
+        b = vbslq_f32(vcltq_f32(b, hi), b, hi);
+        const int16x8_t packed = vcombine_s16(vqmovn_s32(vcvtq_s32_f32(a)), vqmovn_s32(vcvtq_s32_f32(b)));
+        vst1q_s16(dst + i, packed);
+    }
+    floatToInt16Scalar(dst + i, src + i, count - i);
+}
+
+void applyGainNeon(float* data, int count, float gain) {
+    const float32x4_t g = vdupq_n_f32(gain);
+    int i = 0;
+    for (; i + 4 <= count; i += 4) {
+        vst1q_f32(data + i, vmulq_f32(vld1q_f32(data + i), g));
+    }
+    applyGainScalar(data + i, count - i, gain);
+}
+
+void mixNeon(float* dst, const float* const* inputs, const float* gains, int inputCount, int count) {
+    int i = 0;
+    for (; i + 4 <= count; i += 4) {
+        float32x4_t sum = vdupq_n_f32(0.0f);
+        for (int k = 0; k < inputCount; ++k) {
+            // Separate multiply and add: vmlaq may fuse on AArch64
+            sum = vaddq_f32(sum, vmulq_f32(vld1q_f32(inputs[k] + i), vdupq_n_f32(gains[k])));
+        }
+        vst1q_f32(dst + i, sum);
+    }
+    for (; i < count; ++i) {
+        float sum = 0.0f;
+        for (int k = 0; k < inputCount; ++k) {
+            sum += inputs[k][i] * gains[k];
+        }
+        dst[i] = sum;
+    }
+}
+
+void interleave2Neon(float* dst, const float* left, const float* right, int frames) {
+    int i = 0;
+    for (; i + 4 <= frames; i += 4) {
+        float32x4x2_t pair;
+        pair.val[0] = vld1q_f32(left + i);
+        pair.val[1] = vld1q_f32(right + i);
+        vst2q_f32(dst + 2 * i, pair);
+    }
+    interleave2Scalar(dst + 2 * i, left + i, right + i, frames - i);
+}
+
+void deinterleave2Neon(float* left, float* right, const float* src, int frames) {
+    int i = 0;
+    for (; i + 4 <= frames; i += 4) {
+        const float32x4x2_t pair = vld2q_f32(src + 2 * i);
+        vst1q_f32(left + i, pair.val[0]);
+        vst1q_f32(right + i, pair.val[1]);
+    }
+    deinterleave2Scalar(left + i, right + i, src + 2 * i, frames - i);
+}
+
+float dotNeon(const float* a, const float* b, int count) {
+    float32x4_t low = vdupq_n_f32(0.0f);
+    float32x4_t high = vdupq_n_f32(0.0f);
+    int i = 0;
+    for (; i + 8 <= count; i += 8) {
+        low = vaddq_f32(low, vmulq_f32(vld1q_f32(a + i), vld1q_f32(b + i)));
+        high = vaddq_f32(high, vmulq_f32(vld1q_f32(a + i + 4), vld1q_f32(b + i + 4)));
+    }
+    const float32x4_t quad = vaddq_f32(low, high);
+    const float32x2_t pair = vadd_f32(vget_low_f32(quad), vget_high_f32(quad));
+    return dotTail(vget_lane_f32(vpadd_f32(pair, pair), 0), a, b, i, count);
+}
+
+const KernelSet kNeon = {
+    "neon",
+    int16ToFloatNeon,
+    floatToInt16Neon,
+    applyGainNeon,
+    mixNeon,
+    interleave2Neon,
+    deinterleave2Neon,
+    dotNeon,
+};
+
+#endif // AUDIOKERNELS_NEON
+
+//---------- Dispatch ----------
+
+struct Registry {
+    const KernelSet* sets[4] = {};
+    int count = 0;
+    const KernelSet* best = &kScalar;
+
+    Registry() {
+        sets[count++] = &kScalar;
+#if AUDIOKERNELS_X86
+#if defined(__GNUC__) || defined(__clang__)
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("sse2")) {
+            sets[count++] = &kSse2;
+        }
+#if AUDIOKERNELS_AVX2
+        if (__builtin_cpu_supports("avx2")) {
+            sets[count++] = &kAvx2;
+        }
+#endif
+#else
+        // SSE2 is part of the x86-64 baseline
+        sets[count++] = &kSse2;
+#endif
+#endif
+#if AUDIOKERNELS_NEON
+        sets[count++] = &kNeon;
+#endif
+        best = sets[count - 1];
+
+        if (const char* forced = std::getenv("KARAOKE_AUDIO_KERNELS")) {
+            for (int i = 0; i < count; ++i) {
+                if (std::strcmp(sets[i]->name, forced) == 0) {
+                    best = sets[i];
+                }
+            }
+        }
+    }
+};
+
+const Registry& registry() {
+    static const Registry instance;
+    return instance;
+}
+
+} // namespace
+
+const KernelSet& active() {
+    return *registry().best;
+}
+
+int availableCount() {
+    return registry().count;
+}
+
+const KernelSet& available(int index) {
+    const Registry& r = registry();
+    return *r.sets[index >= 0 && index < r.count ? index : 0];
+}
+
+const KernelSet* find(const char* name) {
+    const Registry& r = registry();
+    for (int i = 0; i < r.count; ++i) {
+        if (std::strcmp(r.sets[i]->name, name) == 0) {
+            return r.sets[i];
+        }
+    }
+    return nullptr;
+}
+
+} // namespace AudioKernels
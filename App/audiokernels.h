@@ -0,0 +1,52 @@
+#ifndef AUDIOKERNELS_H
+#define AUDIOKERNELS_H
+
+#include <cstdint>
+
+// Sample kernels used on the audio thread, with SSE2/AVX2/NEON variants
+// selected at runtime. Every variant produces bit-identical results to the
+// scalar one: the same float operations run in the same order, and
+// conversion clamps before truncating toward zero.
+//
+// Float samples are normalised so that Int16 full scale maps to [-1, 1).
+namespace AudioKernels {
+
+struct KernelSet {
+    const char* name;
+
+    // dst[i] = src[i] / 32768
+    void (*int16ToFloat)(float* dst, const int16_t* src, int count);
+
+    // dst[i] = saturate(trunc(src[i] * 32768)), NaN maps to -32768
+    void (*floatToInt16)(int16_t* dst, const float* src, int count);
+
+    // data[i] *= gain
+    void (*applyGain)(float* data, int count, float gain);
+
+    // dst[i] = sum over k in order of inputs[k][i] * gains[k]
+    void (*mix)(float* dst, const float* const* inputs, const float* gains, int inputCount, int count);
+
+    // Stereo interleave/deinterleave of frame count frames
+    void (*interleave2)(float* dst, const float* left, const float* right, int frames);
+    void (*deinterleave2)(float* left, float* right, const float* src, int frames);
+
+    // Sum of a[i] * b[i]. Products go to 8 running sums by i % 8 over
+    // whole groups of 8, the sums are added as ((s0+s4)+(s2+s6)) +
+    // ((s1+s5)+(s3+s7)), then the remaining products in order.
+    float (*dot)(const float* a, const float* b, int count);
+};
+
+// Best kernel set for this CPU. The KARAOKE_AUDIO_KERNELS environment
+// variable can force a set by name ("scalar", "sse2", "avx2", "neon").
+const KernelSet& active();
+
+// Every kernel set this build and CPU can run, scalar first
+int availableCount();
+const KernelSet& available(int index);
+
+// Kernel set by name, or nullptr if it is not available here
+const KernelSet* find(const char* name);
+
+} // namespace AudioKernels
+
+#endif // AUDIOKERNELS_H
@@ -0,0 +1,295 @@
+#include "audiomixbus.h"
+#include "audiopassthrough.h"
+#include "latencyprobe.h"
+#include "realtimeaudio.h"
+#include <QDebug>
+#include <algorithm>
+#include <chrono>
+
+AudioMixBus::AudioMixBus(const QAudioFormat& format, QObject* parent)
+    : QIODevice(parent), m_format(format) {
+    if (m_format.sampleFormat() != QAudioFormat::Int16) {
+        qWarning() << "AudioMixBus only renders Int16, got" << m_format.sampleFormat();
+    }
+    m_channelCount = qMax(1, m_format.channelCount());
+
+    // Pick the SIMD kernels here, off the audio thread
+    m_kernels = &AudioKernels::active();
+
+    const size_t periodSamples = size_t(kMaxPeriodFrames) * m_channelCount;
+    m_accumulator.resize(periodSamples);
+    m_sendBuffer.resize(periodSamples);
+    m_sendDry.resize(periodSamples);
+    for (Source& source : m_sources) {
+        source.scratch.resize(periodSamples);
+        source.monoScratch.resize(kMaxPeriodFrames);
+        source.buffer.resize(periodSamples);
+        source.gain.prepare(m_format.sampleRate());
+        source.send.prepare(m_format.sampleRate());
+    }
+    m_masterChain.prepare(m_format.sampleRate(), m_channelCount, kMaxPeriodFrames);
+    m_sendChain.prepare(m_format.sampleRate(), m_channelCount, kMaxPeriodFrames);
+
+    open(QIODevice::ReadOnly | QIODevice::Unbuffered);
+}
+
+void AudioMixBus::setPeriodFrames(int frames) {
+    m_periodFrames.store(qBound(16, frames, int(kMaxPeriodFrames)), std::memory_order_relaxed);
+}
+
+int AudioMixBus::addSource(AudioPassthrough* source, int channelCount) {
+    if (!source) {
+        return -1;
+    }
+    if (channelCount != 1 && channelCount != m_channelCount) {
+        qWarning() << "AudioMixBus cannot mix a" << channelCount
+                   << "channel source into a" << m_channelCount << "channel bus";
+        return -1;
+    }
+
+    for (int id = 0; id < kMaxSources; ++id) {
+        Source& slot = m_sources[id];
+        if (slot.device.load(std::memory_order_acquire) == nullptr) {
+            slot.channelCount = channelCount;
+            slot.gain.set(1.0f);
+            slot.gain.snap();
+            slot.send.set(0.0f);
+            slot.send.snap();
+            slot.chain.prepare(m_format.sampleRate(), channelCount, kMaxPeriodFrames);
+            // Publishing the device makes the slot visible to the audio thread
+            slot.device.store(source, std::memory_order_release);
+            return id;
+        }
+    }
+
+    qWarning() << "AudioMixBus has no free source slots";
+    return -1;
+}
+
+void AudioMixBus::removeSource(int id) {
+    if (id >= 0 && id < kMaxSources) {
+        m_sources[id].device.store(nullptr, std::memory_order_release);
+    }
+}
+
+bool AudioMixBus::addProcessor(int id, AudioProcessor* processor) {
+    if (id < 0 || id >= kMaxSources || !m_sources[id].device.load(std::memory_order_acquire)) {
+        return false;
+    }
+    return m_sources[id].chain.append(processor);
+}
+
+void AudioMixBus::removeProcessor(int id, AudioProcessor* processor) {
+    if (id >= 0 && id < kMaxSources) {
+        m_sources[id].chain.remove(processor);
+    }
+}
+
+bool AudioMixBus::addMasterProcessor(AudioProcessor* processor) {
+    return m_masterChain.append(processor);
+}
+
+void AudioMixBus::removeMasterProcessor(AudioProcessor* processor) {
+    m_masterChain.remove(processor);
+}
+
+bool AudioMixBus::addSendProcessor(AudioProcessor* processor) {
+    return m_sendChain.append(processor);
+}
+
+void AudioMixBus::removeSendProcessor(AudioProcessor* processor) {
+    m_sendChain.remove(processor);
+}
+
+int AudioMixBus::processorLatencyFrames(int id) const {
+    if (id >= 0 && id < kMaxSources) {
+        return m_sources[id].chain.latencyFrames();
+    }
+    return 0;
+}
+
+void AudioMixBus::setSourceGain(int id, float gain) {
+    if (id >= 0 && id < kMaxSources) {
+        m_sources[id].gain.set(gain);
+    }
+}
+
+float AudioMixBus::sourceGain(int id) const {
+    if (id >= 0 && id < kMaxSources) {
+        return m_sources[id].gain.target();
+    }
+    return 0.0f;
+}
+
+void AudioMixBus::setSourceSend(int id, float level) {
+    if (id >= 0 && id < kMaxSources) {
+        m_sources[id].send.set(level);
+    }
+}
+
+float AudioMixBus::sourceSend(int id) const {
+    if (id >= 0 && id < kMaxSources) {
+        return m_sources[id].send.target();
+    }
+    return 0.0f;
+}
+
+void AudioMixBus::setWorkerThreads(int threads) {
+    threads = qBound(0, threads, int(AudioWorkerPool::kMaxThreads));
+    if (threads == workerThreads()) {
+        return;
+    }
+    // Joins the old workers before starting the new ones
+    m_workerPool.reset();
+    if (threads > 0) {
+        m_workerPool = std::make_unique<AudioWorkerPool>(threads);
+    }
+}
+
+qint64 AudioMixBus::readData(char* data, qint64 maxSize) {
+    const int periodFrames = m_periodFrames.load(std::memory_order_relaxed);
+    const qint64 periodBytes = qint64(periodFrames) * m_channelCount * qint64(sizeof(qint16));
+    const qint64 periods = maxSize / periodBytes;
+    qint16* output = reinterpret_cast<qint16*>(data);
+    if (periods == 0) {
+        return 0;
+    }
+    RealtimeAudio::AuditScope audit;
+
+    // Only whole periods: missing source data becomes silence, and a request
+    // smaller than a period waits for the sink to free more space
+    using Clock = std::chrono::steady_clock;
+    const auto start = Clock::now();
+    for (qint64 period = 0; period < periods; ++period) {
+        renderPeriod(output, periodFrames);
+        output += size_t(periodFrames) * m_channelCount;
+    }
+    const qint64 elapsedNs = std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start).count();
+    m_renderStats.record(elapsedNs, periods * periodFrames * 1000000000LL / qMax(1, m_format.sampleRate()));
+
+    return periods * periodBytes;
+}
+
+qint64 AudioMixBus::writeData(const char* data, qint64 maxSize) {
+    Q_UNUSED(data);
+    Q_UNUSED(maxSize);
+    return -1;
+}
+
+void AudioMixBus::renderPeriod(qint16* output, int frames) {
+    const int samples = frames * m_channelCount;
+
+    int sourceCount = 0;
+    for (int id = 0; id < kMaxSources; ++id) {
+        if (m_sources[id].device.load(std::memory_order_relaxed)) {
+            m_renderIds[sourceCount++] = id;
+        }
+    }
+
+    // Every source renders into its own buffer, so the chains are
+    // independent until the sum
+    m_renderFrames = frames;
+    AudioWorkerPool* pool = m_workerPool.get();
+    if (pool && sourceCount >= kMinParallelSources) {
+        pool->run(&AudioMixBus::renderSourceJob, this, sourceCount);
+    } else {
+        for (int index = 0; index < sourceCount; ++index) {
+            renderSourceJob(this, index);
+        }
+    }
+
+    // One more input for the send return
+    const float* inputs[kMaxSources + 1];
+    float gains[kMaxSources + 1];
+    const float* sendInputs[kMaxSources];
+    float sendGains[kMaxSources];
+    int inputCount = 0;
+    int sendCount = 0;
+    for (int index = 0; index < sourceCount; ++index) {
+        if (!m_renderOk[index]) {
+            continue;
+        }
+        Source& source = m_sources[m_renderIds[index]];
+        const float gain = source.mixGain;
+        inputs[inputCount] = source.buffer.data();
+        gains[inputCount] = gain;
+        ++inputCount;
+
+        const float send = source.send.advance(frames);
+        if (send != 0.0f) {
+            sendInputs[sendCount] = source.buffer.data();
+            sendGains[sendCount] = send * gain;
+            ++sendCount;
+        }
+    }
+
+    // The send chain runs even without sends, so tails ring out; what it
+    // returns is its output minus its input
+    if (!m_sendChain.isEmpty()) {
+        m_kernels->mix(m_sendBuffer.data(), sendInputs, sendGains, sendCount, samples);
+        std::copy_n(m_sendBuffer.data(), samples, m_sendDry.data());
+        m_sendChain.process(m_sendBuffer.data(), frames);
+        inputs[inputCount] = m_sendBuffer.data();
+        gains[inputCount] = 1.0f;
+        ++inputCount;
+        inputs[inputCount] = m_sendDry.data();
+        gains[inputCount] = -1.0f;
+        ++inputCount;
+    }
+
+    m_kernels->mix(m_accumulator.data(), inputs, gains, inputCount, samples);
+    m_masterChain.process(m_accumulator.data(), frames);
+    m_kernels->floatToInt16(output, m_accumulator.data(), samples);
+
+    if (LatencyProbe* probe = m_latencyProbe.load(std::memory_order_acquire)) {
+        probe->processOutput(output, frames);
+    }
+}
+
+void AudioMixBus::renderSourceJob(void* bus, int index) {
+    AudioMixBus* self = static_cast<AudioMixBus*>(bus);
+    self->m_renderOk[index] = self->readSource(self->m_sources[self->m_renderIds[index]], self->m_renderFrames);
+}
+
+bool AudioMixBus::readSource(Source& source, int frames) {
+    AudioPassthrough* device = source.device.load(std::memory_order_acquire);
+    if (!device) {
+        return false;
+    }
+
+    // The ring reads whole frames and counts a short read as an underrun
+    const int channels = source.channelCount;
+    const qint64 frameBytes = qint64(channels) * qint64(sizeof(qint16));
+    const qint64 bytesRead = device->readRaw(reinterpret_cast<char*>(source.scratch.data()), qint64(frames) * frameBytes);
+    const int framesRead = int(bytesRead / frameBytes);
+
+    // Convert and process in the source layout, so a mono mic is processed once
+    float* buffer = source.buffer.data();
+    float* native = channels == m_channelCount ? buffer : source.monoScratch.data();
+    m_kernels->int16ToFloat(native, source.scratch.data(), framesRead * channels);
+
+    // Frames past framesRead are an underrun and play as silence
+    std::fill(native + framesRead * channels, native + frames * channels, 0.0f);
+    source.chain.process(native, frames);
+
+    if (native != buffer) {
+        // Mono source spread over every bus channel
+        if (m_channelCount == 2) {
+            m_kernels->interleave2(buffer, native, native, frames);
+        } else {
+            for (int frame = 0; frame < frames; ++frame) {
+                std::fill_n(buffer + frame * m_channelCount, m_channelCount, native[frame]);
+            }
+        }
+    }
+
+    // A gain on the move is ramped into the buffer; a steady one is left to
+    // the mix, which applies it at no extra cost
+    if (source.gain.update()) {
+        source.gain.applyGain(buffer, frames, m_channelCount);
+        source.mixGain = 1.0f;
+    } else {
+        source.mixGain = source.gain.current();
+    }
+    return true;
+}
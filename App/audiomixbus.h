@@ -0,0 +1,158 @@
+#ifndef AUDIOMIXBUS_H
+#define AUDIOMIXBUS_H
+
+#include <QObject>
+#include <QIODevice>
+#include <QAudioFormat>
+#include <array>
+#include <atomic>
+#include <memory>
+#include <vector>
+#include "audiokernels.h"
+#include "audioprocessor.h"
+#include "audiostats.h"
+#include "audioworkerpool.h"
+#include "smoothedparameter.h"
+
+class AudioPassthrough;
+class LatencyProbe;
+
+// Read-only QIODevice that sums one period from every registered source.
+//
+// Each source is its own AudioPassthrough ring, written by its producer
+// thread. The sink thread pulls from the bus, which reads the same number
+// of frames from every source, applies the source gain and mixes them.
+// A source that has not produced enough data contributes silence for the
+// missing frames, so an underrun never shifts the other sources in time.
+// Gain and send changes ramp over kGainRampMs instead of stepping.
+//
+// Rendering is period driven: every read returns a whole number of periods
+// of periodFrames frames, and each period is mixed on its own.
+//
+// Every source has its own processor chain, run on the source's own channel
+// layout before a mono source is spread over the bus channels. The master
+// chain runs on the summed mix, just before conversion to Int16.
+//
+// Sources can also feed the send chain, shared effects such as reverb that
+// every mic reaches through its own send level. The send chain runs on the
+// sum of the sends, and only what it adds to that sum is mixed back in, so
+// the dry sources are not heard twice.
+//
+// With a worker pool set, the source chains of a period run in parallel
+// once there are kMinParallelSources sources; the sum stays on the calling
+// thread.
+class AudioMixBus : public QIODevice {
+    Q_OBJECT
+
+public:
+    static constexpr int kMaxSources = 8;
+    static constexpr int kMaxPeriodFrames = 4096;
+    static constexpr int kMinParallelSources = 3;
+    static constexpr double kGainRampMs = 20.0;
+
+    explicit AudioMixBus(const QAudioFormat& format, QObject* parent = nullptr);
+
+    QAudioFormat format() const { return m_format; }
+
+    // Frames rendered per period, at most kMaxPeriodFrames
+    void setPeriodFrames(int frames);
+    int periodFrames() const { return m_periodFrames.load(std::memory_order_relaxed); }
+
+    // Register a source producing Int16 PCM at the bus sample rate with
+    // either one channel or the bus channel count. Returns the source id,
+    // or -1 if the source cannot be mixed. Not for use on the audio thread.
+    int addSource(AudioPassthrough* source, int channelCount);
+    void removeSource(int id);
+
+    // Append a stage to a source's processor chain. The processor is prepared
+    // for the source format and must outlive the bus. Not for the audio thread.
+    bool addProcessor(int id, AudioProcessor* processor);
+    void removeProcessor(int id, AudioProcessor* processor);
+
+    // Delay added by a source's processor chain, in frames
+    int processorLatencyFrames(int id) const;
+
+    // Stages run on the mix of all sources, in the bus format. Same rules
+    // as addProcessor().
+    bool addMasterProcessor(AudioProcessor* processor);
+    void removeMasterProcessor(AudioProcessor* processor);
+
+    // Delay added by the master chain, in frames; every source hears it
+    int masterLatencyFrames() const { return m_masterChain.latencyFrames(); }
+
+    // Stages run on the sum of the source sends, in the bus format. They
+    // must add to their input rather than replace it. Same rules as
+    // addProcessor().
+    bool addSendProcessor(AudioProcessor* processor);
+    void removeSendProcessor(AudioProcessor* processor);
+
+    // Linear gain applied to a source while mixing, safe from any thread
+    void setSourceGain(int id, float gain);
+    float sourceGain(int id) const;
+
+    // Share of a source, after its gain, fed to the send chain; 0 by
+    // default. Safe from any thread.
+    void setSourceSend(int id, float level);
+    float sourceSend(int id) const;
+
+    // Threads that help run the source chains, 0 to run them all on the
+    // calling thread. Not while the bus is being read.
+    void setWorkerThreads(int threads);
+    int workerThreads() const { return m_workerPool ? m_workerPool->threadCount() : 0; }
+
+    // Time taken by each read, against the audio it rendered. Safe from
+    // any thread.
+    const CallbackStats& renderStatistics() const { return m_renderStats; }
+    void resetRenderStatistics() { m_renderStats.reset(); }
+
+    // Probe that sees every rendered period, for latency measurement
+    void setLatencyProbe(LatencyProbe* probe) { m_latencyProbe.store(probe, std::memory_order_release); }
+
+    bool isSequential() const override { return true; }
+
+protected:
+    qint64 readData(char* data, qint64 maxSize) override;
+    qint64 writeData(const char* data, qint64 maxSize) override;
+
+private:
+    struct Source {
+        std::atomic<AudioPassthrough*> device{nullptr};
+        SmoothedParameter gain{1.0f, SmoothedParameter::Exponential, kGainRampMs};
+        SmoothedParameter send{0.0f, SmoothedParameter::Linear, kGainRampMs};
+        int channelCount = 1;
+        float mixGain = 1.0f;   // what the mix still has to apply this period
+        AudioProcessorChain chain;
+
+        // Per source, so sources can be rendered on different threads
+        std::vector<qint16> scratch;
+        std::vector<float> monoScratch;
+        std::vector<float> buffer;
+    };
+
+    QAudioFormat m_format;
+    int m_channelCount = 1;
+    std::atomic<int> m_periodFrames{256};
+    std::array<Source, kMaxSources> m_sources;
+    AudioProcessorChain m_masterChain;
+    AudioProcessorChain m_sendChain;
+    const AudioKernels::KernelSet* m_kernels = nullptr;
+    std::atomic<LatencyProbe*> m_latencyProbe{nullptr};
+    std::unique_ptr<AudioWorkerPool> m_workerPool;
+    CallbackStats m_renderStats;
+
+    // Preallocated so that rendering never touches the heap
+    std::vector<float> m_accumulator;
+    std::vector<float> m_sendBuffer;
+    std::vector<float> m_sendDry;
+
+    // Sources of the period being rendered, shared with the workers
+    int m_renderIds[kMaxSources] = {};
+    bool m_renderOk[kMaxSources] = {};
+    int m_renderFrames = 0;
+
+    void renderPeriod(qint16* output, int frames);
+    static void renderSourceJob(void* bus, int index);
+    bool readSource(Source& source, int frames);
+};
+
+#endif // AUDIOMIXBUS_H
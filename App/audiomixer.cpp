@@ -1,12 +1,50 @@
 #include "audiomixer.h"
 #include <QDebug>
 
+namespace {
+
+// The media ring fill is averaged over roughly this many decoder buffers
+// before it becomes the reference the stretch rate is trimmed against
+constexpr int kFillSettleUpdates = 50;
+constexpr double kFillSmoothing = 0.05;
+
+// Rate correction per ms of fill error, and its limit. Pitch is kept, so
+// a 2% trim is inaudible.
+constexpr double kTrimPerMs = 0.0005;
+constexpr double kMaxTrim = 0.02;
+
+} // namespace
+
 AudioMixer::AudioMixer(ThreadedAudioManager* audioManager, QObject* parent)
     : QObject(parent), m_audioManager(audioManager)
 {
+    m_mediaBuffer = new AudioPassthrough(this);
+    m_mediaPitchShifter = new PitchShifter(this);
+    m_mediaVocalReducer = new VocalReducer(this);
+    m_kernels = &AudioKernels::active();
+
     if (m_audioManager) {
         m_passthrough = m_audioManager->passthrough();
+        m_mixBus = m_audioManager->mixBus();
+
+        // Media is delivered in the bus format, so the ring counts and
+        // aligns whole bus frames
+        m_mediaBuffer->setFormat(m_mixBus->format());
+        m_mediaSourceId = m_mixBus->addSource(m_mediaBuffer, m_mixBus->format().channelCount());
+        m_audioManager->setMicVolume(m_inputVolume);
+        m_mixBus->setSourceGain(m_mediaSourceId, m_mediaVolume);
+
+        // Both run all the time: the reducer ramps itself in and out, and
+        // the shifter runs even at 0 semitones, so neither toggling vocals
+        // nor a key change moves the track in time
+        m_mixBus->addProcessor(m_mediaSourceId, m_mediaVocalReducer);
+        m_mixBus->addProcessor(m_mediaSourceId, m_mediaPitchShifter);
+
+        const QAudioFormat format = m_mixBus->format();
+        m_stretcher.configure(format.sampleRate(), format.channelCount());
+        m_stretchOutput.resize(size_t(m_stretcher.hopFrames()) * format.channelCount());
     } else {
+        m_passthrough = nullptr;
         qWarning() << "AudioMixer created without a valid ThreadedAudioManager";
     }
 }
@@ -14,12 +52,21 @@ AudioMixer::AudioMixer(ThreadedAudioManager* audioManager, QObject* parent)
 AudioMixer::~AudioMixer()
 {
     disconnectMediaAudio();
+
+    if (m_mixBus) {
+        m_mixBus->removeProcessor(m_mediaSourceId, m_mediaPitchShifter);
+        m_mixBus->removeProcessor(m_mediaSourceId, m_mediaVocalReducer);
+        m_mixBus->removeSource(m_mediaSourceId);
+    }
 }
 
 void AudioMixer::setInputVolume(float volume)
 {
     if (m_inputVolume != volume) {
         m_inputVolume = volume;
+        if (m_audioManager) {
+            m_audioManager->setMicVolume(volume);
+        }
         emit inputVolumeChanged();
     }
 }
@@ -28,17 +75,74 @@ void AudioMixer::setMediaVolume(float volume)
 {
     if (m_mediaVolume != volume) {
         m_mediaVolume = volume;
+        if (m_mixBus) {
+            m_mixBus->setSourceGain(m_mediaSourceId, volume);
+        }
         emit mediaVolumeChanged();
     }
 }
 
+void AudioMixer::setMediaPlaybackRate(double rate)
+{
+    rate = qBound(TimeStretcher::kMinRate, rate, TimeStretcher::kMaxRate);
+    if (m_mediaRate.exchange(rate, std::memory_order_relaxed) != rate) {
+        // The media thread picks it up with the next buffer
+        m_restartFill.store(true, std::memory_order_release);
+    }
+}
+
+void AudioMixer::flushMedia()
+{
+    if (m_mediaBuffer) {
+        m_mediaBuffer->discardBuffered();
+    }
+    m_flushRequested.store(true, std::memory_order_release);
+}
+
+void AudioMixer::restartMediaClock()
+{
+    m_restartFill.store(true, std::memory_order_release);
+}
+
+double AudioMixer::fillTrim(int bytesPerSecond)
+{
+    // The decoder runs on the media player clock and the mix bus on the
+    // output device clock. Nudging the stretch rate keeps the media ring
+    // at the fill it settled at, so the audio stays with the video.
+    const double fillMs = 1000.0 * m_mediaBuffer->bufferedBytes() / bytesPerSecond;
+    if (m_fillUpdates == 0) {
+        m_fillAverageMs = fillMs;
+    }
+    m_fillAverageMs += kFillSmoothing * (fillMs - m_fillAverageMs);
+    if (++m_fillUpdates < kFillSettleUpdates) {
+        return 1.0;
+    }
+    if (m_fillUpdates == kFillSettleUpdates) {
+        m_fillReferenceMs = m_fillAverageMs;
+    }
+    return 1.0 + qBound(-kMaxTrim, kTrimPerMs * (m_fillAverageMs - m_fillReferenceMs), kMaxTrim);
+}
+
+QAudioFormat AudioMixer::mediaFormat() const
+{
+    if (m_mixBus) {
+        return m_mixBus->format();
+    }
+
+    QAudioFormat format;
+    format.setSampleRate(44100);
+    format.setChannelCount(2);
+    format.setSampleFormat(QAudioFormat::Int16);
+    return format;
+}
+
 void AudioMixer::connectMediaAudio(QIODevice* mediaAudioDevice)
 {
     QMutexLocker locker(&m_mutex);
     
     if (m_mediaAudioDevice != mediaAudioDevice) {
         if (m_mediaAudioDevice) {
-            disconnectMediaAudio();
+            disconnect(m_mediaAudioDevice, nullptr, this, nullptr);
         }
         
         m_mediaAudioDevice = mediaAudioDevice;
@@ -48,16 +152,12 @@ void AudioMixer::connectMediaAudio(QIODevice* mediaAudioDevice)
             connect(m_mediaAudioDevice, &QIODevice::readyRead, this, [this]() {
                 QMutexLocker locker(&m_mutex);
                 
-                if (m_mediaAudioDevice && m_passthrough) {
-                    // Read data from media audio device
-                    QByteArray mediaData = m_mediaAudioDevice->readAll();
-                    
-                    // Apply volume
-                    applyVolume(mediaData, m_mediaVolume);
-                    
-                    // Write mixed data to passthrough device
-                    if (!mediaData.isEmpty()) {
-                        m_passthrough->write(mediaData.constData(), mediaData.size());
+                if (m_mediaAudioDevice) {
+                    // Move everything available through the fixed chunk;
+                    // volume is applied by the mix bus
+                    qint64 bytesRead = 0;
+                    while ((bytesRead = m_mediaAudioDevice->read(m_mediaChunk, kMediaChunkSize)) > 0) {
+                        m_mediaBuffer->write(m_mediaChunk, bytesRead);
                     }
                 }
             });
@@ -75,76 +175,44 @@ void AudioMixer::disconnectMediaAudio()
     }
 }
 
-void AudioMixer::applyVolume(QByteArray& buffer, float volume)
+void AudioMixer::processMediaAudio(const QAudioBuffer& buffer)
 {
-    // Assuming 16-bit PCM audio (Int16)
-    if (buffer.size() < 2) {
-        return;  // Not enough data
+    // An empty buffer marks the end of the stream
+    if (!buffer.isValid() || buffer.byteCount() == 0) {
+        return;
     }
-    
-    int16_t* samples = reinterpret_cast<int16_t*>(buffer.data());
-    int sampleCount = buffer.size() / 2;  // 2 bytes per int16_t sample
-    
-    for (int i = 0; i < sampleCount; i++) {
-        // Apply volume
-        float sample = static_cast<float>(samples[i]) * volume;
-        
-        // Clamp to int16_t range
-        if (sample > 32767.0f) {
-            sample = 32767.0f;
-        } else if (sample < -32768.0f) {
-            sample = -32768.0f;
-        }
-        
-        samples[i] = static_cast<int16_t>(sample);
-    }
-}
 
-QByteArray AudioMixer::mixAudio(const QByteArray& input1, const QByteArray& input2)
-{
-    // Determine the size of the output buffer (use the smaller buffer size)
-    int outputSize = qMin(input1.size(), input2.size());
-    outputSize = outputSize - (outputSize % 2);  // Ensure even size for int16_t samples
-    
-    if (outputSize < 2) {
-        return QByteArray();  // Not enough data
-    }
-    
-    QByteArray outputBuffer(outputSize, 0);
-    int16_t* outputSamples = reinterpret_cast<int16_t*>(outputBuffer.data());
-    const int16_t* input1Samples = reinterpret_cast<const int16_t*>(input1.constData());
-    const int16_t* input2Samples = reinterpret_cast<const int16_t*>(input2.constData());
-    int sampleCount = outputSize / 2;  // 2 bytes per int16_t sample
-    
-    for (int i = 0; i < sampleCount; i++) {
-        // Mix samples
-        float mixedSample = static_cast<float>(input1Samples[i]) + static_cast<float>(input2Samples[i]);
-        
-        // Prevent clipping
-        if (mixedSample > 32767.0f) {
-            mixedSample = 32767.0f;
-        } else if (mixedSample < -32768.0f) {
-            mixedSample = -32768.0f;
+    if (buffer.format() != mediaFormat()) {
+        if (!m_formatWarningShown) {
+            qWarning() << "Dropping media audio that is not in the mix bus format";
+            m_formatWarningShown = true;
         }
-        
-        outputSamples[i] = static_cast<int16_t>(mixedSample);
+        return;
     }
-    
-    return outputBuffer;
-}
 
-void AudioMixer::processMediaAudio(const QByteArray& audioData)
-{
     QMutexLocker locker(&m_mutex);
-    
-    if (m_passthrough && !audioData.isEmpty()) {
-        // Create a copy of the audio data that we can modify
-        QByteArray processedData = audioData;
-        
-        // Apply volume adjustment
-        applyVolume(processedData, m_mediaVolume);
-        
-        // Write the processed audio data to the passthrough device
-        m_passthrough->write(processedData.constData(), processedData.size());
+
+    const QAudioFormat format = buffer.format();
+    if (m_flushRequested.exchange(false, std::memory_order_acquire)) {
+        // Buffers from the old position may have been written since the
+        // request, and the stretcher still holds its lookahead
+        m_stretcher.reset();
+        m_mediaBuffer->discardBuffered();
+        m_fillUpdates = 0;
     }
-} 
\ No newline at end of file
+    if (m_restartFill.exchange(false, std::memory_order_acquire)) {
+        m_fillUpdates = 0;
+    }
+    const double trim = fillTrim(format.bytesForDuration(1000000));
+    m_stretcher.setRate(m_mediaRate.load(std::memory_order_relaxed) * trim);
+
+    // Queue the stretched media audio on its own bus source, the output
+    // thread applies the media volume and sums it with the microphone
+    const int channels = format.channelCount();
+    m_stretcher.process(buffer.constData<qint16>(), int(buffer.frameCount()),
+                        [this, channels](const float* output, int frames) {
+        const int samples = frames * channels;
+        m_kernels->floatToInt16(m_stretchOutput.data(), output, samples);
+        m_mediaBuffer->write(reinterpret_cast<const char*>(m_stretchOutput.data()), qint64(samples) * 2);
+    });
+}
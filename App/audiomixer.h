@@ -7,9 +7,16 @@
 #include <QAudioDevice>
 #include <QAudioFormat>
 #include <QIODevice>
-#include <QByteArray>
+#include <QAudioBuffer>
 #include <QMutex>
+#include <QPointer>
+#include <atomic>
+#include <vector>
+#include "audiokernels.h"
 #include "audiopassthrough.h"
+#include "pitchshifter.h"
+#include "timestretcher.h"
+#include "vocalreducer.h"
 
 class AudioMixer : public QObject {
     Q_OBJECT
@@ -20,7 +27,7 @@ public:
     explicit AudioMixer(ThreadedAudioManager* audioManager, QObject* parent = nullptr);
     ~AudioMixer();
 
-    // Get and set input audio volume
+    // Get and set the volume of every mic
     float inputVolume() const { return m_inputVolume; }
     Q_INVOKABLE void setInputVolume(float volume);
 
@@ -28,12 +35,32 @@ public:
     float mediaVolume() const { return m_mediaVolume; }
     Q_INVOKABLE void setMediaVolume(float volume);
 
+    // Format media audio must be delivered in: the mix bus format
+    QAudioFormat mediaFormat() const;
+
     // Connect a media player's audio buffer to the mixer
     void connectMediaAudio(QIODevice* mediaAudioDevice);
     void disconnectMediaAudio();
     
-    // Process audio data from the media player
-    void processMediaAudio(const QByteArray& audioData);
+    // Process a decoded buffer from the media player, used in place
+    void processMediaAudio(const QAudioBuffer& buffer);
+
+    // Key change applied to the media source on the mix bus
+    PitchShifter* mediaPitchShifter() const { return m_mediaPitchShifter; }
+
+    // Lead vocal removal on the media source, off until enabled
+    VocalReducer* mediaVocalReducer() const { return m_mediaVocalReducer; }
+
+    // Tempo of the decoded media, which arrives rate x faster than real
+    // time; it is stretched back to real time at its original pitch
+    double mediaPlaybackRate() const { return m_mediaRate.load(std::memory_order_relaxed); }
+    void setMediaPlaybackRate(double rate);
+
+    // After a seek, source change or stop: the buffered media audio is
+    // dropped at once and the stretcher starts over with the next buffer.
+    // After a pause the ring has drained, so only the fill clock restarts.
+    void flushMedia();
+    void restartMediaClock();
 
 signals:
     void inputVolumeChanged();
@@ -43,17 +70,38 @@ private:
     ThreadedAudioManager* m_audioManager;
     AudioPassthrough* m_passthrough;
     QIODevice* m_mediaAudioDevice = nullptr;
+
+    // Media audio gets its own bus source so it is summed with the mic
+    // by the output thread instead of being appended to the mic stream
+    QPointer<AudioMixBus> m_mixBus;
+    AudioPassthrough* m_mediaBuffer = nullptr;
+    int m_mediaSourceId = -1;
+    PitchShifter* m_mediaPitchShifter = nullptr;
+    VocalReducer* m_mediaVocalReducer = nullptr;
+
+    // Tempo change on the media producer side, guarded by m_mutex
+    TimeStretcher m_stretcher;
+    std::vector<qint16> m_stretchOutput;
+    const AudioKernels::KernelSet* m_kernels = nullptr;
+    std::atomic<double> m_mediaRate{1.0};
+    std::atomic<bool> m_restartFill{false};
+    std::atomic<bool> m_flushRequested{false};
+    double m_fillAverageMs = 0.0;
+    double m_fillReferenceMs = 0.0;
+    int m_fillUpdates = 0;
+
+    double fillTrim(int bytesPerSecond);
+
+    // Staging area for connectMediaAudio, so reads never allocate
+    static constexpr int kMediaChunkSize = 16384;
+    char m_mediaChunk[kMediaChunkSize];
+    bool m_formatWarningShown = false;
     
     float m_inputVolume = 1.0f;
     float m_mediaVolume = 1.0f;
     
+    // Serialises the media producers; never taken on the audio thread
     QMutex m_mutex;
-    
-    // Apply volume to audio data
-    void applyVolume(QByteArray& buffer, float volume);
-    
-    // Mix two audio streams together
-    QByteArray mixAudio(const QByteArray& input1, const QByteArray& input2);
 };
 
 #endif // AUDIOMIXER_H 
\ No newline at end of file
@@ -1,49 +1,217 @@
 #include "audiopassthrough.h"
 #include <QMediaDevices>
+#include <QElapsedTimer>
 #include <QDebug>
+#include <QTimer>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <thread>
+#include "drifttracker.h"
+#include "realtimeaudio.h"
 
 
 //---------- AudioPassthrough Implementation ----------
 
-AudioPassthrough::AudioPassthrough(QObject *parent) : QIODevice(parent) {
-    open(QIODevice::ReadWrite);
+AudioPassthrough::AudioPassthrough(QObject *parent)
+    : QIODevice(parent), m_buffer(m_maxBufferSize) {
+    QAudioFormat format;
+    format.setSampleRate(m_sampleRate);
+    format.setChannelCount(m_channelCount);
+    format.setSampleFormat(QAudioFormat::Int16);
+    setFormat(format);
+
+    // Unbuffered so QIODevice does not keep a second copy of the stream
+    open(QIODevice::ReadWrite | QIODevice::Unbuffered);
+}
+
+void AudioPassthrough::setFormat(const QAudioFormat &format) {
+    if (format.sampleFormat() != QAudioFormat::Int16 || format.channelCount() < 1 || format.sampleRate() <= 0) {
+        qWarning() << "AudioPassthrough carries Int16 only, got" << format;
+        return;
+    }
+    const double budgetMs = latencyBudgetMs();
+    m_sampleRate = format.sampleRate();
+    m_channelCount = format.channelCount();
+    m_frameBytes = format.bytesPerFrame();
+
+    // 5 ms equal power crossfade: the audio either side of a skip is
+    // unrelated, so their powers add
+    m_crossfadeFrames = qBound(16, m_sampleRate / 200, kMaxCrossfadeFrames);
+    m_fadeOut.assign(size_t(m_crossfadeFrames) * m_channelCount, 0);
+    m_fadeIn.assign(size_t(m_crossfadeFrames) * m_channelCount, 0);
+    m_fadeCurve.resize(size_t(m_crossfadeFrames));
+    for (int i = 0; i < m_crossfadeFrames; ++i) {
+        m_fadeCurve[size_t(i)] = float(std::sin(0.5 * M_PI * (i + 0.5) / m_crossfadeFrames));
+    }
+    setLatencyBudgetMs(budgetMs);
+}
+
+void AudioPassthrough::setLatencyBudgetMs(double ms) {
+    // Never below what a catch-up needs to work with
+    const int frames = ms > 0.0 ? qMax(4 * m_crossfadeFrames, int(ms * m_sampleRate / 1000.0)) : 0;
+    m_budgetFrames.store(frames, std::memory_order_relaxed);
+}
+
+AudioPassthrough::Statistics AudioPassthrough::statistics() const {
+    Statistics stats;
+    stats.fillMs = 1000.0 * double(bufferedBytes() / m_frameBytes) / m_sampleRate;
+    stats.catchUps = m_catchUps.load(std::memory_order_relaxed);
+    stats.skippedFrames = m_skippedFrames.load(std::memory_order_relaxed);
+    stats.overrunFrames = m_overrunFrames.load(std::memory_order_relaxed);
+    stats.droppedBytes = stats.overrunFrames * m_frameBytes;
+    stats.underruns = m_underruns.load(std::memory_order_relaxed);
+    stats.underrunFrames = m_underrunFrames.load(std::memory_order_relaxed);
+    return stats;
+}
+
+qint64 AudioPassthrough::bytesAvailable() const {
+    return qint64(m_buffer.readAvailable()) + QIODevice::bytesAvailable();
 }
 
 qint64 AudioPassthrough::readData(char *data, qint64 maxSize) {
-    QMutexLocker locker(&m_mutex);
+    return readRaw(data, maxSize);
+}
 
-    qint64 bytesToRead = qMin(maxSize, qint64(m_buffer.size()));
-    if (bytesToRead > 0) {
-        // Copy data from our buffer to the output buffer
-        memcpy(data, m_buffer.constData(), bytesToRead);
+qint64 AudioPassthrough::readRaw(char *data, qint64 maxSize) {
+    // Copy out whatever the writer has published, no lock and no memmove
+    m_buffer.skipTo(m_discardPosition.load(std::memory_order_acquire), size_t(m_frameBytes));
+    const qint64 fill = bufferedBytes() / m_frameBytes;
+    const qint64 wanted = maxSize / m_frameBytes;
+    if (wanted <= 0) {
+        return 0;
+    }
+    m_fillHistogram.add(1000.0 * double(fill) / m_sampleRate);
+    if (fill < wanted) {
+        m_underruns.store(m_underruns.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        m_underrunFrames.store(m_underrunFrames.load(std::memory_order_relaxed) + (wanted - fill), std::memory_order_relaxed);
+    }
 
-        // Remove read data from our buffer
-        m_buffer.remove(0, bytesToRead);
+    const int budget = m_budgetFrames.load(std::memory_order_relaxed);
+    if (budget > 0 && fill > budget) {
+        // Down to half the budget, leaving this read its frames
+        const qint64 excess = qMin(fill - budget / 2, fill - wanted);
+        if (excess >= m_crossfadeFrames) {
+            return catchUp(data, wanted, excess);
+        }
     }
-    return bytesToRead;
+    return qint64(m_buffer.read(data, size_t(qMin(fill, wanted) * m_frameBytes)));
+}
+
+qint64 AudioPassthrough::catchUp(char *data, qint64 wanted, qint64 excess) {
+    // The first frames of the read cross from the audio due now into the
+    // audio excess frames later; the frames in between are skipped
+    const int fade = int(qMin<qint64>(wanted, m_crossfadeFrames));
+    const size_t fadeBytes = size_t(fade) * size_t(m_frameBytes);
+    m_buffer.read(reinterpret_cast<char *>(m_fadeOut.data()), fadeBytes);
+    m_buffer.skip(size_t(excess - fade) * size_t(m_frameBytes));
+    m_buffer.read(reinterpret_cast<char *>(m_fadeIn.data()), fadeBytes);
+
+    // A fade shorter than the crossfade still ends on the new audio
+    for (int frame = 0; frame < fade; ++frame) {
+        const float in = m_fadeCurve[size_t(frame * m_crossfadeFrames / fade)];
+        const float out = m_fadeCurve[size_t(m_crossfadeFrames - 1 - frame * m_crossfadeFrames / fade)];
+        qint16 *samples = m_fadeIn.data() + size_t(frame) * m_channelCount;
+        const qint16 *old = m_fadeOut.data() + size_t(frame) * m_channelCount;
+        for (int channel = 0; channel < m_channelCount; ++channel) {
+            const float mixed = samples[channel] * in + old[channel] * out;
+            samples[channel] = qint16(qBound(-32768.0f, mixed, 32767.0f));
+        }
+    }
+    std::memcpy(data, m_fadeIn.data(), fadeBytes);
+
+    const qint64 rest = m_buffer.read(data + fadeBytes, size_t(wanted - fade) * size_t(m_frameBytes));
+    m_catchUps.fetch_add(1, std::memory_order_relaxed);
+    m_skippedFrames.fetch_add(excess, std::memory_order_relaxed);
+    return qint64(fadeBytes) + rest;
 }
 
 qint64 AudioPassthrough::writeData(const char *data, qint64 maxSize) {
-    QMutexLocker locker(&m_mutex);
-    if (m_buffer.size() + maxSize > m_maxBufferSize) {
-        // Buffer is too large, drop oldest data
-        int bytesToDrop = (m_buffer.size() + maxSize) - m_maxBufferSize;
-        m_buffer.remove(0, bytesToDrop);
-    }
-    
-    m_buffer.append(data, maxSize);
+    if (LatencyProbe *probe = m_latencyProbe.load(std::memory_order_acquire)) {
+        data = probe->processCapture(data, maxSize);
+    }
+
+    // The reader owns the read index, so on overrun we drop the newest data
+    // instead of the oldest, in whole frames so the rest stays aligned. The
+    // source still sees a full write.
+    size_t count = size_t(maxSize);
+    const size_t free = m_buffer.writeAvailable();
+    if (free < count) {
+        const size_t fits = free / size_t(m_frameBytes) * size_t(m_frameBytes);
+        m_overrunFrames.fetch_add(qint64((count - fits) / size_t(m_frameBytes)), std::memory_order_relaxed);
+        count = fits;
+    }
+    m_buffer.write(data, count);
+
     // Signal that data is available to be read
     emit readyRead();
 
-    // Emit signal that new data was written
+    return maxSize;
+}
+
+//---------- CaptureSplitter Implementation ----------
+
+CaptureSplitter::CaptureSplitter(QObject* parent) : QIODevice(parent) {
+    open(QIODevice::WriteOnly | QIODevice::Unbuffered);
+}
+
+void CaptureSplitter::setTargets(const QList<AudioPassthrough*>& targets) {
+    m_targets = targets.mid(0, kMaxChannels);
+    m_partialBytes = 0;
+}
+
+qint64 CaptureSplitter::readData(char* data, qint64 maxSize) {
+    Q_UNUSED(data);
+    Q_UNUSED(maxSize);
+    return -1;
+}
+
+qint64 CaptureSplitter::writeData(const char* data, qint64 maxSize) {
+    const int frameBytes = channelCount() * int(sizeof(qint16));
+    if (frameBytes == 0) {
+        return maxSize;
+    }
 
+    const char* in = data;
+    qint64 remaining = maxSize;
+    if (m_partialBytes > 0) {
+        const int taken = int(qMin<qint64>(frameBytes - m_partialBytes, remaining));
+        std::memcpy(m_partial + m_partialBytes, in, size_t(taken));
+        m_partialBytes += taken;
+        in += taken;
+        remaining -= taken;
+        if (m_partialBytes < frameBytes) {
+            return maxSize;
+        }
+        split(m_partial, 1);
+        m_partialBytes = 0;
+    }
+
+    const qint64 frames = remaining / frameBytes;
+    for (qint64 done = 0; done < frames; done += kChunkFrames) {
+        split(in + done * frameBytes, int(qMin<qint64>(kChunkFrames, frames - done)));
+    }
+
+    m_partialBytes = int(remaining - frames * frameBytes);
+    std::memcpy(m_partial, in + frames * frameBytes, size_t(m_partialBytes));
     return maxSize;
 }
 
+void CaptureSplitter::split(const char* frames, int count) {
+    const int channels = channelCount();
+    for (int channel = 0; channel < channels; ++channel) {
+        // The capture buffer need not be aligned for qint16
+        for (int frame = 0; frame < count; ++frame) {
+            std::memcpy(&m_chunk[frame], frames + (size_t(frame) * channels + channel) * sizeof(qint16), sizeof(qint16));
+        }
+        m_targets[channel]->write(reinterpret_cast<const char*>(m_chunk), qint64(count) * qint64(sizeof(qint16)));
+    }
+}
+
 //---------- AudioInputThread Implementation ----------
 
-AudioInputThread::AudioInputThread(AudioPassthrough* passthrough, QObject* parent)
-    : QThread(parent), m_passthrough(passthrough) {
+AudioInputThread::AudioInputThread(QIODevice* target, QObject* parent)
+    : QThread(parent), m_target(target) {
 
     // Set default format
     m_format.setSampleRate(44100);
@@ -56,6 +224,22 @@ AudioInputThread::~AudioInputThread() {
     wait(); // Wait for thread to finish
 }
 
+void AudioInputThread::setTarget(QIODevice* target) {
+    if (!isRunning()) {
+        m_target = target;
+    } else {
+        qWarning() << "Cannot change target while thread is running";
+    }
+}
+
+void AudioInputThread::setDevice(const QAudioDevice& device) {
+    if (!isRunning()) {
+        m_device = device;
+    } else {
+        qWarning() << "Cannot change device while thread is running";
+    }
+}
+
 void AudioInputThread::setFormat(const QAudioFormat& format) {
     if (!isRunning()) {
         m_format = format;
@@ -64,32 +248,128 @@ void AudioInputThread::setFormat(const QAudioFormat& format) {
     }
 }
 
+void AudioInputThread::setConversionQuality(Resampler::Quality quality) {
+    if (!isRunning()) {
+        m_conversionQuality = quality;
+    } else {
+        qWarning() << "Cannot change conversion quality while thread is running";
+    }
+}
+
+void AudioInputThread::setDriftCompensation(AudioPassthrough* ring) {
+    if (!isRunning()) {
+        m_driftRing = ring;
+    } else {
+        qWarning() << "Cannot change drift compensation while thread is running";
+    }
+}
+
+void AudioInputThread::setBufferSize(qsizetype bytes) {
+    if (!isRunning()) {
+        m_bufferSize = bytes;
+    } else {
+        qWarning() << "Cannot change buffer size while thread is running";
+    }
+}
+
 void AudioInputThread::run() {
+    RealtimeAudio::setupAudioThread();
+
     // Create audio input device in this thread
-    QAudioDevice inputDevice = QMediaDevices::defaultAudioInput();
+    const QAudioDevice inputDevice = m_device.isNull() ? QMediaDevices::defaultAudioInput() : m_device;
+    QAudioFormat deviceFormat = m_format;
     if (!inputDevice.isFormatSupported(m_format)) {
-        qWarning() << "Default input format not supported, trying to use nearest";
-        m_format = inputDevice.preferredFormat();
+        deviceFormat = inputDevice.preferredFormat();
+        qWarning() << inputDevice.description() << "does not support the input format, converting from" << deviceFormat;
+    }
+
+    // Capture what the device offers and convert it, the target and
+    // everything reading it stay at m_format. Drift compensation always
+    // needs the resampler. Audio that cannot be converted is not captured
+    // at all: the ring is read at m_format, so it would play at the wrong
+    // speed and pitch.
+    QIODevice* sink = m_target;
+    m_driftPpm.store(0.0, std::memory_order_relaxed);
+    if (deviceFormat != m_format || m_driftRing) {
+        m_converter = new FormatConverter();
+        if (!m_converter->configure(deviceFormat, m_format, m_conversionQuality, m_driftRing != nullptr)) {
+            qWarning() << "Cannot convert the capture of" << inputDevice.description() << "from" << deviceFormat
+                       << "to" << m_format << "- input not started";
+            m_deviceState.record(QAudio::StoppedState, QAudio::OpenError);
+            delete m_converter;
+            m_converter = nullptr;
+            return;
+        }
+        m_converter->setTarget(m_target);
+        sink = m_converter;
     }
 
     // Create audio source
-    m_audioSource = new QAudioSource(inputDevice, m_format);
+    m_audioSource = new QAudioSource(inputDevice, deviceFormat);
+    if (m_bufferSize > 0) {
+        m_audioSource->setBufferSize(deviceFormat.bytesForDuration(m_format.durationForBytes(qint32(m_bufferSize))));
+    }
+
+    connect(m_audioSource, &QAudioSource::stateChanged, m_audioSource, [this](QAudio::State state) {
+        m_deviceState.record(state, m_audioSource->error());
+    });
 
-    // Start capturing
+    // Start capturing. Reading the capture here rather than letting the
+    // source push it gives each capture callback a place to be timed.
     m_running = true;
-    m_audioSource->start(m_passthrough);
+    QIODevice* capture = m_audioSource->start();
+    m_captureScratch.assign(size_t(qMax<qsizetype>(4096, m_audioSource->bufferSize())), 0);
+    if (capture) {
+        connect(capture, &QIODevice::readyRead, capture, [this, capture, sink, deviceFormat]() {
+            RealtimeAudio::AuditScope audit;
+            using Clock = std::chrono::steady_clock;
+            const auto start = Clock::now();
+            qint64 bytes = 0;
+            qint64 count = 0;
+            while ((count = capture->read(m_captureScratch.data(), qint64(m_captureScratch.size()))) > 0) {
+                sink->write(m_captureScratch.data(), count);
+                bytes += count;
+            }
+            const qint64 elapsedNs = std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start).count();
+            m_captureStats.record(elapsedNs, deviceFormat.durationForBytes(qint32(bytes)) * 1000);
+        });
+    }
+    qsizetype actual = m_format.bytesForDuration(deviceFormat.durationForBytes(qint32(m_audioSource->bufferSize())));
+    if (m_converter) {
+        actual += m_format.bytesForFrames(m_converter->latencyFrames());
+    }
+    m_actualBufferSize.store(actual, std::memory_order_relaxed);
+
+    // Steer the capture rate from the fill of the ring, on this thread like
+    // the writes into the converter
+    QTimer driftTimer;
+    QElapsedTimer driftClock;
+    DriftTracker drift;
+    if (m_converter && m_driftRing) {
+        connect(&driftTimer, &QTimer::timeout, &driftTimer, [this, &drift, &driftClock]() {
+            const double fillMs = m_format.durationForBytes(qint32(m_driftRing->bufferedBytes())) / 1000.0;
+            m_converter->setRateTrim(drift.update(fillMs, driftClock.restart() / 1000.0));
+            m_driftPpm.store(drift.driftPpm(), std::memory_order_relaxed);
+        });
+        driftTimer.start(100);
+        driftClock.start();
+    }
 
     qDebug() << "Audio input thread started";
 
     // Run event loop for this thread
     exec();
+    driftTimer.stop();
 
     // Clean up when event loop exits
+    m_actualBufferSize.store(0, std::memory_order_relaxed);
     if (m_audioSource) {
         m_audioSource->stop();
         delete m_audioSource;
         m_audioSource = nullptr;
     }
+    delete m_converter;
+    m_converter = nullptr;
 
     qDebug() << "Audio input thread stopped";
 }
@@ -103,8 +383,8 @@ void AudioInputThread::stop() {
 
 //---------- AudioOutputThread Implementation ----------
 
-AudioOutputThread::AudioOutputThread(AudioPassthrough* passthrough, QObject* parent)
-    : QThread(parent), m_passthrough(passthrough) {
+AudioOutputThread::AudioOutputThread(QIODevice* source, QObject* parent)
+    : QThread(parent), m_source(source) {
 
     // Set default format
     m_format.setSampleRate(44100);
@@ -125,7 +405,17 @@ void AudioOutputThread::setFormat(const QAudioFormat& format) {
     }
 }
 
+void AudioOutputThread::setBufferSize(qsizetype bytes) {
+    if (!isRunning()) {
+        m_bufferSize = bytes;
+    } else {
+        qWarning() << "Cannot change buffer size while thread is running";
+    }
+}
+
 void AudioOutputThread::run() {
+    RealtimeAudio::setupAudioThread();
+
     // Create audio output device in this thread
     QAudioDevice outputDevice = QMediaDevices::defaultAudioOutput();
     if (!outputDevice.isFormatSupported(m_format)) {
@@ -134,10 +424,18 @@ void AudioOutputThread::run() {
 
     // Create audio sink
     m_audioSink = new QAudioSink(outputDevice, m_format);
+    if (m_bufferSize > 0) {
+        m_audioSink->setBufferSize(m_bufferSize);
+    }
+
+    connect(m_audioSink, &QAudioSink::stateChanged, m_audioSink, [this](QAudio::State state) {
+        m_deviceState.record(state, m_audioSink->error());
+    });
 
-    // Start playback
+    // Start playback in pull mode, the sink asks the source for each period
     m_running = true;
-    m_audioSink->start(m_passthrough);
+    m_audioSink->start(m_source);
+    m_actualBufferSize.store(m_audioSink->bufferSize(), std::memory_order_relaxed);
 
     qDebug() << "Audio output thread started";
 
@@ -145,6 +443,7 @@ void AudioOutputThread::run() {
     exec();
 
     // Clean up when event loop exits
+    m_actualBufferSize.store(0, std::memory_order_relaxed);
     if (m_audioSink) {
         m_audioSink->stop();
         delete m_audioSink;
@@ -161,50 +460,652 @@ void AudioOutputThread::stop() {
     }
 }
 
+//---------- OfflineAudioThread Implementation ----------
+
+OfflineAudioThread::OfflineAudioThread(AudioPassthrough* capture, QIODevice* playback, QObject* parent)
+    : QThread(parent), m_capture(capture), m_playback(playback) {
+}
+
+OfflineAudioThread::~OfflineAudioThread() {
+    stop();
+    wait(); // Wait for thread to finish
+}
+
+void OfflineAudioThread::setSource(OfflineAudioSource* source, const QAudioFormat& format) {
+    if (!isRunning()) {
+        m_source = source;
+        m_sourceFormat = format;
+    } else {
+        qWarning() << "Cannot change the offline source while thread is running";
+    }
+}
+
+void OfflineAudioThread::setSink(OfflineAudioSink* sink, const QAudioFormat& format) {
+    if (!isRunning()) {
+        m_sink = sink;
+        m_sinkFormat = format;
+    } else {
+        qWarning() << "Cannot change the offline sink while thread is running";
+    }
+}
+
+void OfflineAudioThread::setPacing(Pacing pacing) {
+    if (!isRunning()) {
+        m_pacing = pacing;
+    } else {
+        qWarning() << "Cannot change pacing while thread is running";
+    }
+}
+
+void OfflineAudioThread::setPeriodFrames(int frames) {
+    if (!isRunning()) {
+        m_periodFrames = qBound(16, frames, int(AudioMixBus::kMaxPeriodFrames));
+    } else {
+        qWarning() << "Cannot change period size while thread is running";
+    }
+}
+
+void OfflineAudioThread::setFrameLimit(qint64 frames) {
+    if (!isRunning()) {
+        m_frameLimit = qMax<qint64>(0, frames);
+    } else {
+        qWarning() << "Cannot change frame limit while thread is running";
+    }
+}
+
+void OfflineAudioThread::run() {
+    using Clock = std::chrono::steady_clock;
+    RealtimeAudio::setupAudioThread();
+
+    // Sized once, the loop below does not allocate
+    m_captureScratch.assign(size_t(m_periodFrames) * qMax(1, m_sourceFormat.channelCount()), 0);
+    m_playbackScratch.assign(size_t(m_periodFrames) * qMax(1, m_sinkFormat.channelCount()), 0);
+    const qint64 captureBytes = qint64(m_captureScratch.size() * sizeof(qint16));
+    const qint64 playbackBytes = qint64(m_playbackScratch.size() * sizeof(qint16));
+
+    // Pace against the side that owns the clock
+    const int sampleRate = m_sink ? m_sinkFormat.sampleRate() : m_sourceFormat.sampleRate();
+    const auto period = std::chrono::duration_cast<Clock::duration>(
+        std::chrono::duration<double>(double(m_periodFrames) / qMax(1, sampleRate)));
+
+    m_framesProcessed.store(0, std::memory_order_relaxed);
+    m_running.store(true, std::memory_order_release);
+
+    qDebug() << "Offline audio thread started,"
+             << (m_source ? m_source->description() : QStringLiteral("device")) << "->"
+             << (m_sink ? m_sink->description() : QStringLiteral("device"))
+             << (m_pacing == RealTime ? "in real time" : "as fast as possible");
+
+    QElapsedTimer wallClock;
+    wallClock.start();
+    auto deadline = Clock::now();
+    qint64 frames = 0;
+
+    while (m_running.load(std::memory_order_acquire)) {
+        // The bus renders whole periods, so the limit is rounded up to one
+        if (m_frameLimit > 0 && frames >= m_frameLimit) {
+            break;
+        }
+        const int periodFrames = m_periodFrames;
+
+        bool endOfStream = false;
+        if (m_source) {
+            const int produced = m_source->read(m_captureScratch.data(), periodFrames);
+            if (produced < periodFrames) {
+                // Pad the last period so the sink still gets whole periods
+                const int channels = m_sourceFormat.channelCount();
+                std::fill(m_captureScratch.begin() + qMax(0, produced) * channels, m_captureScratch.end(), 0);
+                endOfStream = true;
+            }
+            RealtimeAudio::AuditScope audit;
+            m_capture->write(reinterpret_cast<const char*>(m_captureScratch.data()), captureBytes);
+        }
+
+        if (m_sink) {
+            // The backends stand in for devices, only the pipeline is audited
+            qint64 bytesRead = 0;
+            {
+                RealtimeAudio::AuditScope audit;
+                bytesRead = m_playback->read(reinterpret_cast<char*>(m_playbackScratch.data()), playbackBytes);
+            }
+            if (bytesRead > 0) {
+                m_sink->write(m_playbackScratch.data(), int(bytesRead / m_sinkFormat.bytesPerFrame()));
+            }
+        }
+
+        frames += periodFrames;
+        m_framesProcessed.store(frames, std::memory_order_relaxed);
+
+        if (endOfStream) {
+            break;
+        }
+
+        if (m_pacing == RealTime) {
+            deadline += period;
+            std::this_thread::sleep_until(deadline);
+        }
+    }
+
+    m_running.store(false, std::memory_order_release);
+    if (m_sink) {
+        m_sink->close();
+    }
+
+    const double wallSeconds = wallClock.nsecsElapsed() / 1e9;
+    const double audioSeconds = double(frames) / qMax(1, sampleRate);
+    const double realtimeFactor = wallSeconds > 0.0 ? audioSeconds / wallSeconds : 0.0;
+
+    qDebug() << "Offline audio thread stopped after" << frames << "frames," << realtimeFactor << "x realtime";
+    emit runFinished(frames, realtimeFactor);
+}
+
+void OfflineAudioThread::stop() {
+    m_running.store(false, std::memory_order_release);
+}
+
 //---------- ThreadedAudioManager Implementation ----------
 
 ThreadedAudioManager::ThreadedAudioManager(QObject* parent) : QObject(parent) {
-    // Create the passthrough device
-    m_passthrough = new AudioPassthrough(this);
-
     // Set default format
     m_inputformat.setSampleRate(44100);
     m_inputformat.setChannelCount(1);
     m_inputformat.setSampleFormat(QAudioFormat::Int16);
     m_outputformat.setSampleRate(44100);
-    m_outputformat.setChannelCount(1);
+    m_outputformat.setChannelCount(2);
     m_outputformat.setSampleFormat(QAudioFormat::Int16);
 
+    // The output plays the mix bus; the first mic is its first source
+    m_mixBus = new AudioMixBus(m_outputformat, this);
+    MicChannel* firstMic = addMic(QStringLiteral("Mic 1"));
+    m_passthrough = firstMic->passthrough();
+    m_micSourceId = firstMic->sourceId();
+
+    m_pitchAnalyzer = new PitchAnalyzer(this);
+    m_pitchAnalyzer->setBypassed(true);
+    m_mixBus->addProcessor(m_micSourceId, m_pitchAnalyzer);
+
+    m_pitchCorrector = new PitchCorrector(this);
+    m_pitchCorrector->setBypassed(true);
+    m_mixBus->addProcessor(m_micSourceId, m_pitchCorrector);
+
+    // Never bypassed: they fade themselves in and out and idle when off
+    m_echoDelay = new EchoDelay(this);
+    m_mixBus->addSendProcessor(m_echoDelay);
+    m_reverb = new FdnReverb(this);
+    m_mixBus->addSendProcessor(m_reverb);
+
+    // Instead of hard clipping on conversion
+    m_limiter = new PeakLimiter(this);
+    m_mixBus->addMasterProcessor(m_limiter);
+
     // Create threads
     m_inputThread = new AudioInputThread(m_passthrough, this);
-    m_outputThread = new AudioOutputThread(m_passthrough, this);
+    m_splitter = new CaptureSplitter(this);
+    m_outputThread = new AudioOutputThread(m_mixBus, this);
+    m_offlineThread = new OfflineAudioThread(m_passthrough, m_mixBus, this);
+    connect(m_offlineThread, &OfflineAudioThread::runFinished, this, &ThreadedAudioManager::offlineRunFinished);
 
     // Set formats
     m_inputThread->setFormat(m_inputformat);
+    m_inputThread->setDriftCompensation(m_passthrough);
     m_outputThread->setFormat(m_outputformat);
+
+    // Pick the period count for the default latency target
+    m_periodCount = qBound(2, qRound(m_targetLatencyMs / periodMs()) - 1, 16);
+
+    // Measurement bursts go in with the mic and come out of the bus
+    m_latencyProbe = new LatencyProbe(this);
+    m_latencyProbe->configure(m_inputformat, m_outputformat);
+    m_passthrough->setLatencyProbe(m_latencyProbe);
+    m_mixBus->setLatencyProbe(m_latencyProbe);
+    connect(m_latencyProbe, &LatencyProbe::measurementAdded, this, &ThreadedAudioManager::latencyMeasurementChanged);
+
+    m_stats = new AudioStats(this);
+    updateStatsStreams();
+
+    m_latencyTimer = new QTimer(this);
+    m_latencyTimer->setInterval(250);
+    connect(m_latencyTimer, &QTimer::timeout, this, &ThreadedAudioManager::updateAchievedLatency);
+    connect(m_latencyTimer, &QTimer::timeout, this, &ThreadedAudioManager::updateClockDrift);
+    connect(m_latencyTimer, &QTimer::timeout, this, &ThreadedAudioManager::updateBacklog);
+    connect(m_latencyTimer, &QTimer::timeout, m_stats, &AudioStats::update);
 }
 
 ThreadedAudioManager::~ThreadedAudioManager() {
     stop();
+
+    // Before the mics they write into go with the other children
+    qDeleteAll(m_extraInputThreads);
+    m_extraInputThreads.clear();
 }
 
 void ThreadedAudioManager::start() {
-    // Start threads
-    m_inputThread->start(QThread::TimeCriticalPriority);
-    m_outputThread->start(QThread::TimeCriticalPriority);
+    applyBufferSizes();
+
+    // Before the threads start, so locking in the pipeline cannot stall them
+    if (RealtimeAudio::options().enabled) {
+        m_memoryLocked = RealtimeAudio::lockMemory();
+    }
+
+    // Start threads, offline backends stand in for the devices they replace
+    if (!m_offlineSource) {
+        m_inputThread->start(QThread::TimeCriticalPriority);
+        for (AudioInputThread* thread : std::as_const(m_extraInputThreads)) {
+            thread->start(QThread::TimeCriticalPriority);
+        }
+    }
+    if (!m_offlineSink) {
+        m_outputThread->start(QThread::TimeCriticalPriority);
+    }
+    if (m_offlineSource || m_offlineSink) {
+        m_offlineThread->start(QThread::TimeCriticalPriority);
+    }
+
+    m_started = true;
+    m_latencyTimer->start();
 
-    qDebug() << "Audio manager started";
+    qDebug() << "Audio manager started," << m_periodFrames << "frame periods x" << m_periodCount;
 }
 
 void ThreadedAudioManager::stop() {
+    if (m_started && m_stats) {
+        m_stats->finish();
+    }
+    m_started = false;
+    if (m_latencyTimer) {
+        m_latencyTimer->stop();
+    }
+
     // Stop threads
     if (m_inputThread) {
         m_inputThread->stop();
     }
+    for (AudioInputThread* thread : std::as_const(m_extraInputThreads)) {
+        thread->stop();
+    }
 
     if (m_outputThread) {
         m_outputThread->stop();
     }
 
+    if (m_offlineThread) {
+        m_offlineThread->stop();
+    }
+
+    if (m_memoryLocked) {
+        RealtimeAudio::unlockMemory();
+        m_memoryLocked = false;
+    }
+
     qDebug() << "Audio manager stopped";
 }
+
+bool ThreadedAudioManager::setOfflineBackends(std::unique_ptr<OfflineAudioSource> source,
+                                              std::unique_ptr<OfflineAudioSink> sink,
+                                              OfflineAudioThread::Pacing pacing) {
+    if (m_started) {
+        qWarning() << "Cannot change audio backends while running";
+        return false;
+    }
+
+    if (source && !source->open(m_inputformat)) {
+        qWarning() << "Cannot open audio input" << source->description();
+        return false;
+    }
+    if (sink && !sink->open(m_outputformat)) {
+        qWarning() << "Cannot open audio output" << sink->description();
+        return false;
+    }
+
+    // A device on either side sets the pace, so the offline side must follow it
+    if (!source || !sink) {
+        pacing = OfflineAudioThread::RealTime;
+    }
+
+    // With no device on either side, time only exists as frames
+    m_latencyProbe->setVirtualClock(source && sink);
+
+    m_offlineSource = std::move(source);
+    m_offlineSink = std::move(sink);
+    m_offlineThread->setSource(m_offlineSource.get(), m_inputformat);
+    m_offlineThread->setSink(m_offlineSink.get(), m_outputformat);
+    m_offlineThread->setPacing(pacing);
+    return true;
+}
+
+MicChannel* ThreadedAudioManager::addMic(const QString& name) {
+    MicChannel* mic = new MicChannel(int(m_mics.size()), name, m_mixBus, this);
+    if (!mic->isValid()) {
+        delete mic;
+        return nullptr;
+    }
+    mic->setMasterGain(m_micVolume);
+    m_mics.append(mic);
+    return mic;
+}
+
+void ThreadedAudioManager::removeExtraMics() {
+    // Threads first, they write into the mics' rings
+    qDeleteAll(m_extraInputThreads);
+    m_extraInputThreads.clear();
+    while (m_mics.size() > 1) {
+        delete m_mics.takeLast();
+    }
+}
+
+void ThreadedAudioManager::updateWorkerThreads() {
+    // The strips only run in parallel once there are enough sources, the
+    // media track included; leave a core each for the output thread and
+    // the decoder
+    const int sources = int(m_mics.size()) + 1;
+    const int spareCores = qMax(0, QThread::idealThreadCount() - 2);
+    m_mixBus->setWorkerThreads(sources >= AudioMixBus::kMinParallelSources ? qMin(sources - 1, spareCores) : 0);
+}
+
+void ThreadedAudioManager::updateStatsStreams() {
+    // Offline backends leave their device thread idle, which then reports nothing
+    QList<AudioInputThread*> inputs = {m_inputThread};
+    inputs.append(m_extraInputThreads);
+    QList<AudioPassthrough*> rings;
+    for (MicChannel* mic : std::as_const(m_mics)) {
+        rings.append(mic->passthrough());
+    }
+    m_stats->setStreams(m_mixBus, m_outputThread, inputs, rings);
+}
+
+bool ThreadedAudioManager::setMicDevices(const QList<QAudioDevice>& devices) {
+    if (m_started) {
+        qWarning() << "Cannot change the mics while running";
+        return false;
+    }
+    if (devices.isEmpty() || devices.size() > kMaxMics) {
+        qWarning() << "Need 1 to" << kMaxMics << "mic devices, got" << devices.size();
+        return false;
+    }
+
+    removeExtraMics();
+    m_inputThread->setTarget(m_passthrough);
+    m_inputThread->setDevice(devices.first());
+    m_inputThread->setFormat(m_inputformat);
+    m_mics.first()->setName(devices.first().description());
+
+    bool complete = true;
+    for (qsizetype i = 1; i < devices.size(); ++i) {
+        MicChannel* mic = addMic(devices[i].description());
+        if (!mic) {
+            complete = false;
+            break;
+        }
+        AudioInputThread* thread = new AudioInputThread(mic->passthrough(), this);
+        thread->setDevice(devices[i]);
+        thread->setFormat(m_inputformat);
+        thread->setConversionQuality(m_conversionQuality);
+        thread->setDriftCompensation(m_driftCompensation ? mic->passthrough() : nullptr);
+        m_extraInputThreads.append(thread);
+    }
+
+    updateWorkerThreads();
+    updateStatsStreams();
+    emit micsChanged();
+    return complete;
+}
+
+bool ThreadedAudioManager::setMicChannels(int channels) {
+    if (m_started) {
+        qWarning() << "Cannot change the mics while running";
+        return false;
+    }
+    if (channels < 1 || channels > kMaxMics) {
+        qWarning() << "Need 1 to" << kMaxMics << "mic channels, got" << channels;
+        return false;
+    }
+
+    removeExtraMics();
+    bool complete = true;
+    for (int channel = 1; channel < channels; ++channel) {
+        if (!addMic(QStringLiteral("Channel %1").arg(channel + 1))) {
+            complete = false;
+            break;
+        }
+    }
+
+    // Mono needs no splitting, the capture writes mic 0 directly
+    QAudioFormat format = m_inputformat;
+    if (m_mics.size() > 1) {
+        QList<AudioPassthrough*> targets;
+        for (MicChannel* mic : std::as_const(m_mics)) {
+            targets.append(mic->passthrough());
+        }
+        m_splitter->setTargets(targets);
+        format.setChannelCount(int(m_mics.size()));
+        m_inputThread->setTarget(m_splitter);
+        m_mics.first()->setName(QStringLiteral("Channel 1"));
+    } else {
+        m_inputThread->setTarget(m_passthrough);
+        m_mics.first()->setName(QStringLiteral("Mic 1"));
+    }
+    m_inputThread->setFormat(format);
+
+    updateWorkerThreads();
+    updateStatsStreams();
+    emit micsChanged();
+    return complete;
+}
+
+void ThreadedAudioManager::setMicVolume(double volume) {
+    m_micVolume = volume;
+    for (MicChannel* mic : std::as_const(m_mics)) {
+        mic->setMasterGain(volume);
+    }
+}
+
+void ThreadedAudioManager::setConversionQuality(Resampler::Quality quality) {
+    if (m_started) {
+        qWarning() << "Cannot change the conversion quality while running";
+        return;
+    }
+    m_conversionQuality = quality;
+    m_inputThread->setConversionQuality(quality);
+    for (AudioInputThread* thread : std::as_const(m_extraInputThreads)) {
+        thread->setConversionQuality(quality);
+    }
+}
+
+void ThreadedAudioManager::setDriftCompensation(bool enabled) {
+    if (m_started) {
+        qWarning() << "Cannot change drift compensation while running";
+        return;
+    }
+    if (m_driftCompensation == enabled) {
+        return;
+    }
+    m_driftCompensation = enabled;
+    m_inputThread->setDriftCompensation(enabled ? m_passthrough : nullptr);
+    for (int i = 0; i < m_extraInputThreads.size(); ++i) {
+        m_extraInputThreads[i]->setDriftCompensation(enabled ? m_mics[i + 1]->passthrough() : nullptr);
+    }
+    emit driftCompensationChanged();
+}
+
+void ThreadedAudioManager::setRealtimeOptions(const RealtimeAudio::Options& options) {
+    if (m_started) {
+        qWarning() << "Cannot change the realtime options while running";
+        return;
+    }
+    RealtimeAudio::setOptions(options);
+
+    // The bus workers set themselves up as they start, so start them again
+    m_mixBus->setWorkerThreads(0);
+    updateWorkerThreads();
+}
+
+void ThreadedAudioManager::setLatencyBudgetMs(double ms) {
+    ms = qMax(0.0, ms);
+    if (m_latencyBudgetMs != ms) {
+        m_latencyBudgetMs = ms;
+        applyLatencyBudget();
+        emit latencyBudgetMsChanged();
+    }
+}
+
+void ThreadedAudioManager::applyLatencyBudget() {
+    // A burst of capture periods must fit without triggering a skip
+    const double budgetMs = m_latencyBudgetMs > 0.0 ? qMax(m_latencyBudgetMs, 4 * periodMs()) : 0.0;
+    for (MicChannel* mic : std::as_const(m_mics)) {
+        mic->passthrough()->setLatencyBudgetMs(budgetMs);
+    }
+}
+
+void ThreadedAudioManager::setOfflineDuration(double seconds) {
+    m_offlineThread->setFrameLimit(qint64(qMax(0.0, seconds) * m_outputformat.sampleRate()));
+}
+
+void ThreadedAudioManager::setPeriodFrames(int frames) {
+    frames = qBound(16, frames, int(AudioMixBus::kMaxPeriodFrames));
+    if (m_periodFrames != frames) {
+        m_periodFrames = frames;
+        emit periodFramesChanged();
+
+        // Keep the latency target, spread over the new period size
+        const int count = qBound(2, qRound(m_targetLatencyMs / periodMs()) - 1, 16);
+        if (m_periodCount != count) {
+            m_periodCount = count;
+            emit periodCountChanged();
+        }
+        restartIfRunning();
+    }
+}
+
+void ThreadedAudioManager::setPeriodCount(int count) {
+    count = qBound(2, count, 16);
+    if (m_periodCount != count) {
+        m_periodCount = count;
+        emit periodCountChanged();
+
+        m_targetLatencyMs = (m_periodCount + 1) * periodMs();
+        emit targetLatencyMsChanged();
+        restartIfRunning();
+    }
+}
+
+void ThreadedAudioManager::setTargetLatencyMs(double latencyMs) {
+    if (m_targetLatencyMs != latencyMs) {
+        m_targetLatencyMs = latencyMs;
+        emit targetLatencyMsChanged();
+
+        // One period is spent in the capture buffer, the rest in the sink
+        const int count = qBound(2, qRound(latencyMs / periodMs()) - 1, 16);
+        if (m_periodCount != count) {
+            m_periodCount = count;
+            emit periodCountChanged();
+            restartIfRunning();
+        }
+    }
+}
+
+void ThreadedAudioManager::setMeasuringLatency(bool enabled) {
+    if (m_latencyProbe->isEnabled() != enabled) {
+        if (enabled) {
+            m_latencyProbe->resetStatistics();
+        }
+        m_latencyProbe->setEnabled(enabled);
+        emit measuringLatencyChanged();
+        emit latencyMeasurementChanged();
+    }
+}
+
+double ThreadedAudioManager::measuredLatencyMs() const {
+    if (m_latencyProbe->measurementCount() == 0) {
+        return 0.0;
+    }
+    return m_latencyProbe->meanMs() + deviceBufferMs();
+}
+
+QVariantList ThreadedAudioManager::latencyHistogram() const {
+    QVariantList bins;
+    for (int count : m_latencyProbe->histogram()) {
+        bins.append(count);
+    }
+    return bins;
+}
+
+QString ThreadedAudioManager::latencyReport() const {
+    // Pick up a window that finished after the last poll
+    m_latencyProbe->poll();
+    return m_latencyProbe->report(deviceBufferMs());
+}
+
+double ThreadedAudioManager::periodMs() const {
+    return 1000.0 * m_periodFrames / m_outputformat.sampleRate();
+}
+
+void ThreadedAudioManager::applyBufferSizes() {
+    applyLatencyBudget();
+    m_mixBus->setPeriodFrames(m_periodFrames);
+    m_offlineThread->setPeriodFrames(m_periodFrames);
+    m_inputThread->setBufferSize(m_inputThread->format().bytesForFrames(m_periodFrames));
+    for (AudioInputThread* thread : std::as_const(m_extraInputThreads)) {
+        thread->setBufferSize(m_inputformat.bytesForFrames(m_periodFrames));
+    }
+    m_outputThread->setBufferSize(m_outputformat.bytesForFrames(m_periodFrames * m_periodCount));
+}
+
+void ThreadedAudioManager::restartIfRunning() {
+    if (!m_started) {
+        return;
+    }
+
+    stop();
+    m_inputThread->wait();
+    for (AudioInputThread* thread : std::as_const(m_extraInputThreads)) {
+        thread->wait();
+    }
+    m_outputThread->wait();
+    m_offlineThread->wait();
+    start();
+}
+
+double ThreadedAudioManager::deviceBufferMs() const {
+    // Offline backends have no device buffers, their threads report 0
+    const double captureMs = m_inputThread->format().durationForBytes(qint32(m_inputThread->actualBufferSize())) / 1000.0;
+    const double playbackMs = m_outputformat.durationForBytes(qint32(m_outputThread->actualBufferSize())) / 1000.0;
+    return captureMs + playbackMs;
+}
+
+void ThreadedAudioManager::updateClockDrift() {
+    const double ppm = m_inputThread->driftPpm();
+    if (qAbs(ppm - m_clockDriftPpm) >= 0.1) {
+        m_clockDriftPpm = ppm;
+        emit clockDriftPpmChanged();
+    }
+}
+
+void ThreadedAudioManager::updateBacklog() {
+    double backlogMs = 0.0;
+    qint64 catchUps = 0;
+    for (MicChannel* mic : std::as_const(m_mics)) {
+        const AudioPassthrough::Statistics stats = mic->passthrough()->statistics();
+        backlogMs = qMax(backlogMs, stats.fillMs);
+        catchUps += stats.catchUps;
+    }
+    if (qAbs(backlogMs - m_micBacklogMs) >= 0.1 || catchUps != m_catchUpCount) {
+        m_micBacklogMs = backlogMs;
+        m_catchUpCount = int(catchUps);
+        emit backlogChanged();
+    }
+}
+
+void ThreadedAudioManager::updateAchievedLatency() {
+    // Convert what each stage holds into milliseconds at its own format
+    const double captureMs = m_inputThread->format().durationForBytes(qint32(m_inputThread->actualBufferSize())) / 1000.0;
+    const double backlogMs = m_inputformat.durationForBytes(qint32(m_passthrough->bufferedBytes())) / 1000.0;
+    const double playbackMs = m_outputformat.durationForBytes(qint32(m_outputThread->actualBufferSize())) / 1000.0;
+    const int processingFrames = m_mixBus->processorLatencyFrames(m_micSourceId) + m_mixBus->masterLatencyFrames();
+    const double processingMs = 1000.0 * processingFrames / m_inputformat.sampleRate();
+
+    const double latencyMs = captureMs + backlogMs + processingMs + playbackMs;
+    if (qAbs(latencyMs - m_achievedLatencyMs) >= 0.1) {
+        m_achievedLatencyMs = latencyMs;
+        emit achievedLatencyMsChanged();
+    }
+}
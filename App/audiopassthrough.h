@@ -3,22 +3,91 @@
 
 #include <QObject>
 #include <QIODevice>
-#include <QByteArray>
-#include <QMutex>
 #include <QThread>
 #include <QAudioSource>
 #include <QAudioSink>
 #include <QAudioFormat>
 #include <QAudioDevice>
+#include <QList>
+#include <QTimer>
+#include <QVariantList>
+#include <atomic>
+#include <memory>
+#include <vector>
+#include "spscringbuffer.h"
+#include "audiomixbus.h"
+#include "audiobackends.h"
+#include "latencyprobe.h"
+#include "compressor.h"
+#include "noisegate.h"
+#include "peaklimiter.h"
+#include "pitchanalyzer.h"
+#include "pitchcorrector.h"
+#include "echodelay.h"
+#include "feedbacksuppressor.h"
+#include "fdnreverb.h"
+#include "micchannel.h"
+#include "formatconverter.h"
+#include "audiostats.h"
+#include "realtimeaudio.h"
 
-// Shared QIODevice that can be safely accessed from multiple threads
+// Shared QIODevice backed by a lock-free ring buffer.
+// One thread writes (the audio source) and one thread reads (the audio sink).
+//
+// The stream is Int16 frames of the format set with setFormat(). With a
+// latency budget, a reader that finds more than the budget buffered
+// catches up to half of it: it skips the excess and crosses from the audio
+// it would have played into the audio after the gap over a few ms, so the
+// skip neither clicks nor splits a frame. Without one the ring fills up to
+// its capacity and then drops the newest whole frames.
+//
+// The reader counts every read that finds fewer frames than it asked for
+// as an underrun, and keeps a histogram of the fill it found.
 class AudioPassthrough : public QIODevice {
     Q_OBJECT
 
+public:
+    static constexpr int kMaxCrossfadeFrames = 512;
+
+    // Counters since the ring was created; the fill is a snapshot
+    struct Statistics {
+        double fillMs = 0.0;
+        qint64 catchUps = 0;       // skips made to get back within the budget
+        qint64 skippedFrames = 0;  // frames those skips left out
+        qint64 overrunFrames = 0;  // frames dropped because the ring was full
+        qint64 droppedBytes = 0;   // the same in bytes
+        qint64 underruns = 0;      // reads that came up short
+        qint64 underrunFrames = 0; // frames those reads were missing
+    };
+
+    // Fill seen by each read, in ms
+    static constexpr double kFillBinMs = 1.0;
+
 private:
-    QByteArray m_buffer;
-    QMutex m_mutex;
     int m_maxBufferSize = 1024 * 1024; // 1MB max buffer size
+    SpscRingBuffer<char> m_buffer;
+    std::atomic<LatencyProbe*> m_latencyProbe{nullptr};
+
+    int m_sampleRate = 44100;
+    int m_channelCount = 1;
+    int m_frameBytes = 2;
+    int m_crossfadeFrames = 0;
+    std::atomic<int> m_budgetFrames{0};
+    std::atomic<size_t> m_discardPosition{0};
+
+    // Reader side catch-up, preallocated
+    std::vector<qint16> m_fadeOut;
+    std::vector<qint16> m_fadeIn;
+    std::vector<float> m_fadeCurve;
+
+    std::atomic<qint64> m_catchUps{0};
+    std::atomic<qint64> m_skippedFrames{0};
+    std::atomic<qint64> m_overrunFrames{0};
+    std::atomic<qint64> m_underruns{0};
+    std::atomic<qint64> m_underrunFrames{0};
+    StatsHistogram m_fillHistogram{kFillBinMs};
+
+    qint64 catchUp(char *data, qint64 wanted, qint64 excess);
 
 protected:
     qint64 readData(char *data, qint64 maxSize) override;
@@ -27,7 +96,68 @@ protected:
 public:
     explicit AudioPassthrough(QObject *parent = nullptr);
 
+    bool isSequential() const override { return true; }
+    qint64 bytesAvailable() const override;
+
+    // Int16 layout of the stream, 44.1 kHz mono by default. Only while
+    // neither side is running.
+    void setFormat(const QAudioFormat &format);
+
+    // Most audio the ring holds before the reader catches up, in ms; 0 (the
+    // default) for no limit. Safe from any thread.
+    void setLatencyBudgetMs(double ms);
+    double latencyBudgetMs() const { return 1000.0 * m_budgetFrames.load(std::memory_order_relaxed) / m_sampleRate; }
+
+    // Safe from any thread
+    Statistics statistics() const;
+    const StatsHistogram &fillHistogram() const { return m_fillHistogram; }
+    void resetFillHistogram() { m_fillHistogram.reset(); }
+
+    // Consumer-side access for AudioMixBus, bypassing QIODevice bookkeeping.
+    // Reads whole frames only, so a partially written frame stays in the ring.
+    qint64 bufferedBytes() const { return qint64(m_buffer.readAvailable()); }
+    qint64 readRaw(char *data, qint64 maxSize);
+
+    // Drops everything written so far; the reader skips it on its next read.
+    // Safe from any thread, but a write racing the call may go with it.
+    void discardBuffered() { m_discardPosition.store(m_buffer.writePosition(), std::memory_order_release); }
+
+    // Probe that may splice a measurement burst into written data
+    void setLatencyProbe(LatencyProbe *probe) { m_latencyProbe.store(probe, std::memory_order_release); }
+};
+
+// Write-only device that splits one multichannel capture into mono
+// streams, one per passthrough, so every channel of an interface can be
+// its own mic. Takes interleaved Int16 in writes of any size.
+class CaptureSplitter : public QIODevice {
+    Q_OBJECT
+
+public:
+    static constexpr int kMaxChannels = 8;
+
+    explicit CaptureSplitter(QObject* parent = nullptr);
+
+    // Channel n goes to targets[n]. Not while capturing.
+    void setTargets(const QList<AudioPassthrough*>& targets);
+    int channelCount() const { return int(m_targets.size()); }
+
+    bool isSequential() const override { return true; }
 
+protected:
+    qint64 readData(char* data, qint64 maxSize) override;
+    qint64 writeData(const char* data, qint64 maxSize) override;
+
+private:
+    static constexpr int kChunkFrames = 256;
+
+    QList<AudioPassthrough*> m_targets;
+
+    // A frame split between two writes
+    char m_partial[kMaxChannels * sizeof(qint16)] = {};
+    int m_partialBytes = 0;
+    qint16 m_chunk[kChunkFrames] = {};
+
+    void split(const char* frames, int count);
 };
 
 // Thread for handling audio input
@@ -36,15 +166,63 @@ class AudioInputThread : public QThread {
 
 private:
     QAudioSource* m_audioSource = nullptr;
-    AudioPassthrough* m_passthrough = nullptr;
+    QIODevice* m_target = nullptr;
+    FormatConverter* m_converter = nullptr;
+    AudioPassthrough* m_driftRing = nullptr;
+    QAudioDevice m_device;
     QAudioFormat m_format;
+    Resampler::Quality m_conversionQuality = Resampler::Medium;
+    std::atomic<double> m_driftPpm{0.0};
     bool m_running = false;
+    qsizetype m_bufferSize = 0;
+    std::atomic<qsizetype> m_actualBufferSize{0};
+    std::vector<char> m_captureScratch;
+    CallbackStats m_captureStats;
+    DeviceStateCounters m_deviceState;
 
 public:
-    explicit AudioInputThread(AudioPassthrough* passthrough, QObject* parent = nullptr);
+    explicit AudioInputThread(QIODevice* target, QObject* parent = nullptr);
     ~AudioInputThread();
 
+    // Device written by the capture, a passthrough or a CaptureSplitter
+    void setTarget(QIODevice* target);
+
+    // Capture device, the default input when null
+    void setDevice(const QAudioDevice& device);
+    QAudioDevice device() const { return m_device; }
+
+    // Format delivered to the target. A device that cannot capture it is
+    // opened at its preferred format and converted.
     void setFormat(const QAudioFormat& format);
+    QAudioFormat format() const { return m_format; }
+
+    // Resampler quality of that conversion
+    void setConversionQuality(Resampler::Quality quality);
+    Resampler::Quality conversionQuality() const { return m_conversionQuality; }
+
+    // Ring whose fill the capture holds steady by trimming its rate, which
+    // absorbs the drift between the device clock and the clock of whatever
+    // reads the ring. Normally the ring the capture ends up in. Null to
+    // capture at the nominal rate. Not while running.
+    void setDriftCompensation(AudioPassthrough* ring);
+
+    // Device clock against the ring reader's clock, minus one, in ppm
+    double driftPpm() const { return m_driftPpm.load(std::memory_order_relaxed); }
+
+    // Requested QAudioSource buffer in bytes of format(), 0 for the
+    // backend default
+    void setBufferSize(qsizetype bytes);
+
+    // Buffer size the backend actually granted plus any conversion delay,
+    // in bytes of format(), valid while running
+    qsizetype actualBufferSize() const { return m_actualBufferSize.load(std::memory_order_relaxed); }
+
+    // Time taken to hand each capture on to the target, conversion included
+    const CallbackStats& captureStatistics() const { return m_captureStats; }
+    void resetCaptureStatistics() { m_captureStats.reset(); }
+
+    // QAudioSource state changes, safe from any thread
+    const DeviceStateCounters& deviceState() const { return m_deviceState; }
 
 protected:
     void run() override;
@@ -59,44 +237,315 @@ class AudioOutputThread : public QThread {
 
 private:
     QAudioSink* m_audioSink = nullptr;
-    AudioPassthrough* m_passthrough = nullptr;
+    QIODevice* m_source = nullptr;
     QAudioFormat m_format;
     bool m_running = false;
+    qsizetype m_bufferSize = 0;
+    std::atomic<qsizetype> m_actualBufferSize{0};
+    DeviceStateCounters m_deviceState;
 
 public:
-    explicit AudioOutputThread(AudioPassthrough* passthrough, QObject* parent = nullptr);
+    explicit AudioOutputThread(QIODevice* source, QObject* parent = nullptr);
     ~AudioOutputThread();
 
     void setFormat(const QAudioFormat& format);
+    QAudioFormat format() const { return m_format; }
+
+    // Requested QAudioSink buffer in bytes (period size x period count),
+    // 0 for the backend default
+    void setBufferSize(qsizetype bytes);
+
+    // Buffer size the backend actually granted, valid while running
+    qsizetype actualBufferSize() const { return m_actualBufferSize.load(std::memory_order_relaxed); }
+
+    // QAudioSink state changes, safe from any thread. The sink going idle
+    // with an underrun error is an output xrun.
+    const DeviceStateCounters& deviceState() const { return m_deviceState; }
+
+protected:
+    void run() override;
+
+public slots:
+    void stop();
+};
+
+// Thread driving the pipeline from offline backends instead of devices
+//
+// Each period it reads one period from the source into the capture
+// passthrough, then pulls one period from the playback device (the mix bus)
+// into the sink. Either side may be missing, in which case the device thread
+// for that side does the work and this thread only paces the other one.
+class OfflineAudioThread : public QThread {
+    Q_OBJECT
+
+public:
+    enum Pacing {
+        RealTime,        // one period per period duration, like a device
+        AsFastAsPossible // no waiting, for throughput runs and CI
+    };
+
+    OfflineAudioThread(AudioPassthrough* capture, QIODevice* playback, QObject* parent = nullptr);
+    ~OfflineAudioThread();
+
+    // Backends are owned by the caller and must outlive the run
+    void setSource(OfflineAudioSource* source, const QAudioFormat& format);
+    void setSink(OfflineAudioSink* sink, const QAudioFormat& format);
+    bool hasSource() const { return m_source != nullptr; }
+    bool hasSink() const { return m_sink != nullptr; }
+
+    void setPacing(Pacing pacing);
+    Pacing pacing() const { return m_pacing; }
+
+    void setPeriodFrames(int frames);
+
+    // Stop after this many frames, 0 to run until the source ends or stop()
+    void setFrameLimit(qint64 frames);
+
+    qint64 framesProcessed() const { return m_framesProcessed.load(std::memory_order_relaxed); }
 
 protected:
     void run() override;
 
 public slots:
     void stop();
+
+signals:
+    // Audio time over wall time for the whole run
+    void runFinished(qint64 frames, double realtimeFactor);
+
+private:
+    AudioPassthrough* m_capture = nullptr;
+    QIODevice* m_playback = nullptr;
+    OfflineAudioSource* m_source = nullptr;
+    OfflineAudioSink* m_sink = nullptr;
+    QAudioFormat m_sourceFormat;
+    QAudioFormat m_sinkFormat;
+    Pacing m_pacing = RealTime;
+    int m_periodFrames = 128;
+    qint64 m_frameLimit = 0;
+    std::atomic<bool> m_running{false};
+    std::atomic<qint64> m_framesProcessed{0};
+    std::vector<qint16> m_captureScratch;
+    std::vector<qint16> m_playbackScratch;
 };
 
 // Manager class that ties everything together
+//
+// The output runs in pull mode: the sink asks the mix bus for data and the
+// bus renders it one period at a time. The sink buffer holds periodCount
+// periods and the capture buffer one period, which together with the mic
+// backlog make up the mic-to-speaker latency.
+//
+// There is one mic to begin with. More come either from more devices, one
+// capture thread each, or from the channels of one multichannel device,
+// split after capture. Every mic is its own bus source with its own strip;
+// mic 0 also feeds the pitch analyzer and corrector, and all of them share
+// the echo and reverb on the bus send chain. With several mics the bus
+// runs the strips on a worker pool.
 class ThreadedAudioManager : public QObject {
     Q_OBJECT
+    Q_PROPERTY(int micCount READ micCount NOTIFY micsChanged)
+    Q_PROPERTY(int periodFrames READ periodFrames WRITE setPeriodFrames NOTIFY periodFramesChanged)
+    Q_PROPERTY(int periodCount READ periodCount WRITE setPeriodCount NOTIFY periodCountChanged)
+    Q_PROPERTY(double targetLatencyMs READ targetLatencyMs WRITE setTargetLatencyMs NOTIFY targetLatencyMsChanged)
+    Q_PROPERTY(double achievedLatencyMs READ achievedLatencyMs NOTIFY achievedLatencyMsChanged)
+    Q_PROPERTY(bool measuringLatency READ measuringLatency WRITE setMeasuringLatency NOTIFY measuringLatencyChanged)
+    Q_PROPERTY(double measuredLatencyMs READ measuredLatencyMs NOTIFY latencyMeasurementChanged)
+    Q_PROPERTY(double latencyJitterMs READ latencyJitterMs NOTIFY latencyMeasurementChanged)
+    Q_PROPERTY(int latencyMeasurementCount READ latencyMeasurementCount NOTIFY latencyMeasurementChanged)
+    Q_PROPERTY(QVariantList latencyHistogram READ latencyHistogram NOTIFY latencyMeasurementChanged)
+    Q_PROPERTY(bool driftCompensation READ driftCompensation WRITE setDriftCompensation NOTIFY driftCompensationChanged)
+    Q_PROPERTY(double latencyBudgetMs READ latencyBudgetMs WRITE setLatencyBudgetMs NOTIFY latencyBudgetMsChanged)
+    Q_PROPERTY(double micBacklogMs READ micBacklogMs NOTIFY backlogChanged)
+    Q_PROPERTY(int catchUpCount READ catchUpCount NOTIFY backlogChanged)
+    Q_PROPERTY(double clockDriftPpm READ clockDriftPpm NOTIFY clockDriftPpmChanged)
+    Q_PROPERTY(AudioStats* stats READ stats CONSTANT)
 
 private:
     AudioPassthrough* m_passthrough = nullptr;
+    AudioMixBus* m_mixBus = nullptr;
+    int m_micSourceId = -1;
+    QList<MicChannel*> m_mics;
+    double m_micVolume = 1.0;
+    Resampler::Quality m_conversionQuality = Resampler::Medium;
+    bool m_driftCompensation = true;
+    double m_clockDriftPpm = 0.0;
+    double m_latencyBudgetMs = 50.0;
+    double m_micBacklogMs = 0.0;
+    int m_catchUpCount = 0;
     AudioInputThread* m_inputThread = nullptr;
+    QList<AudioInputThread*> m_extraInputThreads;
+    CaptureSplitter* m_splitter = nullptr;
     AudioOutputThread* m_outputThread = nullptr;
+    OfflineAudioThread* m_offlineThread = nullptr;
+    std::unique_ptr<OfflineAudioSource> m_offlineSource;
+    std::unique_ptr<OfflineAudioSink> m_offlineSink;
     QAudioFormat m_inputformat;
     QAudioFormat m_outputformat;
 
+    int m_periodFrames = 128;
+    int m_periodCount = 3;
+    double m_targetLatencyMs = 15.0;
+    double m_achievedLatencyMs = 0.0;
+    bool m_started = false;
+    bool m_memoryLocked = false;
+    QTimer* m_latencyTimer = nullptr;
+    LatencyProbe* m_latencyProbe = nullptr;
+    AudioStats* m_stats = nullptr;
+    PitchAnalyzer* m_pitchAnalyzer = nullptr;
+    PitchCorrector* m_pitchCorrector = nullptr;
+    EchoDelay* m_echoDelay = nullptr;
+    FdnReverb* m_reverb = nullptr;
+    PeakLimiter* m_limiter = nullptr;
+
+    double periodMs() const;
+    double deviceBufferMs() const;
+    void applyBufferSizes();
+    void restartIfRunning();
+    void updateAchievedLatency();
+    void updateClockDrift();
+    void updateBacklog();
+    void applyLatencyBudget();
+    MicChannel* addMic(const QString& name);
+    void removeExtraMics();
+    void updateWorkerThreads();
+    void updateStatsStreams();
+
 public:
+    static constexpr int kMaxMics = 6;
+
     explicit ThreadedAudioManager(QObject* parent = nullptr);
     ~ThreadedAudioManager();
 
-    // Return the passthrough device for external access if needed
+    // One mic per device, captured on a thread each. Only while stopped,
+    // at most kMaxMics; false if a mic cannot be added.
+    bool setMicDevices(const QList<QAudioDevice>& devices);
+
+    // One mic per channel of the capture device, the default input unless
+    // setMicDevices() picked one. Only while stopped.
+    bool setMicChannels(int channels);
+
+    int micCount() const { return int(m_mics.size()); }
+    Q_INVOKABLE MicChannel* mic(int index) const { return m_mics.value(index); }
+
+    // Volume of every mic, on top of each mic's own fader
+    void setMicVolume(double volume);
+
+    // Resampler quality for capture devices that cannot deliver the input
+    // format. Only while stopped.
+    void setConversionQuality(Resampler::Quality quality);
+    Resampler::Quality conversionQuality() const { return m_conversionQuality; }
+
+    // Trim every capture rate so each mic backlog holds where it settled,
+    // instead of slowly growing or draining with the drift between the
+    // input and output clocks. On by default; only while stopped.
+    bool driftCompensation() const { return m_driftCompensation; }
+    void setDriftCompensation(bool enabled);
+
+    // Drift of the mic 0 capture clock against the playback clock, in ppm
+    double clockDriftPpm() const { return m_clockDriftPpm; }
+
+    // Most backlog a mic ring may build up, after a stall for instance,
+    // before its reader skips back to half of it with a short crossfade.
+    // Never less than four periods; 0 for no limit.
+    double latencyBudgetMs() const { return m_latencyBudgetMs; }
+    void setLatencyBudgetMs(double ms);
+
+    // Largest mic backlog right now, and the skips made to stay within the
+    // budget across every mic since the mics were set up
+    double micBacklogMs() const { return m_micBacklogMs; }
+    int catchUpCount() const { return m_catchUpCount; }
+
+    int periodFrames() const { return m_periodFrames; }
+    void setPeriodFrames(int frames);
+
+    int periodCount() const { return m_periodCount; }
+    void setPeriodCount(int count);
+
+    // Target mic-to-speaker latency; picks the period count to match
+    double targetLatencyMs() const { return m_targetLatencyMs; }
+    void setTargetLatencyMs(double latencyMs);
+
+    // Capture buffer + mic backlog + mic and master processing + sink
+    // buffer, as granted by the backend
+    double achievedLatencyMs() const { return m_achievedLatencyMs; }
+
+    // Round trip measured by injecting bursts into the mic stream. The
+    // measured latency adds the device buffers, which the probe cannot see.
+    bool measuringLatency() const { return m_latencyProbe->isEnabled(); }
+    void setMeasuringLatency(bool enabled);
+    double measuredLatencyMs() const;
+    double latencyJitterMs() const { return m_latencyProbe->jitterMs(); }
+    int latencyMeasurementCount() const { return m_latencyProbe->measurementCount(); }
+    QVariantList latencyHistogram() const;
+    Q_INVOKABLE QString latencyReport() const;
+    LatencyProbe* latencyProbe() const { return m_latencyProbe; }
+
+    // Realtime scheduling, core pinning and memory locking for the audio
+    // threads, see RealtimeAudio. Off by default; only while stopped. The
+    // memory stays locked from start() to stop().
+    void setRealtimeOptions(const RealtimeAudio::Options& options);
+    RealtimeAudio::Options realtimeOptions() const { return RealtimeAudio::options(); }
+
+    // Xrun, timing and buffer health counters of the whole audio path,
+    // updated while running and logged every stats()->logIntervalMs()
+    AudioStats* stats() const { return m_stats; }
+
+    // Capture ring of mic 0, for external access if needed
     AudioPassthrough* passthrough() const { return m_passthrough; }
 
+    // The bus the output thread plays; other sources register here
+    AudioMixBus* mixBus() const { return m_mixBus; }
+    int micSourceId() const { return m_micSourceId; }
+
+    // Mic 0 chain stages. The strip (feedback suppressor, gate, EQ,
+    // compressor) is on from the start and comes first, so nothing after
+    // it hears a howl, hiss or an uneven level. The analyzer comes next so
+    // scoring hears the uncorrected voice, then the corrector, off until
+    // enabled.
+    FeedbackSuppressor* feedbackSuppressor() const { return m_mics.first()->feedbackSuppressor(); }
+    NoiseGate* noiseGate() const { return m_mics.first()->noiseGate(); }
+    VoiceEq* voiceEq() const { return m_mics.first()->eq(); }
+    Compressor* compressor() const { return m_mics.first()->compressor(); }
+    PitchAnalyzer* pitchAnalyzer() const { return m_pitchAnalyzer; }
+    PitchCorrector* pitchCorrector() const { return m_pitchCorrector; }
+
+    // On the bus send chain, so they act on the corrected voice of every
+    // mic that sends to them; off until enabled
+    EchoDelay* echoDelay() const { return m_echoDelay; }
+    FdnReverb* reverb() const { return m_reverb; }
+
+    // On the bus master chain, so it catches the sum of mic and music
+    PeakLimiter* limiter() const { return m_limiter; }
+
+    // Replace the capture and/or playback device with offline backends.
+    // A null backend keeps the device for that side. Backends are opened
+    // here, false if either cannot handle the pipeline format. Pacing is
+    // forced to RealTime while one side is still a device.
+    bool setOfflineBackends(std::unique_ptr<OfflineAudioSource> source,
+                            std::unique_ptr<OfflineAudioSink> sink,
+                            OfflineAudioThread::Pacing pacing = OfflineAudioThread::RealTime);
+
+    // Stop the offline run after this many seconds of audio, 0 for no limit
+    void setOfflineDuration(double seconds);
+
 public slots:
     void start();
     void stop();
+
+signals:
+    void periodFramesChanged();
+    void periodCountChanged();
+    void targetLatencyMsChanged();
+    void achievedLatencyMsChanged();
+    void measuringLatencyChanged();
+    void latencyMeasurementChanged();
+    void micsChanged();
+    void driftCompensationChanged();
+    void clockDriftPpmChanged();
+    void latencyBudgetMsChanged();
+    void backlogChanged();
+    void offlineRunFinished(qint64 frames, double realtimeFactor);
 };
 
 #endif // THREADED_AUDIOPASSTHROUGH_H
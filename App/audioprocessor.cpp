@@ -0,0 +1,131 @@
+#include "audioprocessor.h"
+#include "smoothedparameter.h"
+#include <QtGlobal>
+#include <chrono>
+
+namespace {
+
+// Weight of the newest block in the smoothed cost
+constexpr double kCostSmoothing = 0.05;
+
+} // namespace
+
+//---------- AudioProcessor ----------
+
+AudioProcessor::AudioProcessor(QObject* parent) : QObject(parent) {
+}
+
+void AudioProcessor::prepare(int sampleRate, int channelCount, int maxFrames) {
+    m_sampleRate = sampleRate;
+    m_channelCount = channelCount;
+    m_maxFrames = maxFrames;
+    for (int i = 0; i < m_parameterCount; ++i) {
+        m_parameters[size_t(i)]->prepare(sampleRate);
+        m_parameters[size_t(i)]->snap();
+    }
+    prepareBuffers();
+}
+
+void AudioProcessor::registerParameter(SmoothedParameter* parameter) {
+    Q_ASSERT(m_parameterCount < kMaxParameters);
+    if (m_parameterCount < kMaxParameters) {
+        m_parameters[size_t(m_parameterCount++)] = parameter;
+    }
+}
+
+void AudioProcessor::setBypassed(bool bypassed) {
+    if (m_bypassed.exchange(bypassed, std::memory_order_relaxed) != bypassed) {
+        emit bypassedChanged();
+    }
+}
+
+void AudioProcessor::run(float* data, int frames) {
+    if (m_bypassed.load(std::memory_order_relaxed)) {
+        return;
+    }
+
+    using Clock = std::chrono::steady_clock;
+    const auto start = Clock::now();
+    process(data, frames);
+    const double costUs = std::chrono::duration<double, std::micro>(Clock::now() - start).count();
+
+    // Only this thread writes the statistics, so plain load/store is enough
+    const double average = m_averageCostUs.load(std::memory_order_relaxed);
+    m_averageCostUs.store(average + kCostSmoothing * (costUs - average), std::memory_order_relaxed);
+    if (costUs > m_peakCostUs.load(std::memory_order_relaxed)) {
+        m_peakCostUs.store(costUs, std::memory_order_relaxed);
+    }
+    m_lastBlockFrames.store(frames, std::memory_order_relaxed);
+}
+
+double AudioProcessor::loadPercent() const {
+    const int frames = m_lastBlockFrames.load(std::memory_order_relaxed);
+    if (frames <= 0 || m_sampleRate <= 0) {
+        return 0.0;
+    }
+    const double blockUs = 1e6 * frames / m_sampleRate;
+    return 100.0 * averageCostUs() / blockUs;
+}
+
+void AudioProcessor::resetCost() {
+    m_averageCostUs.store(0.0, std::memory_order_relaxed);
+    m_peakCostUs.store(0.0, std::memory_order_relaxed);
+}
+
+//---------- AudioProcessorChain ----------
+
+void AudioProcessorChain::prepare(int sampleRate, int channelCount, int maxFrames) {
+    m_sampleRate = sampleRate;
+    m_channelCount = channelCount;
+    m_maxFrames = maxFrames;
+}
+
+bool AudioProcessorChain::append(AudioProcessor* processor) {
+    if (!processor) {
+        return false;
+    }
+    for (std::atomic<AudioProcessor*>& slot : m_processors) {
+        if (slot.load(std::memory_order_acquire) == nullptr) {
+            // Fully prepared before the audio thread can see it
+            processor->prepare(m_sampleRate, m_channelCount, m_maxFrames);
+            slot.store(processor, std::memory_order_release);
+            return true;
+        }
+    }
+    return false;
+}
+
+void AudioProcessorChain::remove(AudioProcessor* processor) {
+    for (std::atomic<AudioProcessor*>& slot : m_processors) {
+        AudioProcessor* expected = processor;
+        slot.compare_exchange_strong(expected, nullptr, std::memory_order_acq_rel);
+    }
+}
+
+void AudioProcessorChain::process(float* data, int frames) {
+    for (std::atomic<AudioProcessor*>& slot : m_processors) {
+        if (AudioProcessor* processor = slot.load(std::memory_order_acquire)) {
+            processor->run(data, frames);
+        }
+    }
+}
+
+int AudioProcessorChain::latencyFrames() const {
+    int latency = 0;
+    for (const std::atomic<AudioProcessor*>& slot : m_processors) {
+        const AudioProcessor* processor = slot.load(std::memory_order_acquire);
+        if (processor && !processor->isBypassed()) {
+            latency += processor->latencyFrames();
+        }
+    }
+    return latency;
+}
+
+bool AudioProcessorChain::isEmpty() const {
+    for (const std::atomic<AudioProcessor*>& slot : m_processors) {
+        if (slot.load(std::memory_order_acquire)) {
+            return false;
+        }
+    }
+    return true;
+}
@@ -0,0 +1,108 @@
+#ifndef AUDIOPROCESSOR_H
+#define AUDIOPROCESSOR_H
+
+#include <QObject>
+#include <array>
+#include <atomic>
+
+class SmoothedParameter;
+
+// One in-place DSP stage in a processor chain.
+//
+// prepare() runs on the GUI thread before the stage is published to the
+// audio thread; it stores the format and calls prepareBuffers(), which is
+// where subclasses allocate everything they need. process() runs on
+// the audio thread once per period on interleaved float samples in
+// [-1, 1), and must not allocate, lock or block. Parameters are set from
+// the GUI thread, so subclasses keep them in atomics. Those heard directly,
+// such as levels and mix amounts, are SmoothedParameters registered from
+// the constructor: prepare() sets their ramps up for the sample rate and
+// jumps them to their values, and process() ramps them towards later ones.
+class AudioProcessor : public QObject {
+    Q_OBJECT
+    Q_PROPERTY(bool bypassed READ isBypassed WRITE setBypassed NOTIFY bypassedChanged)
+
+public:
+    explicit AudioProcessor(QObject* parent = nullptr);
+
+    void prepare(int sampleRate, int channelCount, int maxFrames);
+    virtual void reset() {}
+
+    int sampleRate() const { return m_sampleRate; }
+    int channelCount() const { return m_channelCount; }
+
+    // Delay this stage adds to the signal, in frames
+    virtual int latencyFrames() const { return 0; }
+
+    bool isBypassed() const { return m_bypassed.load(std::memory_order_relaxed); }
+    void setBypassed(bool bypassed);
+
+    // Runs process() unless bypassed and keeps the cost statistics.
+    // Audio thread only.
+    void run(float* data, int frames);
+
+    // Processing time per block: smoothed mean and the worst seen since the
+    // last resetCost(), plus the mean as a share of the block duration
+    Q_INVOKABLE double averageCostUs() const { return m_averageCostUs.load(std::memory_order_relaxed); }
+    Q_INVOKABLE double peakCostUs() const { return m_peakCostUs.load(std::memory_order_relaxed); }
+    Q_INVOKABLE double loadPercent() const;
+    Q_INVOKABLE void resetCost();
+
+signals:
+    void bypassedChanged();
+
+protected:
+    static constexpr int kMaxParameters = 16;
+
+    // From the constructor; the parameter must live as long as the stage
+    void registerParameter(SmoothedParameter* parameter);
+
+    virtual void prepareBuffers() = 0;
+    virtual void process(float* data, int frames) = 0;
+
+    int m_sampleRate = 44100;
+    int m_channelCount = 1;
+    int m_maxFrames = 0;
+
+private:
+    std::atomic<bool> m_bypassed{false};
+    std::atomic<double> m_averageCostUs{0.0};
+    std::atomic<double> m_peakCostUs{0.0};
+    std::atomic<int> m_lastBlockFrames{0};
+    std::array<SmoothedParameter*, kMaxParameters> m_parameters{};
+    int m_parameterCount = 0;
+};
+
+// Fixed set of processors run in order on one stream.
+//
+// Slots are published with atomic stores, so processors can be added and
+// removed while the audio thread runs the chain. A removed processor may
+// still be running for the rest of the current block, so processors must
+// outlive the chain they were added to.
+class AudioProcessorChain {
+public:
+    static constexpr int kMaxProcessors = 8;
+
+    // Stream format; processors added later are prepared for it
+    void prepare(int sampleRate, int channelCount, int maxFrames);
+
+    // Prepare and append, false when the chain is full. Not for the audio thread.
+    bool append(AudioProcessor* processor);
+    void remove(AudioProcessor* processor);
+
+    // Audio thread
+    void process(float* data, int frames);
+
+    int latencyFrames() const;
+
+    // True with no processor in any slot; safe from any thread
+    bool isEmpty() const;
+
+private:
+    std::array<std::atomic<AudioProcessor*>, kMaxProcessors> m_processors{};
+    int m_sampleRate = 44100;
+    int m_channelCount = 1;
+    int m_maxFrames = 0;
+};
+
+#endif // AUDIOPROCESSOR_H
@@ -0,0 +1,266 @@
+#include "audiostats.h"
+#include "audiomixbus.h"
+#include "audiopassthrough.h"
+#include <QDebug>
+#include <algorithm>
+
+//---------- StatsHistogram ----------
+
+void StatsHistogram::add(double value) {
+    const int bin = std::clamp(int(value / m_binWidth), 0, kBins - 1);
+
+    // Only this thread writes, so plain load/store is enough
+    m_bins[size_t(bin)].store(m_bins[size_t(bin)].load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    m_sum.store(m_sum.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+    if (value > m_max.load(std::memory_order_relaxed)) {
+        m_max.store(value, std::memory_order_relaxed);
+    }
+    m_count.store(m_count.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+}
+
+double StatsHistogram::mean() const {
+    const qint64 count = this->count();
+    return count > 0 ? m_sum.load(std::memory_order_relaxed) / double(count) : 0.0;
+}
+
+double StatsHistogram::percentile(double share) const {
+    qint64 total = 0;
+    for (const std::atomic<qint64>& bin : m_bins) {
+        total += bin.load(std::memory_order_relaxed);
+    }
+    if (total == 0) {
+        return 0.0;
+    }
+
+    const double wanted = std::clamp(share, 0.0, 1.0) * double(total);
+    qint64 seen = 0;
+    for (int bin = 0; bin < kBins - 1; ++bin) {
+        seen += m_bins[size_t(bin)].load(std::memory_order_relaxed);
+        if (double(seen) >= wanted) {
+            return std::min((bin + 1) * m_binWidth, max());
+        }
+    }
+    return max();
+}
+
+QVector<int> StatsHistogram::bins() const {
+    QVector<int> counts(kBins, 0);
+    for (int bin = 0; bin < kBins; ++bin) {
+        counts[bin] = int(m_bins[size_t(bin)].load(std::memory_order_relaxed));
+    }
+    return counts;
+}
+
+void StatsHistogram::reset() {
+    for (std::atomic<qint64>& bin : m_bins) {
+        bin.store(0, std::memory_order_relaxed);
+    }
+    m_count.store(0, std::memory_order_relaxed);
+    m_sum.store(0.0, std::memory_order_relaxed);
+    m_max.store(0.0, std::memory_order_relaxed);
+}
+
+//---------- CallbackStats ----------
+
+void CallbackStats::record(qint64 elapsedNs, qint64 audioNs) {
+    m_timeUs.add(elapsedNs / 1000.0);
+    if (elapsedNs > audioNs) {
+        m_late.store(m_late.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    }
+    m_elapsedNs.store(m_elapsedNs.load(std::memory_order_relaxed) + elapsedNs, std::memory_order_relaxed);
+    m_audioNs.store(m_audioNs.load(std::memory_order_relaxed) + audioNs, std::memory_order_relaxed);
+}
+
+double CallbackStats::loadPercent() const {
+    const qint64 audioNs = m_audioNs.load(std::memory_order_relaxed);
+    return audioNs > 0 ? 100.0 * double(m_elapsedNs.load(std::memory_order_relaxed)) / double(audioNs) : 0.0;
+}
+
+void CallbackStats::reset() {
+    m_timeUs.reset();
+    m_late.store(0, std::memory_order_relaxed);
+    m_elapsedNs.store(0, std::memory_order_relaxed);
+    m_audioNs.store(0, std::memory_order_relaxed);
+}
+
+//---------- DeviceStateCounters ----------
+
+void DeviceStateCounters::record(QAudio::State state, QAudio::Error error) {
+    m_state.store(state, std::memory_order_relaxed);
+    m_transitions.store(m_transitions.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    if (error > QAudio::NoError && error < kErrorKinds) {
+        std::atomic<qint64>& count = m_errors[size_t(error)];
+        count.store(count.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    }
+}
+
+qint64 DeviceStateCounters::errors(QAudio::Error error) const {
+    if (error < 0 || error >= kErrorKinds) {
+        return 0;
+    }
+    return m_errors[size_t(error)].load(std::memory_order_relaxed);
+}
+
+QString DeviceStateCounters::stateName(QAudio::State state) {
+    switch (state) {
+    case QAudio::ActiveState:
+        return QStringLiteral("active");
+    case QAudio::SuspendedState:
+        return QStringLiteral("suspended");
+    case QAudio::StoppedState:
+        return QStringLiteral("stopped");
+    case QAudio::IdleState:
+        return QStringLiteral("idle");
+    }
+    return QStringLiteral("unknown");
+}
+
+//---------- AudioStats ----------
+
+AudioStats::AudioStats(QObject* parent)
+    : QObject(parent), m_inputState(QStringLiteral("none")), m_outputState(QStringLiteral("none")) {
+}
+
+void AudioStats::setStreams(AudioMixBus* bus, AudioOutputThread* output,
+                            const QList<AudioInputThread*>& inputs, const QList<AudioPassthrough*>& rings) {
+    m_bus = bus;
+    m_output = output;
+    m_inputs = inputs;
+    m_rings = rings;
+
+    // New rings start from zero, so the counts start over with them
+    m_totals = readTotals();
+    m_baseline = m_totals;
+    update();
+}
+
+void AudioStats::setLogIntervalMs(int ms) {
+    ms = qMax(0, ms);
+    if (m_logIntervalMs != ms) {
+        m_logIntervalMs = ms;
+        emit logIntervalMsChanged();
+    }
+}
+
+AudioStats::Totals AudioStats::readTotals() const {
+    Totals totals;
+    for (const AudioPassthrough* ring : m_rings) {
+        const AudioPassthrough::Statistics stats = ring->statistics();
+        totals.inputUnderruns += stats.underruns;
+        totals.droppedBytes += stats.droppedBytes;
+        totals.catchUps += stats.catchUps;
+    }
+
+    QList<const DeviceStateCounters*> devices;
+    for (const AudioInputThread* input : m_inputs) {
+        devices.append(&input->deviceState());
+    }
+    if (m_output) {
+        devices.append(&m_output->deviceState());
+        totals.outputUnderruns = m_output->deviceState().errors(QAudio::UnderrunError);
+    }
+    for (const DeviceStateCounters* device : std::as_const(devices)) {
+        totals.transitions += device->transitions();
+        for (QAudio::Error error : {QAudio::OpenError, QAudio::IOError, QAudio::FatalError}) {
+            totals.deviceErrors += device->errors(error);
+        }
+    }
+    return totals;
+}
+
+void AudioStats::update() {
+    m_totals = readTotals();
+
+    if (m_bus) {
+        const CallbackStats& render = m_bus->renderStatistics();
+        m_lateCallbacks = render.lateCallbacks();
+        m_renderMeanUs = render.timeUs().mean();
+        m_renderP99Us = render.timeUs().percentile(0.99);
+        m_renderPeakUs = render.timeUs().max();
+        m_renderLoadPercent = render.loadPercent();
+        m_renderHistogram.clear();
+        for (int count : render.timeUs().bins()) {
+            m_renderHistogram.append(count);
+        }
+    }
+
+    m_captureMeanUs = 0.0;
+    m_capturePeakUs = 0.0;
+    for (const AudioInputThread* input : std::as_const(m_inputs)) {
+        const StatsHistogram& time = input->captureStatistics().timeUs();
+        m_captureMeanUs = qMax(m_captureMeanUs, time.mean());
+        m_capturePeakUs = qMax(m_capturePeakUs, time.max());
+    }
+
+    m_fillMs = 0.0;
+    for (const AudioPassthrough* ring : std::as_const(m_rings)) {
+        m_fillMs = qMax(m_fillMs, ring->statistics().fillMs);
+    }
+    m_fillHistogram.clear();
+    if (!m_rings.isEmpty()) {
+        const StatsHistogram& fill = m_rings.first()->fillHistogram();
+        m_fillP99Ms = fill.percentile(0.99);
+        for (int count : fill.bins()) {
+            m_fillHistogram.append(count);
+        }
+    }
+
+    const auto stateOf = [](const DeviceStateCounters* device) {
+        return device && device->transitions() > 0 ? DeviceStateCounters::stateName(device->state())
+                                                   : QStringLiteral("none");
+    };
+    m_inputState = stateOf(m_inputs.isEmpty() ? nullptr : &m_inputs.first()->deviceState());
+    m_outputState = stateOf(m_output ? &m_output->deviceState() : nullptr);
+
+    emit changed();
+
+    if (!m_logClock.isValid()) {
+        m_logClock.start();
+    } else if (m_logIntervalMs > 0 && m_logClock.elapsed() >= m_logIntervalMs) {
+        m_logClock.restart();
+        qInfo().noquote() << logLine();
+    }
+}
+
+void AudioStats::finish() {
+    update();
+    qInfo().noquote() << logLine();
+    m_logClock.invalidate();
+}
+
+void AudioStats::reset() {
+    m_baseline = readTotals();
+    if (m_bus) {
+        m_bus->resetRenderStatistics();
+    }
+    for (AudioInputThread* input : std::as_const(m_inputs)) {
+        input->resetCaptureStatistics();
+    }
+    for (AudioPassthrough* ring : std::as_const(m_rings)) {
+        ring->resetFillHistogram();
+    }
+    update();
+}
+
+QString AudioStats::logLine() const {
+    return QStringLiteral("audio-stats input_underruns=%1 output_underruns=%2 dropped_bytes=%3 catch_ups=%4"
+                          " late_callbacks=%5 render_mean_us=%6 render_p99_us=%7 render_peak_us=%8 render_load_pct=%9")
+               .arg(inputUnderruns())
+               .arg(outputUnderruns())
+               .arg(qint64(droppedBytes()))
+               .arg(catchUps())
+               .arg(lateCallbacks())
+               .arg(m_renderMeanUs, 0, 'f', 1)
+               .arg(m_renderP99Us, 0, 'f', 1)
+               .arg(m_renderPeakUs, 0, 'f', 1)
+               .arg(m_renderLoadPercent, 0, 'f', 2)
+         + QStringLiteral(" capture_mean_us=%1 capture_peak_us=%2 fill_ms=%3 fill_p99_ms=%4"
+                          " input_state=%5 output_state=%6 transitions=%7 device_errors=%8")
+               .arg(m_captureMeanUs, 0, 'f', 1)
+               .arg(m_capturePeakUs, 0, 'f', 1)
+               .arg(m_fillMs, 0, 'f', 1)
+               .arg(m_fillP99Ms, 0, 'f', 1)
+               .arg(m_inputState, m_outputState)
+               .arg(stateTransitions())
+               .arg(deviceErrors());
+}
@@ -0,0 +1,232 @@
+#ifndef AUDIOSTATS_H
+#define AUDIOSTATS_H
+
+#include <QObject>
+#include <QAudioSink>
+#include <QElapsedTimer>
+#include <QList>
+#include <QString>
+#include <QVariantList>
+#include <QVector>
+#include <array>
+#include <atomic>
+
+class AudioMixBus;
+class AudioPassthrough;
+class AudioInputThread;
+class AudioOutputThread;
+
+// Fixed-bin histogram written by one audio thread and read by any other.
+//
+// add() is a handful of relaxed atomic stores, so it never allocates,
+// locks or blocks. Values past the last bin land in it. Readers see each
+// bin consistently but not the bins as a whole, which is fine for display.
+class StatsHistogram {
+public:
+    static constexpr int kBins = 64;
+
+    explicit StatsHistogram(double binWidth) : m_binWidth(binWidth) {}
+
+    double binWidth() const { return m_binWidth; }
+
+    // Writer thread only
+    void add(double value);
+
+    qint64 count() const { return m_count.load(std::memory_order_relaxed); }
+    double mean() const;
+    double max() const { return m_max.load(std::memory_order_relaxed); }
+
+    // Upper edge of the bin the given share of the values falls within,
+    // the maximum when that is the last bin
+    double percentile(double share) const;
+
+    QVector<int> bins() const;
+
+    // Racy against the writer, the next few values may be counted from
+    // before the reset
+    void reset();
+
+private:
+    const double m_binWidth;
+    std::array<std::atomic<qint64>, kBins> m_bins{};
+    std::atomic<qint64> m_count{0};
+    std::atomic<double> m_sum{0.0};
+    std::atomic<double> m_max{0.0};
+};
+
+// Time a device callback takes against the audio it handles. A callback
+// that takes longer than its audio lasts is late: it ate into the device
+// buffer, and enough of them in a row are an xrun.
+class CallbackStats {
+public:
+    static constexpr double kBinUs = 100.0;
+
+    CallbackStats() : m_timeUs(kBinUs) {}
+
+    // Audio thread only
+    void record(qint64 elapsedNs, qint64 audioNs);
+
+    const StatsHistogram& timeUs() const { return m_timeUs; }
+    qint64 lateCallbacks() const { return m_late.load(std::memory_order_relaxed); }
+
+    // Time spent over audio handled, since the last reset
+    double loadPercent() const;
+
+    void reset();
+
+private:
+    StatsHistogram m_timeUs;
+    std::atomic<qint64> m_late{0};
+    std::atomic<qint64> m_elapsedNs{0};
+    std::atomic<qint64> m_audioNs{0};
+};
+
+// State changes of a QAudioSource or QAudioSink, recorded from its
+// stateChanged() on the device thread
+class DeviceStateCounters {
+public:
+    static constexpr int kErrorKinds = QAudio::FatalError + 1;
+
+    // Device thread only
+    void record(QAudio::State state, QAudio::Error error);
+
+    QAudio::State state() const { return QAudio::State(m_state.load(std::memory_order_relaxed)); }
+    qint64 transitions() const { return m_transitions.load(std::memory_order_relaxed); }
+
+    // Transitions that came with the error
+    qint64 errors(QAudio::Error error) const;
+
+    static QString stateName(QAudio::State state);
+
+private:
+    std::atomic<int> m_state{QAudio::StoppedState};
+    std::atomic<qint64> m_transitions{0};
+    std::array<std::atomic<qint64>, kErrorKinds> m_errors{};
+};
+
+// Health of the audio path, for an on-screen diagnostics overlay and for
+// the log.
+//
+// The audio threads keep their own lock-free counters and histograms; this
+// object reads them on the GUI thread from update(), keeps the totals QML
+// binds to, and every logIntervalMs writes them as one key=value line.
+// Counts are since the last reset(), or since the streams were set up.
+class AudioStats : public QObject {
+    Q_OBJECT
+    Q_PROPERTY(int inputUnderruns READ inputUnderruns NOTIFY changed)
+    Q_PROPERTY(int outputUnderruns READ outputUnderruns NOTIFY changed)
+    Q_PROPERTY(double droppedBytes READ droppedBytes NOTIFY changed)
+    Q_PROPERTY(int catchUps READ catchUps NOTIFY changed)
+    Q_PROPERTY(int lateCallbacks READ lateCallbacks NOTIFY changed)
+    Q_PROPERTY(double renderMeanUs READ renderMeanUs NOTIFY changed)
+    Q_PROPERTY(double renderP99Us READ renderP99Us NOTIFY changed)
+    Q_PROPERTY(double renderPeakUs READ renderPeakUs NOTIFY changed)
+    Q_PROPERTY(double renderLoadPercent READ renderLoadPercent NOTIFY changed)
+    Q_PROPERTY(double captureMeanUs READ captureMeanUs NOTIFY changed)
+    Q_PROPERTY(double capturePeakUs READ capturePeakUs NOTIFY changed)
+    Q_PROPERTY(double fillMs READ fillMs NOTIFY changed)
+    Q_PROPERTY(double fillP99Ms READ fillP99Ms NOTIFY changed)
+    Q_PROPERTY(QString inputState READ inputState NOTIFY changed)
+    Q_PROPERTY(QString outputState READ outputState NOTIFY changed)
+    Q_PROPERTY(int stateTransitions READ stateTransitions NOTIFY changed)
+    Q_PROPERTY(int deviceErrors READ deviceErrors NOTIFY changed)
+    Q_PROPERTY(QVariantList renderHistogram READ renderHistogram NOTIFY changed)
+    Q_PROPERTY(QVariantList fillHistogram READ fillHistogram NOTIFY changed)
+    Q_PROPERTY(int logIntervalMs READ logIntervalMs WRITE setLogIntervalMs NOTIFY logIntervalMsChanged)
+
+public:
+    explicit AudioStats(QObject* parent = nullptr);
+
+    // What to read. The objects must outlive their use here; call again
+    // whenever the set changes.
+    void setStreams(AudioMixBus* bus, AudioOutputThread* output,
+                    const QList<AudioInputThread*>& inputs, const QList<AudioPassthrough*>& rings);
+
+    // Short reads of a mic ring, which play as silence
+    int inputUnderruns() const { return int(m_totals.inputUnderruns - m_baseline.inputUnderruns); }
+    // Sink gone idle with an underrun error
+    int outputUnderruns() const { return int(m_totals.outputUnderruns - m_baseline.outputUnderruns); }
+    // Capture the mic rings had no room for
+    double droppedBytes() const { return double(m_totals.droppedBytes - m_baseline.droppedBytes); }
+    int catchUps() const { return int(m_totals.catchUps - m_baseline.catchUps); }
+    int lateCallbacks() const { return int(m_lateCallbacks); }
+
+    // Time the sink thread spends rendering each pull from the bus
+    double renderMeanUs() const { return m_renderMeanUs; }
+    double renderP99Us() const { return m_renderP99Us; }
+    double renderPeakUs() const { return m_renderPeakUs; }
+    double renderLoadPercent() const { return m_renderLoadPercent; }
+
+    // Time the capture threads spend passing each capture on, slowest thread
+    double captureMeanUs() const { return m_captureMeanUs; }
+    double capturePeakUs() const { return m_capturePeakUs; }
+
+    // Largest mic ring fill now, and the 99th percentile of mic 0 reads
+    double fillMs() const { return m_fillMs; }
+    double fillP99Ms() const { return m_fillP99Ms; }
+
+    // State of the mic 0 capture and of the sink, "none" without a device
+    QString inputState() const { return m_inputState; }
+    QString outputState() const { return m_outputState; }
+    int stateTransitions() const { return int(m_totals.transitions - m_baseline.transitions); }
+    int deviceErrors() const { return int(m_totals.deviceErrors - m_baseline.deviceErrors); }
+
+    QVariantList renderHistogram() const { return m_renderHistogram; }
+    QVariantList fillHistogram() const { return m_fillHistogram; }
+
+    // 0 to only log on stop
+    int logIntervalMs() const { return m_logIntervalMs; }
+    void setLogIntervalMs(int ms);
+
+    // The totals as one structured log line
+    Q_INVOKABLE QString logLine() const;
+
+public slots:
+    // Read the audio threads and log when due. GUI thread.
+    void update();
+    // Update and log once more, at the end of a run
+    void finish();
+    Q_INVOKABLE void reset();
+
+signals:
+    void changed();
+    void logIntervalMsChanged();
+
+private:
+    struct Totals {
+        qint64 inputUnderruns = 0;
+        qint64 outputUnderruns = 0;
+        qint64 droppedBytes = 0;
+        qint64 catchUps = 0;
+        qint64 transitions = 0;
+        qint64 deviceErrors = 0;
+    };
+
+    AudioMixBus* m_bus = nullptr;
+    AudioOutputThread* m_output = nullptr;
+    QList<AudioInputThread*> m_inputs;
+    QList<AudioPassthrough*> m_rings;
+
+    Totals m_totals;
+    Totals m_baseline;
+    qint64 m_lateCallbacks = 0;
+    double m_renderMeanUs = 0.0;
+    double m_renderP99Us = 0.0;
+    double m_renderPeakUs = 0.0;
+    double m_renderLoadPercent = 0.0;
+    double m_captureMeanUs = 0.0;
+    double m_capturePeakUs = 0.0;
+    double m_fillMs = 0.0;
+    double m_fillP99Ms = 0.0;
+    QString m_inputState;
+    QString m_outputState;
+    QVariantList m_renderHistogram;
+    QVariantList m_fillHistogram;
+
+    int m_logIntervalMs = 10000;
+    QElapsedTimer m_logClock;
+
+    Totals readTotals() const;
+};
+
+#endif // AUDIOSTATS_H
@@ -0,0 +1,116 @@
+#include "audioworkerpool.h"
+#include <QtGlobal>
+#include "realtimeaudio.h"
+#include <thread>
+
+namespace {
+
+// Busy-wait rounds for the last jobs before giving up the time slice. A
+// job is a processor chain run, tens of microseconds at most.
+constexpr int kSpinsBeforeYield = 2000;
+
+constexpr int kGenerationShift = 32;
+constexpr unsigned long long kIndexMask = 0xffffffffull;
+
+} // namespace
+
+AudioWorkerPool::AudioWorkerPool(int threads) {
+    threads = qBound(0, threads, int(kMaxThreads));
+    m_workers.reserve(size_t(threads));
+    for (int i = 0; i < threads; ++i) {
+        Worker* worker = new Worker(this);
+        worker->setObjectName(QStringLiteral("AudioWorker%1").arg(i));
+        worker->start(QThread::TimeCriticalPriority);
+        m_workers.push_back(worker);
+    }
+}
+
+AudioWorkerPool::~AudioWorkerPool() {
+    m_stopping.store(true, std::memory_order_release);
+    m_wake.release(int(m_workers.size()));
+    for (Worker* worker : m_workers) {
+        worker->wait();
+        delete worker;
+    }
+}
+
+void AudioWorkerPool::run(Job job, void* context, int count) {
+    if (count <= 0) {
+        return;
+    }
+    if (m_workers.empty() || count == 1) {
+        for (int index = 0; index < count; ++index) {
+            job(context, index);
+        }
+        return;
+    }
+
+    // Close the counter first, so a worker still looking at the previous
+    // period cannot claim with a half-written job, then publish the jobs
+    // and open the new generation
+    const unsigned long long generation =
+        (m_claim.load(std::memory_order_relaxed) >> kGenerationShift) + 1;
+    m_claim.store((generation << kGenerationShift) | kIndexMask, std::memory_order_relaxed);
+    m_job.store(job, std::memory_order_relaxed);
+    m_context.store(context, std::memory_order_relaxed);
+    m_finished.store(0, std::memory_order_relaxed);
+    m_count.store(count, std::memory_order_release);
+    m_claim.store(generation << kGenerationShift, std::memory_order_release);
+
+    // Workers still asleep on an earlier release will pick these up too
+    const int wanted = qMin(threadCount(), count - 1) - m_wake.available();
+    if (wanted > 0) {
+        m_wake.release(wanted);
+    }
+
+    while (runOne(unsigned(generation))) {
+    }
+
+    // Jobs the workers claimed may still be running
+    int spins = 0;
+    while (m_finished.load(std::memory_order_acquire) < count) {
+        if (++spins > kSpinsBeforeYield) {
+            std::this_thread::yield();
+        }
+    }
+}
+
+bool AudioWorkerPool::runOne(unsigned int generation) {
+    unsigned long long claim = m_claim.load(std::memory_order_acquire);
+    for (;;) {
+        if (unsigned(claim >> kGenerationShift) != generation) {
+            return false;
+        }
+
+        // Read before claiming; a successful claim proves the period these
+        // belong to is still running, so they were not overwritten. A count
+        // from the next period comes with the closed counter, and the claim
+        // then fails.
+        const Job job = m_job.load(std::memory_order_relaxed);
+        void* context = m_context.load(std::memory_order_relaxed);
+        const unsigned int index = unsigned(claim & kIndexMask);
+        if (index >= unsigned(m_count.load(std::memory_order_acquire))) {
+            return false;
+        }
+
+        if (m_claim.compare_exchange_weak(claim, claim + 1, std::memory_order_acq_rel, std::memory_order_acquire)) {
+            job(context, int(index));
+            m_finished.fetch_add(1, std::memory_order_release);
+            return true;
+        }
+    }
+}
+
+void AudioWorkerPool::workerLoop() {
+    RealtimeAudio::setupAudioThread();
+    for (;;) {
+        m_wake.acquire();
+        if (m_stopping.load(std::memory_order_acquire)) {
+            return;
+        }
+        RealtimeAudio::AuditScope audit;
+        const unsigned int generation = unsigned(m_claim.load(std::memory_order_acquire) >> kGenerationShift);
+        while (runOne(generation)) {
+        }
+    }
+}
@@ -0,0 +1,69 @@
+#ifndef AUDIOWORKERPOOL_H
+#define AUDIOWORKERPOOL_H
+
+#include <QSemaphore>
+#include <QThread>
+#include <atomic>
+#include <vector>
+
+// Fixed set of time-critical threads that help the audio thread through
+// independent jobs, such as the processor chains of several mics.
+//
+// run() hands out the jobs through one atomic counter; the calling thread
+// takes jobs too and returns once every job is done, so the pool only adds
+// threads to a period, never a hop to another thread. Nothing on the run()
+// path allocates or takes a lock: waking a worker is a semaphore release
+// and the wait for the last job is a short spin.
+//
+// The workers sleep on the semaphore between periods. A worker that wakes
+// after the jobs are gone finds nothing to claim and goes back to sleep,
+// and the generation in the counter keeps a late worker from claiming a
+// job of the next period with the previous period's function.
+class AudioWorkerPool {
+public:
+    using Job = void (*)(void* context, int index);
+
+    static constexpr int kMaxThreads = 8;
+
+    // Starts threads workers (at most kMaxThreads) at TimeCriticalPriority,
+    // set up with the RealtimeAudio options of the time
+    explicit AudioWorkerPool(int threads);
+    ~AudioWorkerPool();
+
+    AudioWorkerPool(const AudioWorkerPool&) = delete;
+    AudioWorkerPool& operator=(const AudioWorkerPool&) = delete;
+
+    int threadCount() const { return int(m_workers.size()); }
+
+    // Calls job(context, index) for every index below count, spread over
+    // the workers and the calling thread. Only one thread may call run().
+    void run(Job job, void* context, int count);
+
+private:
+    class Worker : public QThread {
+    public:
+        explicit Worker(AudioWorkerPool* pool) : m_pool(pool) {}
+
+    protected:
+        void run() override { m_pool->workerLoop(); }
+
+    private:
+        AudioWorkerPool* m_pool;
+    };
+
+    std::vector<Worker*> m_workers;
+    QSemaphore m_wake;
+    std::atomic<bool> m_stopping{false};
+
+    // Generation in the high half, next index in the low half
+    std::atomic<unsigned long long> m_claim{0};
+    std::atomic<int> m_finished{0};
+    std::atomic<Job> m_job{nullptr};
+    std::atomic<void*> m_context{nullptr};
+    std::atomic<int> m_count{0};
+
+    bool runOne(unsigned int generation);
+    void workerLoop();
+};
+
+#endif // AUDIOWORKERPOOL_H
@@ -0,0 +1,159 @@
+// Samples per second for every AudioKernels kernel on every kernel set this
+// CPU supports. Each set is checked bit-for-bit against the scalar set first.
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <vector>
+#include "audiokernels.h"
+
+namespace {
+
+constexpr int kBlock = 4096 + 3; // odd tail exercises the scalar remainder
+constexpr int kMixInputs = 4;
+constexpr double kMinSeconds = 0.25;
+
+struct Buffers {
+    std::vector<int16_t> pcm;
+    std::vector<float> floats;
+    std::vector<float> left;
+    std::vector<float> right;
+    std::vector<float> inputs[kMixInputs];
+    float gains[kMixInputs] = {0.8f, 1.25f, 0.5f, 2.0f};
+
+    Buffers() {
+        std::mt19937 rng(1234);
+        std::uniform_int_distribution<int> pcmDist(-32768, 32767);
+        std::uniform_real_distribution<float> floatDist(-1.5f, 1.5f);
+        pcm.resize(kBlock);
+        floats.resize(kBlock * 2);
+        left.resize(kBlock);
+        right.resize(kBlock);
+        for (auto& s : pcm) s = int16_t(pcmDist(rng));
+        for (auto& f : floats) f = floatDist(rng);
+        for (auto& f : left) f = floatDist(rng);
+        for (auto& f : right) f = floatDist(rng);
+        for (auto& input : inputs) {
+            input.resize(kBlock);
+            for (auto& f : input) f = floatDist(rng);
+        }
+        // Edge values for the saturating conversion
+        const float edges[] = {1.0f, -1.0f, 32767.0f / 32768.0f, -0.0f, 1e9f, -1e9f,
+                               0.99999f, -0.99999f, 0.49999f / 32768.0f, NAN};
+        std::memcpy(floats.data(), edges, sizeof(edges));
+    }
+};
+
+bool sameBits(const void* a, const void* b, size_t bytes) {
+    return std::memcmp(a, b, bytes) == 0;
+}
+
+bool verify(const AudioKernels::KernelSet& set, const AudioKernels::KernelSet& ref, Buffers& in) {
+    bool ok = true;
+    auto report = [&ok, &set](const char* kernel, bool same) {
+        if (!same) {
+            std::printf("  MISMATCH %s/%s\n", set.name, kernel);
+            ok = false;
+        }
+    };
+
+    std::vector<float> fa(kBlock * 2), fb(kBlock * 2), fc(kBlock), fd(kBlock);
+    std::vector<int16_t> sa(kBlock * 2), sb(kBlock * 2);
+
+    set.int16ToFloat(fa.data(), in.pcm.data(), kBlock);
+    ref.int16ToFloat(fb.data(), in.pcm.data(), kBlock);
+    report("int16ToFloat", sameBits(fa.data(), fb.data(), kBlock * sizeof(float)));
+
+    set.floatToInt16(sa.data(), in.floats.data(), kBlock * 2);
+    ref.floatToInt16(sb.data(), in.floats.data(), kBlock * 2);
+    report("floatToInt16", sameBits(sa.data(), sb.data(), kBlock * 2 * sizeof(int16_t)));
+
+    fa.assign(in.floats.begin(), in.floats.end());
+    fb.assign(in.floats.begin(), in.floats.end());
+    set.applyGain(fa.data(), kBlock * 2, 0.7071f);
+    ref.applyGain(fb.data(), kBlock * 2, 0.7071f);
+    report("applyGain", sameBits(fa.data(), fb.data(), kBlock * 2 * sizeof(float)));
+
+    const float* inputs[kMixInputs] = {in.inputs[0].data(), in.inputs[1].data(),
+                                       in.inputs[2].data(), in.inputs[3].data()};
+    set.mix(fa.data(), inputs, in.gains, kMixInputs, kBlock);
+    ref.mix(fb.data(), inputs, in.gains, kMixInputs, kBlock);
+    report("mix", sameBits(fa.data(), fb.data(), kBlock * sizeof(float)));
+
+    set.interleave2(fa.data(), in.left.data(), in.right.data(), kBlock);
+    ref.interleave2(fb.data(), in.left.data(), in.right.data(), kBlock);
+    report("interleave2", sameBits(fa.data(), fb.data(), kBlock * 2 * sizeof(float)));
+
+    set.deinterleave2(fc.data(), fd.data(), in.floats.data(), kBlock);
+    ref.deinterleave2(fa.data(), fb.data(), in.floats.data(), kBlock);
+    report("deinterleave2", sameBits(fc.data(), fa.data(), kBlock * sizeof(float))
+                            && sameBits(fd.data(), fb.data(), kBlock * sizeof(float)));
+
+    // Every length up to a few groups, for the tail handling
+    bool dotSame = true;
+    for (int count = 0; count <= 40; ++count) {
+        const float x = set.dot(in.left.data(), in.right.data(), count);
+        const float y = ref.dot(in.left.data(), in.right.data(), count);
+        dotSame = dotSame && sameBits(&x, &y, sizeof(float));
+    }
+    const float x = set.dot(in.left.data(), in.right.data(), kBlock);
+    const float y = ref.dot(in.left.data(), in.right.data(), kBlock);
+    report("dot", dotSame && sameBits(&x, &y, sizeof(float)));
+    return ok;
+}
+
+template <typename Fn>
+double samplesPerSecond(int samplesPerCall, Fn&& fn) {
+    using Clock = std::chrono::steady_clock;
+    long long calls = 0;
+    const auto start = Clock::now();
+    double elapsed = 0.0;
+    do {
+        for (int i = 0; i < 64; ++i) {
+            fn();
+        }
+        calls += 64;
+        elapsed = std::chrono::duration<double>(Clock::now() - start).count();
+    } while (elapsed < kMinSeconds);
+    return double(calls) * samplesPerCall / elapsed;
+}
+
+void benchmark(const AudioKernels::KernelSet& set, Buffers& in) {
+    std::vector<float> fa(kBlock * 2), fb(kBlock), fc(kBlock);
+    std::vector<int16_t> sa(kBlock * 2);
+    const float* inputs[kMixInputs] = {in.inputs[0].data(), in.inputs[1].data(),
+                                       in.inputs[2].data(), in.inputs[3].data()};
+
+    auto print = [&set](const char* kernel, double rate) {
+        std::printf("  %-8s %-16s %10.1f Msamples/s\n", set.name, kernel, rate / 1e6);
+    };
+
+    print("int16ToFloat", samplesPerSecond(kBlock, [&] { set.int16ToFloat(fa.data(), in.pcm.data(), kBlock); }));
+    print("floatToInt16", samplesPerSecond(kBlock * 2, [&] { set.floatToInt16(sa.data(), in.floats.data(), kBlock * 2); }));
+    print("applyGain", samplesPerSecond(kBlock * 2, [&] { set.applyGain(fa.data(), kBlock * 2, 0.999f); }));
+    print("mix x4", samplesPerSecond(kBlock * kMixInputs, [&] { set.mix(fb.data(), inputs, in.gains, kMixInputs, kBlock); }));
+    print("interleave2", samplesPerSecond(kBlock * 2, [&] { set.interleave2(fa.data(), in.left.data(), in.right.data(), kBlock); }));
+    print("deinterleave2", samplesPerSecond(kBlock * 2, [&] { set.deinterleave2(fb.data(), fc.data(), in.floats.data(), kBlock); }));
+    volatile float sink = 0.0f;
+    print("dot", samplesPerSecond(kBlock, [&] { sink = sink + set.dot(in.left.data(), in.right.data(), kBlock); }));
+}
+
+} // namespace
+
+int main() {
+    Buffers buffers;
+    const AudioKernels::KernelSet& scalar = AudioKernels::available(0);
+    bool allExact = true;
+
+    std::printf("Active kernel set: %s\n", AudioKernels::active().name);
+    for (int i = 0; i < AudioKernels::availableCount(); ++i) {
+        const AudioKernels::KernelSet& set = AudioKernels::available(i);
+        const bool exact = verify(set, scalar, buffers);
+        allExact = allExact && exact;
+        std::printf("%s: %s\n", set.name, exact ? "bit-exact with scalar" : "NOT bit-exact");
+        benchmark(set, buffers);
+    }
+    return allExact ? 0 : 1;
+}
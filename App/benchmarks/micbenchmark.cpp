@@ -0,0 +1,155 @@
+// Cost of the per-mic channel strips and how running them on the bus
+// worker pool scales.
+//
+// Every mic gets the strip the manager builds (feedback suppressor, gate,
+// EQ, compressor) and its own voice, mono at 48 kHz in 128 frame periods,
+// the default period of the pipeline. First the cost of one strip, then
+// the time for a whole period of 1 to 6 mics with 0 to 3 worker threads
+// next to the calling thread. The parallel runs must produce the same
+// samples as the serial one. The speed-up is capped by the cores the
+// machine has; on a single core the pool can only add overhead.
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <memory>
+#include <vector>
+#include "audioprocessor.h"
+#include "audioworkerpool.h"
+#include "compressor.h"
+#include "feedbacksuppressor.h"
+#include "noisegate.h"
+#include "voiceeq.h"
+
+namespace {
+
+constexpr double kPi = 3.14159265358979323846;
+constexpr int kSampleRate = 48000;
+constexpr int kPeriodFrames = 128;
+constexpr int kPeriods = 1500;
+constexpr int kMaxMics = 6;
+constexpr int kMaxWorkers = 3;
+
+struct Strip {
+    FeedbackSuppressor suppressor;
+    NoiseGate gate;
+    VoiceEq eq;
+    Compressor compressor;
+    AudioProcessorChain chain;
+    std::vector<float> voice;
+    std::vector<float> output;
+
+    explicit Strip(int mic) {
+        chain.prepare(kSampleRate, 1, kPeriodFrames);
+        chain.append(&suppressor);
+        chain.append(&gate);
+        chain.append(&eq);
+        chain.append(&compressor);
+        eq.setPresenceDb(3.0);
+
+        // A different note per singer, phrases of a second with gaps, and
+        // a little hiss for the gate
+        const int frames = kPeriods * kPeriodFrames;
+        const double frequency = 196.0 * std::pow(2.0, mic * 3.0 / 12.0);
+        voice.resize(size_t(frames));
+        unsigned int noise = 12345u + unsigned(mic);
+        for (int i = 0; i < frames; ++i) {
+            noise = noise * 1664525u + 1013904223u;
+            const double hiss = 0.002 * (double(noise >> 8) / double(1u << 24) - 0.5);
+            const double phase = 2.0 * kPi * frequency * i / kSampleRate;
+            const bool singing = (i / kSampleRate) % 3 != 2;
+            const double sung = singing ? 0.2 * std::sin(phase) + 0.08 * std::sin(2 * phase) + 0.04 * std::sin(3 * phase) : 0.0;
+            voice[size_t(i)] = float(sung + hiss);
+        }
+        output.resize(size_t(frames));
+    }
+
+    void reset() {
+        for (AudioProcessor* processor : {static_cast<AudioProcessor*>(&suppressor), static_cast<AudioProcessor*>(&gate),
+                                          static_cast<AudioProcessor*>(&eq), static_cast<AudioProcessor*>(&compressor)}) {
+            processor->reset();
+        }
+        std::copy(voice.begin(), voice.end(), output.begin());
+    }
+};
+
+struct Period {
+    std::vector<std::unique_ptr<Strip>>* strips = nullptr;
+    int offset = 0;
+};
+
+void runStrip(void* context, int index) {
+    Period* period = static_cast<Period*>(context);
+    Strip& strip = *(*period->strips)[size_t(index)];
+    strip.chain.process(strip.output.data() + period->offset, kPeriodFrames);
+}
+
+// Runs every period of mics strips, on the pool if there is one; us/period
+double runPeriods(std::vector<std::unique_ptr<Strip>>& strips, int mics, AudioWorkerPool* pool) {
+    using Clock = std::chrono::steady_clock;
+    for (int mic = 0; mic < mics; ++mic) {
+        strips[size_t(mic)]->reset();
+    }
+    Period period;
+    period.strips = &strips;
+    const auto start = Clock::now();
+    for (int i = 0; i < kPeriods; ++i) {
+        period.offset = i * kPeriodFrames;
+        if (pool) {
+            pool->run(&runStrip, &period, mics);
+        } else {
+            for (int mic = 0; mic < mics; ++mic) {
+                runStrip(&period, mic);
+            }
+        }
+    }
+    return std::chrono::duration<double, std::micro>(Clock::now() - start).count() / kPeriods;
+}
+
+} // namespace
+
+int main() {
+    const double periodBudgetUs = 1e6 * kPeriodFrames / kSampleRate;
+    std::vector<std::unique_ptr<Strip>> strips;
+    for (int mic = 0; mic < kMaxMics; ++mic) {
+        strips.push_back(std::make_unique<Strip>(mic));
+    }
+
+    std::printf("Mic strip, mono %d Hz, %d frame periods (%.0f us budget)\n", kSampleRate, kPeriodFrames, periodBudgetUs);
+    const double stripUs = runPeriods(strips, 1, nullptr);
+    std::printf("  %-24s %7.1f us/period  %5.2f%% of a core\n", "one mic", stripUs, 100.0 * stripUs / periodBudgetUs);
+
+    std::vector<std::unique_ptr<AudioWorkerPool>> pools;
+    for (int workers = 1; workers <= kMaxWorkers; ++workers) {
+        pools.push_back(std::make_unique<AudioWorkerPool>(workers));
+    }
+
+    bool ok = true;
+    std::printf("Mics x worker threads, us/period (speed-up over serial)\n");
+    std::printf("  %-6s", "mics");
+    for (int workers = 0; workers <= kMaxWorkers; ++workers) {
+        std::printf("  %12d", workers);
+    }
+    std::printf("\n");
+    for (int mics : {1, 2, 4, 6}) {
+        const double serialUs = runPeriods(strips, mics, nullptr);
+        std::vector<std::vector<float>> reference;
+        for (int mic = 0; mic < mics; ++mic) {
+            reference.push_back(strips[size_t(mic)]->output);
+        }
+
+        std::printf("  %-6d  %7.1f      ", mics, serialUs);
+        for (int workers = 1; workers <= kMaxWorkers; ++workers) {
+            const double parallelUs = runPeriods(strips, mics, pools[size_t(workers - 1)].get());
+            bool same = true;
+            for (int mic = 0; mic < mics; ++mic) {
+                same = same && strips[size_t(mic)]->output == reference[size_t(mic)];
+            }
+            ok = ok && same;
+            std::printf("  %7.1f (%.1fx)%s", parallelUs, serialUs / parallelUs, same ? "" : " FAIL");
+        }
+        std::printf("\n");
+    }
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,144 @@
+// YinPitchTracker accuracy on synthetic voices and cost per estimate.
+//
+// The FFT difference function is timed against the direct O(N^2) sum the
+// Arduino port uses. The percentages are the share of one core needed for
+// an estimate every 10 ms.
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <vector>
+#include "yinpitchtracker.h"
+
+namespace {
+
+constexpr double kPi = 3.14159265358979323846;
+constexpr int kWindow = 2048;
+constexpr double kHopMs = 10.0;
+constexpr double kMinSeconds = 0.5;
+
+// Sawtooth-ish voice: five harmonics with falling level and light vibrato
+std::vector<float> voice(int sampleRate, double frequency, double seconds) {
+    std::vector<float> samples(size_t(sampleRate * seconds));
+    double phase = 0.0;
+    for (size_t i = 0; i < samples.size(); ++i) {
+        const double vibrato = 1.0 + 0.003 * std::sin(2.0 * kPi * 5.0 * i / sampleRate);
+        phase += 2.0 * kPi * frequency * vibrato / sampleRate;
+        double value = 0.0;
+        for (int harmonic = 1; harmonic <= 5; ++harmonic) {
+            value += std::sin(harmonic * phase) / harmonic;
+        }
+        samples[i] = float(0.3 * value);
+    }
+    return samples;
+}
+
+// The Arduino formulation: direct difference, no FFT
+double directDifference(const float* window, int length, int maxTau, std::vector<float>& out) {
+    double checksum = 0.0;
+    for (int tau = 1; tau <= maxTau; ++tau) {
+        double sum = 0.0;
+        for (int j = 0; j < length; ++j) {
+            const double delta = double(window[j]) - window[j + tau];
+            sum += delta * delta;
+        }
+        out[tau] = float(sum);
+        checksum += sum;
+    }
+    return checksum;
+}
+
+template <typename Fn>
+double microsecondsPerCall(Fn&& fn) {
+    using Clock = std::chrono::steady_clock;
+    long long calls = 0;
+    const auto start = Clock::now();
+    double elapsed = 0.0;
+    do {
+        fn();
+        ++calls;
+        elapsed = std::chrono::duration<double>(Clock::now() - start).count();
+    } while (elapsed < kMinSeconds);
+    return elapsed * 1e6 / double(calls);
+}
+
+bool accuracy(int sampleRate) {
+    YinPitchTracker tracker;
+    tracker.configure(sampleRate, kWindow, YinPitchTracker::hopForInterval(sampleRate, kHopMs));
+
+    bool ok = true;
+    std::printf("Accuracy at %d Hz (window %d, hop %d)\n", sampleRate, kWindow, tracker.hopFrames());
+    for (double frequency : {82.4, 110.0, 196.0, 261.6, 440.0, 659.3, 987.8}) {
+        const std::vector<float> samples = voice(sampleRate, frequency, 1.0);
+        int estimates = 0;
+        int voiced = 0;
+        double worstCents = 0.0;
+        tracker.reset();
+        tracker.process(samples.data(), int(samples.size()), [&](const YinPitchTracker::Estimate& estimate) {
+            ++estimates;
+            if (estimate.voiced) {
+                ++voiced;
+                worstCents = std::max(worstCents, std::abs(1200.0 * std::log2(estimate.frequency / frequency)));
+            }
+        });
+        // Vibrato alone moves the pitch by about 5 cents
+        const bool pass = voiced == estimates && worstCents < 10.0;
+        ok = ok && pass;
+        std::printf("  %7.1f Hz: %3d/%3d voiced, worst %6.2f cents %s\n", frequency, voiced, estimates,
+                    worstCents, pass ? "" : "FAIL");
+    }
+
+    std::mt19937 rng(7);
+    std::normal_distribution<float> noiseDist(0.0f, 0.2f);
+    std::vector<float> noise(static_cast<size_t>(sampleRate));
+    for (float& sample : noise) {
+        sample = noiseDist(rng);
+    }
+    int estimates = 0;
+    int voiced = 0;
+    tracker.reset();
+    tracker.process(noise.data(), int(noise.size()), [&](const YinPitchTracker::Estimate& estimate) {
+        ++estimates;
+        voiced += estimate.voiced ? 1 : 0;
+    });
+    std::printf("  white noise: %d/%d voiced\n", voiced, estimates);
+    return ok && voiced * 10 < estimates;
+}
+
+void cost(int sampleRate) {
+    YinPitchTracker tracker;
+    tracker.configure(sampleRate, kWindow, YinPitchTracker::hopForInterval(sampleRate, kHopMs));
+    const std::vector<float> samples = voice(sampleRate, 220.0, 0.5);
+
+    int offset = 0;
+    const double fftUs = microsecondsPerCall([&] {
+        tracker.analyze(samples.data() + offset);
+        offset = (offset + 97) % 4096;
+    });
+
+    const int maxTau = std::min(kWindow / 2, int(std::ceil(sampleRate / 60.0)));
+    std::vector<float> direct(size_t(maxTau) + 1);
+    volatile double sink = 0.0;
+    const double directUs = microsecondsPerCall([&] {
+        sink = sink + directDifference(samples.data(), kWindow - maxTau, maxTau, direct);
+    });
+
+    std::printf("Cost at %d Hz\n", sampleRate);
+    std::printf("  FFT YIN estimate    %8.1f us  (%5.2f%% of a core at %.0f ms hops)\n", fftUs,
+                100.0 * fftUs / (kHopMs * 1000.0), kHopMs);
+    std::printf("  direct difference   %8.1f us  (%5.2f%% of a core, difference function only)\n", directUs,
+                100.0 * directUs / (kHopMs * 1000.0));
+}
+
+} // namespace
+
+int main() {
+    bool ok = true;
+    for (int sampleRate : {44100, 48000}) {
+        ok = accuracy(sampleRate) && ok;
+        cost(sampleRate);
+    }
+    return ok ? 0 : 1;
+}
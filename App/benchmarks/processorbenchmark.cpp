@@ -0,0 +1,336 @@
+// Cost of the mix bus processors on a stereo 48 kHz backing track.
+//
+// Each processor runs on 10 ms blocks the way the output thread drives a
+// bus source. Reported: microseconds per block, the share of one core
+// that is, and the resulting multiple of realtime. The pitch shifter is
+// also checked for landing on the requested interval, the media
+// time-stretcher for keeping the pitch at every tempo, and the vocal
+// reducer for how far it pulls down a centred voice. The mic effects run
+// on a mono voice; two mics with all of them on should stay under 10% of
+// a Raspberry Pi core. The feedback suppressor is also checked for
+// leaving the voice alone and for notching a howl that builds up under it,
+// and the output limiter for holding a backing track driven 12 dB over
+// full scale under its ceiling.
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <vector>
+#include "compressor.h"
+#include "echodelay.h"
+#include "fdnreverb.h"
+#include "feedbacksuppressor.h"
+#include "noisegate.h"
+#include "peaklimiter.h"
+#include "pitchshifter.h"
+#include "timestretcher.h"
+#include "vocalreducer.h"
+#include "yinpitchtracker.h"
+
+namespace {
+
+constexpr double kPi = 3.14159265358979323846;
+constexpr int kSampleRate = 48000;
+constexpr int kChannels = 2;
+constexpr int kBlockFrames = kSampleRate / 100;
+constexpr double kSeconds = 4.0;
+
+// Stand-in for a backing track: a bass note and a fifth above it spread
+// across the channels, so both channels carry harmonics
+std::vector<float> backingTrack(double frequency) {
+    const int frames = int(kSampleRate * kSeconds);
+    std::vector<float> samples(size_t(frames) * kChannels);
+    for (int i = 0; i < frames; ++i) {
+        const double phase = 2.0 * kPi * frequency * i / kSampleRate;
+        double root = 0.0;
+        for (int harmonic = 1; harmonic <= 6; ++harmonic) {
+            root += std::sin(harmonic * phase) / harmonic;
+        }
+        const double fifth = std::sin(1.5 * phase) + 0.3 * std::sin(3.0 * phase);
+        samples[size_t(i) * 2] = float(0.25 * root + 0.05 * fifth);
+        samples[size_t(i) * 2 + 1] = float(0.15 * root + 0.15 * fifth);
+    }
+    return samples;
+}
+
+// Runs the whole buffer through the processor in blocks, returns us/block
+double runBlocks(AudioProcessor& processor, std::vector<float>& samples, int channels = kChannels) {
+    using Clock = std::chrono::steady_clock;
+    const int frames = int(samples.size() / channels);
+    int blocks = 0;
+    const auto start = Clock::now();
+    for (int frame = 0; frame + kBlockFrames <= frames; frame += kBlockFrames) {
+        processor.run(samples.data() + size_t(frame) * channels, kBlockFrames);
+        ++blocks;
+    }
+    return std::chrono::duration<double, std::micro>(Clock::now() - start).count() / blocks;
+}
+
+void report(const char* name, double blockUs) {
+    const double blockBudgetUs = 1e6 * kBlockFrames / kSampleRate;
+    std::printf("  %-24s %7.1f us/block  %5.2f%% of a core  %7.1fx realtime\n", name, blockUs,
+                100.0 * blockUs / blockBudgetUs, blockBudgetUs / blockUs);
+}
+
+struct PitchError {
+    double meanCents = 0.0;
+    double worstCents = 0.0;
+};
+
+// Left channel pitch against the expected one, after the first half second
+PitchError pitchError(const std::vector<float>& samples, double expected) {
+    const int frames = int(samples.size() / kChannels);
+    std::vector<float> left(size_t(frames - kSampleRate / 2));
+    for (size_t i = 0; i < left.size(); ++i) {
+        left[i] = samples[(i + kSampleRate / 2) * kChannels];
+    }
+    YinPitchTracker tracker;
+    tracker.configure(kSampleRate, 2048, YinPitchTracker::hopForInterval(kSampleRate, 10.0));
+    PitchError error;
+    int voiced = 0;
+    tracker.process(left.data(), int(left.size()), [&](const YinPitchTracker::Estimate& estimate) {
+        if (estimate.voiced) {
+            const double cents = std::abs(1200.0 * std::log2(estimate.frequency / expected));
+            error.meanCents += cents;
+            error.worstCents = std::max(error.worstCents, cents);
+            ++voiced;
+        }
+    });
+    error.meanCents /= std::max(1, voiced);
+    return error;
+}
+
+bool pitchShifter() {
+    constexpr double kFrequency = 110.0;
+    bool ok = true;
+    std::printf("PitchShifter, stereo %d Hz, %d frame blocks\n", kSampleRate, kBlockFrames);
+    for (int semitones = PitchShifter::kMinSemitones; semitones <= PitchShifter::kMaxSemitones; ++semitones) {
+        PitchShifter shifter;
+        shifter.prepare(kSampleRate, kChannels, kBlockFrames);
+        shifter.setSemitones(semitones);
+        shifter.reset();
+
+        std::vector<float> samples = backingTrack(kFrequency);
+        const double blockUs = runBlocks(shifter, samples);
+        const PitchError error = pitchError(samples, kFrequency * std::exp2(semitones / 12.0));
+
+        const bool pass = error.worstCents < 5.0;
+        ok = ok && pass;
+        char name[40];
+        std::snprintf(name, sizeof(name), "%+d st (worst %.2f c)%s", semitones, error.worstCents, pass ? "" : " FAIL");
+        report(name, blockUs);
+    }
+    return ok;
+}
+
+bool timeStretcher() {
+    constexpr double kFrequency = 110.0;
+    bool ok = true;
+    std::printf("TimeStretcher, stereo %d Hz, %d frame input blocks\n", kSampleRate, kBlockFrames);
+    for (double rate : {0.5, 0.75, 0.9, 1.0, 1.1, 1.25, 1.5}) {
+        TimeStretcher stretcher;
+        stretcher.configure(kSampleRate, kChannels);
+        stretcher.setRate(rate);
+
+        const std::vector<float> input = backingTrack(kFrequency);
+        std::vector<float> output;
+        output.reserve(size_t(input.size() / rate) + size_t(kSampleRate) * kChannels);
+        using Clock = std::chrono::steady_clock;
+        const int frames = int(input.size() / kChannels);
+        const auto start = Clock::now();
+        for (int frame = 0; frame + kBlockFrames <= frames; frame += kBlockFrames) {
+            stretcher.process(input.data() + size_t(frame) * kChannels, kBlockFrames,
+                              [&](const float* hop, int count) {
+                output.insert(output.end(), hop, hop + size_t(count) * kChannels);
+            });
+        }
+        const double elapsedUs = std::chrono::duration<double, std::micro>(Clock::now() - start).count();
+
+        // Cost per 10 ms of output, which is what the device consumes.
+        // The test chord repeats every 18 ms, longer than the search, so
+        // estimates across a splice wobble by a few cents on average.
+        const double outputBlocks = double(output.size() / kChannels) / kBlockFrames;
+        const PitchError error = pitchError(output, kFrequency);
+        const double lengthError = std::abs(double(output.size()) / input.size() * rate - 1.0);
+        const bool pass = error.meanCents < 10.0 && lengthError < 0.01;
+        ok = ok && pass;
+        char name[40];
+        std::snprintf(name, sizeof(name), "%.2fx (mean %.2f c)%s", rate, error.meanCents, pass ? "" : " FAIL");
+        report(name, elapsedUs / outputBlocks);
+    }
+
+    TimeStretcher stretcher;
+    stretcher.configure(kSampleRate, kChannels);
+    std::printf("  lookahead %.1f ms of input, %.1f ms of wall time at %.2fx\n",
+                1000.0 * stretcher.latencyFrames() / kSampleRate,
+                1000.0 * stretcher.latencyFrames() / (kSampleRate * TimeStretcher::kMinRate), TimeStretcher::kMinRate);
+    return ok;
+}
+
+// Amplitude of the frequency component in one channel, from frame on
+double toneLevel(const std::vector<float>& samples, int channel, int from, double frequency) {
+    double re = 0.0;
+    double im = 0.0;
+    const int frames = int(samples.size() / kChannels);
+    for (int i = from; i < frames; ++i) {
+        const double phase = 2.0 * kPi * frequency * i / kSampleRate;
+        re += samples[size_t(i) * kChannels + channel] * std::cos(phase);
+        im += samples[size_t(i) * kChannels + channel] * std::sin(phase);
+    }
+    return 2.0 * std::hypot(re, im) / (frames - from);
+}
+
+bool vocalReducer() {
+    // A voice on C5, off the backing track's harmonics, panned centre
+    constexpr double kVoice = 523.25;
+    bool ok = true;
+    std::printf("VocalReducer, stereo %d Hz, %d frame blocks\n", kSampleRate, kBlockFrames);
+    const char* names[] = {"mid/side", "band limited", "spectral mask"};
+    for (int mode = VocalReducer::MidSide; mode <= VocalReducer::SpectralMask; ++mode) {
+        VocalReducer reducer;
+        reducer.prepare(kSampleRate, kChannels, kBlockFrames);
+        reducer.setMode(VocalReducer::Mode(mode));
+        reducer.setEnabled(true);
+        reducer.reset();
+
+        std::vector<float> samples = backingTrack(110.0);
+        const int frames = int(samples.size() / kChannels);
+        for (int i = 0; i < frames; ++i) {
+            const float voice = float(0.2 * std::sin(2.0 * kPi * kVoice * i / kSampleRate));
+            samples[size_t(i) * 2] += voice;
+            samples[size_t(i) * 2 + 1] += voice;
+        }
+        const double before = toneLevel(samples, 0, kSampleRate, kVoice);
+        const double blockUs = runBlocks(reducer, samples);
+        const double after = toneLevel(samples, 0, kSampleRate, kVoice);
+
+        const double rejectionDb = 20.0 * std::log10(before / std::max(after, 1e-9));
+        const bool pass = rejectionDb > 25.0;
+        ok = ok && pass;
+        char name[40];
+        std::snprintf(name, sizeof(name), "%s (-%.0f dB)%s", names[mode], rejectionDb, pass ? "" : " FAIL");
+        report(name, blockUs);
+    }
+    return ok;
+}
+
+bool micEffects() {
+    std::printf("Mic effects, mono %d Hz, %d frame blocks\n", kSampleRate, kBlockFrames);
+
+    // A sung vowel: 220 Hz with a few harmonics, on and off every half second
+    const int frames = int(kSampleRate * kSeconds);
+    std::vector<float> voice(static_cast<size_t>(frames));
+    for (int i = 0; i < frames; ++i) {
+        const double phase = 2.0 * kPi * 220.0 * i / kSampleRate;
+        const bool singing = (i / (kSampleRate / 2)) % 2 == 0;
+        voice[i] = singing ? float(0.2 * std::sin(phase) + 0.1 * std::sin(2 * phase) + 0.05 * std::sin(3 * phase)) : 0.0f;
+    }
+
+    double slowestReverbUs = 0.0;
+    for (int preset = FdnReverb::Room; preset <= FdnReverb::Cathedral; ++preset) {
+        FdnReverb reverb;
+        reverb.prepare(kSampleRate, 1, kBlockFrames);
+        reverb.setPreset(FdnReverb::Preset(preset));
+        reverb.setEnabled(true);
+        reverb.reset();
+        std::vector<float> samples = voice;
+        const double blockUs = runBlocks(reverb, samples, 1);
+        slowestReverbUs = std::max(slowestReverbUs, blockUs);
+        const char* names[] = {"reverb room", "reverb hall", "reverb plate", "reverb cathedral"};
+        report(names[preset], blockUs);
+    }
+
+    EchoDelay echo;
+    echo.prepare(kSampleRate, 1, kBlockFrames);
+    echo.setPreset(EchoDelay::DottedEighth);
+    echo.setEnabled(true);
+    echo.reset();
+    std::vector<float> samples = voice;
+    const double echoUs = runBlocks(echo, samples, 1);
+    report("echo dotted eighth", echoUs);
+
+    // The voice alone must not be mistaken for feedback
+    FeedbackSuppressor suppressor;
+    suppressor.prepare(kSampleRate, 1, kBlockFrames);
+    samples = voice;
+    runBlocks(suppressor, samples, 1);
+    const bool voiceKept = suppressor.activeNotchCount() == 0;
+
+    // A 2.5 kHz howl growing from -60 dBFS to -10 dBFS over the first
+    // half, then holding; its level over the last second with and without
+    // the suppressor
+    suppressor.reset();
+    suppressor.resetCost();
+    samples = voice;
+    for (int i = 0; i < frames; ++i) {
+        const double level = std::pow(10.0, (-60.0 + 50.0 * std::min(1.0, 2.0 * i / frames)) / 20.0);
+        samples[i] += float(level * std::sin(2.0 * kPi * 2500.0 * i / kSampleRate));
+    }
+    std::vector<float> howling = samples;
+    const double suppressorUs = runBlocks(suppressor, samples, 1);
+    const auto howlLevel = [frames](const std::vector<float>& signal) {
+        double re = 0.0;
+        double im = 0.0;
+        for (int i = frames - kSampleRate; i < frames; ++i) {
+            re += signal[i] * std::cos(2.0 * kPi * 2500.0 * i / kSampleRate);
+            im += signal[i] * std::sin(2.0 * kPi * 2500.0 * i / kSampleRate);
+        }
+        return std::hypot(re, im);
+    };
+    const double reductionDb = 20.0 * std::log10(howlLevel(howling) / howlLevel(samples));
+    const bool howlCaught = suppressor.activeNotchCount() > 0 && reductionDb > 12.0;
+    report("feedback suppressor", suppressorUs);
+    std::printf("  %-24s %7.1f us worst block, %d notch(es), howl down %.1f dB%s\n", "", suppressor.peakCostUs(),
+                suppressor.activeNotchCount(), reductionDb, voiceKept ? "" : ", voice notched");
+
+    NoiseGate gate;
+    gate.prepare(kSampleRate, 1, kBlockFrames);
+    samples = voice;
+    const double gateUs = runBlocks(gate, samples, 1);
+    report("noise gate", gateUs);
+
+    Compressor compressor;
+    compressor.prepare(kSampleRate, 1, kBlockFrames);
+    samples = voice;
+    const double compressorUs = runBlocks(compressor, samples, 1);
+    report("compressor", compressorUs);
+
+    // Everything on, on two mics
+    report("two mics, all", 2.0 * (slowestReverbUs + echoUs + suppressorUs + gateUs + compressorUs));
+    return voiceKept && howlCaught;
+}
+
+bool outputLimiter() {
+    std::printf("PeakLimiter, stereo %d Hz, %d frame blocks\n", kSampleRate, kBlockFrames);
+    PeakLimiter limiter;
+    limiter.prepare(kSampleRate, kChannels, kBlockFrames);
+
+    std::vector<float> samples = backingTrack(110.0);
+    for (float& sample : samples) {
+        sample *= 4.0f;
+    }
+    const double blockUs = runBlocks(limiter, samples);
+
+    float peak = 0.0f;
+    for (float sample : samples) {
+        peak = std::max(peak, std::abs(sample));
+    }
+    const double peakDb = 20.0 * std::log10(peak);
+    const bool pass = peakDb <= limiter.ceilingDb() + 0.01;
+    char name[40];
+    std::snprintf(name, sizeof(name), "+12 dB in (%.2f dBFS out)%s", peakDb, pass ? "" : " FAIL");
+    report(name, blockUs);
+    return pass;
+}
+
+} // namespace
+
+int main() {
+    bool ok = pitchShifter();
+    ok = timeStretcher() && ok;
+    ok = vocalReducer() && ok;
+    ok = micEffects() && ok;
+    ok = outputLimiter() && ok;
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,132 @@
+// Throughput and read-jitter comparison between the lock-free ring buffer
+// used by AudioPassthrough and the previous QByteArray + QMutex storage.
+//
+// A producer thread pushes 10 ms mic-sized chunks while a consumer thread
+// pulls sink-sized periods, the same pattern as AudioInputThread and
+// AudioOutputThread. Reported: MB/s moved and per-read call latency.
+
+#include <QByteArray>
+#include <QMutex>
+#include <QMutexLocker>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <thread>
+#include <vector>
+#include "spscringbuffer.h"
+
+namespace {
+
+constexpr qint64 kTotalBytes = 256ll * 1024 * 1024;
+constexpr int kWriteChunk = 882;   // 10 ms of 44.1 kHz mono Int16
+constexpr int kReadPeriod = 1024;  // typical QAudioSink pull size
+constexpr int kMaxBufferSize = 1024 * 1024;
+
+// Copy of the storage AudioPassthrough used before the ring buffer
+class LegacyQueue {
+public:
+    qint64 read(char *data, qint64 maxSize) {
+        QMutexLocker locker(&m_mutex);
+        qint64 bytesToRead = qMin(maxSize, qint64(m_buffer.size()));
+        if (bytesToRead > 0) {
+            memcpy(data, m_buffer.constData(), bytesToRead);
+            m_buffer.remove(0, bytesToRead);
+        }
+        return bytesToRead;
+    }
+
+    qint64 write(const char *data, qint64 maxSize) {
+        QMutexLocker locker(&m_mutex);
+        if (m_buffer.size() + maxSize > kMaxBufferSize) {
+            int bytesToDrop = (m_buffer.size() + maxSize) - kMaxBufferSize;
+            m_buffer.remove(0, bytesToDrop);
+        }
+        m_buffer.append(data, maxSize);
+        return maxSize;
+    }
+
+private:
+    QByteArray m_buffer;
+    QMutex m_mutex;
+};
+
+class RingQueue {
+public:
+    qint64 read(char *data, qint64 maxSize) {
+        return qint64(m_buffer.read(data, size_t(maxSize)));
+    }
+
+    qint64 write(const char *data, qint64 maxSize) {
+        return qint64(m_buffer.write(data, size_t(maxSize)));
+    }
+
+private:
+    SpscRingBuffer<char> m_buffer{kMaxBufferSize};
+};
+
+template <typename Queue>
+void runBenchmark(const char *name) {
+    Queue queue;
+    std::atomic<bool> producerDone{false};
+    std::vector<double> readNanos;
+    readNanos.reserve(size_t(kTotalBytes / kReadPeriod) * 2);
+
+    const auto start = std::chrono::steady_clock::now();
+
+    std::thread producer([&queue, &producerDone]() {
+        std::vector<char> chunk(kWriteChunk);
+        qint64 written = 0;
+        while (written < kTotalBytes) {
+            std::fill(chunk.begin(), chunk.end(), char(written));
+            qint64 n = queue.write(chunk.data(), kWriteChunk);
+            if (n == 0) {
+                std::this_thread::yield();
+            }
+            written += n;
+        }
+        producerDone.store(true, std::memory_order_release);
+    });
+
+    std::vector<char> period(kReadPeriod);
+    qint64 totalRead = 0;
+    while (true) {
+        const auto t0 = std::chrono::steady_clock::now();
+        const qint64 n = queue.read(period.data(), kReadPeriod);
+        const auto t1 = std::chrono::steady_clock::now();
+        if (n > 0) {
+            readNanos.push_back(std::chrono::duration<double, std::nano>(t1 - t0).count());
+            totalRead += n;
+        } else if (producerDone.load(std::memory_order_acquire)) {
+            break;
+        } else {
+            std::this_thread::yield();
+        }
+    }
+    producer.join();
+
+    const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    std::sort(readNanos.begin(), readNanos.end());
+    auto percentile = [&readNanos](double p) {
+        if (readNanos.empty()) {
+            return 0.0;
+        }
+        return readNanos[size_t(p * double(readNanos.size() - 1))];
+    };
+
+    std::printf("%-10s %9.1f MB/s  read ns p50 %8.0f  p99 %8.0f  p99.9 %8.0f  max %10.0f  (%lld bytes read)\n",
+                name, double(totalRead) / seconds / (1024.0 * 1024.0),
+                percentile(0.5), percentile(0.99), percentile(0.999),
+                readNanos.empty() ? 0.0 : readNanos.back(), static_cast<long long>(totalRead));
+}
+
+} // namespace
+
+int main() {
+    std::printf("Moving %lld MB, %d byte writes, %d byte reads\n",
+                static_cast<long long>(kTotalBytes / (1024 * 1024)), kWriteChunk, kReadPeriod);
+    runBenchmark<LegacyQueue>("legacy");
+    runBenchmark<RingQueue>("spsc-ring");
+    return 0;
+}
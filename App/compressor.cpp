@@ -0,0 +1,62 @@
+#include "compressor.h"
+#include <QtGlobal>
+#include <algorithm>
+
+namespace {
+
+constexpr double kDetectorMs = 10.0;
+constexpr double kAttackMs = 5.0;
+constexpr double kReleaseMs = 100.0;
+
+} // namespace
+
+Compressor::Compressor(QObject* parent)
+    : DynamicsProcessor(kDetectorMs, kAttackMs, kReleaseMs, true, parent) {
+}
+
+void Compressor::setThresholdDb(double db) {
+    db = qBound(-60.0, db, 0.0);
+    if (m_thresholdDb.exchange(db, std::memory_order_relaxed) != db) {
+        emit parametersChanged();
+    }
+}
+
+void Compressor::setRatio(double ratio) {
+    ratio = qBound(1.0, ratio, 20.0);
+    if (m_ratio.exchange(ratio, std::memory_order_relaxed) != ratio) {
+        emit parametersChanged();
+    }
+}
+
+void Compressor::setKneeDb(double db) {
+    db = qBound(0.0, db, 24.0);
+    if (m_kneeDb.exchange(db, std::memory_order_relaxed) != db) {
+        emit parametersChanged();
+    }
+}
+
+void Compressor::setMakeupDb(double db) {
+    db = qBound(0.0, db, 24.0);
+    if (m_makeupDb.exchange(db, std::memory_order_relaxed) != db) {
+        emit parametersChanged();
+    }
+}
+
+void Compressor::loadParameters() {
+    m_threshold = float(thresholdDb());
+    m_slope = float(1.0 / ratio() - 1.0);
+    m_knee = float(kneeDb());
+    m_makeup = float(makeupDb());
+}
+
+float Compressor::gainDb(float levelDb) const {
+    const float over = levelDb - m_threshold;
+    if (2.0f * over <= -m_knee) {
+        return 0.0f;
+    }
+    if (2.0f * over < m_knee) {
+        const float into = over + 0.5f * m_knee;
+        return m_slope * into * into / (2.0f * m_knee);
+    }
+    return m_slope * over;
+}
@@ -0,0 +1,57 @@
+#ifndef COMPRESSOR_H
+#define COMPRESSOR_H
+
+#include "dynamicsprocessor.h"
+
+// RMS compressor with a soft knee and makeup gain, for the voice.
+//
+// Above thresholdDb the level rises by only 1/ratio dB per dB of input;
+// over the kneeDb wide region around the threshold the ratio blends in
+// gradually (Giannoulis, Massberg & Reiss, 2012), so quiet passages are
+// untouched and loud ones are not squashed abruptly. The detector
+// averages power over about 10 ms, so the gain follows the loudness of
+// the voice rather than individual waveform peaks; those are the output
+// limiter's job. makeupDb is added after the reduction and left out of
+// the meter.
+class Compressor : public DynamicsProcessor {
+    Q_OBJECT
+    Q_PROPERTY(double thresholdDb READ thresholdDb WRITE setThresholdDb NOTIFY parametersChanged)
+    Q_PROPERTY(double ratio READ ratio WRITE setRatio NOTIFY parametersChanged)
+    Q_PROPERTY(double kneeDb READ kneeDb WRITE setKneeDb NOTIFY parametersChanged)
+    Q_PROPERTY(double makeupDb READ makeupDb WRITE setMakeupDb NOTIFY parametersChanged)
+
+public:
+    explicit Compressor(QObject* parent = nullptr);
+
+    double thresholdDb() const { return m_thresholdDb.load(std::memory_order_relaxed); }
+    void setThresholdDb(double db);
+
+    // 1 (off) to 20 (close to limiting)
+    double ratio() const { return m_ratio.load(std::memory_order_relaxed); }
+    void setRatio(double ratio);
+
+    double kneeDb() const { return m_kneeDb.load(std::memory_order_relaxed); }
+    void setKneeDb(double db);
+
+    double makeupDb() const { return m_makeupDb.load(std::memory_order_relaxed); }
+    void setMakeupDb(double db);
+
+protected:
+    void loadParameters() override;
+    float gainDb(float levelDb) const override;
+    float fixedGainDb() const override { return m_makeup; }
+
+private:
+    std::atomic<double> m_thresholdDb{-20.0};
+    std::atomic<double> m_ratio{3.0};
+    std::atomic<double> m_kneeDb{6.0};
+    std::atomic<double> m_makeupDb{3.0};
+
+    // Audio thread copies
+    float m_threshold = -20.0f;
+    float m_slope = -2.0f / 3.0f;   // 1/ratio - 1
+    float m_knee = 6.0f;
+    float m_makeup = 3.0f;
+};
+
+#endif // COMPRESSOR_H
@@ -0,0 +1,200 @@
+#include "contouranalyzer.h"
+#include "contourfile.h"
+#include "yinpitchtracker.h"
+#include <QAudioBuffer>
+#include <QAudioDecoder>
+#include <QAudioFormat>
+#include <QDebug>
+#include <QEventLoop>
+#include <QFileInfo>
+#include <QThread>
+#include <QUrl>
+#include <cmath>
+#include <vector>
+
+namespace {
+
+// Voice and lead instruments; the mix's bass line is below this range
+constexpr double kMinFrequency = 80.0;
+constexpr double kMaxFrequency = 1000.0;
+
+double frequencyToNote(double frequency) {
+    return 69.0 + 12.0 * std::log2(frequency / 440.0);
+}
+
+} // namespace
+
+ContourAnalyzer::ContourAnalyzer(QObject* parent) : QObject(parent) {
+    m_pool.setMaxThreadCount(QThread::idealThreadCount());
+    m_pool.setThreadPriority(QThread::LowPriority);
+}
+
+ContourAnalyzer::~ContourAnalyzer() {
+    cancel();
+    m_pool.waitForDone();
+}
+
+double ContourAnalyzer::progress() const {
+    const int total = m_done + m_queued;
+    return total > 0 ? double(m_done) / total : 0.0;
+}
+
+int ContourAnalyzer::analyze(const QStringList& paths) {
+    if (m_cancelled.load() && isRunning()) {
+        qWarning() << "Contour analysis is still cancelling";
+        return 0;
+    }
+
+    int queued = 0;
+    for (const QString& path : paths) {
+        const QFileInfo media(path);
+        const QString absolute = media.absoluteFilePath();
+        if (!media.isFile() || m_pending.contains(absolute) ||
+            ContourFile::isCurrent(ContourFile::pathFor(absolute), media)) {
+            continue;
+        }
+        m_pending.insert(absolute);
+        m_pool.start([this, absolute]() {
+            const bool ok = !m_cancelled.load(std::memory_order_relaxed) && analyzeFile(absolute);
+            QMetaObject::invokeMethod(this, [this, absolute, ok]() { fileDone(absolute, ok); },
+                                      Qt::QueuedConnection);
+        });
+        ++queued;
+    }
+
+    if (queued > 0) {
+        const bool wasRunning = isRunning();
+        m_queued += queued;
+        if (!wasRunning) {
+            emit runningChanged();
+        }
+        emit progressChanged();
+    }
+    return queued;
+}
+
+void ContourAnalyzer::cancel() {
+    if (isRunning()) {
+        // Queued files still report back, they just skip the work
+        m_cancelled.store(true);
+    }
+}
+
+void ContourAnalyzer::fileDone(const QString& path, bool ok) {
+    m_pending.remove(path);
+    --m_queued;
+    ++m_done;
+    ok ? ++m_analyzed : ++m_failed;
+    emit fileAnalyzed(path, ok);
+    emit progressChanged();
+
+    if (m_queued == 0) {
+        const int analyzed = m_analyzed;
+        const int failed = m_failed;
+        m_done = m_analyzed = m_failed = 0;
+        m_cancelled.store(false);
+        emit runningChanged();
+        emit finished(analyzed, failed);
+    }
+}
+
+bool ContourAnalyzer::analyzeFile(const QString& path) {
+    const QFileInfo media(path);
+
+    QAudioFormat format;
+    format.setSampleRate(kSampleRate);
+    format.setChannelCount(1);
+    format.setSampleFormat(QAudioFormat::Int16);
+
+    // Pool threads have no event loop of their own, the decoder runs in a
+    // local one
+    QAudioDecoder decoder;
+    decoder.setAudioFormat(format);
+    decoder.setSource(QUrl::fromLocalFile(path));
+    QEventLoop loop;
+
+    YinPitchTracker tracker;
+    int sampleRate = 0;
+    std::vector<float> mono;
+    std::vector<ContourFile::Frame> frames;
+    bool failed = false;
+
+    auto onEstimate = [&frames](const YinPitchTracker::Estimate& estimate) {
+        ContourFile::Frame frame;
+        if (estimate.voiced && estimate.frequency > 0.0) {
+            frame.note = frequencyToNote(estimate.frequency);
+            frame.confidence = estimate.confidence;
+        }
+        frames.push_back(frame);
+    };
+
+    QObject::connect(&decoder, &QAudioDecoder::bufferReady, &loop, [&]() {
+        if (m_cancelled.load(std::memory_order_relaxed)) {
+            failed = true;
+            decoder.stop();
+            loop.quit();
+            return;
+        }
+        const QAudioBuffer buffer = decoder.read();
+        const QAudioFormat bufferFormat = buffer.format();
+        const int channels = bufferFormat.channelCount();
+        if (!buffer.isValid() || channels < 1) {
+            return;
+        }
+
+        // Backends that cannot resample hand back their native format:
+        // follow its rate and take the first channel
+        if (sampleRate != bufferFormat.sampleRate()) {
+            if (sampleRate != 0) {
+                qWarning() << path << "changed sample rate while decoding";
+                failed = true;
+                decoder.stop();
+                loop.quit();
+                return;
+            }
+            sampleRate = bufferFormat.sampleRate();
+            tracker.configure(sampleRate, kWindowFrames * sampleRate / kSampleRate,
+                              YinPitchTracker::hopForInterval(sampleRate, kHopMs), kMinFrequency, kMaxFrequency);
+        }
+
+        const int count = int(buffer.frameCount());
+        if (bufferFormat.sampleFormat() == QAudioFormat::Int16 && channels == 1) {
+            tracker.process(buffer.constData<qint16>(), count, onEstimate);
+            return;
+        }
+        mono.resize(size_t(count));
+        if (bufferFormat.sampleFormat() == QAudioFormat::Int16) {
+            const qint16* data = buffer.constData<qint16>();
+            for (int i = 0; i < count; ++i) {
+                mono[i] = data[i * channels] * (1.0f / 32768.0f);
+            }
+        } else if (bufferFormat.sampleFormat() == QAudioFormat::Float) {
+            const float* data = buffer.constData<float>();
+            for (int i = 0; i < count; ++i) {
+                mono[i] = data[i * channels];
+            }
+        } else {
+            qWarning() << path << "decodes to an unsupported sample format";
+            failed = true;
+            decoder.stop();
+            loop.quit();
+            return;
+        }
+        tracker.process(mono.data(), count, onEstimate);
+    });
+    QObject::connect(&decoder, &QAudioDecoder::finished, &loop, &QEventLoop::quit);
+    QObject::connect(&decoder, qOverload<QAudioDecoder::Error>(&QAudioDecoder::error), &loop,
+                     [&](QAudioDecoder::Error) {
+                         qWarning() << "Cannot decode" << path << decoder.errorString();
+                         failed = true;
+                         loop.quit();
+                     });
+
+    decoder.start();
+    loop.exec();
+
+    if (failed || frames.empty()) {
+        return false;
+    }
+    return ContourFile::write(ContourFile::pathFor(path), media, sampleRate, tracker.hopFrames(), frames);
+}
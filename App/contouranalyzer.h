@@ -0,0 +1,69 @@
+#ifndef CONTOURANALYZER_H
+#define CONTOURANALYZER_H
+
+#include <QObject>
+#include <QSet>
+#include <QStringList>
+#include <QThreadPool>
+#include <atomic>
+
+// Batch extraction of reference pitch contours for songs without a MIDI
+// melody.
+//
+// Each file is decoded to 16 kHz mono and tracked with YIN at a 10 ms hop
+// on a worker pool, one file per thread, so a library is analysed on every
+// core at once. The result goes to ContourFile::pathFor(file), stamped
+// with the size and modification time of the media, and files whose
+// contour is still current are skipped. Workers run at low priority so
+// the audio threads are not starved.
+//
+// The contour follows the predominant pitch of the whole mix, which is the
+// voice for most karaoke videos with a guide vocal and the lead instrument
+// otherwise.
+class ContourAnalyzer : public QObject {
+    Q_OBJECT
+    Q_PROPERTY(bool running READ isRunning NOTIFY runningChanged)
+    Q_PROPERTY(double progress READ progress NOTIFY progressChanged)
+
+public:
+    static constexpr int kSampleRate = 16000;
+    static constexpr int kWindowFrames = 1024;
+    static constexpr double kHopMs = 10.0;
+
+    explicit ContourAnalyzer(QObject* parent = nullptr);
+    ~ContourAnalyzer();
+
+    bool isRunning() const { return m_queued > 0; }
+
+    // Files finished over files queued since the pool was last idle, in [0, 1]
+    double progress() const;
+
+    // Queue media files for analysis, returns how many needed it
+    Q_INVOKABLE int analyze(const QStringList& paths);
+
+    // Stop the running files at their next decoded buffer and drop the rest
+    Q_INVOKABLE void cancel();
+
+    // Decode and track one file on the calling thread, false on failure or
+    // cancellation
+    bool analyzeFile(const QString& path);
+
+signals:
+    void runningChanged();
+    void progressChanged();
+    void fileAnalyzed(const QString& path, bool ok);
+    void finished(int analyzed, int failed);
+
+private:
+    QThreadPool m_pool;
+    std::atomic<bool> m_cancelled{false};
+    QSet<QString> m_pending;
+    int m_queued = 0;
+    int m_done = 0;
+    int m_analyzed = 0;
+    int m_failed = 0;
+
+    void fileDone(const QString& path, bool ok);
+};
+
+#endif // CONTOURANALYZER_H
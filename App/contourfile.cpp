@@ -0,0 +1,149 @@
+#include "contourfile.h"
+#include <QCryptographicHash>
+#include <QDateTime>
+#include <QDebug>
+#include <QDir>
+#include <QSaveFile>
+#include <QStandardPaths>
+#include <QtEndian>
+#include <cmath>
+#include <cstring>
+
+namespace {
+
+struct ContourHeader {
+    char magic[4];
+    quint16 version;
+    quint16 headerSize;
+    quint32 sampleRate;
+    quint32 hopFrames;
+    quint32 frameCount;
+    quint16 frameStride;
+    quint16 reserved0;
+    qint64 sourceSize;
+    qint64 sourceModifiedMs;
+    char reserved[24];
+};
+static_assert(sizeof(ContourHeader) == ContourFile::kHeaderSize, "contour header must be packed");
+
+// Header fields in host order, or false when the bytes are not a contour.
+// data holds at least the fixed header; fileSize is the size of the whole
+// file, checked against the frames the header describes.
+bool readHeader(const uchar* data, qint64 available, qint64 fileSize, ContourHeader& header) {
+    if (available < qint64(sizeof(ContourHeader))) {
+        return false;
+    }
+    memcpy(&header, data, sizeof(header));
+    if (memcmp(header.magic, "KCTR", 4) != 0) {
+        return false;
+    }
+    header.version = qFromLittleEndian(header.version);
+    header.headerSize = qFromLittleEndian(header.headerSize);
+    header.sampleRate = qFromLittleEndian(header.sampleRate);
+    header.hopFrames = qFromLittleEndian(header.hopFrames);
+    header.frameCount = qFromLittleEndian(header.frameCount);
+    header.frameStride = qFromLittleEndian(header.frameStride);
+    header.sourceSize = qFromLittleEndian(header.sourceSize);
+    header.sourceModifiedMs = qFromLittleEndian(header.sourceModifiedMs);
+    return header.version == ContourFile::kVersion && header.headerSize >= sizeof(ContourHeader) &&
+           header.frameStride >= ContourFile::kFrameStride && header.sampleRate > 0 && header.hopFrames > 0 &&
+           fileSize >= qint64(header.headerSize) + qint64(header.frameCount) * header.frameStride;
+}
+
+} // namespace
+
+ContourFile::~ContourFile() {
+    close();
+}
+
+bool ContourFile::open(const QString& path) {
+    close();
+    m_file.setFileName(path);
+    if (!m_file.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+    const qint64 size = m_file.size();
+    const uchar* data = m_file.map(0, size);
+    ContourHeader header;
+    if (!data || !readHeader(data, size, size, header)) {
+        qWarning() << path << "is not a current contour file";
+        close();
+        return false;
+    }
+    m_frames = data + header.headerSize;
+    m_frameCount = int(header.frameCount);
+    m_stride = header.frameStride;
+    m_hopMs = 1000.0 * header.hopFrames / header.sampleRate;
+    return true;
+}
+
+void ContourFile::close() {
+    // Unmapped by QFile when it closes
+    m_file.close();
+    m_frames = nullptr;
+    m_frameCount = 0;
+}
+
+ContourFile::Frame ContourFile::frame(int index) const {
+    const uchar* data = m_frames + size_t(index) * m_stride;
+    Frame frame;
+    frame.note = qFromLittleEndian<quint16>(data) / 100.0;
+    frame.confidence = data[2] / 255.0;
+    return frame;
+}
+
+QString ContourFile::pathFor(const QString& mediaPath) {
+    const QByteArray key = QFileInfo(mediaPath).absoluteFilePath().toUtf8();
+    const QString name = QString::fromLatin1(QCryptographicHash::hash(key, QCryptographicHash::Sha1).toHex());
+    return QStandardPaths::writableLocation(QStandardPaths::CacheLocation) + "/contours/" + name + ".contour";
+}
+
+bool ContourFile::isCurrent(const QString& path, const QFileInfo& media) {
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+    // Same checks as open(), so a file passes here exactly when it will map
+    const QByteArray bytes = file.read(sizeof(ContourHeader));
+    ContourHeader header;
+    if (!readHeader(reinterpret_cast<const uchar*>(bytes.constData()), bytes.size(), file.size(), header)) {
+        return false;
+    }
+    return header.sourceSize == media.size() &&
+           header.sourceModifiedMs == media.lastModified().toMSecsSinceEpoch();
+}
+
+bool ContourFile::write(const QString& path, const QFileInfo& media, int sampleRate, int hopFrames,
+                        const std::vector<Frame>& frames) {
+    QDir().mkpath(QFileInfo(path).absolutePath());
+    QSaveFile file(path);
+    if (!file.open(QIODevice::WriteOnly)) {
+        qWarning() << "Cannot write" << path << file.errorString();
+        return false;
+    }
+
+    ContourHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, "KCTR", 4);
+    header.version = qToLittleEndian<quint16>(kVersion);
+    header.headerSize = qToLittleEndian<quint16>(kHeaderSize);
+    header.sampleRate = qToLittleEndian<quint32>(quint32(sampleRate));
+    header.hopFrames = qToLittleEndian<quint32>(quint32(hopFrames));
+    header.frameCount = qToLittleEndian<quint32>(quint32(frames.size()));
+    header.frameStride = qToLittleEndian<quint16>(kFrameStride);
+    header.sourceSize = qToLittleEndian<qint64>(media.size());
+    header.sourceModifiedMs = qToLittleEndian<qint64>(media.lastModified().toMSecsSinceEpoch());
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+    QByteArray packed(qsizetype(frames.size()) * kFrameStride, '\0');
+    uchar* out = reinterpret_cast<uchar*>(packed.data());
+    for (const Frame& frame : frames) {
+        const double cents = frame.note > 0.0 ? std::round(frame.note * 100.0) : 0.0;
+        qToLittleEndian<quint16>(quint16(qBound(0.0, cents, 65535.0)), out);
+        out[2] = uchar(std::lround(qBound(0.0, frame.confidence, 1.0) * 255.0));
+        out[3] = 0;
+        out += kFrameStride;
+    }
+    file.write(packed);
+    return file.commit();
+}
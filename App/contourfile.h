@@ -0,0 +1,76 @@
+#ifndef CONTOURFILE_H
+#define CONTOURFILE_H
+
+#include <QFile>
+#include <QFileInfo>
+#include <QString>
+#include <vector>
+
+// Reference pitch contour of a song, as written by ContourAnalyzer.
+//
+// The file is a 64 byte little-endian header followed by fixed-stride
+// frames, one per analysis hop:
+//
+//   offset  size  field
+//        0     4  magic "KCTR"
+//        4     2  version (kVersion)
+//        6     2  header size in bytes
+//        8     4  sample rate of the analysis
+//       12     4  hop in frames at that rate
+//       16     4  frame count
+//       20     2  frame stride in bytes
+//       22     2  reserved
+//       24     8  size of the media file it was made from
+//       32     8  its modification time, ms since the epoch
+//       40    24  reserved, zero
+//
+//   frame: u16 pitch in cents above MIDI note 0 (0 = unvoiced),
+//          u8 confidence * 255, u8 reserved
+//
+// Readers map the file and decode frames in place, so opening a contour
+// costs one mmap however long the song is. The header size and stride
+// let later versions append fields without breaking older readers.
+class ContourFile {
+public:
+    static constexpr quint16 kVersion = 1;
+    static constexpr int kHeaderSize = 64;
+    static constexpr int kFrameStride = 4;
+
+    struct Frame {
+        double note = 0.0;       // fractional MIDI note, 0 when unvoiced
+        double confidence = 0.0; // [0, 1]
+    };
+
+    ContourFile() = default;
+    ContourFile(const ContourFile&) = delete;
+    ContourFile& operator=(const ContourFile&) = delete;
+    ~ContourFile();
+
+    // Map a contour file, false if it is missing, truncated or a different version
+    bool open(const QString& path);
+    void close();
+    bool isOpen() const { return m_frames != nullptr; }
+
+    int frameCount() const { return m_frameCount; }
+    double hopMs() const { return m_hopMs; }
+    Frame frame(int index) const;
+
+    // Where the contour of a media file is cached
+    static QString pathFor(const QString& mediaPath);
+
+    // True when path holds a contour made from the media file as it is now
+    static bool isCurrent(const QString& path, const QFileInfo& media);
+
+    // Write a contour for media atomically (temporary file and rename)
+    static bool write(const QString& path, const QFileInfo& media, int sampleRate, int hopFrames,
+                      const std::vector<Frame>& frames);
+
+private:
+    QFile m_file;
+    const uchar* m_frames = nullptr;
+    int m_frameCount = 0;
+    int m_stride = kFrameStride;
+    double m_hopMs = 10.0;
+};
+
+#endif // CONTOURFILE_H
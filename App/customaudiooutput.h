@@ -1,42 +1,26 @@
 #ifndef CUSTOMAUDIOOUTPUT_H
 #define CUSTOMAUDIOOUTPUT_H
 
-#include <QAudioSink>
-#include <QAudioDevice>
-#include <QIODevice>
+#include <QAudioBufferOutput>
+#include <QAudioBuffer>
 #include <QAudioFormat>
-#include <QBuffer>
-#include <QAudioOutput>
 #include "audiomixer.h"
 
-// Custom QIODevice to intercept audio data
-class AudioInterceptor : public QIODevice
-{
-    Q_OBJECT
-public:
-    AudioInterceptor(AudioMixer* mixer, QObject* parent = nullptr);
-    
-    // Reimplemented methods from QIODevice
-    qint64 readData(char *data, qint64 maxSize) override;
-    qint64 writeData(const char *data, qint64 maxSize) override;
-    
-private:
-    AudioMixer* m_mixer;
-};
-
-// Custom audio output that uses our AudioInterceptor
-class CustomAudioOutput : public QAudioOutput
+// Decoded-audio tap for QMediaPlayer.
+//
+// Set with QMediaPlayer::setAudioBufferOutput instead of a QAudioOutput, so
+// the backing track is not played by the backend but handed to AudioMixer
+// in the mix bus format. Buffers are forwarded by reference on the thread
+// that decoded them and copied once, straight into the media ring.
+class CustomAudioOutput : public QAudioBufferOutput
 {
     Q_OBJECT
 public:
     explicit CustomAudioOutput(AudioMixer* mixer, QObject* parent = nullptr);
     ~CustomAudioOutput();
-    
-    // Get the interceptor, which will be set as the QMediaPlayer's audio device
-    QIODevice* interceptor() const { return m_interceptor; }
-    
+
 private:
-    AudioInterceptor* m_interceptor;
+    AudioMixer* m_mixer;
 };
 
 #endif // CUSTOMAUDIOOUTPUT_H 
@@ -0,0 +1,52 @@
+#include "drifttracker.h"
+#include <algorithm>
+
+namespace {
+
+// Fill smoothing and the wait before the reference is taken
+constexpr double kSmoothingSeconds = 2.0;
+constexpr double kSettleSeconds = 3.0;
+
+// A correction of c ppm moves the fill by c / 1000 ms per second, so with
+// a natural frequency w the loop gains are 1000 w^2 and 2000 w for
+// critical damping
+constexpr double kNaturalFrequency = 0.05;  // rad/s
+constexpr double kIntegralGain = 1000.0 * kNaturalFrequency * kNaturalFrequency;  // ppm per ms second
+constexpr double kProportionalGain = 2000.0 * kNaturalFrequency;                  // ppm per ms
+
+} // namespace
+
+void DriftTracker::reset() {
+    m_averageMs = 0.0;
+    m_referenceMs = 0.0;
+    m_integralPpm = 0.0;
+    m_correctionPpm = 0.0;
+    m_settleSeconds = 0.0;
+    m_primed = false;
+    m_settled = false;
+}
+
+double DriftTracker::update(double fillMs, double elapsedSeconds) {
+    const double dt = std::clamp(elapsedSeconds, 0.0, 1.0);
+    if (!m_primed) {
+        m_averageMs = fillMs;
+        m_primed = true;
+    }
+    m_averageMs += std::min(1.0, dt / kSmoothingSeconds) * (fillMs - m_averageMs);
+
+    if (!m_settled) {
+        m_settleSeconds += dt;
+        if (m_settleSeconds < kSettleSeconds) {
+            return 0.0;
+        }
+        m_referenceMs = m_averageMs;
+        m_settled = true;
+    }
+
+    // Clamping the integral keeps it from winding up past what the
+    // correction can deliver
+    const double errorMs = m_averageMs - m_referenceMs;
+    m_integralPpm = std::clamp(m_integralPpm + kIntegralGain * errorMs * dt, -kMaxPpm, kMaxPpm);
+    m_correctionPpm = std::clamp(m_integralPpm + kProportionalGain * errorMs, -kMaxPpm, kMaxPpm);
+    return m_correctionPpm;
+}
@@ -0,0 +1,49 @@
+#ifndef DRIFTTRACKER_H
+#define DRIFTTRACKER_H
+
+// Clock drift between the producer and the consumer of a buffer, estimated
+// from how the buffer fill moves, and the rate correction that holds the
+// fill where it settled.
+//
+// Capture and playback devices run on their own crystals, typically tens
+// of ppm apart. Left alone the buffer between them grows or drains by that
+// much: 100 ppm is 6 ms a minute. The tracker smooths the fill over a
+// couple of seconds to average out the period sized steps of both sides,
+// takes the first settled value as the reference, and runs a PI loop on
+// the error. The integral converges on the drift itself and is what
+// driftPpm() reports; the proportional part pulls the fill back to the
+// reference. The loop is critically damped with a time constant of about
+// twenty seconds: the period steps beat slowly against each other when the
+// clocks are close, and a faster loop would chase that beat.
+class DriftTracker {
+public:
+    static constexpr double kMaxPpm = 500.0;
+
+    DriftTracker() { reset(); }
+
+    // Forget the reference and the estimate
+    void reset();
+
+    // Fill of the buffer in ms, seconds after the previous update. Returns
+    // by how many ppm the producer should slow down, within kMaxPpm.
+    double update(double fillMs, double elapsedSeconds);
+
+    // Producer clock over consumer clock minus one, in ppm
+    double driftPpm() const { return m_integralPpm; }
+    double correctionPpm() const { return m_correctionPpm; }
+
+    bool isSettled() const { return m_settled; }
+    double referenceMs() const { return m_referenceMs; }
+    double averageFillMs() const { return m_averageMs; }
+
+private:
+    double m_averageMs = 0.0;
+    double m_referenceMs = 0.0;
+    double m_integralPpm = 0.0;
+    double m_correctionPpm = 0.0;
+    double m_settleSeconds = 0.0;
+    bool m_primed = false;
+    bool m_settled = false;
+};
+
+#endif // DRIFTTRACKER_H
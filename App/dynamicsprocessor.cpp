@@ -0,0 +1,139 @@
+#include "dynamicsprocessor.h"
+#include <QtGlobal>
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+constexpr double kMinTimeMs = 0.1;
+constexpr double kMaxTimeMs = 2000.0;
+
+// Below this the detected power counts as silence, about -120 dBFS
+constexpr float kPowerFloor = 1e-12f;
+
+// Gain this close to unity is unity for the purpose of going idle
+constexpr float kUnityTolerance = 1e-4f;
+
+// Per-frame coefficient of a one-pole filter reaching 63% in ms
+float coefficient(double ms, int sampleRate) {
+    return float(std::exp(-1000.0 / (ms * sampleRate)));
+}
+
+} // namespace
+
+DynamicsProcessor::DynamicsProcessor(double detectorMs, double attackMs, double releaseMs,
+                                     bool attackLowersGain, QObject* parent)
+    : AudioProcessor(parent),
+      m_detectorMs(detectorMs),
+      m_attackLowersGain(attackLowersGain),
+      m_attackMs(attackMs),
+      m_releaseMs(releaseMs) {
+}
+
+void DynamicsProcessor::setEnabled(bool enabled) {
+    if (m_enabled.exchange(enabled, std::memory_order_relaxed) != enabled) {
+        emit enabledChanged();
+    }
+}
+
+void DynamicsProcessor::setAttackMs(double ms) {
+    ms = qBound(kMinTimeMs, ms, kMaxTimeMs);
+    if (m_attackMs.exchange(ms, std::memory_order_relaxed) != ms) {
+        emit parametersChanged();
+    }
+}
+
+void DynamicsProcessor::setReleaseMs(double ms) {
+    ms = qBound(kMinTimeMs, ms, kMaxTimeMs);
+    if (m_releaseMs.exchange(ms, std::memory_order_relaxed) != ms) {
+        emit parametersChanged();
+    }
+}
+
+void DynamicsProcessor::prepareBuffers() {
+    m_power.assign(size_t(m_maxFrames), 0.0f);
+    m_gains.assign(size_t(m_maxFrames), 1.0f);
+    m_detectorCoefficient = coefficient(m_detectorMs, m_sampleRate);
+    reset();
+}
+
+void DynamicsProcessor::reset() {
+    m_level = 0.0f;
+    m_gain = 1.0f;
+    m_idle = !isEnabled();
+    m_gainReductionDb.store(0.0f, std::memory_order_relaxed);
+}
+
+void DynamicsProcessor::process(float* data, int frames) {
+    const bool enabled = isEnabled();
+    if (m_idle) {
+        if (!enabled) {
+            return;
+        }
+        m_idle = false;
+    }
+
+    loadParameters();
+    const float attack = coefficient(attackMs(), m_sampleRate);
+    const float release = coefficient(releaseMs(), m_sampleRate);
+    const float lowering = m_attackLowersGain ? attack : release;
+    const float raising = m_attackLowersGain ? release : attack;
+    const int channels = m_channelCount;
+
+    // Channel-averaged power
+    float* power = m_power.data();
+    const float channelScale = 1.0f / channels;
+    for (int frame = 0; frame < frames; ++frame) {
+        float sum = 0.0f;
+        for (int channel = 0; channel < channels; ++channel) {
+            const float x = data[frame * channels + channel];
+            sum += x * x;
+        }
+        power[frame] = sum * channelScale;
+    }
+
+    // Detector and gain smoother; the target changes at control rate
+    float* gains = m_gains.data();
+    const float detector = m_detectorCoefficient;
+    const float fixedDb = enabled ? fixedGainDb() : 0.0f;
+    float level = m_level;
+    float gain = m_gain;
+    float lowest = 1.0f;
+    for (int start = 0; start < frames; start += kControlFrames) {
+        const int end = std::min(frames, start + kControlFrames);
+        for (int frame = start; frame < end; ++frame) {
+            level = power[frame] + detector * (level - power[frame]);
+        }
+
+        float target = 1.0f;
+        if (enabled) {
+            const float levelDb = 10.0f * std::log10(std::max(level, kPowerFloor));
+            const float reductionDb = gainDb(levelDb);
+            lowest = std::min(lowest, std::pow(10.0f, reductionDb / 20.0f));
+            target = std::pow(10.0f, (reductionDb + fixedDb) / 20.0f);
+        }
+
+        for (int frame = start; frame < end; ++frame) {
+            const float c = target < gain ? lowering : raising;
+            gain = target + c * (gain - target);
+            gains[frame] = gain;
+        }
+    }
+    m_level = level;
+    m_gain = gain;
+
+    for (int frame = 0; frame < frames; ++frame) {
+        const float g = gains[frame];
+        for (int channel = 0; channel < channels; ++channel) {
+            data[frame * channels + channel] *= g;
+        }
+    }
+
+    m_gainReductionDb.store(std::max(0.0f, -20.0f * std::log10(lowest)), std::memory_order_relaxed);
+
+    if (!enabled && std::abs(m_gain - 1.0f) < kUnityTolerance) {
+        m_gain = 1.0f;
+        m_level = 0.0f;
+        m_idle = true;
+    }
+}
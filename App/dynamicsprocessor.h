@@ -0,0 +1,86 @@
+#ifndef DYNAMICSPROCESSOR_H
+#define DYNAMICSPROCESSOR_H
+
+#include <atomic>
+#include <vector>
+#include "audioprocessor.h"
+
+// Common part of the gain-riding mic stages (NoiseGate, Compressor).
+//
+// Each block runs in passes: the channel-averaged power of every frame
+// into a scratch buffer, then a one-pole level detector over it, then
+// every kControlFrames frames the subclass's gain computer on the
+// detected level in dB, then a one-pole smoother toward that gain, then
+// the gain applied to every channel. The per-frame passes have no
+// branches (the attack/release choice is a select) and the first and last
+// are plain loops over arrays that vectorise; only the gain computer,
+// with its logs and powers, runs at the lower control rate.
+//
+// Disabling makes the target gain unity; once the smoothed gain gets
+// there the stage idles.
+class DynamicsProcessor : public AudioProcessor {
+    Q_OBJECT
+    Q_PROPERTY(bool enabled READ isEnabled WRITE setEnabled NOTIFY enabledChanged)
+    Q_PROPERTY(double attackMs READ attackMs WRITE setAttackMs NOTIFY parametersChanged)
+    Q_PROPERTY(double releaseMs READ releaseMs WRITE setReleaseMs NOTIFY parametersChanged)
+
+public:
+    static constexpr int kControlFrames = 16;
+
+    bool isEnabled() const { return m_enabled.load(std::memory_order_relaxed); }
+    void setEnabled(bool enabled);
+
+    // How fast the gain acts on a signal that calls for it (attack) and
+    // lets go again (release)
+    double attackMs() const { return m_attackMs.load(std::memory_order_relaxed); }
+    void setAttackMs(double ms);
+    double releaseMs() const { return m_releaseMs.load(std::memory_order_relaxed); }
+    void setReleaseMs(double ms);
+
+    // Largest gain reduction in the latest block, in dB (0 or positive).
+    // Safe from any thread, for meters.
+    Q_INVOKABLE double gainReductionDb() const { return m_gainReductionDb.load(std::memory_order_relaxed); }
+
+    void reset() override;
+
+signals:
+    void enabledChanged();
+    void parametersChanged();
+
+protected:
+    // attackLowersGain: a compressor attacks by reducing the gain, a gate
+    // by opening up
+    DynamicsProcessor(double detectorMs, double attackMs, double releaseMs, bool attackLowersGain,
+                      QObject* parent);
+
+    void prepareBuffers() override;
+    void process(float* data, int frames) override;
+
+    // Audio thread: pick up the subclass parameters once per block
+    virtual void loadParameters() = 0;
+
+    // Gain in dB for a detected level in dBFS, from the loaded parameters
+    virtual float gainDb(float levelDb) const = 0;
+
+    // Gain in dB that is not reduction (makeup), left out of the meter
+    virtual float fixedGainDb() const { return 0.0f; }
+
+private:
+    const double m_detectorMs;
+    const bool m_attackLowersGain;
+
+    std::atomic<bool> m_enabled{true};
+    std::atomic<double> m_attackMs;
+    std::atomic<double> m_releaseMs;
+    std::atomic<float> m_gainReductionDb{0.0f};
+
+    // Audio thread
+    std::vector<float> m_power;
+    std::vector<float> m_gains;
+    float m_detectorCoefficient = 0.0f;
+    float m_level = 0.0f;         // detected power
+    float m_gain = 1.0f;          // smoothed linear gain
+    bool m_idle = false;
+};
+
+#endif // DYNAMICSPROCESSOR_H
@@ -0,0 +1,200 @@
+#include "echodelay.h"
+#include <QtGlobal>
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+constexpr double kSmoothingMs = 30.0;
+constexpr double kCrossfadeMs = 50.0;
+
+// Each repeat loses a little top end
+constexpr double kFeedbackCutoffHz = 5000.0;
+
+constexpr float kSilence = 1e-5f;
+
+struct PresetValues {
+    double delayMs;
+    double syncBeats;
+    double feedback;
+    double mix;
+};
+
+constexpr PresetValues kPresets[] = {
+    {90.0, 0.0, 0.1, 0.3},     // Slapback
+    {500.0, 1.0, 0.35, 0.25},  // Quarter
+    {375.0, 0.75, 0.35, 0.25}, // DottedEighth
+    {250.0, 0.5, 0.3, 0.2},    // Eighth
+};
+
+} // namespace
+
+EchoDelay::EchoDelay(QObject* parent)
+    : AudioProcessor(parent),
+      m_feedback(0.35f, SmoothedParameter::Linear, kSmoothingMs),
+      m_mix(0.25f, SmoothedParameter::Linear, kSmoothingMs),
+      m_input(0.0f, SmoothedParameter::Linear, kSmoothingMs) {
+    registerParameter(&m_feedback);
+    registerParameter(&m_mix);
+    registerParameter(&m_input);
+}
+
+void EchoDelay::setEnabled(bool enabled) {
+    m_input.set(enabled ? 1.0f : 0.0f);
+    if (m_enabled.exchange(enabled, std::memory_order_relaxed) != enabled) {
+        emit enabledChanged();
+    }
+}
+
+void EchoDelay::setPreset(Preset preset) {
+    if (preset != Custom) {
+        const PresetValues& values = kPresets[preset];
+        m_delayMs.store(values.delayMs, std::memory_order_relaxed);
+        m_syncBeats.store(values.syncBeats, std::memory_order_relaxed);
+        m_feedback.set(float(values.feedback));
+        m_mix.set(float(values.mix));
+        emit parametersChanged();
+    }
+    if (m_preset.exchange(preset, std::memory_order_relaxed) != preset) {
+        emit presetChanged();
+    }
+}
+
+void EchoDelay::setCustom() {
+    if (m_preset.exchange(Custom, std::memory_order_relaxed) != Custom) {
+        emit presetChanged();
+    }
+    emit parametersChanged();
+}
+
+void EchoDelay::setDelayMs(double ms) {
+    ms = qBound(kMinDelayMs, ms, kMaxDelayMs);
+    if (m_delayMs.exchange(ms, std::memory_order_relaxed) != ms) {
+        setCustom();
+    }
+}
+
+void EchoDelay::setSyncBeats(double beats) {
+    beats = qMax(0.0, beats);
+    if (m_syncBeats.exchange(beats, std::memory_order_relaxed) != beats) {
+        setCustom();
+    }
+}
+
+void EchoDelay::setTempoBpm(double bpm) {
+    bpm = qBound(30.0, bpm, 300.0);
+    if (m_tempoBpm.exchange(bpm, std::memory_order_relaxed) != bpm) {
+        emit tempoBpmChanged();
+    }
+}
+
+void EchoDelay::setFeedback(double feedback) {
+    feedback = qBound(0.0, feedback, kMaxFeedback);
+    if (m_feedback.set(float(feedback))) {
+        setCustom();
+    }
+}
+
+void EchoDelay::setMix(double mix) {
+    mix = qBound(0.0, mix, 1.0);
+    if (m_mix.set(float(mix))) {
+        setCustom();
+    }
+}
+
+double EchoDelay::effectiveDelayMs() const {
+    const double beats = syncBeats();
+    const double ms = beats > 0.0 ? beats * 60000.0 / tempoBpm() : delayMs();
+    return qBound(kMinDelayMs, ms, kMaxDelayMs);
+}
+
+int EchoDelay::targetDelayFrames() const {
+    return qBound(1, int(std::lround(effectiveDelayMs() * m_sampleRate / 1000.0)), m_lineMask);
+}
+
+void EchoDelay::prepareBuffers() {
+    const int longest = int(std::ceil(kMaxDelayMs * m_sampleRate / 1000.0)) + 1;
+    int frames = 1;
+    while (frames < longest) {
+        frames <<= 1;
+    }
+    m_line.assign(size_t(frames), 0.0f);
+    m_lineMask = frames - 1;
+    m_lowpassCoefficient = float(1.0 - std::exp(-2.0 * M_PI * kFeedbackCutoffHz / m_sampleRate));
+    m_fadeStep = float(1000.0 / (kCrossfadeMs * m_sampleRate));
+    reset();
+}
+
+void EchoDelay::reset() {
+    std::fill(m_line.begin(), m_line.end(), 0.0f);
+    m_write = 0;
+    m_tapDelay = m_nextDelay = targetDelayFrames();
+    m_fading = false;
+    m_lowpass = 0.0f;
+    m_feedback.snap();
+    m_mix.snap();
+    m_input.snap();
+    m_quietFrames = 0;
+    m_idle = !isEnabled();
+}
+
+void EchoDelay::process(float* data, int frames) {
+    const bool enabled = isEnabled();
+    if (m_idle) {
+        if (!enabled) {
+            return;
+        }
+        m_idle = false;
+    }
+
+    // One crossfade at a time; a change during a fade is picked up after it
+    const int target = targetDelayFrames();
+    if (!m_fading && target != m_tapDelay) {
+        m_nextDelay = target;
+        m_fadeGain = 0.0f;
+        m_fading = true;
+    }
+
+    m_input.update();
+    m_mix.update();
+    m_feedback.update();
+
+    const int channels = m_channelCount;
+    const float inputScale = 1.0f / channels;
+    for (int frame = 0; frame < frames; ++frame) {
+        float* out = data + frame * channels;
+        float dry = 0.0f;
+        for (int channel = 0; channel < channels; ++channel) {
+            dry += out[channel];
+        }
+        const float input = m_input.next();
+        const float wet = m_mix.next();
+        const float feedbackGain = m_feedback.next();
+
+        float echo = m_line[(m_write - m_tapDelay) & m_lineMask];
+        if (m_fading) {
+            const float next = m_line[(m_write - m_nextDelay) & m_lineMask];
+            echo += m_fadeGain * (next - echo);
+            m_fadeGain += m_fadeStep;
+            if (m_fadeGain >= 1.0f) {
+                m_tapDelay = m_nextDelay;
+                m_fading = false;
+            }
+        }
+
+        m_lowpass += m_lowpassCoefficient * (echo - m_lowpass);
+        const float written = dry * inputScale * input + feedbackGain * m_lowpass;
+        m_line[m_write & m_lineMask] = written;
+        m_write = (m_write + 1) & m_lineMask;
+        m_quietFrames = std::abs(written) > kSilence ? 0 : m_quietFrames + 1;
+
+        for (int channel = 0; channel < channels; ++channel) {
+            out[channel] += wet * echo;
+        }
+    }
+
+    // Idle once nothing audible is left anywhere in the line
+    if (!enabled && m_input.current() < kSilence && m_quietFrames > std::max(m_tapDelay, m_nextDelay)) {
+        m_idle = true;
+    }
+}
@@ -0,0 +1,110 @@
+#ifndef ECHODELAY_H
+#define ECHODELAY_H
+
+#include <atomic>
+#include <vector>
+#include "audioprocessor.h"
+#include "smoothedparameter.h"
+
+// Feedback echo for the voice, free running or locked to the song tempo.
+//
+// The delay is either delayMs or syncBeats beats at tempoBpm. Repeats are
+// fed back through a gentle low-pass, so each one is a little darker than
+// the last, like a tape echo. A new delay time crossfades from the old
+// tap to the new one instead of sliding, so tempo changes neither click
+// nor bend the pitch of the repeats. Disabling stops feeding the line and
+// lets the repeats die away.
+class EchoDelay : public AudioProcessor {
+    Q_OBJECT
+    Q_PROPERTY(bool enabled READ isEnabled WRITE setEnabled NOTIFY enabledChanged)
+    Q_PROPERTY(Preset preset READ preset WRITE setPreset NOTIFY presetChanged)
+    Q_PROPERTY(double delayMs READ delayMs WRITE setDelayMs NOTIFY parametersChanged)
+    Q_PROPERTY(double syncBeats READ syncBeats WRITE setSyncBeats NOTIFY parametersChanged)
+    Q_PROPERTY(double tempoBpm READ tempoBpm WRITE setTempoBpm NOTIFY tempoBpmChanged)
+    Q_PROPERTY(double feedback READ feedback WRITE setFeedback NOTIFY parametersChanged)
+    Q_PROPERTY(double mix READ mix WRITE setMix NOTIFY parametersChanged)
+
+public:
+    enum Preset { Slapback, Quarter, DottedEighth, Eighth, Custom };
+    Q_ENUM(Preset)
+
+    static constexpr double kMinDelayMs = 20.0;
+    static constexpr double kMaxDelayMs = 2000.0;
+    static constexpr double kMaxFeedback = 0.9;
+    static constexpr double kDefaultTempoBpm = 120.0;
+
+    explicit EchoDelay(QObject* parent = nullptr);
+
+    bool isEnabled() const { return m_enabled.load(std::memory_order_relaxed); }
+    void setEnabled(bool enabled);
+
+    // Applies the preset's parameters; changing one afterwards makes it
+    // Custom. The tempo is not part of a preset.
+    Preset preset() const { return Preset(m_preset.load(std::memory_order_relaxed)); }
+    void setPreset(Preset preset);
+
+    // Free running delay, used while syncBeats is 0
+    double delayMs() const { return m_delayMs.load(std::memory_order_relaxed); }
+    void setDelayMs(double ms);
+
+    // Delay in beats of tempoBpm (1 = quarter note), 0 for free running
+    double syncBeats() const { return m_syncBeats.load(std::memory_order_relaxed); }
+    void setSyncBeats(double beats);
+
+    // Tempo the beats are counted in, the song's when it is known
+    double tempoBpm() const { return m_tempoBpm.load(std::memory_order_relaxed); }
+    void setTempoBpm(double bpm);
+
+    // Delay in effect, after tempo sync and limits
+    Q_INVOKABLE double effectiveDelayMs() const;
+
+    double feedback() const { return m_feedback.target(); }
+    void setFeedback(double feedback);
+
+    // Echo level added to the dry voice, 0 to 1
+    double mix() const { return m_mix.target(); }
+    void setMix(double mix);
+
+    void reset() override;
+
+signals:
+    void enabledChanged();
+    void presetChanged();
+    void parametersChanged();
+    void tempoBpmChanged();
+
+protected:
+    void prepareBuffers() override;
+    void process(float* data, int frames) override;
+
+private:
+    std::atomic<bool> m_enabled{false};
+    std::atomic<int> m_preset{DottedEighth};
+    std::atomic<double> m_delayMs{375.0};
+    std::atomic<double> m_syncBeats{0.75};
+    std::atomic<double> m_tempoBpm{kDefaultTempoBpm};
+    SmoothedParameter m_feedback;
+    SmoothedParameter m_mix;
+    SmoothedParameter m_input;   // 1 while enabled, fades the feed to the line
+
+    // Mono line, power-of-two frames
+    std::vector<float> m_line;
+    int m_lineMask = 0;
+    int m_write = 0;
+
+    // Audio thread
+    int m_tapDelay = 0;
+    int m_nextDelay = 0;
+    float m_fadeGain = 0.0f;
+    float m_fadeStep = 0.0f;
+    bool m_fading = false;
+    float m_lowpass = 0.0f;
+    float m_lowpassCoefficient = 1.0f;
+    int m_quietFrames = 0;   // since the last audible write to the line
+    bool m_idle = true;
+
+    void setCustom();
+    int targetDelayFrames() const;
+};
+
+#endif // ECHODELAY_H
@@ -0,0 +1,288 @@
+#include "fdnreverb.h"
+#include <QtGlobal>
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+// Line lengths at size 1, in ms; no two share a common period
+constexpr float kLineMs[FdnReverb::kLines] = {29.7f, 37.1f, 41.1f, 43.7f, 53.9f, 59.3f, 67.1f, 73.3f};
+
+// Input is injected with alternating signs, the wet output taken with a
+// different pattern, so the two never line up with one Hadamard row
+constexpr float kInputSign[FdnReverb::kLines] = {1, -1, 1, -1, 1, -1, 1, -1};
+constexpr float kOutputSign[FdnReverb::kLines] = {1, 1, -1, -1, 1, 1, -1, -1};
+
+// Levels, decay and damping glide over about this long
+constexpr double kSmoothingMs = 30.0;
+
+// Moving a tap bends the pitch of what it reads, so line lengths move by
+// at most this many frames per frame: a quarter tone
+constexpr float kMaxLengthGlide = 0.03f;
+
+// Below this the tail is inaudible and a disabled stage goes idle
+constexpr float kSilence = 1e-5f;
+
+// The damping low-pass runs from 16 kHz (bright) down to 2 kHz (dark)
+constexpr double kBrightHz = 16000.0;
+constexpr double kDarkHz = 2000.0;
+
+struct PresetValues {
+    double decaySeconds;
+    double damping;
+    double preDelayMs;
+    double size;
+    double mix;
+};
+
+constexpr PresetValues kPresets[] = {
+    {0.8, 0.5, 5.0, 0.6, 0.2},     // Room
+    {2.2, 0.35, 20.0, 1.0, 0.25},  // Hall
+    {1.6, 0.1, 0.0, 0.75, 0.25},   // Plate
+    {4.5, 0.5, 35.0, 1.5, 0.3},    // Cathedral
+};
+
+const float kHadamardScale = float(1.0 / std::sqrt(double(FdnReverb::kLines)));
+
+// In-place fast Walsh-Hadamard transform, orthonormal
+inline void hadamard(float* v) {
+    for (int span = 1; span < FdnReverb::kLines; span *= 2) {
+        for (int i = 0; i < FdnReverb::kLines; i += 2 * span) {
+            for (int j = i; j < i + span; ++j) {
+                const float a = v[j];
+                const float b = v[j + span];
+                v[j] = a + b;
+                v[j + span] = a - b;
+            }
+        }
+    }
+    for (int line = 0; line < FdnReverb::kLines; ++line) {
+        v[line] *= kHadamardScale;
+    }
+}
+
+} // namespace
+
+FdnReverb::FdnReverb(QObject* parent)
+    : AudioProcessor(parent),
+      m_decay(2.2f, SmoothedParameter::Linear, kSmoothingMs),
+      m_damping(0.35f, SmoothedParameter::Linear, kSmoothingMs),
+      m_wet(0.25f, SmoothedParameter::Linear, kSmoothingMs),
+      m_input(0.0f, SmoothedParameter::Linear, kSmoothingMs) {
+    registerParameter(&m_decay);
+    registerParameter(&m_damping);
+    registerParameter(&m_wet);
+    registerParameter(&m_input);
+}
+
+void FdnReverb::setEnabled(bool enabled) {
+    m_input.set(enabled ? 1.0f : 0.0f);
+    if (m_enabled.exchange(enabled, std::memory_order_relaxed) != enabled) {
+        emit enabledChanged();
+    }
+}
+
+void FdnReverb::setPreset(Preset preset) {
+    if (preset != Custom) {
+        const PresetValues& values = kPresets[preset];
+        m_decay.set(float(values.decaySeconds));
+        m_damping.set(float(values.damping));
+        m_preDelayMs.store(values.preDelayMs, std::memory_order_relaxed);
+        m_size.store(values.size, std::memory_order_relaxed);
+        m_wet.set(float(values.mix));
+        emit parametersChanged();
+    }
+    if (m_preset.exchange(preset, std::memory_order_relaxed) != preset) {
+        emit presetChanged();
+    }
+}
+
+void FdnReverb::setCustom() {
+    if (m_preset.exchange(Custom, std::memory_order_relaxed) != Custom) {
+        emit presetChanged();
+    }
+    emit parametersChanged();
+}
+
+void FdnReverb::setDecaySeconds(double seconds) {
+    seconds = qBound(kMinDecaySeconds, seconds, kMaxDecaySeconds);
+    if (m_decay.set(float(seconds))) {
+        setCustom();
+    }
+}
+
+void FdnReverb::setDamping(double damping) {
+    damping = qBound(0.0, damping, 1.0);
+    if (m_damping.set(float(damping))) {
+        setCustom();
+    }
+}
+
+void FdnReverb::setPreDelayMs(double ms) {
+    ms = qBound(0.0, ms, kMaxPreDelayMs);
+    if (m_preDelayMs.exchange(ms, std::memory_order_relaxed) != ms) {
+        setCustom();
+    }
+}
+
+void FdnReverb::setSize(double size) {
+    size = qBound(kMinSize, size, kMaxSize);
+    if (m_size.exchange(size, std::memory_order_relaxed) != size) {
+        setCustom();
+    }
+}
+
+void FdnReverb::setMix(double mix) {
+    mix = qBound(0.0, mix, 1.0);
+    if (m_wet.set(float(mix))) {
+        setCustom();
+    }
+}
+
+void FdnReverb::prepareBuffers() {
+    // Longest line at the largest size, plus the interpolation neighbour
+    const int longest = int(std::ceil(kLineMs[kLines - 1] * kMaxSize * m_sampleRate / 1000.0)) + 2;
+    int frames = 1;
+    while (frames < longest) {
+        frames <<= 1;
+    }
+    m_lines.assign(size_t(frames) * kLines, 0.0f);
+    m_lineMask = frames - 1;
+
+    const int preDelayLongest = int(std::ceil(kMaxPreDelayMs * m_sampleRate / 1000.0)) + 2;
+    int preDelayFrames = 1;
+    while (preDelayFrames < preDelayLongest) {
+        preDelayFrames <<= 1;
+    }
+    m_preDelay.assign(size_t(preDelayFrames), 0.0f);
+    m_preDelayMask = preDelayFrames - 1;
+    reset();
+}
+
+void FdnReverb::reset() {
+    std::fill(m_lines.begin(), m_lines.end(), 0.0f);
+    std::fill(m_preDelay.begin(), m_preDelay.end(), 0.0f);
+    m_write = 0;
+
+    // Start at the targets instead of gliding from zero
+    const double size = this->size();
+    for (int line = 0; line < kLines; ++line) {
+        m_length[line] = float(kLineMs[line] * size * m_sampleRate / 1000.0);
+        m_lowpass[line] = 0.0f;
+    }
+    m_preDelayFrames = preDelayMs() * m_sampleRate / 1000.0;
+    m_decay.snap();
+    m_damping.snap();
+    m_wet.snap();
+    m_input.snap();
+    m_idle = !isEnabled();
+    updateParameters(0);
+}
+
+// frames == 0 (from reset()) designs for the current values
+void FdnReverb::updateParameters(int frames) {
+    // Lengths move sample by sample in process(), these are the slopes
+    const float maxMove = kMaxLengthGlide * frames;
+    const double size = this->size();
+    for (int line = 0; line < kLines; ++line) {
+        const float target = float(kLineMs[line] * size * m_sampleRate / 1000.0);
+        m_lengthStep[line] = frames > 0 ? std::clamp(target - m_length[line], -maxMove, maxMove) / frames : 0.0f;
+    }
+    const double preDelayTarget = preDelayMs() * m_sampleRate / 1000.0;
+    m_preDelayStep = frames > 0 ? std::clamp(preDelayTarget - m_preDelayFrames, -double(maxMove), double(maxMove)) / frames
+                                : 0.0;
+
+    // A line of length d loses 60 dB over the decay time. Gains ramp to
+    // the value for the length and decay at the end of the block.
+    const double perFrame = -3.0 / (m_decay.advance(frames) * m_sampleRate);
+    for (int line = 0; line < kLines; ++line) {
+        const float target = float(std::pow(10.0, perFrame * (m_length[line] + m_lengthStep[line] * frames)));
+        if (frames > 0) {
+            m_gainStep[line] = (target - m_gain[line]) / frames;
+        } else {
+            m_gain[line] = target;
+            m_gainStep[line] = 0.0f;
+        }
+    }
+
+    const double cutoff = kBrightHz * std::pow(kDarkHz / kBrightHz, double(m_damping.advance(frames)));
+    m_dampCoefficient = float(1.0 - std::exp(-2.0 * M_PI * std::min(cutoff, 0.45 * m_sampleRate) / m_sampleRate));
+}
+
+void FdnReverb::process(float* data, int frames) {
+    const bool enabled = isEnabled();
+    if (m_idle) {
+        if (!enabled) {
+            return;
+        }
+        m_idle = false;
+    }
+
+    updateParameters(frames);
+    m_input.update();
+    m_wet.update();
+
+    const int channels = m_channelCount;
+    const float inputScale = kHadamardScale / channels;
+    const float damp = m_dampCoefficient;
+    float peak = 0.0f;
+
+    for (int frame = 0; frame < frames; ++frame) {
+        float* out = data + frame * channels;
+        float dry = 0.0f;
+        for (int channel = 0; channel < channels; ++channel) {
+            dry += out[channel];
+        }
+        const float input = m_input.next();
+        const float wet = m_wet.next();
+
+        m_preDelay[m_write & m_preDelayMask] = dry * input * inputScale;
+        m_preDelayFrames += m_preDelayStep;
+        const double preDelayPosition = double(m_write) - m_preDelayFrames;
+        const double preDelayBase = std::floor(preDelayPosition);
+        const int preDelayIndex = int(preDelayBase);
+        const float preDelayFraction = float(preDelayPosition - preDelayBase);
+        const float a = m_preDelay[preDelayIndex & m_preDelayMask];
+        const float b = m_preDelay[(preDelayIndex + 1) & m_preDelayMask];
+        const float injected = a + preDelayFraction * (b - a);
+
+        alignas(32) float v[kLines];
+        for (int line = 0; line < kLines; ++line) {
+            m_length[line] += m_lengthStep[line];
+            m_gain[line] += m_gainStep[line];
+        }
+        for (int line = 0; line < kLines; ++line) {
+            const float position = float(m_write) - m_length[line];
+            const float base = std::floor(position);
+            const int index = int(base);
+            const float fraction = position - base;
+            const float x0 = m_lines[size_t(index & m_lineMask) * kLines + line];
+            const float x1 = m_lines[size_t((index + 1) & m_lineMask) * kLines + line];
+            v[line] = x0 + fraction * (x1 - x0);
+        }
+
+        float wetSample = 0.0f;
+        for (int line = 0; line < kLines; ++line) {
+            m_lowpass[line] += damp * (v[line] - m_lowpass[line]);
+            v[line] = m_lowpass[line] * m_gain[line];
+            wetSample += kOutputSign[line] * v[line];
+        }
+        wetSample *= kHadamardScale;
+
+        hadamard(v);
+        float* written = m_lines.data() + size_t(m_write & m_lineMask) * kLines;
+        for (int line = 0; line < kLines; ++line) {
+            written[line] = v[line] + kInputSign[line] * injected;
+        }
+
+        for (int channel = 0; channel < channels; ++channel) {
+            out[channel] += wet * wetSample;
+        }
+        peak = std::max(peak, std::abs(wetSample));
+        m_write = (m_write + 1) & std::max(m_lineMask, m_preDelayMask);
+    }
+
+    if (!enabled && m_input.current() < kSilence && peak < kSilence) {
+        m_idle = true;
+    }
+}
@@ -0,0 +1,398 @@
+#include "feedbacksuppressor.h"
+#include <QVariantMap>
+#include <QtGlobal>
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+// 2048 points at 44.1/48 kHz: bins of about 23 Hz, hops of about 11 ms
+constexpr double kAnalysisMs = 40.0;
+constexpr int kOverlap = 4;
+
+constexpr double kLowestHz = 100.0;
+constexpr double kHighestHz = 12000.0;
+
+// A howl candidate is at least this loud, this far above the mean bin
+// level, and this far above the bins three either side (a windowed sine
+// is down by more than 30 dB there; voice and noise are broader)
+constexpr float kMinLevelDb = -50.0f;
+constexpr float kPeakToMeanDb = 15.0f;
+constexpr float kNarrowDb = 20.0f;
+constexpr int kNarrowSpan = 3;
+
+// A peak with a neighbour of its harmonic series within this many dB is
+// taken for a sung or played note
+constexpr float kHarmonicDb = 20.0f;
+
+// Howl frequency is fixed by the room, a held note still wanders: a track
+// spreading over more than this many bins is not a howl
+constexpr float kMaxDriftBins = 0.25f;
+
+// A howl does not fade by itself; one losing more than this is released
+constexpr float kMaxDecayDb = 3.0f;
+
+// Notches: about a twentieth of an octave wide, merged with an existing
+// notch within a quarter tone, which then deepens by kDeepenDb
+constexpr double kNotchQ = 30.0;
+constexpr double kMergeCents = 50.0;
+constexpr float kDeepenDb = 6.0f;
+
+// Depth moves at kRampDbPerSecond toward its target, so a new notch is
+// in within about 30 ms; the target itself releases much more slowly
+constexpr float kRampDbPerSecond = 400.0f;
+constexpr float kReleaseDbPerSecond = 1.0f;
+
+inline float toDb(float power) {
+    return 10.0f * std::log10(power + 1e-20f);
+}
+
+} // namespace
+
+FeedbackSuppressor::FeedbackSuppressor(QObject* parent) : AudioProcessor(parent) {
+}
+
+void FeedbackSuppressor::setEnabled(bool enabled) {
+    if (m_enabled.exchange(enabled, std::memory_order_relaxed) != enabled) {
+        emit enabledChanged();
+    }
+}
+
+int FeedbackSuppressor::activeNotchCount() const {
+    int count = 0;
+    for (const std::atomic<float>& depth : m_publishedDepth) {
+        if (depth.load(std::memory_order_relaxed) < 0.0f) {
+            ++count;
+        }
+    }
+    return count;
+}
+
+QVariantList FeedbackSuppressor::notches() const {
+    std::vector<std::pair<float, float>> active;
+    for (int i = 0; i < kMaxNotches; ++i) {
+        const float depth = m_publishedDepth[i].load(std::memory_order_relaxed);
+        if (depth < 0.0f) {
+            active.emplace_back(m_publishedFrequency[i].load(std::memory_order_relaxed), depth);
+        }
+    }
+    std::sort(active.begin(), active.end());
+
+    QVariantList list;
+    for (const auto& [frequency, depth] : active) {
+        QVariantMap notch;
+        notch.insert("frequency", double(frequency));
+        notch.insert("depthDb", double(depth));
+        list.append(notch);
+    }
+    return list;
+}
+
+void FeedbackSuppressor::clearNotches() {
+    m_clearRequested.store(true, std::memory_order_relaxed);
+}
+
+void FeedbackSuppressor::prepareBuffers() {
+    m_fftSize = RealFft::nextPowerOfTwo(int(kAnalysisMs * m_sampleRate / 1000.0));
+    m_hop = m_fftSize / kOverlap;
+    m_fft.setSize(m_fftSize);
+
+    const int bins = m_fftSize / 2 + 1;
+    const double binHz = double(m_sampleRate) / m_fftSize;
+    m_lowBin = qMax(kNarrowSpan, int(std::ceil(kLowestHz / binHz)));
+    m_highBin = qMin(bins - 1 - kNarrowSpan, int(std::floor(qMin(kHighestHz, 0.45 * m_sampleRate) / binHz)));
+    m_persistFrames = int(std::ceil(kPersistMs * m_sampleRate / 1000.0));
+
+    // Hann window sums to N/2, so a sine of amplitude A peaks at A N/4
+    m_levelOffsetDb = float(20.0 * std::log10(4.0 / m_fftSize));
+
+    m_window.resize(size_t(m_fftSize));
+    for (int i = 0; i < m_fftSize; ++i) {
+        m_window[i] = float(0.5 - 0.5 * std::cos(2.0 * M_PI * i / m_fftSize));
+    }
+    m_history.assign(size_t(m_fftSize), 0.0f);
+    m_frame.assign(size_t(m_fftSize), 0.0f);
+    m_spectrum.assign(size_t(m_fftSize) + 2, 0.0f);
+    m_levelDb.assign(size_t(bins), 0.0f);
+    reset();
+}
+
+void FeedbackSuppressor::reset() {
+    std::fill(m_history.begin(), m_history.end(), 0.0f);
+    m_write = 0;
+    m_sinceHop = 0;
+    m_trackCount = 0;
+    for (Notch& notch : m_notches) {
+        notch = Notch();
+    }
+    m_idle = !isEnabled();
+    publish();
+}
+
+void FeedbackSuppressor::designNotch(Notch& notch) const {
+    // RBJ peaking filter with negative gain
+    const double w0 = 2.0 * M_PI * notch.frequency / m_sampleRate;
+    const double a = std::pow(10.0, notch.depthDb / 40.0);
+    const double alpha = std::sin(w0) / (2.0 * kNotchQ);
+    const double cosine = std::cos(w0);
+    const double a0 = 1.0 + alpha / a;
+    notch.b0 = float((1.0 + alpha * a) / a0);
+    notch.b1 = float(-2.0 * cosine / a0);
+    notch.b2 = float((1.0 - alpha * a) / a0);
+    notch.a1 = notch.b1;
+    notch.a2 = float((1.0 - alpha / a) / a0);
+    notch.appliedDb = notch.depthDb;
+}
+
+void FeedbackSuppressor::deploy(float frequency) {
+    m_detections.fetch_add(1, std::memory_order_relaxed);
+    const int holdFrames = int(kHoldSeconds * m_sampleRate);
+
+    for (Notch& notch : m_notches) {
+        if (notch.active && std::abs(1200.0 * std::log2(frequency / notch.frequency)) < kMergeCents) {
+            notch.targetDb = std::max(float(kMaxDepthDb), std::min(notch.targetDb, notch.depthDb) - kDeepenDb);
+            notch.holdFrames = holdFrames;
+            return;
+        }
+    }
+
+    // A free slot, else the shallowest notch, which is the least audible
+    // one to restart
+    Notch* slot = &m_notches[0];
+    for (Notch& notch : m_notches) {
+        if (!notch.active) {
+            slot = &notch;
+            break;
+        }
+        if (notch.depthDb > slot->depthDb) {
+            slot = &notch;
+        }
+    }
+    *slot = Notch();
+    slot->active = true;
+    slot->frequency = frequency;
+    slot->targetDb = float(kInitialDepthDb);
+    slot->holdFrames = holdFrames;
+    designNotch(*slot);
+}
+
+bool FeedbackSuppressor::isHowl(int bin, float meanDb) const {
+    const float level = m_levelDb[bin];
+    if (level < kMinLevelDb || level - meanDb < kPeakToMeanDb) {
+        return false;
+    }
+    if (level - m_levelDb[bin - kNarrowSpan] < kNarrowDb || level - m_levelDb[bin + kNarrowSpan] < kNarrowDb) {
+        return false;
+    }
+
+    // Where the neighbours would be if this were harmonic 1 to 4 of a note
+    static constexpr float kRatios[] = {0.5f, 2.0f / 3.0f, 0.75f, 4.0f / 3.0f, 1.5f, 2.0f};
+    const int bins = int(m_levelDb.size());
+    for (float ratio : kRatios) {
+        const int centre = int(std::lround(bin * ratio));
+        for (int other = centre - 1; other <= centre + 1; ++other) {
+            if (other > 0 && other < bins && m_levelDb[other] > level - kHarmonicDb) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+void FeedbackSuppressor::analyze(int elapsed) {
+    const int mask = m_fftSize - 1;
+    for (int i = 0; i < m_fftSize; ++i) {
+        m_frame[i] = m_history[(m_write + i) & mask] * m_window[i];
+    }
+    m_fft.forward(m_frame.data(), m_spectrum.data());
+
+    double meanPower = 0.0;
+    for (int bin = m_lowBin - kNarrowSpan; bin <= m_highBin + kNarrowSpan; ++bin) {
+        const float re = m_spectrum[2 * bin];
+        const float im = m_spectrum[2 * bin + 1];
+        const float power = re * re + im * im;
+        m_levelDb[bin] = toDb(power) + m_levelOffsetDb;
+        if (bin >= m_lowBin && bin <= m_highBin) {
+            meanPower += power;
+        }
+    }
+    const float meanDb = toDb(float(meanPower / (m_highBin - m_lowBin + 1))) + m_levelOffsetDb;
+
+    // The harmonic check also looks at half and twice the frequency
+    const int bins = int(m_levelDb.size());
+    for (int bin = 1; bin < m_lowBin - kNarrowSpan; ++bin) {
+        m_levelDb[bin] = toDb(m_spectrum[2 * bin] * m_spectrum[2 * bin] + m_spectrum[2 * bin + 1] * m_spectrum[2 * bin + 1]) + m_levelOffsetDb;
+    }
+    for (int bin = m_highBin + kNarrowSpan + 1; bin < bins; ++bin) {
+        m_levelDb[bin] = toDb(m_spectrum[2 * bin] * m_spectrum[2 * bin] + m_spectrum[2 * bin + 1] * m_spectrum[2 * bin + 1]) + m_levelOffsetDb;
+    }
+
+    std::array<bool, kMaxTracks> seen{};
+    for (int bin = m_lowBin; bin <= m_highBin; ++bin) {
+        const float level = m_levelDb[bin];
+        if (level <= m_levelDb[bin - 1] || level < m_levelDb[bin + 1] || !isHowl(bin, meanDb)) {
+            continue;
+        }
+
+        // Parabolic interpolation of the peak in dB
+        const float left = m_levelDb[bin - 1];
+        const float right = m_levelDb[bin + 1];
+        const float curvature = left - 2.0f * level + right;
+        const float peak = bin + (curvature < 0.0f ? 0.5f * (left - right) / curvature : 0.0f);
+
+        int match = -1;
+        for (int i = 0; i < m_trackCount; ++i) {
+            if (std::abs(m_tracks[i].bin - peak) <= 1.0f) {
+                match = i;
+                break;
+            }
+        }
+        if (match < 0) {
+            if (m_trackCount == kMaxTracks) {
+                continue;
+            }
+            match = m_trackCount++;
+            Track& track = m_tracks[match];
+            track.minBin = track.maxBin = peak;
+            track.frames = 0;
+            track.firstDb = level;
+        }
+
+        Track& track = m_tracks[match];
+        track.bin = peak;
+        track.minBin = std::min(track.minBin, peak);
+        track.maxBin = std::max(track.maxBin, peak);
+        track.lastDb = level;
+        track.misses = 0;
+        seen[match] = true;
+    }
+
+    // Age the tracks; promote the ones that held long enough
+    for (int i = 0; i < m_trackCount;) {
+        Track& track = m_tracks[i];
+        if (!seen[i] && ++track.misses > 1) {
+            track = m_tracks[--m_trackCount];
+            seen[i] = seen[m_trackCount];
+            continue;
+        }
+        track.frames += elapsed;
+        if (track.frames >= m_persistFrames) {
+            if (track.maxBin - track.minBin <= kMaxDriftBins && track.lastDb >= track.firstDb - kMaxDecayDb) {
+                deploy(float(track.bin * m_sampleRate / m_fftSize));
+            }
+            // Start over, so a howl that survives its notch deepens it
+            // after another persistence period
+            track.frames = 0;
+            track.minBin = track.maxBin = track.bin;
+            track.firstDb = track.lastDb;
+        }
+        ++i;
+    }
+}
+
+void FeedbackSuppressor::updateNotches(int frames, bool enabled) {
+    const bool releaseAll = !enabled || m_clearRequested.exchange(false, std::memory_order_relaxed);
+    const float rampDb = kRampDbPerSecond * frames / m_sampleRate;
+    const float releaseDb = kReleaseDbPerSecond * frames / m_sampleRate;
+
+    for (Notch& notch : m_notches) {
+        if (!notch.active) {
+            continue;
+        }
+        if (releaseAll) {
+            notch.targetDb = 0.0f;
+            notch.holdFrames = 0;
+        } else if (notch.holdFrames > 0) {
+            notch.holdFrames -= frames;
+        } else {
+            notch.targetDb = std::min(0.0f, notch.targetDb + releaseDb);
+        }
+
+        if (notch.depthDb < notch.targetDb) {
+            notch.depthDb = std::min(notch.targetDb, notch.depthDb + rampDb);
+        } else {
+            notch.depthDb = std::max(notch.targetDb, notch.depthDb - rampDb);
+        }
+
+        if (notch.targetDb >= 0.0f && notch.depthDb >= 0.0f) {
+            notch = Notch();
+        } else if (notch.depthDb != notch.appliedDb) {
+            designNotch(notch);
+        }
+    }
+}
+
+void FeedbackSuppressor::publish() {
+    for (int i = 0; i < kMaxNotches; ++i) {
+        const Notch& notch = m_notches[i];
+        m_publishedFrequency[i].store(notch.frequency, std::memory_order_relaxed);
+        m_publishedDepth[i].store(notch.active ? std::min(notch.depthDb, -0.01f) : 0.0f, std::memory_order_relaxed);
+    }
+}
+
+void FeedbackSuppressor::process(float* data, int frames) {
+    const bool enabled = isEnabled();
+    if (m_idle) {
+        if (!enabled) {
+            return;
+        }
+        // Whatever the detector saw before going idle is stale
+        std::fill(m_history.begin(), m_history.end(), 0.0f);
+        m_sinceHop = 0;
+        m_trackCount = 0;
+        m_idle = false;
+    }
+
+    updateNotches(frames, enabled);
+
+    const int channels = m_channelCount;
+    const int filtered = qMin(channels, kMaxChannels);
+    for (Notch& notch : m_notches) {
+        if (!notch.active) {
+            continue;
+        }
+        for (int channel = 0; channel < filtered; ++channel) {
+            float z1 = notch.z1[channel];
+            float z2 = notch.z2[channel];
+            for (int frame = 0; frame < frames; ++frame) {
+                float& sample = data[frame * channels + channel];
+                const float x = sample;
+                const float y = notch.b0 * x + z1;
+                z1 = notch.b1 * x - notch.a1 * y + z2;
+                z2 = notch.b2 * x - notch.a2 * y;
+                sample = y;
+            }
+            notch.z1[channel] = z1;
+            notch.z2[channel] = z2;
+        }
+    }
+    publish();
+
+    if (!enabled) {
+        if (std::none_of(m_notches.begin(), m_notches.end(), [](const Notch& notch) { return notch.active; })) {
+            m_idle = true;
+        }
+        return;
+    }
+
+    // Listen to the output, so a howl that gets through its notch is
+    // heard again and deepens it
+    const int mask = m_fftSize - 1;
+    const float scale = 1.0f / channels;
+    for (int frame = 0; frame < frames; ++frame) {
+        float sum = 0.0f;
+        for (int channel = 0; channel < channels; ++channel) {
+            sum += data[frame * channels + channel];
+        }
+        m_history[m_write] = sum * scale;
+        m_write = (m_write + 1) & mask;
+    }
+
+    // One analysis per block at most; hops that fall in the same block
+    // are skipped rather than run back to back
+    m_sinceHop += frames;
+    if (m_sinceHop >= m_hop) {
+        analyze(m_sinceHop);
+        m_sinceHop = 0;
+    }
+}
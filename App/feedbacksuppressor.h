@@ -0,0 +1,131 @@
+#ifndef FEEDBACKSUPPRESSOR_H
+#define FEEDBACKSUPPRESSOR_H
+
+#include <QVariantList>
+#include <array>
+#include <atomic>
+#include <vector>
+#include "audioprocessor.h"
+#include "realfft.h"
+
+// Stops acoustic feedback (howl) between the speakers and the mic.
+//
+// A howl is a single frequency that the room loop amplifies until it
+// dominates the spectrum. The detector looks at the stage's own output
+// every analysis hop for spectral peaks that are loud, narrow, far above
+// the average level, without a harmonic series around them (unlike a
+// sung note) and still there after kPersistMs. Each one gets a narrow
+// notch; if the howl persists through it, the notch deepens. A notch that
+// has not been needed for kHoldSeconds slowly releases, and the bank
+// reuses the shallowest notch once all kMaxNotches are in use.
+//
+// Analysis is at most one FFT per block, so the cost per block is bounded
+// regardless of where the hops fall. Depth changes ramp, so deploying,
+// deepening and releasing do not click. Disabling releases every notch
+// within a few tens of ms and then idles. Sustained pure tones, such as a
+// test tone on the mic, are indistinguishable from howl and get notched
+// too.
+class FeedbackSuppressor : public AudioProcessor {
+    Q_OBJECT
+    Q_PROPERTY(bool enabled READ isEnabled WRITE setEnabled NOTIFY enabledChanged)
+
+public:
+    static constexpr int kMaxNotches = 12;
+    static constexpr double kPersistMs = 200.0;
+    static constexpr double kHoldSeconds = 15.0;
+    static constexpr double kInitialDepthDb = -12.0;
+    static constexpr double kMaxDepthDb = -36.0;
+
+    explicit FeedbackSuppressor(QObject* parent = nullptr);
+
+    bool isEnabled() const { return m_enabled.load(std::memory_order_relaxed); }
+    void setEnabled(bool enabled);
+
+    // Diagnostics, safe from any thread. Each notch is a map with
+    // "frequency" in Hz and "depthDb" (negative), lowest frequency first.
+    Q_INVOKABLE int activeNotchCount() const;
+    Q_INVOKABLE QVariantList notches() const;
+
+    // Howls detected since start, including ones that deepened a notch
+    Q_INVOKABLE int detectionCount() const { return m_detections.load(std::memory_order_relaxed); }
+
+    // Release every notch at once, e.g. after moving the speakers
+    Q_INVOKABLE void clearNotches();
+
+    void reset() override;
+
+signals:
+    void enabledChanged();
+
+protected:
+    void prepareBuffers() override;
+    void process(float* data, int frames) override;
+
+private:
+    // Streams wider than stereo have only their first two channels notched
+    static constexpr int kMaxChannels = 2;
+
+    struct Notch {
+        bool active = false;
+        float frequency = 0.0f;
+        float depthDb = 0.0f;     // current, ramps toward targetDb
+        float targetDb = 0.0f;
+        float appliedDb = 0.0f;   // depth the coefficients were designed for
+        int holdFrames = 0;       // until the release starts
+        float b0 = 1.0f, b1 = 0.0f, b2 = 0.0f, a1 = 0.0f, a2 = 0.0f;
+        float z1[kMaxChannels] = {};
+        float z2[kMaxChannels] = {};
+    };
+
+    // Peak followed across analysis frames until it proves to be a howl
+    struct Track {
+        float bin = 0.0f;         // fractional, latest estimate
+        float minBin = 0.0f;
+        float maxBin = 0.0f;
+        int frames = 0;           // audio frames followed
+        int misses = 0;           // analyses in a row without the peak
+        float firstDb = 0.0f;
+        float lastDb = 0.0f;
+    };
+
+    static constexpr int kMaxTracks = 16;
+
+    std::atomic<bool> m_enabled{true};
+    std::atomic<bool> m_clearRequested{false};
+    std::atomic<int> m_detections{0};
+
+    // Published by the audio thread once per block, depth 0 when unused
+    std::array<std::atomic<float>, kMaxNotches> m_publishedFrequency{};
+    std::array<std::atomic<float>, kMaxNotches> m_publishedDepth{};
+
+    // Analysis: the last m_fftSize mono frames of the output
+    RealFft m_fft;
+    int m_fftSize = 0;
+    int m_hop = 0;
+    int m_write = 0;
+    int m_sinceHop = 0;
+    int m_lowBin = 0;
+    int m_highBin = 0;
+    int m_persistFrames = 0;
+    float m_levelOffsetDb = 0.0f;   // bin power to dBFS of a sine
+    std::vector<float> m_history;
+    std::vector<float> m_window;
+    std::vector<float> m_frame;
+    std::vector<float> m_spectrum;
+    std::vector<float> m_levelDb;
+
+    // Audio thread
+    std::array<Notch, kMaxNotches> m_notches;
+    std::array<Track, kMaxTracks> m_tracks;
+    int m_trackCount = 0;
+    bool m_idle = false;
+
+    void analyze(int elapsed);
+    bool isHowl(int bin, float meanDb) const;
+    void deploy(float frequency);
+    void updateNotches(int frames, bool enabled);
+    void designNotch(Notch& notch) const;
+    void publish();
+};
+
+#endif // FEEDBACKSUPPRESSOR_H
@@ -0,0 +1,217 @@
+#include "formatconverter.h"
+#include <QDebug>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace {
+
+bool isSupported(const QAudioFormat& format, int maxChannels) {
+    return format.sampleFormat() != QAudioFormat::Unknown && format.sampleRate() > 0 && format.channelCount() >= 1
+           && format.channelCount() <= maxChannels;
+}
+
+} // namespace
+
+FormatConverter::FormatConverter(QObject* parent) : QIODevice(parent) {
+    m_kernels = &AudioKernels::active();
+    open(QIODevice::WriteOnly | QIODevice::Unbuffered);
+}
+
+bool FormatConverter::configure(const QAudioFormat& input, const QAudioFormat& output, Resampler::Quality quality,
+                                bool adjustableRate) {
+    if (!isSupported(input, kMaxInputChannels) || !isSupported(output, Resampler::kMaxChannels)) {
+        qWarning() << "Cannot convert from" << input << "to" << output;
+        return false;
+    }
+
+    m_input = input;
+    m_output = output;
+    m_resample = adjustableRate || input.sampleRate() != output.sampleRate();
+    const int inputChannels = input.channelCount();
+    const int outputChannels = output.channelCount();
+    m_resampler.configure(input.sampleRate(), output.sampleRate(), std::min(inputChannels, outputChannels), quality);
+
+    // Writes arrive in chunks, the resampler hands out blocks
+    const int bufferFrames = std::max(int(kChunkFrames), Resampler::kBlockFrames);
+    m_decoded.assign(size_t(kChunkFrames) * inputChannels, 0.0f);
+    m_mapped.assign(size_t(bufferFrames) * outputChannels, 0.0f);
+    m_pcm.assign(size_t(bufferFrames) * std::max(inputChannels, outputChannels), 0);
+    m_encoded.assign(size_t(bufferFrames) * outputChannels * output.bytesPerSample(), 0);
+    clear();
+    return true;
+}
+
+void FormatConverter::setTarget(QIODevice* target) {
+    m_target = target;
+}
+
+void FormatConverter::setRateTrim(double ppm) {
+    const double nominal = double(m_input.sampleRate()) / m_output.sampleRate();
+    m_resampler.setRatio(nominal * (1.0 + ppm * 1e-6));
+}
+
+int FormatConverter::latencyFrames() const {
+    if (!m_resample) {
+        return 0;
+    }
+    return int(std::lround(m_resampler.latencyFrames() / m_resampler.ratio()));
+}
+
+void FormatConverter::clear() {
+    m_resampler.reset();
+    m_partialBytes = 0;
+}
+
+qint64 FormatConverter::readData(char* data, qint64 maxSize) {
+    Q_UNUSED(data);
+    Q_UNUSED(maxSize);
+    return -1;
+}
+
+qint64 FormatConverter::writeData(const char* data, qint64 maxSize) {
+    const int frameBytes = m_input.bytesPerFrame();
+    if (frameBytes == 0 || !m_target) {
+        return maxSize;
+    }
+
+    const char* in = data;
+    qint64 remaining = maxSize;
+    if (m_partialBytes > 0) {
+        const int taken = int(qMin<qint64>(frameBytes - m_partialBytes, remaining));
+        std::memcpy(m_partial + m_partialBytes, in, size_t(taken));
+        m_partialBytes += taken;
+        in += taken;
+        remaining -= taken;
+        if (m_partialBytes < frameBytes) {
+            return maxSize;
+        }
+        convert(m_partial, 1);
+        m_partialBytes = 0;
+    }
+
+    const qint64 frames = remaining / frameBytes;
+    for (qint64 done = 0; done < frames; done += kChunkFrames) {
+        convert(in + done * frameBytes, int(qMin<qint64>(kChunkFrames, frames - done)));
+    }
+
+    m_partialBytes = int(remaining - frames * frameBytes);
+    std::memcpy(m_partial, in + frames * frameBytes, size_t(m_partialBytes));
+    return maxSize;
+}
+
+void FormatConverter::convert(const char* frames, int count) {
+    const int inputChannels = m_input.channelCount();
+    const int outputChannels = m_output.channelCount();
+    const int samples = count * inputChannels;
+    float* decoded = m_decoded.data();
+
+    // The capture buffer need not be aligned for the sample type
+    switch (m_input.sampleFormat()) {
+    case QAudioFormat::UInt8:
+        for (int i = 0; i < samples; ++i) {
+            decoded[i] = (float(quint8(frames[i])) - 128.0f) * (1.0f / 128.0f);
+        }
+        break;
+    case QAudioFormat::Int16:
+        std::memcpy(m_pcm.data(), frames, sizeof(qint16) * size_t(samples));
+        m_kernels->int16ToFloat(decoded, m_pcm.data(), samples);
+        break;
+    case QAudioFormat::Int32:
+        for (int i = 0; i < samples; ++i) {
+            qint32 value;
+            std::memcpy(&value, frames + size_t(i) * sizeof(qint32), sizeof(qint32));
+            decoded[i] = float(double(value) * (1.0 / 2147483648.0));
+        }
+        break;
+    case QAudioFormat::Float:
+        std::memcpy(decoded, frames, sizeof(float) * size_t(samples));
+        break;
+    default:
+        return;
+    }
+
+    const float* source = decoded;
+    int channels = inputChannels;
+    if (outputChannels < inputChannels) {
+        mapChannels(m_mapped.data(), outputChannels, decoded, inputChannels, count);
+        source = m_mapped.data();
+        channels = outputChannels;
+    }
+
+    if (m_resample) {
+        m_resampler.process(source, count, [this, channels](const float* resampled, int frames) {
+            deliver(resampled, frames, channels);
+        });
+    } else {
+        deliver(source, count, channels);
+    }
+}
+
+void FormatConverter::deliver(const float* frames, int count, int channels) {
+    const int outputChannels = m_output.channelCount();
+    if (channels < outputChannels) {
+        mapChannels(m_mapped.data(), outputChannels, frames, channels, count);
+        frames = m_mapped.data();
+    }
+    encode(frames, count * outputChannels);
+}
+
+void FormatConverter::mapChannels(float* dst, int dstChannels, const float* src, int srcChannels, int count) const {
+    if (dstChannels <= srcChannels) {
+        // Average every input channel that folds onto each output channel
+        for (int frame = 0; frame < count; ++frame) {
+            const float* in = src + size_t(frame) * srcChannels;
+            float* out = dst + size_t(frame) * dstChannels;
+            for (int channel = 0; channel < dstChannels; ++channel) {
+                float sum = 0.0f;
+                int folded = 0;
+                for (int k = channel; k < srcChannels; k += dstChannels) {
+                    sum += in[k];
+                    ++folded;
+                }
+                out[channel] = sum / float(folded);
+            }
+        }
+    } else {
+        for (int frame = 0; frame < count; ++frame) {
+            const float* in = src + size_t(frame) * srcChannels;
+            float* out = dst + size_t(frame) * dstChannels;
+            for (int channel = 0; channel < dstChannels; ++channel) {
+                out[channel] = in[channel % srcChannels];
+            }
+        }
+    }
+}
+
+void FormatConverter::encode(const float* samples, int count) {
+    const char* bytes = m_encoded.data();
+    switch (m_output.sampleFormat()) {
+    case QAudioFormat::UInt8: {
+        quint8* out = reinterpret_cast<quint8*>(m_encoded.data());
+        for (int i = 0; i < count; ++i) {
+            // Written so NaN lands on the lower bound
+            const float value = samples[i] * 128.0f + 128.0f;
+            out[i] = quint8(value > 0.0f ? (value < 255.0f ? value : 255.0f) : 0.0f);
+        }
+        break;
+    }
+    case QAudioFormat::Int16:
+        m_kernels->floatToInt16(m_pcm.data(), samples, count);
+        bytes = reinterpret_cast<const char*>(m_pcm.data());
+        break;
+    case QAudioFormat::Int32:
+        for (int i = 0; i < count; ++i) {
+            const double value = double(samples[i]) * 2147483648.0;
+            const qint32 sample = qint32(value > -2147483648.0 ? (value < 2147483647.0 ? value : 2147483647.0) : -2147483648.0);
+            std::memcpy(m_encoded.data() + size_t(i) * sizeof(qint32), &sample, sizeof(qint32));
+        }
+        break;
+    case QAudioFormat::Float:
+        bytes = reinterpret_cast<const char*>(samples);
+        break;
+    default:
+        return;
+    }
+    m_target->write(bytes, qint64(count) * m_output.bytesPerSample());
+}
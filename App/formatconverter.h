@@ -0,0 +1,87 @@
+#ifndef FORMATCONVERTER_H
+#define FORMATCONVERTER_H
+
+#include <QAudioFormat>
+#include <QIODevice>
+#include <vector>
+#include "audiokernels.h"
+#include "resampler.h"
+
+// Write-only device that converts audio written in one format to another
+// and passes it on to a target device: used when a capture device cannot
+// deliver the format the pipeline runs at.
+//
+// Samples of any QAudioFormat sample format are decoded to float, the
+// channels mapped, the rate converted with a Resampler and the result
+// encoded to the output sample format. Going to mono averages every
+// channel, coming from mono copies it to every channel; otherwise output
+// channel c takes input channel c, or the average of every input channel
+// that folds onto c when there are more inputs. The channel reduction runs
+// before the resampler and the expansion after it, so it filters as few
+// channels as possible, and an input can have more channels than the
+// resampler takes. Takes writes of any size without allocating.
+class FormatConverter : public QIODevice {
+    Q_OBJECT
+
+public:
+    // Multichannel interfaces; folded down before resampling
+    static constexpr int kMaxInputChannels = 32;
+
+    explicit FormatConverter(QObject* parent = nullptr);
+
+    // Not while writing. Fails for an unset sample format, more than
+    // kMaxInputChannels input or Resampler::kMaxChannels output channels.
+    // With adjustableRate the audio goes
+    // through the resampler even at equal rates, so setRateTrim() works.
+    bool configure(const QAudioFormat& input, const QAudioFormat& output, Resampler::Quality quality,
+                   bool adjustableRate = false);
+
+    QAudioFormat inputFormat() const { return m_input; }
+    QAudioFormat outputFormat() const { return m_output; }
+
+    void setTarget(QIODevice* target);
+
+    // Produce ppm fewer output frames per input frame than the nominal
+    // rates give, to absorb clock drift; negative produces more
+    void setRateTrim(double ppm);
+
+    // Added delay in output frames
+    int latencyFrames() const;
+
+    // Drop buffered audio, the next write starts a new stream
+    void clear();
+
+    bool isSequential() const override { return true; }
+
+protected:
+    qint64 readData(char* data, qint64 maxSize) override;
+    qint64 writeData(const char* data, qint64 maxSize) override;
+
+private:
+    static constexpr int kChunkFrames = 256;
+    static constexpr int kMaxFrameBytes = kMaxInputChannels * 4;
+
+    QAudioFormat m_input;
+    QAudioFormat m_output;
+    QIODevice* m_target = nullptr;
+    Resampler m_resampler;
+    bool m_resample = false;
+    const AudioKernels::KernelSet* m_kernels = nullptr;
+
+    // A frame split between two writes
+    char m_partial[kMaxFrameBytes] = {};
+    int m_partialBytes = 0;
+
+    std::vector<float> m_decoded;  // interleaved, input channels
+    std::vector<float> m_mapped;   // interleaved, output channels
+    std::vector<qint16> m_pcm;
+    std::vector<char> m_encoded;
+
+    void convert(const char* frames, int count);
+    // Expands the channels of converted frames if needed, encodes and writes
+    void deliver(const float* frames, int count, int channels);
+    void mapChannels(float* dst, int dstChannels, const float* src, int srcChannels, int count) const;
+    void encode(const float* samples, int count);
+};
+
+#endif // FORMATCONVERTER_H
@@ -0,0 +1,302 @@
+#include "latencyprobe.h"
+#include <QDebug>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+
+namespace {
+
+// Largest capture chunk the burst can be spliced into
+constexpr qint64 kMaxCaptureChunkBytes = 64 * 1024;
+
+// Burst level, well clear of clipping once mixed with the media
+constexpr float kBurstAmplitude = 0.25f;
+
+// Normalised correlation a peak needs to count as the burst
+constexpr double kDetectionThreshold = 0.5;
+
+} // namespace
+
+LatencyProbe::LatencyProbe(QObject* parent) : QObject(parent), m_histogram(kHistogramBins, 0) {
+    // Fibonacci LFSR for x^10 + x^7 + 1, which visits every non-zero state
+    m_mls.resize(kMlsLength);
+    quint32 lfsr = 1;
+    for (int i = 0; i < kMlsLength; ++i) {
+        const quint32 bit = ((lfsr >> 9) ^ (lfsr >> 6)) & 1u;
+        m_mls[i] = (lfsr & 1u) ? 1.0f : -1.0f;
+        lfsr = ((lfsr << 1) | bit) & ((1u << kMlsOrder) - 1);
+    }
+
+    m_captureScratch.resize(kMaxCaptureChunkBytes);
+
+    m_pollTimer = new QTimer(this);
+    m_pollTimer->setInterval(20);
+    connect(m_pollTimer, &QTimer::timeout, this, &LatencyProbe::poll);
+
+    configure(QAudioFormat(), QAudioFormat());
+}
+
+void LatencyProbe::configure(const QAudioFormat& captureFormat, const QAudioFormat& outputFormat) {
+    if (isEnabled()) {
+        qWarning() << "Cannot reconfigure the latency probe while it is measuring";
+        return;
+    }
+
+    m_captureChannels = qMax(1, captureFormat.channelCount());
+    m_outputChannels = qMax(1, outputFormat.channelCount());
+    m_sampleRate = outputFormat.sampleRate() > 0 ? outputFormat.sampleRate() : 44100;
+    if (captureFormat.sampleRate() > 0 && captureFormat.sampleRate() != m_sampleRate) {
+        qWarning() << "Latency probe expects capture and output at the same rate";
+    }
+
+    // Room for the longest latency we look for plus the burst itself
+    m_window.assign(size_t(kMaxLatencyMs * m_sampleRate / 1000.0) + kMlsLength, 0.0f);
+    m_windowFill = 0;
+    setIntervalMs(250.0);
+}
+
+void LatencyProbe::setVirtualClock(bool enabled) {
+    if (!isEnabled()) {
+        m_virtualClock = enabled;
+    } else {
+        qWarning() << "Cannot change the latency probe clock while it is measuring";
+    }
+}
+
+void LatencyProbe::setIntervalMs(double intervalMs) {
+    m_intervalFrames = qMax<qint64>(kMlsLength, qint64(intervalMs * m_sampleRate / 1000.0));
+}
+
+void LatencyProbe::setEnabled(bool enabled) {
+    m_enabled.store(enabled, std::memory_order_relaxed);
+    if (enabled) {
+        m_pollTimer->start();
+    } else {
+        m_pollTimer->stop();
+    }
+}
+
+qint64 LatencyProbe::timestampNs(qint64 frame, qint64 framesBack) const {
+    if (m_virtualClock) {
+        return (frame - framesBack) * 1000000000 / m_sampleRate;
+    }
+    const qint64 now = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                           std::chrono::steady_clock::now().time_since_epoch())
+                           .count();
+    return now - framesBack * 1000000000 / m_sampleRate;
+}
+
+const char* LatencyProbe::processCapture(const char* data, qint64 size) {
+    const int frameBytes = m_captureChannels * int(sizeof(qint16));
+    const qint64 frames = size / frameBytes;
+
+    // The frame counters keep running while disabled so that the virtual
+    // clocks of both sides stay aligned
+    const qint64 chunkStart = m_captureFrames;
+    m_captureFrames += frames;
+    m_framesSinceBurst += frames;
+
+    if (!m_enabled.load(std::memory_order_relaxed)) {
+        return data;
+    }
+
+    if (m_burstPosition >= kMlsLength && m_framesSinceBurst >= m_intervalFrames
+        && m_state.load(std::memory_order_acquire) == Idle && size <= kMaxCaptureChunkBytes) {
+        // The burst starts at the first frame of this chunk. Injected is
+        // published before the chunk reaches the ring, so the output side
+        // cannot render the burst without also seeing the state change.
+        m_burstPosition = 0;
+        m_framesSinceBurst = 0;
+        m_injectTimeNs = timestampNs(chunkStart + frames, frames);
+        m_state.store(Injected, std::memory_order_release);
+    }
+
+    if (m_burstPosition >= kMlsLength) {
+        return data;
+    }
+    if (size > kMaxCaptureChunkBytes) {
+        // Cannot splice, the rest of this burst is lost and shows up as missed
+        m_burstPosition = kMlsLength;
+        return data;
+    }
+
+    std::memcpy(m_captureScratch.data(), data, size_t(size));
+    qint16* samples = reinterpret_cast<qint16*>(m_captureScratch.data());
+    const int count = int(qMin<qint64>(frames, kMlsLength - m_burstPosition));
+    for (int frame = 0; frame < count; ++frame) {
+        const qint16 value = qint16(m_mls[m_burstPosition + frame] * kBurstAmplitude * 32767.0f);
+        std::fill_n(samples + frame * m_captureChannels, m_captureChannels, value);
+    }
+    m_burstPosition += count;
+    return m_captureScratch.data();
+}
+
+void LatencyProbe::processOutput(const qint16* data, int frames) {
+    const qint64 blockStart = m_outputFrames;
+    m_outputFrames += frames;
+
+    if (m_state.load(std::memory_order_acquire) != Injected) {
+        return;
+    }
+
+    if (m_windowFill == 0) {
+        m_windowStartNs = timestampNs(blockStart, 0);
+    }
+
+    // The first channel is enough to find the burst
+    const int windowSize = int(m_window.size());
+    const int count = qMin(frames, windowSize - m_windowFill);
+    float* window = m_window.data() + m_windowFill;
+    for (int frame = 0; frame < count; ++frame) {
+        window[frame] = data[frame * m_outputChannels] / 32768.0f;
+    }
+    m_windowFill += count;
+
+    if (m_windowFill == windowSize) {
+        m_windowFill = 0;
+        m_state.store(Ready, std::memory_order_release);
+    }
+}
+
+bool LatencyProbe::correlate(int& lag) const {
+    const float* window = m_window.data();
+    const float* mls = m_mls.data();
+    const int lags = int(m_window.size()) - kMlsLength + 1;
+
+    // Running energy of the window segment under the burst, so the peak can
+    // be normalised independently of the mic gain
+    double energy = 0.0;
+    for (int i = 0; i < kMlsLength; ++i) {
+        energy += double(window[i]) * window[i];
+    }
+
+    double best = 0.0;
+    int bestLag = -1;
+    for (int candidate = 0; candidate < lags; ++candidate) {
+        if (candidate > 0) {
+            const double leaving = window[candidate - 1];
+            const double entering = window[candidate + kMlsLength - 1];
+            energy += entering * entering - leaving * leaving;
+        }
+        if (energy <= 1e-9) {
+            continue;
+        }
+
+        float sum = 0.0f;
+        const float* segment = window + candidate;
+        for (int i = 0; i < kMlsLength; ++i) {
+            sum += segment[i] * mls[i];
+        }
+
+        const double score = sum / std::sqrt(double(kMlsLength) * energy);
+        if (score > best) {
+            best = score;
+            bestLag = candidate;
+        }
+    }
+
+    lag = bestLag;
+    return best >= kDetectionThreshold;
+}
+
+void LatencyProbe::poll() {
+    if (m_state.load(std::memory_order_acquire) != Ready) {
+        return;
+    }
+
+    int lag = -1;
+    const bool detected = correlate(lag);
+    const qint64 injectTimeNs = m_injectTimeNs;
+    const qint64 windowStartNs = m_windowStartNs;
+
+    // Hand the burst slot back to the capture thread
+    m_state.store(Idle, std::memory_order_release);
+
+    if (!detected) {
+        ++m_missed;
+        emit measurementMissed();
+        return;
+    }
+
+    const qint64 arrivalNs = windowStartNs + qint64(lag) * 1000000000 / m_sampleRate;
+    const double latencyMs = qMax<qint64>(0, arrivalNs - injectTimeNs) / 1e6;
+    m_latencies.push_back(latencyMs);
+
+    const int bin = qMin(int(latencyMs / kHistogramBinMs), kHistogramBins - 1);
+    ++m_histogram[bin];
+
+    emit measurementAdded(latencyMs);
+}
+
+void LatencyProbe::resetStatistics() {
+    m_latencies.clear();
+    m_histogram.fill(0);
+    m_missed = 0;
+}
+
+double LatencyProbe::meanMs() const {
+    if (m_latencies.empty()) {
+        return 0.0;
+    }
+    double sum = 0.0;
+    for (double latency : m_latencies) {
+        sum += latency;
+    }
+    return sum / double(m_latencies.size());
+}
+
+double LatencyProbe::jitterMs() const {
+    if (m_latencies.size() < 2) {
+        return 0.0;
+    }
+    const double mean = meanMs();
+    double sum = 0.0;
+    for (double latency : m_latencies) {
+        sum += (latency - mean) * (latency - mean);
+    }
+    return std::sqrt(sum / double(m_latencies.size() - 1));
+}
+
+double LatencyProbe::percentileMs(double percentile) const {
+    if (m_latencies.empty()) {
+        return 0.0;
+    }
+    std::vector<double> sorted = m_latencies;
+    std::sort(sorted.begin(), sorted.end());
+    const size_t index = size_t(qBound(0.0, percentile, 1.0) * double(sorted.size() - 1) + 0.5);
+    return sorted[index];
+}
+
+QString LatencyProbe::report(double deviceLatencyMs) const {
+    QString text = QStringLiteral("Latency: %1 bursts detected, %2 missed (%3 clock)\n")
+                       .arg(measurementCount())
+                       .arg(m_missed)
+                       .arg(m_virtualClock ? QStringLiteral("virtual") : QStringLiteral("steady"));
+    if (m_latencies.empty()) {
+        return text;
+    }
+
+    const auto ms = [](double value) { return QString::number(value, 'f', 2); };
+    text += QStringLiteral("  pipeline    mean %1 ms, jitter %2 ms, min %3 / p50 %4 / p95 %5 / max %6 ms\n")
+                .arg(ms(meanMs()), ms(jitterMs()), ms(percentileMs(0.0)), ms(percentileMs(0.5)),
+                     ms(percentileMs(0.95)), ms(percentileMs(1.0)));
+    text += QStringLiteral("  end-to-end  mean %1 ms, including %2 ms of device buffers\n")
+                .arg(ms(meanMs() + deviceLatencyMs), ms(deviceLatencyMs));
+
+    const int peak = *std::max_element(m_histogram.cbegin(), m_histogram.cend());
+    text += QStringLiteral("  histogram (pipeline, %1 ms bins)\n").arg(kHistogramBinMs);
+    for (int bin = 0; bin < kHistogramBins; ++bin) {
+        const int count = m_histogram[bin];
+        if (count == 0) {
+            continue;
+        }
+        const QString label = bin == kHistogramBins - 1 ? QStringLiteral(">=%1").arg(bin * kHistogramBinMs)
+                                                        : QString::number(bin * kHistogramBinMs, 'f', 1);
+        text += QStringLiteral("  %1 ms %2 %3\n")
+                    .arg(label, 8)
+                    .arg(QString(qMax(1, count * 40 / peak), QLatin1Char('#')))
+                    .arg(count);
+    }
+    return text;
+}
@@ -0,0 +1,118 @@
+#ifndef LATENCYPROBE_H
+#define LATENCYPROBE_H
+
+#include <QObject>
+#include <QAudioFormat>
+#include <QTimer>
+#include <QString>
+#include <QVector>
+#include <atomic>
+#include <vector>
+
+// Measures how long the capture -> mix bus path takes.
+//
+// The capture thread splices a maximum length sequence (MLS) burst into the
+// mic stream as it enters AudioPassthrough, and notes when it did. The
+// output thread then records a window of what the bus renders after that.
+// Once the window is full, the owner thread cross-correlates it with the
+// burst, and the peak lag gives the time the burst took to reach the sink.
+//
+// Only one burst is in flight at a time. The three threads hand it over
+// through m_state, so the audio threads never block or allocate.
+//
+// Timestamps come from the steady clock for live devices. Offline runs can
+// go faster than real time, so they use a virtual clock derived from the
+// frame counters instead.
+class LatencyProbe : public QObject {
+    Q_OBJECT
+
+public:
+    static constexpr int kMlsOrder = 10;
+    static constexpr int kMlsLength = (1 << kMlsOrder) - 1;
+    static constexpr double kMaxLatencyMs = 500.0;
+    static constexpr double kHistogramBinMs = 0.5;
+    static constexpr int kHistogramBins = 200;
+
+    explicit LatencyProbe(QObject* parent = nullptr);
+
+    // Formats of the capture stream and the bus output. Not while enabled.
+    void configure(const QAudioFormat& captureFormat, const QAudioFormat& outputFormat);
+
+    // Frame-derived timestamps, for offline runs. Not while enabled.
+    void setVirtualClock(bool enabled);
+    bool virtualClock() const { return m_virtualClock; }
+
+    // Time between bursts, in capture audio time
+    void setIntervalMs(double intervalMs);
+
+    void setEnabled(bool enabled);
+    bool isEnabled() const { return m_enabled.load(std::memory_order_relaxed); }
+
+    // Capture thread: returns the bytes to store, which are either data or
+    // a copy of it with the burst spliced in
+    const char* processCapture(const char* data, qint64 size);
+
+    // Output thread: sees every rendered Int16 frame
+    void processOutput(const qint16* data, int frames);
+
+    // Results, owner thread only
+    int measurementCount() const { return int(m_latencies.size()); }
+    int missedCount() const { return m_missed; }
+    double meanMs() const;
+    double jitterMs() const;
+    double percentileMs(double percentile) const;
+    QVector<int> histogram() const { return m_histogram; }
+
+    // Human readable summary; deviceLatencyMs is added for the end-to-end figure
+    QString report(double deviceLatencyMs = 0.0) const;
+
+public slots:
+    // Analyse a finished window, if any. Runs from a timer while enabled.
+    void poll();
+    void resetStatistics();
+
+signals:
+    void measurementAdded(double latencyMs);
+    void measurementMissed();
+
+private:
+    enum State {
+        Idle,     // owner thread is done, capture may inject
+        Injected, // burst is in the capture stream, output records
+        Ready     // window is full, owner thread correlates
+    };
+
+    std::atomic<bool> m_enabled{false};
+    std::atomic<int> m_state{Idle};
+    bool m_virtualClock = false;
+    int m_captureChannels = 1;
+    int m_outputChannels = 2;
+    int m_sampleRate = 44100;
+    qint64 m_intervalFrames = 11025;
+
+    std::vector<float> m_mls;
+
+    // Capture thread
+    std::vector<char> m_captureScratch;
+    qint64 m_captureFrames = 0;
+    qint64 m_framesSinceBurst = 0;
+    int m_burstPosition = kMlsLength;
+    qint64 m_injectTimeNs = 0;
+
+    // Output thread
+    std::vector<float> m_window;
+    int m_windowFill = 0;
+    qint64 m_outputFrames = 0;
+    qint64 m_windowStartNs = 0;
+
+    // Owner thread
+    QTimer* m_pollTimer = nullptr;
+    std::vector<double> m_latencies;
+    QVector<int> m_histogram;
+    int m_missed = 0;
+
+    qint64 timestampNs(qint64 frame, qint64 framesBack) const;
+    bool correlate(int& lag) const;
+};
+
+#endif // LATENCYPROBE_H
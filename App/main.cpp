@@ -1,4 +1,12 @@
 #include <QApplication>
+#include <QCommandLineParser>
+#include <QCommandLineOption>
+#include <algorithm>
+#include <cstring>
+#include <memory>
+#include <QDirIterator>
+#include <QFileInfo>
+#include <QMediaDevices>
 #include <QQmlApplicationEngine>
 #include <QQmlContext>
 #include <QIODevice>
@@ -8,27 +16,299 @@
 #include "autogen/environment.h"
 #include "audiopassthrough.h"
 #include "audiomixer.h"
+#include "contouranalyzer.h"
 #include "mediaplayer.h"
+#include "scoreengine.h"
+#include "songlibrary.h"
+
+// Headless runs must not create a QApplication, so look before parsing
+static bool hasHeadlessFlag(int argc, char *argv[])
+{
+    for (int i = 1; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--headless") == 0 || std::strcmp(argv[i], "--analyze-contours") == 0)
+            return true;
+    }
+    return false;
+}
+
+// Extract the reference contour of every media file under directory
+static int runContourAnalysis(QCoreApplication &app, const QString &directory)
+{
+    QStringList paths;
+    QDirIterator it(directory, SongLibrary::mediaFilters(), QDir::Files, QDirIterator::Subdirectories);
+    while (it.hasNext())
+        paths.append(it.next());
+
+    ContourAnalyzer analyzer;
+    QObject::connect(&analyzer, &ContourAnalyzer::fileAnalyzed, &app,
+                     [&analyzer](const QString &path, bool ok) {
+                         qInfo().noquote() << QStringLiteral("[%1%] %2 %3")
+                                                  .arg(qRound(100.0 * analyzer.progress()), 3)
+                                                  .arg(ok ? "analyzed" : "failed")
+                                                  .arg(QFileInfo(path).fileName());
+                     });
+    QObject::connect(&analyzer, &ContourAnalyzer::finished, &app, [](int analyzed, int failed) {
+        qInfo().noquote() << QStringLiteral("%1 contours written, %2 failed").arg(analyzed).arg(failed);
+        QCoreApplication::exit(failed > 0 ? 1 : 0);
+    });
+
+    const int queued = analyzer.analyze(paths);
+    qInfo().noquote() << QStringLiteral("%1 of %2 files need analysis").arg(queued).arg(paths.size());
+    if (queued == 0)
+        return 0;
+    return app.exec();
+}
+
+// Mics from --mics: a count takes that many channels of the default input,
+// anything else is a comma separated list of input devices, matched by name
+static bool configureMics(ThreadedAudioManager *audioManager, const QString &spec)
+{
+    bool isCount = false;
+    const int channels = spec.toInt(&isCount);
+    if (isCount)
+        return audioManager->setMicChannels(channels);
+
+    const QList<QAudioDevice> inputs = QMediaDevices::audioInputs();
+    QList<QAudioDevice> devices;
+    for (const QString &name : spec.split(',', Qt::SkipEmptyParts)) {
+        const auto match = std::find_if(inputs.begin(), inputs.end(), [&name](const QAudioDevice &device) {
+            return device.description().contains(name.trimmed(), Qt::CaseInsensitive);
+        });
+        if (match == inputs.end()) {
+            qWarning() << "No input device matches" << name;
+            return false;
+        }
+        devices.append(*match);
+    }
+    return audioManager->setMicDevices(devices);
+}
+
+// Run the audio pipeline without a UI, printing throughput when done
+static int runHeadless(QCoreApplication &app, ThreadedAudioManager *audioManager)
+{
+    QObject::connect(audioManager, &ThreadedAudioManager::offlineRunFinished, &app,
+                     [audioManager](qint64 frames, double realtimeFactor) {
+                         qInfo().noquote() << QStringLiteral("Processed %1 frames at %2x realtime")
+                                                  .arg(frames)
+                                                  .arg(realtimeFactor, 0, 'f', 1);
+
+                         const PitchCorrector *corrector = audioManager->pitchCorrector();
+                         if (!corrector->isBypassed())
+                             qInfo().noquote() << QStringLiteral("Pitch correction: %1 us per block on average, %2 us peak, %3% load")
+                                                      .arg(corrector->averageCostUs(), 0, 'f', 1)
+                                                      .arg(corrector->peakCostUs(), 0, 'f', 1)
+                                                      .arg(corrector->loadPercent(), 0, 'f', 2);
+
+                         const FeedbackSuppressor *suppressor = audioManager->feedbackSuppressor();
+                         if (suppressor->detectionCount() > 0) {
+                             QStringList notches;
+                             for (const QVariant &notch : suppressor->notches()) {
+                                 const QVariantMap values = notch.toMap();
+                                 notches.append(QStringLiteral("%1 Hz at %2 dB")
+                                                    .arg(values.value("frequency").toDouble(), 0, 'f', 0)
+                                                    .arg(values.value("depthDb").toDouble(), 0, 'f', 1));
+                             }
+                             qInfo().noquote() << QStringLiteral("Feedback: %1 detections, notches: %2")
+                                                      .arg(suppressor->detectionCount())
+                                                      .arg(notches.isEmpty() ? QStringLiteral("none") : notches.join(", "));
+                         }
+                         QCoreApplication::quit();
+                     });
+
+    audioManager->start();
+    const int result = app.exec();
+
+    // Audit builds fail the run when the audio threads allocated or locked
+    if (RealtimeAudio::auditCompiledIn()) {
+        const qint64 violations = RealtimeAudio::auditViolations();
+        qInfo().noquote() << QStringLiteral("Realtime audit: %1 violations on audio threads").arg(violations);
+        if (violations > 0)
+            return 3;
+    }
+    return result;
+}
 
 int main(int argc, char *argv[])
 {
-    // Set appropriate rendering backend for Raspberry Pi
-    // QQuickWindow::setGraphicsApi(QSGRendererInterface::Software);
-    QQuickWindow::setGraphicsApi(QSGRendererInterface::OpenGL); // or simply omit the call
-    
-    set_qt_environment();
-    QApplication app(argc, argv);
-    QQmlApplicationEngine engine;
+    const bool headless = hasHeadlessFlag(argc, argv);
+
+    std::unique_ptr<QCoreApplication> application;
+    if (headless) {
+        application = std::make_unique<QCoreApplication>(argc, argv);
+    } else {
+        // Set appropriate rendering backend for Raspberry Pi
+        // QQuickWindow::setGraphicsApi(QSGRendererInterface::Software);
+        QQuickWindow::setGraphicsApi(QSGRendererInterface::OpenGL); // or simply omit the call
+
+        set_qt_environment();
+        application = std::make_unique<QApplication>(argc, argv);
+    }
+    QCoreApplication &app = *application;
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Karaoke player");
+    parser.addHelpOption();
+    QCommandLineOption inputOption("input", "Capture from <spec>: device, tone[:hz], noise or wav:<file>.", "spec", "device");
+    QCommandLineOption outputOption("output", "Play to <spec>: device, null or wav:<file>.", "spec", "device");
+    QCommandLineOption fastOption("fast", "Run offline backends as fast as possible instead of in real time.");
+    QCommandLineOption durationOption("duration", "Stop an offline run after <seconds> of audio.", "seconds", "0");
+    QCommandLineOption headlessOption("headless", "Run the audio pipeline without the UI.");
+    QCommandLineOption pitchOption("pitch-correct", "Enable pitch correction in <key> (C, C#, ... B), optionally with :minor.", "key");
+    QCommandLineOption latencyOption("measure-latency", "Inject test bursts into the mic stream and report the round trip latency.");
+    QCommandLineOption micsOption("mics", "Capture <spec> mics: a number of channels of the default input, or a comma separated list of input device names.", "spec");
+    QCommandLineOption conversionOption("resample-quality", "Resampler quality when a capture device needs format conversion: low, medium or high.", "tier", "medium");
+    QCommandLineOption realtimeOption("realtime", "Run the audio threads with SCHED_FIFO where permitted and lock the process memory.");
+    QCommandLineOption priorityOption("rt-priority", "SCHED_FIFO priority of the audio threads in --realtime mode, 1 to 99.", "priority", "70");
+    QCommandLineOption coresOption("audio-cores", "Pin the audio threads in --realtime mode to a comma separated list of CPU <cores>.", "cores");
+    QCommandLineOption libraryOption("library", "Scan <dir> for songs instead of the directories scanned last time; may be repeated.", "dir");
+    QCommandLineOption contoursOption("analyze-contours", "Extract reference melody contours for the media files under <dir> and exit.", "dir");
+    parser.addOption(inputOption);
+    parser.addOption(outputOption);
+    parser.addOption(fastOption);
+    parser.addOption(durationOption);
+    parser.addOption(headlessOption);
+    parser.addOption(pitchOption);
+    parser.addOption(latencyOption);
+    parser.addOption(micsOption);
+    parser.addOption(conversionOption);
+    parser.addOption(realtimeOption);
+    parser.addOption(priorityOption);
+    parser.addOption(coresOption);
+    parser.addOption(libraryOption);
+    parser.addOption(contoursOption);
+    parser.process(app);
+
+    if (parser.isSet(contoursOption))
+        return runContourAnalysis(app, parser.value(contoursOption));
 
     // Create the threaded audio manager
     ThreadedAudioManager* audioManager = new ThreadedAudioManager(&app);
 
+    if (parser.isSet(micsOption) && !configureMics(audioManager, parser.value(micsOption)))
+        return 1;
+
+    static const QStringList tiers = {"low", "medium", "high"};
+    const int tier = tiers.indexOf(parser.value(conversionOption).toLower());
+    if (tier < 0) {
+        qWarning() << "Unknown resample quality" << parser.value(conversionOption);
+        return 1;
+    }
+    audioManager->setConversionQuality(Resampler::Quality(tier));
+
+    if (parser.isSet(realtimeOption)) {
+        RealtimeAudio::Options realtime;
+        realtime.enabled = true;
+        realtime.priority = parser.value(priorityOption).toInt();
+        for (const QString &core : parser.value(coresOption).split(',', Qt::SkipEmptyParts)) {
+            bool isNumber = false;
+            realtime.cores.append(core.trimmed().toInt(&isNumber));
+            if (!isNumber) {
+                qWarning() << "Unknown core" << core;
+                return 1;
+            }
+        }
+        audioManager->setRealtimeOptions(realtime);
+    }
+
+    const QString input = parser.value(inputOption);
+    const QString output = parser.value(outputOption);
+    if (input != "device" || output != "device") {
+        auto source = createOfflineAudioSource(input);
+        auto sink = createOfflineAudioSink(output);
+        if ((input != "device" && !source) || (output != "device" && !sink))
+            return 1;
+
+        const auto pacing = parser.isSet(fastOption) ? OfflineAudioThread::AsFastAsPossible
+                                                     : OfflineAudioThread::RealTime;
+        if (!audioManager->setOfflineBackends(std::move(source), std::move(sink), pacing))
+            return 1;
+
+        // Synthetic inputs never end, so give a headless run a default length
+        double duration = parser.value(durationOption).toDouble();
+        if (headless && duration <= 0.0 && !input.startsWith("wav:"))
+            duration = 10.0;
+        audioManager->setOfflineDuration(duration);
+    }
+
+    if (parser.isSet(pitchOption)) {
+        static const QStringList keys = {"C", "C#", "D", "D#", "E", "F", "F#", "G", "G#", "A", "A#", "B"};
+        const QStringList parts = parser.value(pitchOption).split(':');
+        const int key = keys.indexOf(parts.first().toUpper());
+        if (key < 0) {
+            qWarning() << "Unknown key" << parts.first();
+            return 1;
+        }
+        PitchCorrector *corrector = audioManager->pitchCorrector();
+        corrector->setKey(key);
+        corrector->setScale(parts.value(1) == "minor" ? PitchCorrector::Minor : PitchCorrector::Major);
+        corrector->setBypassed(false);
+    }
+
+    if (parser.isSet(latencyOption)) {
+        audioManager->setMeasuringLatency(true);
+
+        // Report while the devices are still open, their buffers are part of the result
+        QObject::connect(&app, &QCoreApplication::aboutToQuit, audioManager, [audioManager]() {
+            if (audioManager->measuringLatency())
+                qInfo().noquote() << audioManager->latencyReport();
+        });
+    }
+
+    if (headless) {
+        if (output == "device") {
+            qWarning() << "--headless needs an offline --output";
+            return 1;
+        }
+        return runHeadless(app, audioManager);
+    }
+
+    QQmlApplicationEngine engine;
+
     // Create the audio mixer
     AudioMixer* audioMixer = new AudioMixer(audioManager, &app);
     
     // Create the media player
     MediaPlayer* mediaPlayer = new MediaPlayer(audioMixer, &app);
 
+    // Score the singer against the song's melody, heard through the
+    // mic-to-speaker latency
+    ScoreEngine* scoreEngine = new ScoreEngine(audioManager->pitchAnalyzer(), &app);
+    scoreEngine->setMediaPlayer(mediaPlayer);
+    scoreEngine->setLatencyCompensationMs(audioManager->achievedLatencyMs());
+    QObject::connect(audioManager, &ThreadedAudioManager::achievedLatencyMsChanged, scoreEngine,
+                     [audioManager, scoreEngine]() {
+                         scoreEngine->setLatencyCompensationMs(audioManager->achievedLatencyMs());
+                     });
+
+    // Lock the echo to the song's tempo as it is played, at the default
+    // tempo when the song has none
+    EchoDelay* echoDelay = audioManager->echoDelay();
+    auto syncEchoTempo = [mediaPlayer, scoreEngine, echoDelay]() {
+        const double bpm = scoreEngine->tempoBpm() > 0.0 ? scoreEngine->tempoBpm() : EchoDelay::kDefaultTempoBpm;
+        echoDelay->setTempoBpm(bpm * mediaPlayer->playbackRate());
+    };
+    QObject::connect(scoreEngine, &ScoreEngine::melodyChanged, echoDelay, syncEchoTempo);
+    QObject::connect(mediaPlayer, &MediaPlayer::playbackRateChanged, echoDelay, syncEchoTempo);
+    syncEchoTempo();
+
+    // Contours for songs without MIDI, analysed when such a song is
+    // loaded; the score picks up the current song's as soon as it is written
+    ContourAnalyzer* contourAnalyzer = new ContourAnalyzer(&app);
+    QObject::connect(scoreEngine, &ScoreEngine::melodyMissing, contourAnalyzer,
+                     [contourAnalyzer](const QString &path) { contourAnalyzer->analyze({path}); });
+    QObject::connect(contourAnalyzer, &ContourAnalyzer::fileAnalyzed, scoreEngine,
+                     [mediaPlayer, scoreEngine](const QString &path, bool ok) {
+                         if (ok && !scoreEngine->hasMelody() && mediaPlayer->source().isLocalFile() &&
+                             QFileInfo(mediaPlayer->source().toLocalFile()).absoluteFilePath() == path)
+                             scoreEngine->loadMelodyForSource();
+                     });
+
+    // Songs from the cached index at once, then whatever the scan finds
+    SongLibrary* songLibrary = new SongLibrary(&app);
+    if (parser.isSet(libraryOption))
+        songLibrary->setRoots(parser.values(libraryOption));
+    songLibrary->load();
+
     // Start the audio threads
     audioManager->start();
 
@@ -36,6 +316,17 @@ int main(int argc, char *argv[])
     engine.rootContext()->setContextProperty("audioManager", audioManager);
     engine.rootContext()->setContextProperty("audioMixer", audioMixer);
     engine.rootContext()->setContextProperty("mediaPlayerBackend", mediaPlayer);
+    engine.rootContext()->setContextProperty("feedbackSuppressor", audioManager->feedbackSuppressor());
+    engine.rootContext()->setContextProperty("noiseGate", audioManager->noiseGate());
+    engine.rootContext()->setContextProperty("compressor", audioManager->compressor());
+    engine.rootContext()->setContextProperty("limiter", audioManager->limiter());
+    engine.rootContext()->setContextProperty("pitchCorrector", audioManager->pitchCorrector());
+    engine.rootContext()->setContextProperty("vocalReducer", audioMixer->mediaVocalReducer());
+    engine.rootContext()->setContextProperty("echoDelay", audioManager->echoDelay());
+    engine.rootContext()->setContextProperty("reverb", audioManager->reverb());
+    engine.rootContext()->setContextProperty("scoreEngine", scoreEngine);
+    engine.rootContext()->setContextProperty("contourAnalyzer", contourAnalyzer);
+    engine.rootContext()->setContextProperty("songLibrary", songLibrary);
 
     const QUrl url(mainQmlFile); // Assuming mainQmlFile is defined in environment.h
     QObject::connect(
@@ -2,6 +2,7 @@
 #include <QDebug>
 #include <QCoreApplication>
 #include <QTimer>
+#include <cmath>
 
 MediaPlayer::MediaPlayer(AudioMixer* audioMixer, QObject *parent)
     : QObject(parent)
@@ -14,9 +15,14 @@ MediaPlayer::MediaPlayer(AudioMixer* audioMixer, QObject *parent)
     // Create the QMediaPlayer instance with a specific render control
     m_mediaPlayer = new QMediaPlayer(this);
     
-    // Create our custom audio output and set it up
+    // Tap decoded audio into our mixer instead of letting the backend play it
     m_audioOutput = new CustomAudioOutput(m_audioMixer, this);
-    m_mediaPlayer->setAudioOutput(m_audioOutput);
+    m_mediaPlayer->setAudioBufferOutput(m_audioOutput);
+
+    if (m_audioMixer) {
+        connect(m_audioMixer->mediaPitchShifter(), &PitchShifter::semitonesChanged,
+                this, &MediaPlayer::transposeChanged);
+    }
     
     // Set video output properties - be explicit about video rendering 
     m_mediaPlayer->setVideoOutput(nullptr); // Reset any existing output
@@ -61,6 +67,7 @@ void MediaPlayer::setSource(const QUrl &source)
 {
     if (m_source != source) {
         m_source = source;
+        flushAudio();
         m_mediaPlayer->setSource(source);
         emit sourceChanged();
     }
@@ -76,10 +83,7 @@ void MediaPlayer::setVolume(float volume)
     if (m_volume != volume) {
         m_volume = volume;
         
-        // Apply volume to our audio output
-        m_audioOutput->setVolume(volume);
-        
-        // If we have a mixer, tell it about the volume change
+        // The backing track is played through the mixer, which owns its volume
         if (m_audioMixer) {
             m_audioMixer->setMediaVolume(volume);
         }
@@ -125,6 +129,7 @@ void MediaPlayer::setVideoSink(QVideoSink* sink)
             if (!m_source.isEmpty()) {
                 qDebug() << "Reloading source after video sink change";
                 QUrl currentSource = m_source;
+                flushAudio();
                 m_mediaPlayer->setSource(QUrl()); // Clear first
                 m_mediaPlayer->setSource(currentSource); // Reload
             }
@@ -180,6 +185,7 @@ void MediaPlayer::play()
         
         // If not loaded, try to reload
         QUrl currentSource = m_source;
+        flushAudio();
         m_mediaPlayer->setSource(QUrl());  // Clear it first
         m_mediaPlayer->setSource(currentSource);  // Set it again
     }
@@ -196,13 +202,24 @@ void MediaPlayer::play()
 void MediaPlayer::pause()
 {
     m_mediaPlayer->pause();
+    if (m_audioMixer) {
+        m_audioMixer->restartMediaClock();
+    }
 }
 
 void MediaPlayer::stop()
 {
+    flushAudio();
     m_mediaPlayer->stop();
 }
 
+void MediaPlayer::flushAudio()
+{
+    if (m_audioMixer) {
+        m_audioMixer->flushMedia();
+    }
+}
+
 void MediaPlayer::handleMediaStatusChanged(QMediaPlayer::MediaStatus status)
 {
     // Log all media status changes
@@ -254,6 +271,7 @@ qint64 MediaPlayer::position() const
 
 void MediaPlayer::setPosition(qint64 position)
 {
+    flushAudio();
     m_mediaPlayer->setPosition(position);
 }
 
@@ -269,10 +287,32 @@ float MediaPlayer::playbackRate() const
 
 void MediaPlayer::setPlaybackRate(float rate)
 {
+    // 5% steps within what the time-stretcher supports
+    rate = qBound(float(TimeStretcher::kMinRate), std::round(rate * 20.0f) / 20.0f,
+                  float(TimeStretcher::kMaxRate));
     if (m_playbackRate != rate) {
         m_playbackRate = rate;
+
+        // The decoder and the video run at the new rate; the decoded audio
+        // is stretched back to real time by the mixer so its pitch is kept
         m_mediaPlayer->setPlaybackRate(rate);
+        if (m_audioMixer) {
+            m_audioMixer->setMediaPlaybackRate(rate);
+        }
         emit playbackRateChanged();
     }
 }
 
+
+int MediaPlayer::transpose() const
+{
+    return m_audioMixer ? m_audioMixer->mediaPitchShifter()->semitones() : 0;
+}
+
+void MediaPlayer::setTranspose(int semitones)
+{
+    // Applied on the mix bus, so playback carries on without a reload
+    if (m_audioMixer) {
+        m_audioMixer->mediaPitchShifter()->setSemitones(semitones);
+    }
+}
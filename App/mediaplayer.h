@@ -3,7 +3,6 @@
 
 #include <QObject>
 #include <QMediaPlayer>
-#include <QAudioOutput>
 #include <QVideoSink>
 #include <QUrl>
 #include <QString>
@@ -20,6 +19,7 @@ class MediaPlayer : public QObject
     Q_PROPERTY(qint64 position READ position WRITE setPosition NOTIFY positionChanged)
     Q_PROPERTY(qint64 duration READ duration NOTIFY durationChanged)
     Q_PROPERTY(float playbackRate READ playbackRate WRITE setPlaybackRate NOTIFY playbackRateChanged)
+    Q_PROPERTY(int transpose READ transpose WRITE setTranspose NOTIFY transposeChanged)
 
 public:
     explicit MediaPlayer(AudioMixer* audioMixer, QObject *parent = nullptr);
@@ -44,6 +44,10 @@ public:
     float playbackRate() const;
     void setPlaybackRate(float rate);
 
+    // Key change of the backing track in semitones, -6 to +6
+    int transpose() const;
+    void setTranspose(int semitones);
+
 public slots:
     void play();
     void pause();
@@ -57,6 +61,7 @@ signals:
     void positionChanged();
     void durationChanged();
     void playbackRateChanged();
+    void transposeChanged();
     void errorOccurred(const QString &error);
 
 private:
@@ -69,6 +74,9 @@ private:
     QVideoSink *m_videoSink;
     float m_playbackRate;
 
+    // Drop media audio decoded for the old position or source
+    void flushAudio();
+
 private slots:
     void handleMediaStatusChanged(QMediaPlayer::MediaStatus status);
     void handleErrorOccurred(QMediaPlayer::Error error, const QString &errorString);
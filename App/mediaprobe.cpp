@@ -0,0 +1,806 @@
+#include "mediaprobe.h"
+#include "songindex.h"
+#include <QCoreApplication>
+#include <QFile>
+#include <QFileInfo>
+#include <QMediaMetaData>
+#include <QMediaPlayer>
+#include <QMutex>
+#include <QQueue>
+#include <QSize>
+#include <QThread>
+#include <QTimer>
+#include <QUrl>
+#include <QWaitCondition>
+#include <QtEndian>
+
+namespace {
+
+// Guards against garbage box sizes sending the walk round in circles
+constexpr int kMaxBoxes = 4096;
+constexpr int kMaxTagBytes = 1024;
+
+// Tags are read from this much of an ID3v2 tag or a Vorbis comment block,
+// title and artist come before any cover picture
+constexpr int kMaxTagBlockBytes = 64 * 1024;
+
+// How far past the ID3v2 tag the first MPEG audio frame is looked for
+constexpr int kMaxSyncScan = 64 * 1024;
+
+constexpr quint32 fourcc(const char (&name)[5]) {
+    return quint32(uchar(name[0])) << 24 | quint32(uchar(name[1])) << 16 | quint32(uchar(name[2])) << 8 |
+           quint32(uchar(name[3]));
+}
+
+constexpr quint32 kFtyp = fourcc("ftyp");
+constexpr quint32 kMoov = fourcc("moov");
+constexpr quint32 kMvhd = fourcc("mvhd");
+constexpr quint32 kTrak = fourcc("trak");
+constexpr quint32 kTkhd = fourcc("tkhd");
+constexpr quint32 kUdta = fourcc("udta");
+constexpr quint32 kMeta = fourcc("meta");
+constexpr quint32 kHdlr = fourcc("hdlr");
+constexpr quint32 kIlst = fourcc("ilst");
+constexpr quint32 kData = fourcc("data");
+constexpr quint32 kTitle = fourcc("\xa9nam");
+constexpr quint32 kArtist = fourcc("\xa9" "ART");
+constexpr quint32 kAlbumArtist = fourcc("aART");
+
+struct Box {
+    quint32 type = 0;
+    qint64 payload = 0;  // file offset of the contents
+    qint64 end = 0;
+};
+
+// Calls visit for each box in [begin, end), false if the boxes do not tile it
+template<typename Visit>
+bool forEachBox(QFile& file, qint64 begin, qint64 end, Visit visit) {
+    qint64 pos = begin;
+    for (int count = 0; pos + 8 <= end; ++count) {
+        uchar header[16];
+        if (count == kMaxBoxes || !file.seek(pos) || file.read(reinterpret_cast<char*>(header), 8) != 8) {
+            return false;
+        }
+        quint64 size = qFromBigEndian<quint32>(header);
+        qint64 headerSize = 8;
+        if (size == 1) {
+            if (file.read(reinterpret_cast<char*>(header + 8), 8) != 8) {
+                return false;
+            }
+            size = qFromBigEndian<quint64>(header + 8);
+            headerSize = 16;
+        } else if (size == 0) {
+            // Runs to the end of the enclosing box
+            size = quint64(end - pos);
+        }
+        if (size < quint64(headerSize) || size > quint64(end - pos)) {
+            return false;
+        }
+
+        Box box;
+        box.type = qFromBigEndian<quint32>(header + 4);
+        box.payload = pos + headerSize;
+        box.end = pos + qint64(size);
+        visit(box);
+        pos = box.end;
+    }
+    return true;
+}
+
+QByteArray readPayload(QFile& file, const Box& box, qint64 maxBytes) {
+    if (!file.seek(box.payload)) {
+        return QByteArray();
+    }
+    return file.read(qMin(box.end - box.payload, maxBytes));
+}
+
+// Movie duration from mvhd
+void readMovieHeader(QFile& file, const Box& box, SongInfo& info) {
+    const QByteArray bytes = readPayload(file, box, 32);
+    const uchar* data = reinterpret_cast<const uchar*>(bytes.constData());
+    quint32 timescale = 0;
+    quint64 duration = 0;
+    if (bytes.size() >= 20 && data[0] == 0) {
+        timescale = qFromBigEndian<quint32>(data + 12);
+        duration = qFromBigEndian<quint32>(data + 16);
+        if (duration == 0xffffffff) {
+            duration = 0;
+        }
+    } else if (bytes.size() >= 32 && data[0] == 1) {
+        timescale = qFromBigEndian<quint32>(data + 20);
+        duration = qFromBigEndian<quint64>(data + 24);
+        if (duration == ~quint64(0)) {
+            duration = 0;
+        }
+    }
+    if (timescale > 0) {
+        info.durationMs = qint64(duration * 1000 / timescale);
+    }
+}
+
+// Picture size from the first track that has one; sound tracks have none
+void readTrackHeader(QFile& file, const Box& box, SongInfo& info) {
+    if (info.width > 0) {
+        return;
+    }
+    const QByteArray bytes = readPayload(file, box, 96);
+    const uchar* data = reinterpret_cast<const uchar*>(bytes.constData());
+    const int sizeOffset = bytes.isEmpty() ? 0 : (data[0] == 1 ? 88 : 76);
+    if (sizeOffset > 0 && bytes.size() >= sizeOffset + 8) {
+        // 16.16 fixed point
+        info.width = int(qFromBigEndian<quint32>(data + sizeOffset) >> 16);
+        info.height = int(qFromBigEndian<quint32>(data + sizeOffset + 4) >> 16);
+    }
+}
+
+// Text of an ilst item, from its data box
+QString readTag(QFile& file, const Box& item) {
+    QString text;
+    forEachBox(file, item.payload, item.end, [&](const Box& box) {
+        if (box.type != kData || !text.isEmpty()) {
+            return;
+        }
+        const QByteArray bytes = readPayload(file, box, 8 + kMaxTagBytes);
+        if (bytes.size() < 8) {
+            return;
+        }
+        const quint32 kind = qFromBigEndian<quint32>(reinterpret_cast<const uchar*>(bytes.constData()));
+        const QByteArray value = bytes.mid(8);
+        if (kind == 1) {
+            text = QString::fromUtf8(value);
+        } else if (kind == 2) {
+            for (qsizetype i = 0; i + 1 < value.size(); i += 2) {
+                text.append(QChar(qFromBigEndian<quint16>(reinterpret_cast<const uchar*>(value.constData()) + i)));
+            }
+        }
+    });
+    return text.trimmed();
+}
+
+void readMeta(QFile& file, const Box& meta, SongInfo& info) {
+    // A full box in MP4, a plain one in QuickTime: the first child of a
+    // plain meta is its hdlr
+    qint64 children = meta.payload;
+    if (!file.seek(meta.payload)) {
+        return;
+    }
+    const QByteArray peek = file.read(8);
+    if (peek.size() == 8 && qFromBigEndian<quint32>(reinterpret_cast<const uchar*>(peek.constData()) + 4) != kHdlr) {
+        children += 4;
+    }
+
+    QString albumArtist;
+    forEachBox(file, children, meta.end, [&](const Box& box) {
+        if (box.type != kIlst) {
+            return;
+        }
+        forEachBox(file, box.payload, box.end, [&](const Box& item) {
+            if (item.type == kTitle) {
+                info.title = readTag(file, item);
+            } else if (item.type == kArtist) {
+                info.artist = readTag(file, item);
+            } else if (item.type == kAlbumArtist) {
+                albumArtist = readTag(file, item);
+            }
+        });
+    });
+    if (info.artist.isEmpty()) {
+        info.artist = albumArtist;
+    }
+}
+
+const uchar* raw(const QByteArray& bytes) {
+    return reinterpret_cast<const uchar*>(bytes.constData());
+}
+
+QByteArray readAt(QFile& file, qint64 pos, qint64 maxBytes) {
+    if (pos < 0 || !file.seek(pos)) {
+        return QByteArray();
+    }
+    return file.read(maxBytes);
+}
+
+// Title and artist from tag fields, the album artist standing in for a
+// missing artist as it does in MP4
+void setTag(SongInfo& info, QString& albumArtist, const QString& key, const QString& value) {
+    if (key == QLatin1String("TITLE")) {
+        info.title = value.trimmed();
+    } else if (key == QLatin1String("ARTIST")) {
+        info.artist = value.trimmed();
+    } else if (key == QLatin1String("ALBUMARTIST")) {
+        albumArtist = value.trimmed();
+    }
+}
+
+// Bytes taken by an ID3v2 tag at pos, 0 if there is none
+qint64 id3Size(QFile& file, qint64 pos) {
+    const QByteArray header = readAt(file, pos, 10);
+    const uchar* data = raw(header);
+    if (header.size() < 10 || !header.startsWith("ID3") || ((data[6] | data[7] | data[8] | data[9]) & 0x80)) {
+        return 0;
+    }
+    const qint64 size = qint64(data[6]) << 21 | qint64(data[7]) << 14 | qint64(data[8]) << 7 | data[9];
+    const bool footer = data[5] & 0x10;
+    return 10 + size + (footer ? 10 : 0);
+}
+
+// Text of an ID3v2 text frame, up to the first terminator
+QString id3Text(const QByteArray& frame) {
+    if (frame.isEmpty()) {
+        return QString();
+    }
+    const char encoding = frame[0];
+    const QByteArray value = frame.mid(1);
+    if (encoding == 0) {
+        return QString::fromLatin1(value.left(value.indexOf('\0')));
+    }
+    if (encoding == 3) {
+        return QString::fromUtf8(value.left(value.indexOf('\0')));
+    }
+
+    // UTF-16, with a byte order mark unless it is big-endian by encoding
+    bool littleEndian = false;
+    qsizetype i = 0;
+    if (encoding == 1 && value.size() >= 2) {
+        littleEndian = uchar(value[0]) == 0xff && uchar(value[1]) == 0xfe;
+        i = 2;
+    }
+    QString text;
+    for (; i + 1 < value.size(); i += 2) {
+        const quint16 unit = littleEndian ? qFromLittleEndian<quint16>(raw(value) + i)
+                                          : qFromBigEndian<quint16>(raw(value) + i);
+        if (unit == 0) {
+            break;
+        }
+        text.append(QChar(unit));
+    }
+    return text;
+}
+
+// Title and artist from the ID3v2 tag at the start of the file
+void readId3(QFile& file, qint64 tagSize, SongInfo& info) {
+    const QByteArray tag = readAt(file, 0, qMin<qint64>(tagSize, kMaxTagBlockBytes));
+    if (tag.size() < 10) {
+        return;
+    }
+    const uchar* data = raw(tag);
+    const int major = data[3];
+    const uchar flags = data[5];
+    if (major < 2 || major > 4 || (flags & 0x80)) {
+        // Unknown version, or unsynchronised frames we do not undo
+        return;
+    }
+
+    // 2.2 has three letter ids and sizes, 2.4 syncsafe frame sizes
+    const int idBytes = major == 2 ? 3 : 4;
+    const int headerBytes = major == 2 ? 6 : 10;
+    qsizetype pos = 10;
+    if (major >= 3 && (flags & 0x40) && tag.size() >= 14) {
+        const quint32 extended = qFromBigEndian<quint32>(data + 10);
+        pos += major == 4 ? qsizetype((extended >> 24 & 0x7f) << 21 | (extended >> 16 & 0x7f) << 14 |
+                                      (extended >> 8 & 0x7f) << 7 | (extended & 0x7f))
+                          : qsizetype(extended) + 4;
+    }
+
+    QString albumArtist;
+    for (int count = 0; count < kMaxBoxes && pos + headerBytes <= tag.size(); ++count) {
+        const QByteArray id = tag.mid(pos, idBytes);
+        if (id.at(0) == '\0') {
+            // Padding
+            break;
+        }
+        const uchar* size = data + pos + idBytes;
+        qsizetype frameSize = 0;
+        if (major == 2) {
+            frameSize = qsizetype(size[0]) << 16 | qsizetype(size[1]) << 8 | size[2];
+        } else if (major == 3) {
+            frameSize = qsizetype(qFromBigEndian<quint32>(size));
+        } else {
+            frameSize = qsizetype(size[0] & 0x7f) << 21 | qsizetype(size[1] & 0x7f) << 14 |
+                        qsizetype(size[2] & 0x7f) << 7 | (size[3] & 0x7f);
+        }
+        pos += headerBytes;
+        if (frameSize > tag.size() - pos) {
+            break;
+        }
+        const QByteArray frame = tag.mid(pos, qMin<qsizetype>(frameSize, kMaxTagBytes));
+        if (id == "TIT2" || id == "TT2") {
+            setTag(info, albumArtist, QStringLiteral("TITLE"), id3Text(frame));
+        } else if (id == "TPE1" || id == "TP1") {
+            setTag(info, albumArtist, QStringLiteral("ARTIST"), id3Text(frame));
+        } else if (id == "TPE2" || id == "TP2") {
+            setTag(info, albumArtist, QStringLiteral("ALBUMARTIST"), id3Text(frame));
+        }
+        pos += frameSize;
+    }
+    if (info.artist.isEmpty()) {
+        info.artist = albumArtist;
+    }
+}
+
+// Title and artist from the 128 byte ID3v1 tag at the end of the file
+bool readId3v1(QFile& file, SongInfo& info) {
+    const QByteArray tag = readAt(file, file.size() - 128, 128);
+    if (tag.size() != 128 || !tag.startsWith("TAG")) {
+        return false;
+    }
+    auto field = [&tag](int offset) {
+        const QByteArray value = tag.mid(offset, 30);
+        return QString::fromLatin1(value.left(value.indexOf('\0'))).trimmed();
+    };
+    if (info.title.isEmpty()) {
+        info.title = field(3);
+    }
+    if (info.artist.isEmpty()) {
+        info.artist = field(33);
+    }
+    return true;
+}
+
+struct MpegFrame {
+    int bitrateKbps = 0;
+    int sampleRate = 0;
+    int samplesPerFrame = 0;
+    int bytes = 0;
+    int xingOffset = 0;  // of the Xing/Info header, from the frame start
+    quint32 stream = 0;  // header bits every frame of the stream shares
+};
+
+// Decodes an MPEG audio frame header, false if it is not one
+bool parseMpegHeader(quint32 header, MpegFrame& frame) {
+    static constexpr short kBitrates[2][3][15] = {
+        {{0, 32, 64, 96, 128, 160, 192, 224, 256, 288, 320, 352, 384, 416, 448},
+         {0, 32, 48, 56, 64, 80, 96, 112, 128, 160, 192, 224, 256, 320, 384},
+         {0, 32, 40, 48, 56, 64, 80, 96, 112, 128, 160, 192, 224, 256, 320}},
+        {{0, 32, 48, 56, 64, 80, 96, 112, 128, 144, 160, 176, 192, 224, 256},
+         {0, 8, 16, 24, 32, 40, 48, 56, 64, 80, 96, 112, 128, 144, 160},
+         {0, 8, 16, 24, 32, 40, 48, 56, 64, 80, 96, 112, 128, 144, 160}}};
+    static constexpr int kSampleRates[3] = {44100, 48000, 32000};
+
+    const int version = int(header >> 19 & 3);  // 0 is 2.5, 2 is 2, 3 is 1
+    const int layer = 4 - int(header >> 17 & 3);
+    const int bitrateIndex = int(header >> 12 & 15);
+    const int rateIndex = int(header >> 10 & 3);
+    if ((header & 0xffe00000) != 0xffe00000 || version == 1 || layer == 4 || bitrateIndex == 0 ||
+        bitrateIndex == 15 || rateIndex == 3) {
+        return false;
+    }
+
+    const bool mpeg1 = version == 3;
+    const bool mono = (header >> 6 & 3) == 3;
+    const int padding = int(header >> 9 & 1);
+    frame.bitrateKbps = kBitrates[mpeg1 ? 0 : 1][layer - 1][bitrateIndex];
+    frame.sampleRate = kSampleRates[rateIndex] >> (mpeg1 ? 0 : (version == 2 ? 1 : 2));
+    frame.samplesPerFrame = layer == 1 ? 384 : (layer == 3 && !mpeg1 ? 576 : 1152);
+    frame.bytes = layer == 1 ? (12000 * frame.bitrateKbps / frame.sampleRate + padding) * 4
+                             : frame.samplesPerFrame / 8 * 1000 * frame.bitrateKbps / frame.sampleRate + padding;
+    frame.xingOffset = 4 + (mpeg1 ? (mono ? 17 : 32) : (mono ? 9 : 17));
+    frame.stream = header & 0xfffe0c00;
+    return true;
+}
+
+// Frame count from a Xing/Info or VBRI header in the first frame, 0 if
+// there is neither and the stream is taken to be constant bitrate
+qint64 vbrFrames(const QByteArray& window, qsizetype start, const MpegFrame& frame) {
+    const qsizetype xing = start + frame.xingOffset;
+    if (window.size() >= xing + 12 && (window.mid(xing, 4) == "Xing" || window.mid(xing, 4) == "Info") &&
+        (qFromBigEndian<quint32>(raw(window) + xing + 4) & 1)) {
+        return qFromBigEndian<quint32>(raw(window) + xing + 8);
+    }
+    const qsizetype vbri = start + 36;
+    if (window.size() >= vbri + 18 && window.mid(vbri, 4) == "VBRI") {
+        return qFromBigEndian<quint32>(raw(window) + vbri + 14);
+    }
+    return 0;
+}
+
+// Title and artist from a Vorbis comment block
+void readVorbisComment(const QByteArray& block, SongInfo& info) {
+    const uchar* data = raw(block);
+    qsizetype pos = 0;
+    auto readLength = [&](quint32& value) {
+        if (pos + 4 > block.size()) {
+            return false;
+        }
+        value = qFromLittleEndian<quint32>(data + pos);
+        pos += 4;
+        return true;
+    };
+
+    quint32 vendorBytes = 0;
+    quint32 count = 0;
+    if (!readLength(vendorBytes) || vendorBytes > quint32(block.size() - pos)) {
+        return;
+    }
+    pos += vendorBytes;
+    if (!readLength(count)) {
+        return;
+    }
+
+    QString albumArtist;
+    for (quint32 i = 0; i < count && i < quint32(kMaxBoxes); ++i) {
+        quint32 bytes = 0;
+        if (!readLength(bytes) || bytes > quint32(block.size() - pos)) {
+            break;
+        }
+        const QString comment = QString::fromUtf8(block.mid(pos, bytes));
+        pos += bytes;
+        const qsizetype equals = comment.indexOf(QLatin1Char('='));
+        if (equals > 0) {
+            setTag(info, albumArtist, comment.left(equals).toUpper(), comment.mid(equals + 1));
+        }
+    }
+    if (info.artist.isEmpty()) {
+        info.artist = albumArtist;
+    }
+}
+
+void readPlayerMetaData(const QMediaPlayer& player, SongInfo& info) {
+    const QMediaMetaData metaData = player.metaData();
+    info.title = metaData.stringValue(QMediaMetaData::Title).trimmed();
+    info.artist = metaData.stringValue(QMediaMetaData::ContributingArtist).trimmed();
+    if (info.artist.isEmpty()) {
+        info.artist = metaData.stringValue(QMediaMetaData::AlbumArtist).trimmed();
+    }
+    info.durationMs = player.duration();
+    const QSize resolution = metaData.value(QMediaMetaData::Resolution).toSize();
+    if (resolution.isValid()) {
+        info.width = resolution.width();
+        info.height = resolution.height();
+    }
+}
+
+// The one QMediaPlayer behind probeWithPlayer. It lives on this thread
+// and loads the queued files one after the other in the thread's own
+// event loop, while the callers wait for their own file.
+class PlayerProbeThread : public QThread {
+public:
+    static PlayerProbeThread& instance() {
+        static PlayerProbeThread thread;
+        return thread;
+    }
+
+    ~PlayerProbeThread() override {
+        quit();
+        wait();
+    }
+
+    bool probe(const QString& path, SongInfo& info) {
+        Request request;
+        request.path = path;
+        request.info = &info;
+
+        QMutexLocker locker(&m_mutex);
+        if (m_stopped) {
+            return false;
+        }
+        m_queue.enqueue(&request);
+        QMetaObject::invokeMethod(&m_context, [this]() { loadNext(); }, Qt::QueuedConnection);
+        while (!request.done) {
+            m_finished.wait(&m_mutex);
+        }
+        return request.loaded;
+    }
+
+protected:
+    void run() override {
+        QMediaPlayer player;
+        QTimer timeout;
+        timeout.setSingleShot(true);
+        m_player = &player;
+        m_timeout = &timeout;
+        QObject::connect(&player, &QMediaPlayer::mediaStatusChanged, &m_context,
+                         [this](QMediaPlayer::MediaStatus status) {
+            if (status == QMediaPlayer::LoadedMedia) {
+                finish(true);
+            } else if (status == QMediaPlayer::InvalidMedia) {
+                finish(false);
+            }
+        });
+        QObject::connect(&player, &QMediaPlayer::errorOccurred, &m_context, [this]() { finish(false); });
+        QObject::connect(&timeout, &QTimer::timeout, &m_context, [this]() { finish(false); });
+
+        exec();
+
+        // Nobody is left to load the rest
+        QMutexLocker locker(&m_mutex);
+        m_stopped = true;
+        if (m_current) {
+            m_queue.prepend(m_current);
+            m_current = nullptr;
+        }
+        for (Request* request : std::as_const(m_queue)) {
+            request->done = true;
+        }
+        m_queue.clear();
+        m_finished.wakeAll();
+        m_player = nullptr;
+        m_timeout = nullptr;
+    }
+
+private:
+    struct Request {
+        QString path;
+        SongInfo* info = nullptr;
+        bool loaded = false;
+        bool done = false;
+    };
+
+    PlayerProbeThread() {
+        m_context.moveToThread(this);
+        // Stop with the application, before the statics go
+        if (QCoreApplication* app = QCoreApplication::instance()) {
+            QObject::connect(app, &QCoreApplication::aboutToQuit, app, [this]() { quit(); },
+                             Qt::DirectConnection);
+        }
+        setObjectName(QStringLiteral("MediaProbePlayer"));
+        start(QThread::LowPriority);
+    }
+
+    // On this thread
+    void loadNext() {
+        if (m_current) {
+            return;
+        }
+        {
+            QMutexLocker locker(&m_mutex);
+            if (m_queue.isEmpty()) {
+                return;
+            }
+            m_current = m_queue.dequeue();
+        }
+        m_timeout->start(MediaProbe::kPlayerTimeoutMs);
+        m_player->setSource(QUrl::fromLocalFile(m_current->path));
+        if (m_player->mediaStatus() == QMediaPlayer::LoadedMedia) {
+            finish(true);
+        }
+    }
+
+    void finish(bool loaded) {
+        if (!m_current) {
+            return;
+        }
+        m_timeout->stop();
+        if (loaded) {
+            readPlayerMetaData(*m_player, *m_current->info);
+        }
+
+        // The caller may return as soon as it is told
+        QMutexLocker locker(&m_mutex);
+        m_current->loaded = loaded;
+        m_current->done = true;
+        m_current = nullptr;
+        m_finished.wakeAll();
+        locker.unlock();
+
+        m_player->setSource(QUrl());
+        QMetaObject::invokeMethod(&m_context, [this]() { loadNext(); }, Qt::QueuedConnection);
+    }
+
+    // Receives the queued calls on this thread
+    QObject m_context;
+    QMediaPlayer* m_player = nullptr;
+    QTimer* m_timeout = nullptr;
+    Request* m_current = nullptr;  // only touched on this thread
+
+    QMutex m_mutex;
+    QWaitCondition m_finished;
+    QQueue<Request*> m_queue;
+    bool m_stopped = false;
+};
+
+} // namespace
+
+bool MediaProbe::probe(const QString& path, SongInfo& info) {
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+
+    // The cheap header parsers first; mp3 last, as its frame sync is the
+    // least distinctive signature
+    bool ok = probeMp4(file, info) || probeFlac(file, info) || probeWav(file, info) || probeMp3(file, info);
+    file.close();
+    if (!ok) {
+        ok = probeWithPlayer(path, info);
+    }
+    if (info.title.isEmpty()) {
+        nameFromFile(path, info);
+    }
+    return ok;
+}
+
+bool MediaProbe::probeMp4(QFile& file, SongInfo& info) {
+    // Every ISO base media file starts with ftyp, or moov in old QuickTime
+    uchar start[8];
+    if (!file.seek(0) || file.read(reinterpret_cast<char*>(start), 8) != 8) {
+        return false;
+    }
+    const quint32 firstType = qFromBigEndian<quint32>(start + 4);
+    if (firstType != kFtyp && firstType != kMoov) {
+        return false;
+    }
+
+    bool haveMovie = false;
+    forEachBox(file, 0, file.size(), [&](const Box& moov) {
+        if (moov.type != kMoov || haveMovie) {
+            return;
+        }
+        forEachBox(file, moov.payload, moov.end, [&](const Box& box) {
+            if (box.type == kMvhd) {
+                readMovieHeader(file, box, info);
+                haveMovie = true;
+            } else if (box.type == kTrak) {
+                forEachBox(file, box.payload, box.end, [&](const Box& child) {
+                    if (child.type == kTkhd) {
+                        readTrackHeader(file, child, info);
+                    }
+                });
+            } else if (box.type == kMeta) {
+                readMeta(file, box, info);
+            } else if (box.type == kUdta) {
+                forEachBox(file, box.payload, box.end, [&](const Box& child) {
+                    if (child.type == kMeta) {
+                        readMeta(file, child, info);
+                    }
+                });
+            }
+        });
+    });
+    return haveMovie;
+}
+
+bool MediaProbe::probeMp3(QFile& file, SongInfo& info) {
+    // An ID3v2 tag or a frame right at the start says this is MPEG audio;
+    // behind a tag the first frame may follow some junk
+    const qint64 tagSize = id3Size(file, 0);
+    const QByteArray window = readAt(file, tagSize, tagSize > 0 ? kMaxSyncScan : 4 + 4096);
+    const qsizetype scan = tagSize > 0 ? window.size() - 4 : qMin<qsizetype>(window.size() - 4, 1);
+
+    // A frame counts when the next one follows it where it should, unless
+    // the window ends first
+    MpegFrame frame;
+    qsizetype start = -1;
+    for (qsizetype i = 0; i < scan && start < 0; ++i) {
+        if (uchar(window[i]) != 0xff || !parseMpegHeader(qFromBigEndian<quint32>(raw(window) + i), frame)) {
+            continue;
+        }
+        const qsizetype next = i + frame.bytes;
+        MpegFrame following;
+        if (next + 4 > window.size() ||
+            (parseMpegHeader(qFromBigEndian<quint32>(raw(window) + next), following) &&
+             following.stream == frame.stream)) {
+            start = i;
+        }
+    }
+    if (start < 0) {
+        return false;
+    }
+
+    if (tagSize > 0) {
+        readId3(file, tagSize, info);
+    }
+    const bool id3v1 = readId3v1(file, info);
+
+    const qint64 frames = vbrFrames(window, start, frame);
+    if (frames > 0) {
+        info.durationMs = frames * frame.samplesPerFrame * 1000 / frame.sampleRate;
+    } else {
+        // Constant bitrate: kbit/s is bits per ms
+        const qint64 audioBytes = file.size() - (tagSize + start) - (id3v1 ? 128 : 0);
+        info.durationMs = qMax<qint64>(0, audioBytes) * 8 / frame.bitrateKbps;
+    }
+    return true;
+}
+
+bool MediaProbe::probeWav(QFile& file, SongInfo& info) {
+    const QByteArray header = readAt(file, 0, 12);
+    if (header.size() != 12 || !header.startsWith("RIFF") || header.mid(8, 4) != "WAVE") {
+        return false;
+    }
+
+    // Chunks are little-endian and padded to an even size
+    quint32 byteRate = 0;
+    qint64 dataBytes = -1;
+    QString albumArtist;
+    qint64 pos = 12;
+    for (int count = 0; count < kMaxBoxes && pos + 8 <= file.size(); ++count) {
+        const QByteArray chunk = readAt(file, pos, 8);
+        if (chunk.size() != 8) {
+            break;
+        }
+        const QByteArray id = chunk.left(4);
+        const qint64 payload = pos + 8;
+        qint64 size = qFromLittleEndian<quint32>(raw(chunk) + 4);
+        if (id == "fmt ") {
+            const QByteArray format = readAt(file, payload, 12);
+            if (format.size() == 12) {
+                byteRate = qFromLittleEndian<quint32>(raw(format) + 8);
+            }
+        } else if (id == "data") {
+            // Streamed files leave the size at 0 or all ones
+            if (size == 0 || size > file.size() - payload) {
+                size = file.size() - payload;
+            }
+            dataBytes = size;
+        } else if (id == "LIST") {
+            const QByteArray list = readAt(file, payload, qMin<qint64>(size, kMaxTagBlockBytes));
+            for (qsizetype item = 4; list.startsWith("INFO") && item + 8 <= list.size();) {
+                const QByteArray itemId = list.mid(item, 4);
+                const qsizetype itemSize = qFromLittleEndian<quint32>(raw(list) + item + 4);
+                const QByteArray value = list.mid(item + 8, qMin<qsizetype>(itemSize, kMaxTagBytes));
+                const QString text = QString::fromUtf8(value.left(value.indexOf('\0')));
+                if (itemId == "INAM") {
+                    setTag(info, albumArtist, QStringLiteral("TITLE"), text);
+                } else if (itemId == "IART") {
+                    setTag(info, albumArtist, QStringLiteral("ARTIST"), text);
+                }
+                item += 8 + itemSize + (itemSize & 1);
+            }
+        }
+        pos = payload + size + (size & 1);
+    }
+    if (byteRate == 0 || dataBytes < 0) {
+        return false;
+    }
+    info.durationMs = dataBytes * 1000 / byteRate;
+    return true;
+}
+
+bool MediaProbe::probeFlac(QFile& file, SongInfo& info) {
+    // Some taggers put an ID3v2 tag before the stream marker
+    qint64 pos = id3Size(file, 0);
+    if (readAt(file, pos, 4) != "fLaC") {
+        return false;
+    }
+    pos += 4;
+
+    // Metadata blocks, each behind a last-block flag, a type and a 24 bit
+    // size; STREAMINFO always comes first
+    bool haveStreamInfo = false;
+    for (int count = 0; count < kMaxBoxes; ++count) {
+        const QByteArray header = readAt(file, pos, 4);
+        if (header.size() != 4) {
+            break;
+        }
+        const uchar* data = raw(header);
+        const bool last = data[0] & 0x80;
+        const int type = data[0] & 0x7f;
+        const qint64 size = qint64(data[1]) << 16 | qint64(data[2]) << 8 | data[3];
+        if (type == 0) {
+            const QByteArray streamInfo = readAt(file, pos + 4, 18);
+            if (streamInfo.size() != 18) {
+                break;
+            }
+            const uchar* stream = raw(streamInfo);
+            const quint32 sampleRate = quint32(stream[10]) << 12 | quint32(stream[11]) << 4 | stream[12] >> 4;
+            const quint64 samples = quint64(stream[13] & 0x0f) << 32 | qFromBigEndian<quint32>(stream + 14);
+            if (sampleRate > 0 && samples > 0) {
+                info.durationMs = qint64(samples * 1000 / sampleRate);
+                haveStreamInfo = true;
+            }
+        } else if (type == 4) {
+            readVorbisComment(readAt(file, pos + 4, qMin<qint64>(size, kMaxTagBlockBytes)), info);
+        }
+        pos += 4 + size;
+        if (last) {
+            break;
+        }
+    }
+    return haveStreamInfo;
+}
+
+bool MediaProbe::probeWithPlayer(const QString& path, SongInfo& info) {
+    return PlayerProbeThread::instance().probe(path, info);
+}
+
+void MediaProbe::nameFromFile(const QString& path, SongInfo& info) {
+    const QString name = QFileInfo(path).completeBaseName();
+    const qsizetype dash = name.indexOf(QStringLiteral(" - "));
+    if (dash > 0 && info.artist.isEmpty()) {
+        info.artist = name.left(dash).trimmed();
+        info.title = name.mid(dash + 3).trimmed();
+    } else {
+        info.title = name;
+    }
+}
@@ -0,0 +1,54 @@
+#ifndef MEDIAPROBE_H
+#define MEDIAPROBE_H
+
+#include <QString>
+
+class QFile;
+struct SongInfo;
+
+// Reads the duration, title, artist and picture size of a media file for
+// the song library.
+//
+// MP4 and QuickTime files, which most karaoke videos are, go through a
+// small ISO base media parser that seeks from box header to box header
+// and reads only mvhd, the tkhd of each track and the iTunes-style tags,
+// a few hundred bytes however large the file. FLAC, WAV and MP3 files get
+// the same treatment from their STREAMINFO block, RIFF chunks and first
+// MPEG frame with its Xing or VBRI header. Anything else is loaded by one
+// QMediaPlayer on a thread of its own, one file at a time, which costs far
+// more. Either way a file without a title tag is named after itself,
+// "Artist - Title" file names being split in two. Safe to call from any
+// thread but the player's.
+class MediaProbe {
+public:
+    static constexpr int kPlayerTimeoutMs = 5000;
+
+    // Fills everything but path and the file stamps; false when the file
+    // could not be read at all
+    static bool probe(const QString& path, SongInfo& info);
+
+    // False if the file is not ISO base media or has no movie header
+    static bool probeMp4(QFile& file, SongInfo& info);
+
+    // Duration from STREAMINFO, tags from the Vorbis comment; false if the
+    // file is not FLAC or does not say how long it is
+    static bool probeFlac(QFile& file, SongInfo& info);
+
+    // Duration from the fmt and data chunks, tags from LIST INFO; false if
+    // the file is not a RIFF WAVE with both
+    static bool probeWav(QFile& file, SongInfo& info);
+
+    // Duration from the Xing/Info or VBRI frame count, or from the size and
+    // bitrate of a constant bitrate stream; tags from ID3v2 or ID3v1. False
+    // if no MPEG audio frame is found where one should start.
+    static bool probeMp3(QFile& file, SongInfo& info);
+
+    // Through Qt Multimedia, false if it cannot load the file in time.
+    // Blocks until the shared player has got to the file.
+    static bool probeWithPlayer(const QString& path, SongInfo& info);
+
+    // Title, and artist if the name has one, from the file name
+    static void nameFromFile(const QString& path, SongInfo& info);
+};
+
+#endif // MEDIAPROBE_H
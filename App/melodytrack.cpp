@@ -0,0 +1,437 @@
+#include "melodytrack.h"
+#include "contourfile.h"
+#include <QDebug>
+#include <QFile>
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+constexpr int kDrumChannel = 9;
+constexpr int kDefaultTempo = 500000; // us per quarter note, 120 bpm
+
+// Sung melodies sit between C3 and C6
+constexpr int kLowestSungNote = 48;
+constexpr int kHighestSungNote = 84;
+
+// Contour frames below this confidence count as unvoiced
+constexpr double kMinContourConfidence = 0.5;
+
+// A note survives a wobble or dropout this long
+constexpr qint64 kContourHoldMs = 30;
+
+struct RawNote {
+    qint64 startTick = 0;
+    qint64 endTick = 0;
+    int pitch = 0;
+};
+
+struct MidiTrack {
+    QString name;
+    QVector<RawNote> notes;
+};
+
+struct TempoChange {
+    qint64 tick = 0;
+    double ms = 0.0;
+    int usPerQuarter = kDefaultTempo;
+};
+
+// Bounds-checked big-endian reader over the file contents
+class MidiReader {
+public:
+    MidiReader(const QByteArray& data, qsizetype begin, qsizetype end) : m_data(data), m_pos(begin), m_end(end) {}
+
+    bool atEnd() const { return m_pos >= m_end; }
+    bool failed() const { return m_failed; }
+    qsizetype position() const { return m_pos; }
+
+    quint8 byte() {
+        if (m_pos >= m_end) {
+            m_failed = true;
+            return 0;
+        }
+        return quint8(m_data[m_pos++]);
+    }
+
+    quint8 peek() const { return m_pos < m_end ? quint8(m_data[m_pos]) : 0; }
+
+    quint32 big(int bytes) {
+        quint32 value = 0;
+        for (int i = 0; i < bytes; ++i) {
+            value = (value << 8) | byte();
+        }
+        return value;
+    }
+
+    // Variable length quantity, at most four bytes
+    quint32 vlq() {
+        quint32 value = 0;
+        for (int i = 0; i < 4; ++i) {
+            const quint8 b = byte();
+            value = (value << 7) | (b & 0x7F);
+            if (!(b & 0x80)) {
+                return value;
+            }
+        }
+        m_failed = true;
+        return value;
+    }
+
+    QByteArray bytes(quint32 count) {
+        if (qsizetype(count) > m_end - m_pos) {
+            m_failed = true;
+            m_pos = m_end;
+            return QByteArray();
+        }
+        const QByteArray result = m_data.mid(m_pos, count);
+        m_pos += count;
+        return result;
+    }
+
+private:
+    const QByteArray& m_data;
+    qsizetype m_pos;
+    qsizetype m_end;
+    bool m_failed = false;
+};
+
+bool parseTrack(MidiReader& reader, MidiTrack& track, QVector<TempoChange>& tempos, QVector<qint64>& lineBreaks) {
+    qint64 tick = 0;
+    quint8 runningStatus = 0;
+    qint64 openNotes[16][128];
+    std::fill(&openNotes[0][0], &openNotes[0][0] + 16 * 128, -1);
+    bool breakPending = false;
+
+    while (!reader.atEnd() && !reader.failed()) {
+        tick += reader.vlq();
+        quint8 status = runningStatus;
+        if (reader.peek() & 0x80) {
+            status = reader.byte();
+        } else if (status == 0) {
+            return false; // data byte without a channel message to repeat
+        }
+
+        if (status == 0xFF) {
+            const quint8 type = reader.byte();
+            const QByteArray data = reader.bytes(reader.vlq());
+            if (type == 0x2F) {
+                break;
+            } else if (type == 0x03 && track.name.isEmpty()) {
+                track.name = QString::fromLatin1(data);
+            } else if (type == 0x51 && data.size() == 3) {
+                TempoChange change;
+                change.tick = tick;
+                change.usPerQuarter = (quint8(data[0]) << 16) | (quint8(data[1]) << 8) | quint8(data[2]);
+                tempos.append(change);
+            } else if ((type == 0x01 || type == 0x05) && !data.isEmpty() && data[0] != '@') {
+                // Karaoke text: '\' starts a paragraph and '/' a line;
+                // lyric events may end a line with a newline instead
+                if (breakPending || data[0] == '\\' || data[0] == '/') {
+                    lineBreaks.append(tick);
+                }
+                breakPending = data.endsWith('\r') || data.endsWith('\n');
+            }
+            continue;
+        }
+        if (status == 0xF0 || status == 0xF7) {
+            reader.bytes(reader.vlq());
+            continue;
+        }
+
+        if (status > 0xEF) {
+            return false; // realtime and common messages do not belong in files
+        }
+
+        // Meta and sysex events should cancel running status, but enough
+        // karaoke files keep using it across lyric events that it is kept
+        runningStatus = status;
+
+        const int kind = status & 0xF0;
+        const int channel = status & 0x0F;
+        const int first = reader.byte() & 0x7F;
+        const int second = (kind == 0xC0 || kind == 0xD0) ? 0 : reader.byte() & 0x7F;
+        if (channel == kDrumChannel || (kind != 0x80 && kind != 0x90)) {
+            continue;
+        }
+
+        qint64& open = openNotes[channel][first];
+        if (open >= 0) {
+            // Note off, or a retrigger that ends the sounding note
+            if (tick > open) {
+                track.notes.append({open, tick, first});
+            }
+            open = -1;
+        }
+        if (kind == 0x90 && second > 0) {
+            open = tick;
+        }
+    }
+    return !reader.failed();
+}
+
+double ticksToMs(qint64 tick, const QVector<TempoChange>& tempos, int ticksPerQuarter) {
+    auto next = std::upper_bound(tempos.begin(), tempos.end(), tick,
+                                 [](qint64 value, const TempoChange& change) { return value < change.tick; });
+    const TempoChange& change = *(next - 1);
+    return change.ms + double(tick - change.tick) * change.usPerQuarter / (1000.0 * ticksPerQuarter);
+}
+
+// Preference for the track that carries the sung line
+double melodyScore(const MidiTrack& track) {
+    if (track.notes.isEmpty()) {
+        return -1.0;
+    }
+    double score = 0.0;
+    const QString name = track.name.toLower();
+    for (const char* hint : {"melody", "melodie", "vocal", "voice", "lead", "sing"}) {
+        if (name.contains(QLatin1String(hint))) {
+            score += 1000.0;
+            break;
+        }
+    }
+
+    QVector<int> pitches;
+    pitches.reserve(track.notes.size());
+    int overlapping = 0;
+    for (qsizetype i = 0; i < track.notes.size(); ++i) {
+        pitches.append(track.notes[i].pitch);
+        if (i + 1 < track.notes.size() && track.notes[i + 1].startTick < track.notes[i].endTick) {
+            ++overlapping;
+        }
+    }
+    std::nth_element(pitches.begin(), pitches.begin() + pitches.size() / 2, pitches.end());
+    const int median = pitches[pitches.size() / 2];
+    if (median >= kLowestSungNote && median <= kHighestSungNote) {
+        score += 50.0;
+    }
+    score += 100.0 * (1.0 - double(overlapping) / track.notes.size());
+    score += std::min<qsizetype>(track.notes.size(), 200) / 10.0;
+    return score;
+}
+
+} // namespace
+
+int MelodyTrack::indexAt(qint64 timeMs) const {
+    auto it = std::upper_bound(m_notes.begin(), m_notes.end(), timeMs,
+                               [](qint64 value, const Note& note) { return value < note.endMs; });
+    return int(it - m_notes.begin());
+}
+
+void MelodyTrack::setNotes(QVector<Note> notes) {
+    std::sort(notes.begin(), notes.end(), [](const Note& a, const Note& b) {
+        return a.startMs != b.startMs ? a.startMs < b.startMs : a.pitch > b.pitch;
+    });
+
+    m_notes.clear();
+    m_notes.reserve(notes.size());
+    for (Note note : notes) {
+        if (note.endMs <= note.startMs) {
+            continue;
+        }
+        // Skyline: where notes overlap the higher one is the melody
+        while (!m_notes.isEmpty() && m_notes.last().endMs > note.startMs && note.pitch > m_notes.last().pitch) {
+            m_notes.last().endMs = note.startMs;
+            if (m_notes.last().endMs > m_notes.last().startMs) {
+                break;
+            }
+            m_notes.removeLast();
+        }
+        if (!m_notes.isEmpty() && m_notes.last().endMs > note.startMs) {
+            note.startMs = m_notes.last().endMs;
+            if (note.startMs >= note.endMs) {
+                continue;
+            }
+        }
+        m_notes.append(note);
+    }
+
+    m_phraseCount = 0;
+    int previous = 0;
+    for (Note& note : m_notes) {
+        if (m_phraseCount == 0 || note.phrase != previous) {
+            previous = note.phrase;
+            ++m_phraseCount;
+        }
+        note.phrase = m_phraseCount - 1;
+    }
+}
+
+bool MelodyTrack::loadMidiFile(const QString& path) {
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        qWarning() << "Cannot open" << path << file.errorString();
+        return false;
+    }
+    const QByteArray data = file.readAll();
+
+    MidiReader header(data, 0, data.size());
+    if (header.bytes(4) != "MThd" || header.big(4) != 6) {
+        qWarning() << path << "is not a Standard MIDI File";
+        return false;
+    }
+    header.big(2); // format 0, 1 and 2 are all read track by track
+    const int trackCount = int(header.big(2));
+    const quint16 division = quint16(header.big(2));
+    if (header.failed() || division == 0) {
+        qWarning() << path << "has a broken MIDI header";
+        return false;
+    }
+
+    QVector<MidiTrack> tracks;
+    QVector<TempoChange> tempos;
+    QVector<qint64> lineBreaks;
+    qsizetype pos = header.position();
+    for (int i = 0; i < trackCount && pos + 8 <= data.size(); ++i) {
+        MidiReader chunk(data, pos, data.size());
+        const QByteArray id = chunk.bytes(4);
+        const qsizetype length = chunk.big(4);
+        const qsizetype begin = chunk.position();
+        const qsizetype end = std::min(begin + length, data.size());
+        pos = end;
+        if (id != "MTrk") {
+            continue; // unknown chunks are skipped, as the standard asks
+        }
+        MidiReader reader(data, begin, end);
+        MidiTrack track;
+        if (!parseTrack(reader, track, tempos, lineBreaks)) {
+            qWarning() << path << "has a broken track" << i;
+            return false;
+        }
+        std::sort(track.notes.begin(), track.notes.end(),
+                  [](const RawNote& a, const RawNote& b) { return a.startTick < b.startTick; });
+        tracks.append(track);
+    }
+
+    const MidiTrack* melody = nullptr;
+    double bestScore = 0.0;
+    for (const MidiTrack& track : tracks) {
+        const double score = melodyScore(track);
+        if (score > bestScore) {
+            bestScore = score;
+            melody = &track;
+        }
+    }
+    if (!melody) {
+        qWarning() << path << "has no melody notes";
+        return false;
+    }
+
+    // SMPTE divisions count frames and subframes; they are turned into an
+    // equivalent fixed tempo
+    int ticksPerQuarter = division;
+    const bool smpte = division & 0x8000;
+    if (smpte) {
+        const int framesPerSecond = -qint8(division >> 8);
+        const int ticksPerFrame = division & 0xFF;
+        ticksPerQuarter = qMax(1, framesPerSecond * ticksPerFrame / 2);
+        tempos.clear();
+    }
+    std::stable_sort(tempos.begin(), tempos.end(),
+                     [](const TempoChange& a, const TempoChange& b) { return a.tick < b.tick; });
+    if (tempos.isEmpty() || tempos.first().tick > 0) {
+        tempos.prepend(TempoChange());
+    }
+    for (qsizetype i = 1; i < tempos.size(); ++i) {
+        const TempoChange& previous = tempos[i - 1];
+        tempos[i].ms = previous.ms + double(tempos[i].tick - previous.tick) * previous.usPerQuarter /
+                                         (1000.0 * ticksPerQuarter);
+    }
+    std::sort(lineBreaks.begin(), lineBreaks.end());
+
+    m_tempoBpm = 0.0;
+    if (!smpte) {
+        const qint64 firstTick = melody->notes.first().startTick;
+        auto next = std::upper_bound(tempos.begin(), tempos.end(), firstTick,
+                                     [](qint64 value, const TempoChange& change) { return value < change.tick; });
+        const int usPerQuarter = (next - 1)->usPerQuarter;
+        if (usPerQuarter > 0) {
+            m_tempoBpm = 60000000.0 / usPerQuarter;
+        }
+    }
+
+    QVector<Note> notes;
+    notes.reserve(melody->notes.size());
+    qint64 previousEndMs = 0;
+    int gapPhrase = 0;
+    for (const RawNote& raw : melody->notes) {
+        Note note;
+        note.startMs = qint64(ticksToMs(raw.startTick, tempos, ticksPerQuarter));
+        note.endMs = qint64(ticksToMs(raw.endTick, tempos, ticksPerQuarter));
+        note.pitch = raw.pitch;
+        if (!lineBreaks.isEmpty()) {
+            // Notes starting a little before the lyric break belong to the new line
+            note.phrase = int(std::upper_bound(lineBreaks.begin(), lineBreaks.end(), raw.startTick + 1) -
+                              lineBreaks.begin());
+        } else {
+            if (!notes.isEmpty() && note.startMs - previousEndMs >= kPhraseGapMs) {
+                ++gapPhrase;
+            }
+            note.phrase = gapPhrase;
+        }
+        previousEndMs = std::max(previousEndMs, note.endMs);
+        notes.append(note);
+    }
+    setNotes(notes);
+    return !m_notes.isEmpty();
+}
+
+bool MelodyTrack::loadContour(const ContourFile& contour) {
+    m_tempoBpm = 0.0;
+    const double hopMs = contour.hopMs();
+    const int holdFrames = qMax(1, int(kContourHoldMs / hopMs));
+    const int count = contour.frameCount();
+
+    QVector<Note> notes;
+    qint64 previousEndMs = 0;
+    int phrase = 0;
+    auto addNote = [&](int startFrame, int endFrame, int pitch) {
+        Note note;
+        note.startMs = qint64(startFrame * hopMs);
+        note.endMs = qint64(endFrame * hopMs);
+        note.pitch = pitch;
+        if (note.endMs - note.startMs < kMinContourNoteMs) {
+            return;
+        }
+        if (!notes.isEmpty() && note.startMs - previousEndMs >= kPhraseGapMs) {
+            ++phrase;
+        }
+        note.phrase = phrase;
+        previousEndMs = note.endMs;
+        notes.append(note);
+    };
+
+    // Frames at the current pitch extend the note; anything else ends it
+    // once it has lasted longer than the hold, and a pitch that outlasted
+    // the hold starts the next note where the old one stopped
+    int pitch = 0;
+    int startFrame = 0;
+    int lastFrame = 0;
+    for (int i = 0; i <= count; ++i) {
+        int current = 0;
+        if (i < count) {
+            const ContourFile::Frame frame = contour.frame(i);
+            if (frame.note > 0.0 && frame.confidence >= kMinContourConfidence) {
+                current = int(std::lround(frame.note));
+            }
+        }
+        if (pitch != 0 && current == pitch) {
+            lastFrame = i;
+            continue;
+        }
+        if (pitch != 0 && i < count && i - lastFrame <= holdFrames) {
+            continue;
+        }
+        if (pitch != 0) {
+            addNote(startFrame, lastFrame + 1, pitch);
+            startFrame = current != 0 ? lastFrame + 1 : i;
+        } else {
+            startFrame = i;
+        }
+        pitch = current;
+        lastFrame = i;
+    }
+
+    setNotes(notes);
+    return !m_notes.isEmpty();
+}
@@ -0,0 +1,61 @@
+#ifndef MELODYTRACK_H
+#define MELODYTRACK_H
+
+#include <QString>
+#include <QVector>
+#include <QtGlobal>
+
+class ContourFile;
+
+// Reference melody of a song: the notes the singer is expected to hit,
+// in song time, grouped into phrases (lyric lines).
+//
+// Notes are sorted by start time and never overlap, so a cursor can walk
+// them in order. indexAt() is the binary search used after a seek.
+class MelodyTrack {
+public:
+    struct Note {
+        qint64 startMs = 0;
+        qint64 endMs = 0;
+        int pitch = 60;  // MIDI note number
+        int phrase = 0;
+    };
+
+    bool isEmpty() const { return m_notes.isEmpty(); }
+    int noteCount() const { return int(m_notes.size()); }
+    int phraseCount() const { return m_phraseCount; }
+    const Note& note(int index) const { return m_notes[index]; }
+    const QVector<Note>& notes() const { return m_notes; }
+
+    // Tempo in effect when the melody starts, 0 when the source has none
+    // (contours, SMPTE-timed MIDI)
+    double tempoBpm() const { return m_tempoBpm; }
+
+    // First note that ends after timeMs, noteCount() if there is none
+    int indexAt(qint64 timeMs) const;
+
+    // Takes notes in any order; overlaps are cut so the highest note
+    // sounding wins, and phrases are renumbered from 0
+    void setNotes(QVector<Note> notes);
+
+    // Melody track of a Standard MIDI File or a .kar karaoke file. The
+    // track is picked by name ("melody", "vocal", ...) or else as the most
+    // monophonic non-drum track in singing range. Lyric line breaks start
+    // new phrases; without lyrics a rest of kPhraseGapMs does.
+    bool loadMidiFile(const QString& path);
+
+    // Notes segmented from an analysed pitch contour, for songs without
+    // MIDI: runs of frames at one steady semitone, at least kMinContourNoteMs
+    // long, with phrases split on kPhraseGapMs rests
+    bool loadContour(const ContourFile& contour);
+
+    static constexpr qint64 kPhraseGapMs = 800;
+    static constexpr qint64 kMinContourNoteMs = 80;
+
+private:
+    QVector<Note> m_notes;
+    int m_phraseCount = 0;
+    double m_tempoBpm = 0.0;
+};
+
+#endif // MELODYTRACK_H
@@ -0,0 +1,69 @@
+#include "micchannel.h"
+#include "audiopassthrough.h"
+#include <QDebug>
+
+MicChannel::MicChannel(int index, const QString& name, AudioMixBus* bus, QObject* parent)
+    : QObject(parent), m_index(index), m_name(name), m_bus(bus) {
+    m_passthrough = new AudioPassthrough(this);
+    m_feedbackSuppressor = new FeedbackSuppressor(this);
+    m_noiseGate = new NoiseGate(this);
+    m_eq = new VoiceEq(this);
+    m_compressor = new Compressor(this);
+
+    m_sourceId = m_bus->addSource(m_passthrough, 1);
+    if (m_sourceId < 0) {
+        qWarning() << "No bus slot for mic" << name;
+        return;
+    }
+
+    // Howl is caught before anything else reacts to it
+    for (AudioProcessor* stage : {static_cast<AudioProcessor*>(m_feedbackSuppressor),
+                                  static_cast<AudioProcessor*>(m_noiseGate), static_cast<AudioProcessor*>(m_eq),
+                                  static_cast<AudioProcessor*>(m_compressor)}) {
+        m_bus->addProcessor(m_sourceId, stage);
+    }
+    m_bus->setSourceSend(m_sourceId, float(m_effectsSend));
+    applyGain();
+}
+
+MicChannel::~MicChannel() {
+    if (m_bus && m_sourceId >= 0) {
+        m_bus->removeSource(m_sourceId);
+    }
+}
+
+void MicChannel::setName(const QString& name) {
+    if (m_name != name) {
+        m_name = name;
+        emit nameChanged();
+    }
+}
+
+void MicChannel::setGain(double gain) {
+    gain = qBound(0.0, gain, 4.0);
+    if (m_gain != gain) {
+        m_gain = gain;
+        applyGain();
+        emit gainChanged();
+    }
+}
+
+void MicChannel::setEffectsSend(double level) {
+    level = qBound(0.0, level, 1.0);
+    if (m_effectsSend != level) {
+        m_effectsSend = level;
+        m_bus->setSourceSend(m_sourceId, float(level));
+        emit effectsSendChanged();
+    }
+}
+
+void MicChannel::setMasterGain(double gain) {
+    if (m_masterGain != gain) {
+        m_masterGain = gain;
+        applyGain();
+    }
+}
+
+void MicChannel::applyGain() {
+    m_bus->setSourceGain(m_sourceId, float(m_gain * m_masterGain));
+}
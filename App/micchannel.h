@@ -0,0 +1,91 @@
+#ifndef MICCHANNEL_H
+#define MICCHANNEL_H
+
+#include <QObject>
+#include <QPointer>
+#include <QString>
+#include "audiomixbus.h"
+#include "compressor.h"
+#include "feedbacksuppressor.h"
+#include "noisegate.h"
+#include "voiceeq.h"
+
+class AudioPassthrough;
+
+// One microphone on the mix bus: its capture ring and its channel strip.
+//
+// Every mic is a mono bus source with its own chain, in the order the
+// mixer of a PA would have it: feedback suppressor, gate, EQ, compressor.
+// The fader (gain) scales the mic in the mix and, being before the send,
+// the share of it that reaches the shared echo and reverb through
+// effectsSend. The mic volume of the mixer scales every mic on top.
+class MicChannel : public QObject {
+    Q_OBJECT
+    Q_PROPERTY(int index READ index CONSTANT)
+    Q_PROPERTY(QString name READ name NOTIFY nameChanged)
+    Q_PROPERTY(double gain READ gain WRITE setGain NOTIFY gainChanged)
+    Q_PROPERTY(double effectsSend READ effectsSend WRITE setEffectsSend NOTIFY effectsSendChanged)
+    Q_PROPERTY(FeedbackSuppressor* feedbackSuppressor READ feedbackSuppressor CONSTANT)
+    Q_PROPERTY(NoiseGate* noiseGate READ noiseGate CONSTANT)
+    Q_PROPERTY(VoiceEq* eq READ eq CONSTANT)
+    Q_PROPERTY(Compressor* compressor READ compressor CONSTANT)
+
+public:
+    // Registers a mono source on the bus with the strip as its chain;
+    // isValid() is false when the bus has no free slot
+    MicChannel(int index, const QString& name, AudioMixBus* bus, QObject* parent = nullptr);
+
+    // Takes the source off the bus, if the bus is still there. Only while
+    // the bus is not being read.
+    ~MicChannel();
+
+    bool isValid() const { return m_sourceId >= 0; }
+
+    int index() const { return m_index; }
+    QString name() const { return m_name; }
+    void setName(const QString& name);
+
+    // Fader, linear, 0 to 4
+    double gain() const { return m_gain; }
+    void setGain(double gain);
+
+    // Level into the send effects, linear, 0 to 1; 1 by default
+    double effectsSend() const { return m_effectsSend; }
+    void setEffectsSend(double level);
+
+    // Volume shared by all mics
+    void setMasterGain(double gain);
+
+    // Where the capture writes this mic
+    AudioPassthrough* passthrough() const { return m_passthrough; }
+    int sourceId() const { return m_sourceId; }
+
+    FeedbackSuppressor* feedbackSuppressor() const { return m_feedbackSuppressor; }
+    NoiseGate* noiseGate() const { return m_noiseGate; }
+    VoiceEq* eq() const { return m_eq; }
+    Compressor* compressor() const { return m_compressor; }
+
+signals:
+    void nameChanged();
+    void gainChanged();
+    void effectsSendChanged();
+
+private:
+    int m_index = 0;
+    QString m_name;
+    QPointer<AudioMixBus> m_bus;
+    AudioPassthrough* m_passthrough = nullptr;
+    int m_sourceId = -1;
+    double m_gain = 1.0;
+    double m_masterGain = 1.0;
+    double m_effectsSend = 1.0;
+
+    FeedbackSuppressor* m_feedbackSuppressor = nullptr;
+    NoiseGate* m_noiseGate = nullptr;
+    VoiceEq* m_eq = nullptr;
+    Compressor* m_compressor = nullptr;
+
+    void applyGain();
+};
+
+#endif // MICCHANNEL_H
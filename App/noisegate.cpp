@@ -0,0 +1,47 @@
+#include "noisegate.h"
+#include <QtGlobal>
+#include <algorithm>
+
+namespace {
+
+// Level detector: short enough to catch the onset of a word
+constexpr double kDetectorMs = 5.0;
+constexpr double kAttackMs = 1.0;
+constexpr double kReleaseMs = 150.0;
+
+} // namespace
+
+NoiseGate::NoiseGate(QObject* parent)
+    : DynamicsProcessor(kDetectorMs, kAttackMs, kReleaseMs, false, parent) {
+}
+
+void NoiseGate::setThresholdDb(double db) {
+    db = qBound(-90.0, db, 0.0);
+    if (m_thresholdDb.exchange(db, std::memory_order_relaxed) != db) {
+        emit parametersChanged();
+    }
+}
+
+void NoiseGate::setRatio(double ratio) {
+    ratio = qBound(1.0, ratio, 100.0);
+    if (m_ratio.exchange(ratio, std::memory_order_relaxed) != ratio) {
+        emit parametersChanged();
+    }
+}
+
+void NoiseGate::setRangeDb(double db) {
+    db = qBound(0.0, db, 90.0);
+    if (m_rangeDb.exchange(db, std::memory_order_relaxed) != db) {
+        emit parametersChanged();
+    }
+}
+
+void NoiseGate::loadParameters() {
+    m_threshold = float(thresholdDb());
+    m_slope = float(ratio() - 1.0);
+    m_floor = float(-rangeDb());
+}
+
+float NoiseGate::gainDb(float levelDb) const {
+    return std::max(m_floor, std::min(0.0f, (levelDb - m_threshold) * m_slope));
+}
@@ -0,0 +1,49 @@
+#ifndef NOISEGATE_H
+#define NOISEGATE_H
+
+#include "dynamicsprocessor.h"
+
+// Downward expander that keeps an idle mic from hissing.
+//
+// Below thresholdDb every dB the level falls takes ratio - 1 dB of gain
+// away, down to at most rangeDb of attenuation; at the default ratio of 4
+// that closes within about 13 dB under the threshold. A high ratio makes
+// it a hard gate, a low one a gentle expander. Attack opens the gate
+// quickly on the first consonant, release closes it slowly enough not to
+// chop the tail of a phrase.
+class NoiseGate : public DynamicsProcessor {
+    Q_OBJECT
+    Q_PROPERTY(double thresholdDb READ thresholdDb WRITE setThresholdDb NOTIFY parametersChanged)
+    Q_PROPERTY(double ratio READ ratio WRITE setRatio NOTIFY parametersChanged)
+    Q_PROPERTY(double rangeDb READ rangeDb WRITE setRangeDb NOTIFY parametersChanged)
+
+public:
+    explicit NoiseGate(QObject* parent = nullptr);
+
+    double thresholdDb() const { return m_thresholdDb.load(std::memory_order_relaxed); }
+    void setThresholdDb(double db);
+
+    // Expansion ratio, 1 (off) to 100 (gate)
+    double ratio() const { return m_ratio.load(std::memory_order_relaxed); }
+    void setRatio(double ratio);
+
+    // Most attenuation applied, in dB (positive)
+    double rangeDb() const { return m_rangeDb.load(std::memory_order_relaxed); }
+    void setRangeDb(double db);
+
+protected:
+    void loadParameters() override;
+    float gainDb(float levelDb) const override;
+
+private:
+    std::atomic<double> m_thresholdDb{-50.0};
+    std::atomic<double> m_ratio{4.0};
+    std::atomic<double> m_rangeDb{40.0};
+
+    // Audio thread copies
+    float m_threshold = -50.0f;
+    float m_slope = 3.0f;
+    float m_floor = -40.0f;
+};
+
+#endif // NOISEGATE_H
@@ -0,0 +1,158 @@
+#include "peaklimiter.h"
+#include <QtGlobal>
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+// The interpolated points lie between frame n - kCentre and the next one
+constexpr int kCentre = PeakLimiter::kTaps / 2;
+
+constexpr float kMinPeak = 1e-9f;
+
+int powerOfTwoAtLeast(int value) {
+    int size = 1;
+    while (size < value) {
+        size <<= 1;
+    }
+    return size;
+}
+
+} // namespace
+
+PeakLimiter::PeakLimiter(QObject* parent) : AudioProcessor(parent) {
+    // Blackman-windowed sinc at the original Nyquist, each phase
+    // normalised to unity gain at DC
+    for (int phase = 1; phase < kPhases; ++phase) {
+        float* taps = m_phaseTaps[phase - 1];
+        double sum = 0.0;
+        for (int tap = 0; tap < kTaps; ++tap) {
+            const double t = kCentre - tap - double(phase) / kPhases;
+            const double sinc = std::sin(M_PI * t) / (M_PI * t);
+            const double x = t / kTaps;
+            const double window = 0.42 + 0.5 * std::cos(2.0 * M_PI * x) + 0.08 * std::cos(4.0 * M_PI * x);
+            taps[tap] = float(sinc * window);
+            sum += taps[tap];
+        }
+        for (int tap = 0; tap < kTaps; ++tap) {
+            taps[tap] = float(taps[tap] / sum);
+        }
+    }
+}
+
+void PeakLimiter::setCeilingDb(double db) {
+    db = qBound(-24.0, db, 0.0);
+    if (m_ceilingDb.exchange(db, std::memory_order_relaxed) != db) {
+        emit parametersChanged();
+    }
+}
+
+void PeakLimiter::setReleaseMs(double ms) {
+    ms = qBound(1.0, ms, 2000.0);
+    if (m_releaseMs.exchange(ms, std::memory_order_relaxed) != ms) {
+        emit parametersChanged();
+    }
+}
+
+void PeakLimiter::prepareBuffers() {
+    m_windowFrames = qMax(1, int(std::lround(kLookaheadMs * m_sampleRate / 1000.0)));
+    m_delayFrames = m_windowFrames + kCentre - 1;
+
+    m_planar.assign(size_t(m_channelCount), std::vector<float>(size_t(kTaps - 1 + m_maxFrames), 0.0f));
+    m_peaks.assign(size_t(m_maxFrames), 0.0f);
+
+    const int delaySize = powerOfTwoAtLeast(m_delayFrames + 1);
+    m_delay.assign(size_t(delaySize) * m_channelCount, 0.0f);
+    m_delayMask = delaySize - 1;
+
+    const int minSize = powerOfTwoAtLeast(m_windowFrames + 2);
+    m_minGain.assign(size_t(minSize), 1.0f);
+    m_minFrame.assign(size_t(minSize), 0);
+    m_minMask = minSize - 1;
+
+    m_average.assign(size_t(m_windowFrames), 1.0f);
+    reset();
+}
+
+void PeakLimiter::reset() {
+    for (std::vector<float>& channel : m_planar) {
+        std::fill(channel.begin(), channel.end(), 0.0f);
+    }
+    std::fill(m_delay.begin(), m_delay.end(), 0.0f);
+    m_delayWrite = 0;
+    m_minHead = m_minTail = 0;
+    m_frame = 0;
+    m_released = 1.0f;
+    std::fill(m_average.begin(), m_average.end(), 1.0f);
+    m_averageWrite = 0;
+    m_averageSum = m_windowFrames;
+    m_gainReductionDb.store(0.0f, std::memory_order_relaxed);
+}
+
+void PeakLimiter::process(float* data, int frames) {
+    const int channels = m_channelCount;
+    const float ceiling = float(std::pow(10.0, ceilingDb() / 20.0));
+    const float release = float(std::exp(-1000.0 / (releaseMs() * m_sampleRate)));
+
+    // True peak of every frame, over all channels
+    std::fill_n(m_peaks.begin(), frames, 0.0f);
+    for (int channel = 0; channel < channels; ++channel) {
+        float* planar = m_planar[channel].data();
+        for (int frame = 0; frame < frames; ++frame) {
+            planar[kTaps - 1 + frame] = data[frame * channels + channel];
+        }
+        for (int frame = 0; frame < frames; ++frame) {
+            // planar[frame + kTaps - 1 - tap] is input frame n - tap
+            const float* newest = planar + frame + kTaps - 1;
+            float peak = std::abs(newest[-kCentre]);
+            for (int phase = 0; phase < kPhases - 1; ++phase) {
+                const float* taps = m_phaseTaps[phase];
+                float sum = 0.0f;
+                for (int tap = 0; tap < kTaps; ++tap) {
+                    sum += taps[tap] * newest[-tap];
+                }
+                peak = std::max(peak, std::abs(sum));
+            }
+            m_peaks[frame] = std::max(m_peaks[frame], peak);
+        }
+        std::copy(planar + frames, planar + frames + kTaps - 1, planar);
+    }
+
+    float lowest = 1.0f;
+    const long long window = m_windowFrames + 1;
+    for (int frame = 0; frame < frames; ++frame, ++m_frame) {
+        const float wanted = std::min(1.0f, ceiling / std::max(m_peaks[frame], kMinPeak));
+
+        // Lowest wanted gain of the last window frames
+        while (m_minHead != m_minTail && m_minGain[(m_minTail - 1) & m_minMask] >= wanted) {
+            m_minTail = (m_minTail - 1) & m_minMask;
+        }
+        m_minGain[m_minTail] = wanted;
+        m_minFrame[m_minTail] = m_frame;
+        m_minTail = (m_minTail + 1) & m_minMask;
+        if (m_minFrame[m_minHead] <= m_frame - window) {
+            m_minHead = (m_minHead + 1) & m_minMask;
+        }
+        const float held = m_minGain[m_minHead];
+
+        // Instant attack to the held gain, exponential release, then the
+        // average over the window smooths the attack into a ramp that
+        // arrives with the peak
+        m_released = std::min(held, held + release * (m_released - held));
+        m_averageSum += m_released - m_average[m_averageWrite];
+        m_average[m_averageWrite] = m_released;
+        m_averageWrite = m_averageWrite + 1 == m_windowFrames ? 0 : m_averageWrite + 1;
+        const float gain = std::min(1.0f, float(m_averageSum / m_windowFrames));
+        lowest = std::min(lowest, gain);
+
+        float* slot = m_delay.data() + size_t(m_delayWrite) * channels;
+        const float* delayed = m_delay.data() + size_t((m_delayWrite - m_delayFrames) & m_delayMask) * channels;
+        for (int channel = 0; channel < channels; ++channel) {
+            slot[channel] = data[frame * channels + channel];
+            data[frame * channels + channel] = delayed[channel] * gain;
+        }
+        m_delayWrite = (m_delayWrite + 1) & m_delayMask;
+    }
+
+    m_gainReductionDb.store(std::max(0.0f, -20.0f * std::log10(lowest)), std::memory_order_relaxed);
+}
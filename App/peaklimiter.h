@@ -0,0 +1,94 @@
+#ifndef PEAKLIMITER_H
+#define PEAKLIMITER_H
+
+#include <atomic>
+#include <vector>
+#include "audioprocessor.h"
+
+// Lookahead true-peak limiter for the output bus.
+//
+// Without it, anything the mix pushes past full scale is hard-clipped on
+// conversion to Int16. The limiter estimates the true (inter-sample) peak
+// of every frame with a 4x, 12 taps per phase interpolator, like a
+// BS.1770 meter, and computes the gain that keeps it under ceilingDb.
+// Sample peaks never pass the ceiling; inter-sample peaks of broadband
+// material driven far into the limiter can end up about half a dB over
+// it, which is what the interpolator under-reads. The audio is
+// delayed by kLookaheadMs, during which the gain is held at the lowest
+// value needed anywhere in the window and then averaged over the window,
+// so it has reached that value by the time the peak comes out, without a
+// step. After the peak the gain recovers with releaseMs.
+//
+// The interpolator runs on planar copies of the block, a fixed-length dot
+// product per phase that vectorises; the minimum and the average are
+// running ones, O(1) per frame.
+class PeakLimiter : public AudioProcessor {
+    Q_OBJECT
+    Q_PROPERTY(double ceilingDb READ ceilingDb WRITE setCeilingDb NOTIFY parametersChanged)
+    Q_PROPERTY(double releaseMs READ releaseMs WRITE setReleaseMs NOTIFY parametersChanged)
+
+public:
+    static constexpr double kLookaheadMs = 1.5;
+    static constexpr int kPhases = 4;
+    static constexpr int kTaps = 12;
+
+    explicit PeakLimiter(QObject* parent = nullptr);
+
+    // Highest true peak let through, in dBFS
+    double ceilingDb() const { return m_ceilingDb.load(std::memory_order_relaxed); }
+    void setCeilingDb(double db);
+
+    double releaseMs() const { return m_releaseMs.load(std::memory_order_relaxed); }
+    void setReleaseMs(double ms);
+
+    // Largest gain reduction in the latest block, in dB (0 or positive).
+    // Safe from any thread, for meters.
+    Q_INVOKABLE double gainReductionDb() const { return m_gainReductionDb.load(std::memory_order_relaxed); }
+
+    int latencyFrames() const override { return m_delayFrames; }
+    void reset() override;
+
+signals:
+    void parametersChanged();
+
+protected:
+    void prepareBuffers() override;
+    void process(float* data, int frames) override;
+
+private:
+    std::atomic<double> m_ceilingDb{-1.0};
+    std::atomic<double> m_releaseMs{60.0};
+    std::atomic<float> m_gainReductionDb{0.0f};
+
+    // Interpolation phases 1 to 3; phase 0 is the sample itself
+    float m_phaseTaps[kPhases - 1][kTaps] = {};
+
+    int m_windowFrames = 0;   // lookahead: min and average window
+    int m_delayFrames = 0;    // window plus the interpolator's delay
+
+    // Per channel: kTaps - 1 frames of history followed by the block
+    std::vector<std::vector<float>> m_planar;
+    std::vector<float> m_peaks;     // per frame of the block
+
+    // Audio delay, interleaved, power-of-two frames
+    std::vector<float> m_delay;
+    int m_delayMask = 0;
+    int m_delayWrite = 0;
+
+    // Running minimum of the wanted gain over m_windowFrames + 1 frames,
+    // as a monotonic queue of (gain, frame) in a ring
+    std::vector<float> m_minGain;
+    std::vector<long long> m_minFrame;
+    int m_minMask = 0;
+    int m_minHead = 0;
+    int m_minTail = 0;
+    long long m_frame = 0;
+
+    // Released gain and its running average over m_windowFrames
+    float m_released = 1.0f;
+    std::vector<float> m_average;
+    int m_averageWrite = 0;
+    double m_averageSum = 0.0;
+};
+
+#endif // PEAKLIMITER_H
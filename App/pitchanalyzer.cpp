@@ -0,0 +1,46 @@
+#include "pitchanalyzer.h"
+
+namespace {
+
+// About 2.5 s of estimates, plenty for a consumer polling every 20 ms
+constexpr int kQueueCapacity = 256;
+
+} // namespace
+
+PitchAnalyzer::PitchAnalyzer(QObject* parent) : AudioProcessor(parent) {
+}
+
+int PitchAnalyzer::takeEstimates(Estimate* estimates, int maxCount) {
+    return int(m_estimates.read(estimates, size_t(maxCount)));
+}
+
+void PitchAnalyzer::prepareBuffers() {
+    m_tracker.configure(m_sampleRate, 2048, YinPitchTracker::hopForInterval(m_sampleRate, kHopMs));
+    m_mono.assign(size_t(qMax(1, m_maxFrames)), 0.0f);
+    m_estimates.reset(kQueueCapacity);
+    reset();
+}
+
+void PitchAnalyzer::reset() {
+    m_tracker.reset();
+    m_framesAnalyzed.store(0, std::memory_order_release);
+}
+
+void PitchAnalyzer::process(float* data, int frames) {
+    const float* input = data;
+    if (m_channelCount > 1) {
+        for (int frame = 0; frame < frames; ++frame) {
+            m_mono[frame] = data[frame * m_channelCount];
+        }
+        input = m_mono.data();
+    }
+
+    // Counted before the block's estimates are queued, so a consumer that
+    // reads framesAnalyzed() after taking an estimate never sees it ahead
+    m_framesAnalyzed.fetch_add(frames, std::memory_order_release);
+    m_tracker.process(input, frames, [this](const Estimate& estimate) {
+        if (m_estimates.write(&estimate, 1) == 0) {
+            m_dropped.fetch_add(1, std::memory_order_relaxed);
+        }
+    });
+}
@@ -0,0 +1,53 @@
+#ifndef PITCHANALYZER_H
+#define PITCHANALYZER_H
+
+#include <QtGlobal>
+#include <atomic>
+#include <vector>
+#include "audioprocessor.h"
+#include "spscringbuffer.h"
+#include "yinpitchtracker.h"
+
+// Pitch of the singer for scoring, tracked on the mic chain.
+//
+// An analysis-only stage: the audio passes through untouched, every 10 ms
+// a YIN estimate of the first channel is queued in a lock-free ring for
+// the GUI thread. Estimates carry their position in the analysed stream,
+// and framesAnalyzed() gives the current position, so the consumer can
+// tell how old each estimate is when it picks it up. Read the position
+// after taking the estimates: it then covers every one of them.
+class PitchAnalyzer : public AudioProcessor {
+    Q_OBJECT
+
+public:
+    using Estimate = YinPitchTracker::Estimate;
+
+    static constexpr double kHopMs = 10.0;
+
+    explicit PitchAnalyzer(QObject* parent = nullptr);
+
+    // Consumer side: moves up to maxCount queued estimates into estimates
+    int takeEstimates(Estimate* estimates, int maxCount);
+
+    // Frames seen by process() since the last prepare
+    qint64 framesAnalyzed() const { return m_framesAnalyzed.load(std::memory_order_acquire); }
+    int hopFrames() const { return m_tracker.hopFrames(); }
+
+    // Estimates lost because nobody was taking them
+    int droppedEstimates() const { return m_dropped.load(std::memory_order_relaxed); }
+
+    void reset() override;
+
+protected:
+    void prepareBuffers() override;
+    void process(float* data, int frames) override;
+
+private:
+    YinPitchTracker m_tracker;
+    std::vector<float> m_mono;
+    SpscRingBuffer<Estimate> m_estimates;
+    std::atomic<qint64> m_framesAnalyzed{0};
+    std::atomic<int> m_dropped{0};
+};
+
+#endif // PITCHANALYZER_H
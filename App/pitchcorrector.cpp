@@ -0,0 +1,245 @@
+#include "pitchcorrector.h"
+#include <QtGlobal>
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+// Semitones of each scale relative to the key, one bit per pitch class
+constexpr quint16 kScaleMasks[] = {
+    0x0FFF,                                                               // Chromatic
+    (1 << 0) | (1 << 2) | (1 << 4) | (1 << 5) | (1 << 7) | (1 << 9) | (1 << 11), // Major
+    (1 << 0) | (1 << 2) | (1 << 3) | (1 << 5) | (1 << 7) | (1 << 8) | (1 << 10), // Natural minor
+    (1 << 0) | (1 << 2) | (1 << 4) | (1 << 7) | (1 << 9),                 // Major pentatonic
+    (1 << 0) | (1 << 3) | (1 << 5) | (1 << 7) | (1 << 10),                // Minor pentatonic
+};
+
+// YIN setup: the window covers two periods of the lowest note, the hop
+// gives a fresh estimate every ~6 ms
+constexpr int kTrackerWindow = 1536;
+constexpr int kTrackerHop = 256;
+
+// Estimates below this confidence leave the voice uncorrected
+constexpr double kMinConfidence = 0.8;
+
+// A note held this long gets the full humanize slowdown
+constexpr double kHeldNoteMs = 300.0;
+
+inline double midiNote(double frequency) {
+    return 69.0 + 12.0 * std::log2(frequency / 440.0);
+}
+
+// 4-point, third order Hermite interpolation between x1 and x2
+inline float hermite(float x0, float x1, float x2, float x3, float t) {
+    const float c1 = 0.5f * (x2 - x0);
+    const float c2 = x0 - 2.5f * x1 + 2.0f * x2 - 0.5f * x3;
+    const float c3 = 0.5f * (x3 - x0) + 1.5f * (x1 - x2);
+    return ((c3 * t + c2) * t + c1) * t + x1;
+}
+
+} // namespace
+
+PitchCorrector::PitchCorrector(QObject* parent) : AudioProcessor(parent) {
+}
+
+void PitchCorrector::setKey(int key) {
+    key = ((key % 12) + 12) % 12;
+    if (m_key.exchange(key, std::memory_order_relaxed) != key) {
+        emit keyChanged();
+    }
+}
+
+void PitchCorrector::setScale(Scale scale) {
+    if (m_scale.exchange(scale, std::memory_order_relaxed) != scale) {
+        emit scaleChanged();
+    }
+}
+
+void PitchCorrector::setSpeed(double speed) {
+    speed = qBound(0.0, speed, 1.0);
+    if (m_speed.exchange(speed, std::memory_order_relaxed) != speed) {
+        emit speedChanged();
+    }
+}
+
+void PitchCorrector::setHumanize(double humanize) {
+    humanize = qBound(0.0, humanize, 1.0);
+    if (m_humanize.exchange(humanize, std::memory_order_relaxed) != humanize) {
+        emit humanizeChanged();
+    }
+}
+
+double PitchCorrector::nearestNoteFrequency(double frequency, int key, Scale scale) {
+    if (frequency <= 0.0) {
+        return 0.0;
+    }
+    const quint16 mask = kScaleMasks[qBound(0, int(scale), int(MinorPentatonic))];
+    const double note = midiNote(frequency);
+    const int nearest = int(std::lround(note));
+
+    // Widen the search around the nearest semitone until a scale note turns up
+    int best = nearest;
+    double bestDistance = 1e9;
+    for (int offset = 0; offset <= 6; ++offset) {
+        for (int candidate : {nearest - offset, nearest + offset}) {
+            const int pitchClass = ((candidate - key) % 12 + 12) % 12;
+            const double distance = std::abs(candidate - note);
+            if ((mask & (1 << pitchClass)) && distance < bestDistance) {
+                best = candidate;
+                bestDistance = distance;
+            }
+        }
+        if (bestDistance < 1e9) {
+            break;
+        }
+    }
+    return 440.0 * std::exp2((best - 69) / 12.0);
+}
+
+void PitchCorrector::prepareBuffers() {
+    m_tracker.configure(m_sampleRate, kTrackerWindow, kTrackerHop, kMinFrequency, kMaxFrequency);
+    m_mono.assign(size_t(qMax(1, m_maxFrames)), 0.0f);
+
+    // Longest tap plus the fade overshoot and one block of writes
+    const int longestDelay = kMinDelay + int(std::ceil(m_sampleRate / kMinFrequency)) + kMaxFadeFrames;
+    int frames = 1;
+    while (frames < longestDelay + m_maxFrames + 4) {
+        frames <<= 1;
+    }
+    m_delay.assign(size_t(frames) * m_channelCount, 0.0f);
+    m_delayMask = frames - 1;
+    reset();
+}
+
+void PitchCorrector::reset() {
+    m_tracker.reset();
+    std::fill(m_delay.begin(), m_delay.end(), 0.0f);
+    m_writeFrame = 0;
+    m_targetCents = 0.0;
+    m_currentCents = 0.0;
+    m_period = 0.0;
+    m_heldNote = -1;
+    m_heldFrames = 0;
+    m_tapDelay = kMinDelay;
+    m_fading = false;
+    m_appliedCents.store(0.0, std::memory_order_relaxed);
+    m_latencyFrames.store(kMinDelay, std::memory_order_relaxed);
+}
+
+void PitchCorrector::updateTarget(const YinPitchTracker::Estimate& estimate) {
+    if (!estimate.voiced || estimate.confidence < kMinConfidence) {
+        // Breaths and consonants pass through unshifted
+        m_targetCents = 0.0;
+        m_heldNote = -1;
+        m_heldFrames = 0;
+        return;
+    }
+
+    const double target = nearestNoteFrequency(estimate.frequency, key(), scale());
+    m_targetCents = 1200.0 * std::log2(target / estimate.frequency);
+    m_period = m_sampleRate / estimate.frequency;
+    m_detectedFrequency.store(estimate.frequency, std::memory_order_relaxed);
+
+    const int note = int(std::lround(midiNote(target)));
+    if (note == m_heldNote) {
+        m_heldFrames += m_tracker.hopFrames();
+    } else {
+        m_heldNote = note;
+        m_heldFrames = 0;
+    }
+}
+
+void PitchCorrector::startSplice(double newDelay) {
+    // Short enough to finish long before the new tap reaches the far edge
+    const int fadeFrames = qBound(16, int(m_period / 4.0), kMaxFadeFrames);
+    m_fadeDelay = newDelay;
+    m_fadeGain = 0.0;
+    m_fadeStep = 1.0 / fadeFrames;
+    m_fading = true;
+}
+
+float PitchCorrector::tap(double delay, int channel) const {
+    const double position = double(m_writeFrame) - delay;
+    const double base = std::floor(position);
+    const float t = float(position - base);
+    const int index = int(base);
+    const int channels = m_channelCount;
+    const float* line = m_delay.data();
+    const float x0 = line[((index - 1) & m_delayMask) * channels + channel];
+    const float x1 = line[(index & m_delayMask) * channels + channel];
+    const float x2 = line[((index + 1) & m_delayMask) * channels + channel];
+    const float x3 = line[((index + 2) & m_delayMask) * channels + channel];
+    return hermite(x0, x1, x2, x3, t);
+}
+
+void PitchCorrector::process(float* data, int frames) {
+    const int channels = m_channelCount;
+
+    // Track the first channel
+    for (int frame = 0; frame < frames; ++frame) {
+        m_mono[frame] = data[frame * channels];
+    }
+    m_tracker.process(m_mono.data(), frames,
+                      [this](const YinPitchTracker::Estimate& estimate) { updateTarget(estimate); });
+
+    // Glide toward the target once per block; humanize stretches the glide
+    // the longer a note is held
+    const double blockMs = 1000.0 * frames / m_sampleRate;
+    const double held = qMin(1.0, (1000.0 * m_heldFrames / m_sampleRate) / kHeldNoteMs);
+    const double retuneMs = (1.0 - speed()) * kMaxRetuneMs * (1.0 + 3.0 * humanize() * held);
+    const double alpha = retuneMs <= 0.0 ? 1.0 : 1.0 - std::exp(-blockMs / retuneMs);
+    m_currentCents += alpha * (m_targetCents - m_currentCents);
+    m_appliedCents.store(m_currentCents, std::memory_order_relaxed);
+
+    // Reading at ratio x the write speed changes the delay by 1 - ratio per frame
+    const double ratio = std::exp2(m_currentCents / 1200.0);
+    const double drift = 1.0 - ratio;
+    const double period = m_period > 0.0 ? qMin(m_period, m_sampleRate / kMinFrequency) : 0.0;
+    const double maxDelay = kMinDelay + (period > 0.0 ? period : 0.0);
+    m_latencyFrames.store(int(kMinDelay + period / 2.0), std::memory_order_relaxed);
+
+    for (int frame = 0; frame < frames; ++frame) {
+        float* sample = data + frame * channels;
+        float* line = m_delay.data() + size_t(m_writeFrame & m_delayMask) * channels;
+        for (int channel = 0; channel < channels; ++channel) {
+            line[channel] = sample[channel];
+        }
+
+        if (m_fading) {
+            const float gain = float(m_fadeGain);
+            for (int channel = 0; channel < channels; ++channel) {
+                sample[channel] = (1.0f - gain) * tap(m_tapDelay, channel) + gain * tap(m_fadeDelay, channel);
+            }
+            m_fadeGain += m_fadeStep;
+            m_fadeDelay += drift;
+            if (m_fadeGain >= 1.0) {
+                m_tapDelay = m_fadeDelay;
+                m_fading = false;
+            }
+        } else {
+            for (int channel = 0; channel < channels; ++channel) {
+                sample[channel] = tap(m_tapDelay, channel);
+            }
+        }
+        m_tapDelay += drift;
+        ++m_writeFrame;
+
+        if (m_fading) {
+            continue;
+        }
+        if (period > 0.0) {
+            // Jump by one pitch period so the splice is in phase
+            if (m_tapDelay < kMinDelay) {
+                startSplice(m_tapDelay + period);
+            } else if (m_tapDelay > maxDelay) {
+                startSplice(m_tapDelay - period);
+            }
+        } else if (m_tapDelay < kMinDelay || m_tapDelay > kMinDelay + kMaxFadeFrames) {
+            // No period yet: plain crossfade back to the shortest delay
+            startSplice(kMinDelay);
+        }
+    }
+
+    // Keep the counter small, the mask does the wrapping
+    m_writeFrame &= m_delayMask;
+}
@@ -0,0 +1,109 @@
+#ifndef PITCHCORRECTOR_H
+#define PITCHCORRECTOR_H
+
+#include <atomic>
+#include <vector>
+#include "audioprocessor.h"
+#include "yinpitchtracker.h"
+
+// Real-time vocal pitch correction, the engine version of ref/AutoTune.ino.
+//
+// YIN tracks the singer, the nearest note of the selected key and scale
+// becomes the target, and the correction glides toward it at a rate set
+// by speed. The voice is repitched by reading a short delay line at
+// `ratio` times the write speed. Whenever the read tap drifts out of its
+// window it is moved by exactly one detected pitch period and crossfaded,
+// so each splice lands on the same point of the waveform (pitch-synchronous
+// overlap-add on a delay line, as in time-domain PSOLA).
+//
+// The tap window is [kMinDelay, kMinDelay + period], so the added delay is
+// at most kMinDelay plus one period of kMinFrequency: under 15 ms at
+// 44.1 and 48 kHz, and around 5 ms for a typical singing voice.
+class PitchCorrector : public AudioProcessor {
+    Q_OBJECT
+    Q_PROPERTY(int key READ key WRITE setKey NOTIFY keyChanged)
+    Q_PROPERTY(Scale scale READ scale WRITE setScale NOTIFY scaleChanged)
+    Q_PROPERTY(double speed READ speed WRITE setSpeed NOTIFY speedChanged)
+    Q_PROPERTY(double humanize READ humanize WRITE setHumanize NOTIFY humanizeChanged)
+
+public:
+    enum Scale { Chromatic, Major, Minor, MajorPentatonic, MinorPentatonic };
+    Q_ENUM(Scale)
+
+    static constexpr double kMinFrequency = 80.0;
+    static constexpr double kMaxFrequency = 1000.0;
+    static constexpr double kMaxRetuneMs = 200.0;
+    static constexpr int kMinDelay = 68;
+    static constexpr int kMaxFadeFrames = 64;
+
+    explicit PitchCorrector(QObject* parent = nullptr);
+
+    // Tonic as a pitch class, 0 = C ... 11 = B
+    int key() const { return m_key.load(std::memory_order_relaxed); }
+    void setKey(int key);
+
+    Scale scale() const { return Scale(m_scale.load(std::memory_order_relaxed)); }
+    void setScale(Scale scale);
+
+    // 1 snaps to the note at once, 0 glides over kMaxRetuneMs
+    double speed() const { return m_speed.load(std::memory_order_relaxed); }
+    void setSpeed(double speed);
+
+    // Slows the correction down on held notes so vibrato and drift survive
+    double humanize() const { return m_humanize.load(std::memory_order_relaxed); }
+    void setHumanize(double humanize);
+
+    // Last voiced pitch and the correction currently applied, for meters
+    Q_INVOKABLE double detectedFrequency() const { return m_detectedFrequency.load(std::memory_order_relaxed); }
+    Q_INVOKABLE double correctionCents() const { return m_appliedCents.load(std::memory_order_relaxed); }
+
+    int latencyFrames() const override { return m_latencyFrames.load(std::memory_order_relaxed); }
+    void reset() override;
+
+    // Closest note of the key and scale to frequency, in Hz
+    static double nearestNoteFrequency(double frequency, int key, Scale scale);
+
+signals:
+    void keyChanged();
+    void scaleChanged();
+    void speedChanged();
+    void humanizeChanged();
+
+protected:
+    void prepareBuffers() override;
+    void process(float* data, int frames) override;
+
+private:
+    std::atomic<int> m_key{0};
+    std::atomic<int> m_scale{Chromatic};
+    std::atomic<double> m_speed{0.8};
+    std::atomic<double> m_humanize{0.0};
+    std::atomic<double> m_detectedFrequency{0.0};
+    std::atomic<double> m_appliedCents{0.0};
+    std::atomic<int> m_latencyFrames{kMinDelay};
+
+    // Detection
+    YinPitchTracker m_tracker;
+    std::vector<float> m_mono;
+    double m_targetCents = 0.0;
+    double m_currentCents = 0.0;
+    double m_period = 0.0;      // frames, 0 until the first voiced estimate
+    int m_heldNote = -1;
+    int m_heldFrames = 0;
+
+    // Delay line, interleaved, power-of-two frames
+    std::vector<float> m_delay;
+    int m_delayMask = 0;
+    int m_writeFrame = 0;
+    double m_tapDelay = kMinDelay;
+    double m_fadeDelay = 0.0;
+    double m_fadeGain = 0.0;
+    double m_fadeStep = 0.0;
+    bool m_fading = false;
+
+    void updateTarget(const YinPitchTracker::Estimate& estimate);
+    void startSplice(double newDelay);
+    float tap(double delay, int channel) const;
+};
+
+#endif // PITCHCORRECTOR_H
@@ -0,0 +1,192 @@
+#include "pitchshifter.h"
+#include <QtGlobal>
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+constexpr double kCorrelationMs = 5.0;
+constexpr double kSearchMs = 12.0;
+constexpr double kWindowMs = 30.0;
+
+// A transpose change reaches its new ratio over about this long
+constexpr double kGlideMs = 30.0;
+
+inline float hermite(float x0, float x1, float x2, float x3, float t) {
+    const float c1 = 0.5f * (x2 - x0);
+    const float c2 = x0 - 2.5f * x1 + 2.0f * x2 - 0.5f * x3;
+    const float c3 = 0.5f * (x3 - x0) + 1.5f * (x1 - x2);
+    return ((c3 * t + c2) * t + c1) * t + x1;
+}
+
+} // namespace
+
+PitchShifter::PitchShifter(QObject* parent)
+    : AudioProcessor(parent), m_ratio(1.0f, SmoothedParameter::Exponential, kGlideMs) {
+    registerParameter(&m_ratio);
+}
+
+void PitchShifter::setSemitones(int semitones) {
+    semitones = qBound(kMinSemitones, semitones, kMaxSemitones);
+    m_ratio.set(float(std::exp2(semitones / 12.0)));
+    if (m_semitones.exchange(semitones, std::memory_order_relaxed) != semitones) {
+        emit semitonesChanged();
+    }
+}
+
+int PitchShifter::latencyFrames() const {
+    return (m_minDelay + m_maxDelay) / 2;
+}
+
+void PitchShifter::prepareBuffers() {
+    m_correlationFrames = qMax(32, int(kCorrelationMs * m_sampleRate / 1000.0));
+    m_searchFrames = qMax(64, int(kSearchMs * m_sampleRate / 1000.0));
+
+    // The tap must stay far enough behind the write position for the audio
+    // ahead of it to exist when a splice is searched
+    m_minDelay = m_correlationFrames + 4;
+    m_maxDelay = m_minDelay + qMax(m_searchFrames * 2, int(kWindowMs * m_sampleRate / 1000.0));
+
+    // Room for the longest tap, the crossfade overshoot and a block
+    int frames = 1;
+    while (frames < m_maxDelay + 2 * m_correlationFrames + m_maxFrames + 4) {
+        frames <<= 1;
+    }
+    m_delay.assign(size_t(frames) * m_channelCount, 0.0f);
+    m_delayMask = frames - 1;
+
+    m_reference.assign(size_t(m_correlationFrames), 0.0f);
+    m_candidates.assign(size_t(m_searchFrames + m_correlationFrames), 0.0f);
+    reset();
+}
+
+void PitchShifter::reset() {
+    std::fill(m_delay.begin(), m_delay.end(), 0.0f);
+    m_writeFrame = 0;
+    m_ratio.snap();
+    m_tapDelay = (m_minDelay + m_maxDelay) / 2.0;
+    m_fading = false;
+}
+
+float PitchShifter::sample(int frame, int channel) const {
+    return m_delay[size_t(frame & m_delayMask) * m_channelCount + channel];
+}
+
+float PitchShifter::mono(int frame) const {
+    const float* line = m_delay.data() + size_t(frame & m_delayMask) * m_channelCount;
+    float sum = 0.0f;
+    for (int channel = 0; channel < m_channelCount; ++channel) {
+        sum += line[channel];
+    }
+    return sum;
+}
+
+float PitchShifter::tap(double delay, int channel) const {
+    const double position = double(m_writeFrame) - delay;
+    const double base = std::floor(position);
+    const int index = int(base);
+    const float t = float(position - base);
+    return hermite(sample(index - 1, channel), sample(index, channel), sample(index + 1, channel),
+                   sample(index + 2, channel), t);
+}
+
+double PitchShifter::findSplice(double fromDelay, int lowestDelay) {
+    // Integer jumps keep the fractional tap position, so the comparison at
+    // whole frames is exact relative to the tap
+    const int from = int(std::floor(fromDelay));
+    const int length = m_correlationFrames;
+    const int start = m_writeFrame - from;
+    for (int i = 0; i < length; ++i) {
+        m_reference[i] = mono(start + i);
+    }
+
+    // Candidate delays lowestDelay .. lowestDelay + searchFrames, the
+    // longest delay reads the oldest audio
+    const int highestDelay = lowestDelay + m_searchFrames;
+    const int oldest = m_writeFrame - highestDelay;
+    const int span = m_searchFrames + length;
+    for (int i = 0; i < span; ++i) {
+        m_candidates[i] = mono(oldest + i);
+    }
+
+    double energy = 0.0;
+    for (int i = 0; i < length; ++i) {
+        energy += double(m_candidates[i]) * m_candidates[i];
+    }
+
+    double bestScore = -2.0;
+    int bestOffset = m_searchFrames / 2;
+    for (int offset = 0; offset <= m_searchFrames; ++offset) {
+        if (offset > 0) {
+            const double leaving = m_candidates[offset - 1];
+            const double entering = m_candidates[offset + length - 1];
+            energy += entering * entering - leaving * leaving;
+        }
+        const float* candidate = m_candidates.data() + offset;
+        float dot = 0.0f;
+        for (int i = 0; i < length; ++i) {
+            dot += candidate[i] * m_reference[i];
+        }
+        const double score = energy > 1e-9 ? dot / std::sqrt(energy) : 0.0;
+        if (score > bestScore) {
+            bestScore = score;
+            bestOffset = offset;
+        }
+    }
+
+    const int target = highestDelay - bestOffset;
+    return fromDelay + double(target - from);
+}
+
+void PitchShifter::process(float* data, int frames) {
+    const int channels = m_channelCount;
+
+    m_ratio.update();
+    for (int frame = 0; frame < frames; ++frame) {
+        // Change in the tap delay this frame, negative when pitched up
+        const double drift = 1.0 - m_ratio.next();
+        float* out = data + frame * channels;
+        float* line = m_delay.data() + size_t(m_writeFrame & m_delayMask) * channels;
+        for (int channel = 0; channel < channels; ++channel) {
+            line[channel] = out[channel];
+        }
+        ++m_writeFrame;
+
+        if (!m_fading) {
+            if (m_tapDelay < m_minDelay) {
+                // Pitched up, the tap caught up with the writer: jump back
+                // to the oldest part of the window
+                m_fadeDelay = findSplice(m_tapDelay, m_maxDelay - m_searchFrames);
+                m_fading = true;
+            } else if (m_tapDelay > m_maxDelay) {
+                // Pitched down, the tap fell behind: jump forward
+                m_fadeDelay = findSplice(m_tapDelay, m_minDelay);
+                m_fading = true;
+            }
+            if (m_fading) {
+                m_fadeGain = 0.0;
+                m_fadeStep = 1.0 / m_correlationFrames;
+            }
+        }
+
+        if (m_fading) {
+            const float gain = float(m_fadeGain);
+            for (int channel = 0; channel < channels; ++channel) {
+                out[channel] = (1.0f - gain) * tap(m_tapDelay, channel) + gain * tap(m_fadeDelay, channel);
+            }
+            m_fadeDelay += drift;
+            m_fadeGain += m_fadeStep;
+            if (m_fadeGain >= 1.0) {
+                m_tapDelay = m_fadeDelay;
+                m_fading = false;
+            }
+        } else {
+            for (int channel = 0; channel < channels; ++channel) {
+                out[channel] = tap(m_tapDelay, channel);
+            }
+        }
+        m_tapDelay += drift;
+    }
+
+    m_writeFrame &= m_delayMask;
+}
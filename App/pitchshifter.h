@@ -0,0 +1,75 @@
+#ifndef PITCHSHIFTER_H
+#define PITCHSHIFTER_H
+
+#include <atomic>
+#include <vector>
+#include "audioprocessor.h"
+#include "smoothedparameter.h"
+
+// Streaming pitch shift for the backing track, tempo unchanged.
+//
+// The stream is written into a delay line that is read back at `ratio`
+// times the write speed, so the read tap drifts through a window of the
+// recent past. When it reaches the edge of the window it jumps back across
+// it under a short crossfade. A backing track has no single period to jump
+// by, so the jump target is picked by normalised cross-correlation of the
+// audio that is about to be crossfaded (as in WSOLA), which keeps the
+// splices free of phasing and clicks.
+//
+// The transpose amount can change at any time: the tap only changes speed,
+// gliding to the new ratio by an even number of cents per sample, so there
+// is no gap and nothing is reloaded. The added delay averages
+// about 20 ms, which stays inside lip-sync tolerance for the video.
+class PitchShifter : public AudioProcessor {
+    Q_OBJECT
+    Q_PROPERTY(int semitones READ semitones WRITE setSemitones NOTIFY semitonesChanged)
+
+public:
+    static constexpr int kMinSemitones = -6;
+    static constexpr int kMaxSemitones = 6;
+
+    explicit PitchShifter(QObject* parent = nullptr);
+
+    int semitones() const { return m_semitones.load(std::memory_order_relaxed); }
+    void setSemitones(int semitones);
+
+    int latencyFrames() const override;
+    void reset() override;
+
+signals:
+    void semitonesChanged();
+
+protected:
+    void prepareBuffers() override;
+    void process(float* data, int frames) override;
+
+private:
+    std::atomic<int> m_semitones{0};
+    SmoothedParameter m_ratio;   // read speed of the tap
+
+    // Sizes in frames, derived from the sample rate in prepareBuffers()
+    int m_correlationFrames = 0; // audio compared for a splice, also the crossfade
+    int m_searchFrames = 0;      // range of jump targets tried
+    int m_minDelay = 0;
+    int m_maxDelay = 0;
+
+    std::vector<float> m_delay; // interleaved, power-of-two frames
+    int m_delayMask = 0;
+    int m_writeFrame = 0;
+
+    double m_tapDelay = 0.0;
+    double m_fadeDelay = 0.0;
+    double m_fadeGain = 0.0;
+    double m_fadeStep = 0.0;
+    bool m_fading = false;
+
+    std::vector<float> m_reference; // mono audio ahead of the current tap
+    std::vector<float> m_candidates; // mono audio covering every jump target
+
+    float sample(int frame, int channel) const;
+    float tap(double delay, int channel) const;
+    float mono(int frame) const;
+    double findSplice(double fromDelay, int lowestDelay);
+};
+
+#endif // PITCHSHIFTER_H
@@ -0,0 +1,161 @@
+#include "realfft.h"
+#include <cmath>
+#include <utility>
+
+namespace {
+
+constexpr double kPi = 3.14159265358979323846;
+
+} // namespace
+
+RealFft::RealFft(int size) {
+    if (size > 0) {
+        setSize(size);
+    }
+}
+
+int RealFft::nextPowerOfTwo(int value) {
+    int size = 1;
+    while (size < value) {
+        size <<= 1;
+    }
+    return size;
+}
+
+void RealFft::setSize(int size) {
+    size = nextPowerOfTwo(size < 4 ? 4 : size);
+    if (size == m_size) {
+        return;
+    }
+    m_size = size;
+    m_half = size / 2;
+
+    // Twiddles for the half size complex FFT, computed in double so large
+    // sizes do not accumulate rounding error
+    m_twiddles.resize(size_t(m_half));
+    for (int j = 0; j < m_half / 2; ++j) {
+        const double angle = -2.0 * kPi * j / m_half;
+        m_twiddles[2 * j] = float(std::cos(angle));
+        m_twiddles[2 * j + 1] = float(std::sin(angle));
+    }
+
+    m_splitTwiddles.resize(size_t(m_half + 1) * 2);
+    for (int k = 0; k <= m_half; ++k) {
+        const double angle = -2.0 * kPi * k / m_size;
+        m_splitTwiddles[2 * k] = float(std::cos(angle));
+        m_splitTwiddles[2 * k + 1] = float(std::sin(angle));
+    }
+
+    m_bitReverse.resize(size_t(m_half));
+    int bits = 0;
+    while ((1 << bits) < m_half) {
+        ++bits;
+    }
+    for (int i = 0; i < m_half; ++i) {
+        int reversed = 0;
+        for (int bit = 0; bit < bits; ++bit) {
+            reversed |= ((i >> bit) & 1) << (bits - 1 - bit);
+        }
+        m_bitReverse[i] = reversed;
+    }
+
+    m_work.resize(size_t(m_size));
+}
+
+void RealFft::transform(float* data, bool inverse) const {
+    const int n = m_half;
+
+    for (int i = 0; i < n; ++i) {
+        const int j = m_bitReverse[i];
+        if (j > i) {
+            std::swap(data[2 * i], data[2 * j]);
+            std::swap(data[2 * i + 1], data[2 * j + 1]);
+        }
+    }
+
+    // Iterative radix-2 butterflies; the inverse conjugates the twiddles
+    const float sign = inverse ? -1.0f : 1.0f;
+    for (int length = 2; length <= n; length <<= 1) {
+        const int halfLength = length / 2;
+        const int stride = n / length;
+        for (int start = 0; start < n; start += length) {
+            for (int k = 0; k < halfLength; ++k) {
+                const float wr = m_twiddles[2 * k * stride];
+                const float wi = sign * m_twiddles[2 * k * stride + 1];
+                float* a = data + 2 * (start + k);
+                float* b = data + 2 * (start + k + halfLength);
+                const float tr = b[0] * wr - b[1] * wi;
+                const float ti = b[0] * wi + b[1] * wr;
+                b[0] = a[0] - tr;
+                b[1] = a[1] - ti;
+                a[0] += tr;
+                a[1] += ti;
+            }
+        }
+    }
+}
+
+void RealFft::forward(const float* input, float* spectrum) {
+    const int n = m_half;
+    float* z = m_work.data();
+
+    // z[j] = x[2j] + i x[2j+1]
+    for (int i = 0; i < m_size; ++i) {
+        z[i] = input[i];
+    }
+    transform(z, false);
+
+    // X[k] = E[k] + W^k O[k] with E = (Z[k] + conj Z[n-k]) / 2 and
+    // O = (Z[k] - conj Z[n-k]) / 2i
+    for (int k = 0; k <= n; ++k) {
+        const int a = k % n;
+        const int b = (n - k) % n;
+        const float zr = z[2 * a];
+        const float zi = z[2 * a + 1];
+        const float cr = z[2 * b];
+        const float ci = -z[2 * b + 1];
+
+        const float er = 0.5f * (zr + cr);
+        const float ei = 0.5f * (zi + ci);
+        const float orr = 0.5f * (zi - ci);
+        const float oi = -0.5f * (zr - cr);
+
+        const float wr = m_splitTwiddles[2 * k];
+        const float wi = m_splitTwiddles[2 * k + 1];
+        spectrum[2 * k] = er + orr * wr - oi * wi;
+        spectrum[2 * k + 1] = ei + orr * wi + oi * wr;
+    }
+}
+
+void RealFft::inverse(const float* spectrum, float* output) {
+    const int n = m_half;
+    float* z = m_work.data();
+
+    // Undo the split: E = (X[k] + conj X[n-k]) / 2, O = (X[k] - conj X[n-k]) / 2 * conj W^k,
+    // then Z = E + i O
+    for (int k = 0; k < n; ++k) {
+        const float xr = spectrum[2 * k];
+        const float xi = spectrum[2 * k + 1];
+        const float cr = spectrum[2 * (n - k)];
+        const float ci = -spectrum[2 * (n - k) + 1];
+
+        const float er = 0.5f * (xr + cr);
+        const float ei = 0.5f * (xi + ci);
+        const float dr = 0.5f * (xr - cr);
+        const float di = 0.5f * (xi - ci);
+
+        const float wr = m_splitTwiddles[2 * k];
+        const float wi = -m_splitTwiddles[2 * k + 1];
+        const float orr = dr * wr - di * wi;
+        const float oi = dr * wi + di * wr;
+
+        z[2 * k] = er - oi;
+        z[2 * k + 1] = ei + orr;
+    }
+    transform(z, true);
+
+    const float scale = 1.0f / float(n);
+    for (int i = 0; i < m_size; ++i) {
+        output[i] = z[i] * scale;
+    }
+}
@@ -0,0 +1,42 @@
+#ifndef REALFFT_H
+#define REALFFT_H
+
+#include <vector>
+
+// Power-of-two FFT for real signals.
+//
+// A size N transform packs the even and odd samples into one complex FFT
+// of size N/2 and untangles the halves afterwards, so it costs about half
+// of a complex FFT of the same size. Twiddles and the bit reversal table
+// are built by setSize(); forward() and inverse() never allocate.
+//
+// Spectra are N/2 + 1 bins stored as interleaved re, im pairs (N + 2
+// floats). Bin 0 and bin N/2 have a zero imaginary part.
+class RealFft {
+public:
+    explicit RealFft(int size = 0);
+
+    // size must be a power of two, at least 4
+    void setSize(int size);
+    int size() const { return m_size; }
+
+    // spectrum[2k], spectrum[2k+1] = sum over n of input[n] * e^(-2 pi i k n / N)
+    void forward(const float* input, float* spectrum);
+
+    // Inverse of forward(), including the 1/N scale. spectrum is not modified.
+    void inverse(const float* spectrum, float* output);
+
+    static int nextPowerOfTwo(int value);
+
+private:
+    int m_size = 0;
+    int m_half = 0;
+    std::vector<float> m_twiddles;     // e^(-2 pi i j / (N/2)), j < N/4
+    std::vector<float> m_splitTwiddles; // e^(-2 pi i k / N), k <= N/2
+    std::vector<int> m_bitReverse;
+    std::vector<float> m_work;         // N/2 complex values
+
+    void transform(float* data, bool inverse) const;
+};
+
+#endif // REALFFT_H
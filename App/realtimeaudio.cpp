@@ -0,0 +1,365 @@
+#include "realtimeaudio.h"
+#include <QDebug>
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+
+#ifdef Q_OS_UNIX
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <unistd.h>
+#endif
+
+#if defined(AUDIO_REALTIME_AUDIT) && defined(__GLIBC__)
+#define REALTIME_AUDIT_HOOKS
+#include <cstdarg>
+#include <cstdio>
+#include <dlfcn.h>
+#include <execinfo.h>
+#include <linux/futex.h>
+#include <semaphore.h>
+#include <sys/syscall.h>
+#endif
+
+namespace {
+
+RealtimeAudio::Options s_options;
+
+// Each refusal is reported once, not once per thread
+std::atomic<bool> s_schedulingWarned{false};
+std::atomic<bool> s_affinityWarned{false};
+std::atomic<bool> s_lockWarned{false};
+
+bool firstTime(std::atomic<bool>& warned) {
+    return !warned.exchange(true, std::memory_order_relaxed);
+}
+
+size_t pageSize() {
+#ifdef Q_OS_UNIX
+    return size_t(sysconf(_SC_PAGESIZE));
+#else
+    return 4096;
+#endif
+}
+
+// Touches the stack below the caller, then locks what it touched
+Q_DECL_NOINLINE void prefaultStack() {
+    char stack[RealtimeAudio::kStackPrefaultBytes];
+    RealtimeAudio::prefault(stack, sizeof(stack));
+#ifdef Q_OS_UNIX
+    mlock(stack, sizeof(stack));
+#endif
+}
+
+} // namespace
+
+namespace RealtimeAudio {
+
+void setOptions(const Options& options) {
+    s_options = options;
+}
+
+Options options() {
+    return s_options;
+}
+
+bool setupAudioThread() {
+    const Options options = s_options;
+    if (!options.enabled) {
+        return true;
+    }
+
+    prefaultStack();
+    bool permitted = true;
+
+#ifdef Q_OS_LINUX
+    sched_param param = {};
+    param.sched_priority = qBound(sched_get_priority_min(SCHED_FIFO), options.priority, sched_get_priority_max(SCHED_FIFO));
+    int error = pthread_setschedparam(pthread_self(), SCHED_FIFO, &param);
+    if (error != 0) {
+        permitted = false;
+        if (firstTime(s_schedulingWarned)) {
+            qWarning() << "Audio threads cannot use SCHED_FIFO:" << std::strerror(error)
+                       << "- raise the rtprio limit or grant CAP_SYS_NICE";
+        }
+    }
+
+    if (!options.cores.isEmpty()) {
+        cpu_set_t cores;
+        CPU_ZERO(&cores);
+        for (int core : options.cores) {
+            if (core >= 0 && core < CPU_SETSIZE) {
+                CPU_SET(core, &cores);
+            }
+        }
+        error = pthread_setaffinity_np(pthread_self(), sizeof(cores), &cores);
+        if (error != 0) {
+            permitted = false;
+            if (firstTime(s_affinityWarned)) {
+                qWarning() << "Audio threads cannot be pinned to cores" << options.cores << ":" << std::strerror(error);
+            }
+        }
+    }
+#else
+    permitted = false;
+    if (firstTime(s_schedulingWarned)) {
+        qWarning() << "Realtime scheduling and core pinning of audio threads are only supported on Linux";
+    }
+#endif
+
+    return permitted;
+}
+
+bool lockMemory() {
+#ifdef Q_OS_UNIX
+    if (mlockall(MCL_CURRENT) == 0) {
+        return true;
+    }
+    const int error = errno;
+    if (firstTime(s_lockWarned)) {
+        rlimit limit = {};
+        getrlimit(RLIMIT_MEMLOCK, &limit);
+        qWarning() << "Cannot lock the audio memory:" << std::strerror(error) << "- the memlock limit is"
+                   << (limit.rlim_cur == RLIM_INFINITY ? QStringLiteral("unlimited") : QString::number(limit.rlim_cur / 1024) + QStringLiteral(" KiB"));
+    }
+#else
+    if (firstTime(s_lockWarned)) {
+        qWarning() << "Locking the audio memory is not supported on this platform";
+    }
+#endif
+    return false;
+}
+
+void unlockMemory() {
+#ifdef Q_OS_UNIX
+    munlockall();
+#endif
+}
+
+void prefault(void* data, size_t bytes) {
+    // Read and write back, so the contents survive
+    volatile char* bytesOf = static_cast<volatile char*>(data);
+    const size_t step = pageSize();
+    for (size_t offset = 0; offset < bytes; offset += step) {
+        bytesOf[offset] = bytesOf[offset];
+    }
+    if (bytes > 0) {
+        bytesOf[bytes - 1] = bytesOf[bytes - 1];
+    }
+}
+
+} // namespace RealtimeAudio
+
+//---------- Audit ----------
+
+#ifdef REALTIME_AUDIT_HOOKS
+
+namespace {
+
+thread_local int t_scopeDepth = 0;
+thread_local bool t_reporting = false;
+std::atomic<qint64> s_violations{0};
+std::atomic<int> s_reports{0};
+
+// The first backtrace() loads the unwinder, which allocates; get that
+// done before any audio thread needs it
+[[maybe_unused]] const bool s_unwinderLoaded = [] {
+    void* frame = nullptr;
+    return backtrace(&frame, 1) >= 0;
+}();
+
+// Nothing in here allocates or locks, and the reporting flag keeps the
+// calls it makes itself from being flagged
+void flag(const char* call) {
+    if (t_scopeDepth == 0 || t_reporting) {
+        return;
+    }
+    t_reporting = true;
+    const qint64 count = s_violations.fetch_add(1, std::memory_order_relaxed) + 1;
+    if (s_reports.fetch_add(1, std::memory_order_relaxed) < RealtimeAudio::kMaxAuditReports) {
+        char line[128];
+        const int length = std::snprintf(line, sizeof(line), "Realtime audit: %s on an audio thread (#%lld)\n", call, (long long)count);
+        if (length > 0) {
+            [[maybe_unused]] const ssize_t written = write(STDERR_FILENO, line, size_t(qMin(length, int(sizeof(line)) - 1)));
+        }
+        void* frames[32];
+        const int depth = backtrace(frames, 32);
+        // Leave out flag() itself
+        backtrace_symbols_fd(frames + 1, depth - 1, STDERR_FILENO);
+    }
+    t_reporting = false;
+}
+
+// The libc definition the interposed one stands in for. Looked up on
+// first use; two threads racing here find the same address.
+template<typename Function>
+Function next(std::atomic<Function>& cache, const char* name) {
+    Function function = cache.load(std::memory_order_relaxed);
+    if (!function) {
+        function = reinterpret_cast<Function>(dlsym(RTLD_NEXT, name));
+        cache.store(function, std::memory_order_relaxed);
+    }
+    return function;
+}
+
+} // namespace
+
+namespace RealtimeAudio {
+
+bool auditCompiledIn() {
+    return true;
+}
+
+qint64 auditViolations() {
+    return s_violations.load(std::memory_order_relaxed);
+}
+
+AuditScope::AuditScope() {
+    ++t_scopeDepth;
+}
+
+AuditScope::~AuditScope() {
+    --t_scopeDepth;
+}
+
+} // namespace RealtimeAudio
+
+// glibc's own allocator entry points, which the interposed ones forward to
+extern "C" {
+void* __libc_malloc(size_t size);
+void* __libc_calloc(size_t count, size_t size);
+void* __libc_realloc(void* data, size_t size);
+void* __libc_memalign(size_t alignment, size_t size);
+void __libc_free(void* data);
+}
+
+extern "C" {
+
+void* malloc(size_t size) noexcept {
+    flag("malloc");
+    return __libc_malloc(size);
+}
+
+void* calloc(size_t count, size_t size) noexcept {
+    flag("calloc");
+    return __libc_calloc(count, size);
+}
+
+void* realloc(void* data, size_t size) noexcept {
+    flag("realloc");
+    return __libc_realloc(data, size);
+}
+
+void free(void* data) noexcept {
+    if (data) {
+        flag("free");
+    }
+    __libc_free(data);
+}
+
+void* memalign(size_t alignment, size_t size) noexcept {
+    flag("memalign");
+    return __libc_memalign(alignment, size);
+}
+
+void* aligned_alloc(size_t alignment, size_t size) noexcept {
+    flag("aligned_alloc");
+    return __libc_memalign(alignment, size);
+}
+
+int posix_memalign(void** data, size_t alignment, size_t size) noexcept {
+    flag("posix_memalign");
+    if (alignment % sizeof(void*) != 0 || (alignment & (alignment - 1)) != 0) {
+        return EINVAL;
+    }
+    void* allocated = __libc_memalign(alignment, size);
+    if (!allocated && size > 0) {
+        return ENOMEM;
+    }
+    *data = allocated;
+    return 0;
+}
+
+int pthread_mutex_lock(pthread_mutex_t* mutex) noexcept {
+    static std::atomic<int (*)(pthread_mutex_t*)> real{nullptr};
+    flag("pthread_mutex_lock");
+    return next(real, "pthread_mutex_lock")(mutex);
+}
+
+int pthread_mutex_timedlock(pthread_mutex_t* mutex, const timespec* timeout) noexcept {
+    static std::atomic<int (*)(pthread_mutex_t*, const timespec*)> real{nullptr};
+    flag("pthread_mutex_timedlock");
+    return next(real, "pthread_mutex_timedlock")(mutex, timeout);
+}
+
+int pthread_rwlock_rdlock(pthread_rwlock_t* lock) noexcept {
+    static std::atomic<int (*)(pthread_rwlock_t*)> real{nullptr};
+    flag("pthread_rwlock_rdlock");
+    return next(real, "pthread_rwlock_rdlock")(lock);
+}
+
+int pthread_rwlock_wrlock(pthread_rwlock_t* lock) noexcept {
+    static std::atomic<int (*)(pthread_rwlock_t*)> real{nullptr};
+    flag("pthread_rwlock_wrlock");
+    return next(real, "pthread_rwlock_wrlock")(lock);
+}
+
+int sem_wait(sem_t* semaphore) {
+    static std::atomic<int (*)(sem_t*)> real{nullptr};
+    flag("sem_wait");
+    return next(real, "sem_wait")(semaphore);
+}
+
+int sem_timedwait(sem_t* semaphore, const timespec* timeout) {
+    static std::atomic<int (*)(sem_t*, const timespec*)> real{nullptr};
+    flag("sem_timedwait");
+    return next(real, "sem_timedwait")(semaphore, timeout);
+}
+
+// Qt's futex based QMutex, QSemaphore and QWaitCondition wait here
+long syscall(long number, ...) noexcept {
+    static std::atomic<long (*)(long, ...)> real{nullptr};
+
+    // Like libc, always pass on six arguments
+    va_list list;
+    va_start(list, number);
+    long args[6];
+    for (long& arg : args) {
+        arg = va_arg(list, long);
+    }
+    va_end(list);
+
+    if (number == SYS_futex) {
+        const int operation = int(args[1]) & FUTEX_CMD_MASK;
+        if (operation == FUTEX_WAIT || operation == FUTEX_WAIT_BITSET || operation == FUTEX_LOCK_PI) {
+            flag("futex wait");
+        }
+    }
+    return next(real, "syscall")(number, args[0], args[1], args[2], args[3], args[4], args[5]);
+}
+
+} // extern "C"
+
+#else
+
+namespace RealtimeAudio {
+
+bool auditCompiledIn() {
+    return false;
+}
+
+qint64 auditViolations() {
+    return 0;
+}
+
+#ifdef AUDIO_REALTIME_AUDIT
+// Only glibc can be interposed this way; elsewhere the scopes do nothing
+AuditScope::AuditScope() {}
+AuditScope::~AuditScope() {}
+#endif
+
+} // namespace RealtimeAudio
+
+#endif // REALTIME_AUDIT_HOOKS
@@ -0,0 +1,80 @@
+#ifndef REALTIMEAUDIO_H
+#define REALTIMEAUDIO_H
+
+#include <QList>
+#include <QtGlobal>
+
+// Process-wide realtime setup of the audio threads, and a debug audit of
+// what they do inside their callbacks.
+//
+// In realtime mode every audio thread (capture, sink, offline and the mix
+// bus workers) calls setupAudioThread() as it starts: the thread asks for
+// SCHED_FIFO, is pinned to the chosen cores and touches its stack so the
+// first deep callback does not page fault. lockMemory() then locks the
+// whole process into RAM once the pipeline is built, which also faults in
+// every buffer allocated so far. Each step needs permission (rtprio and
+// memlock limits, or CAP_SYS_NICE and CAP_IPC_LOCK); a step that is not
+// permitted warns once and the audio runs without it.
+//
+// Builds with AUDIO_REALTIME_AUDIT on glibc interpose malloc and friends,
+// pthread mutex and rwlock locks, semaphore waits, and futex waits made
+// through syscall(), which is where a contended QMutex or QSemaphore ends
+// up on Linux. Any of those made inside an AuditScope is counted and,
+// for the first kMaxAuditReports, printed to stderr with a stack trace.
+// An uncontended QMutex never leaves user space and goes unseen. Without
+// the define AuditScope compiles to nothing.
+namespace RealtimeAudio {
+
+struct Options {
+    bool enabled = false;
+    int priority = 70;   // SCHED_FIFO priority, 1 to 99
+    QList<int> cores;    // CPUs the audio threads may run on, empty for any
+};
+
+constexpr int kStackPrefaultBytes = 256 * 1024;
+constexpr int kMaxAuditReports = 16;
+
+// Only while no audio thread is running
+void setOptions(const Options& options);
+Options options();
+
+// On the audio thread as it starts; does nothing unless enabled. False if
+// any part was not permitted.
+bool setupAudioThread();
+
+// Lock every page the process has mapped now. Later allocations are not
+// locked, so they cannot fail because of the lock limit.
+bool lockMemory();
+void unlockMemory();
+
+// Write to every page of the range
+void prefault(void* data, size_t bytes);
+
+// Audit
+
+bool auditCompiledIn();
+
+// Calls flagged so far, on any thread
+qint64 auditViolations();
+
+#ifdef AUDIO_REALTIME_AUDIT
+// Marks the calling thread as inside an audio callback for its lifetime;
+// scopes nest
+class AuditScope {
+public:
+    AuditScope();
+    ~AuditScope();
+
+    AuditScope(const AuditScope&) = delete;
+    AuditScope& operator=(const AuditScope&) = delete;
+};
+#else
+class AuditScope {
+public:
+    AuditScope() {}
+};
+#endif
+
+} // namespace RealtimeAudio
+
+#endif // REALTIMEAUDIO_H
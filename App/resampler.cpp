@@ -0,0 +1,164 @@
+#include "resampler.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace {
+
+constexpr double kPi = 3.14159265358979323846;
+
+// Input frames taken per append on top of the filter history
+constexpr int kChunkFrames = 1024;
+
+struct Tier {
+    int taps;
+    int phases;
+    double beta;
+};
+
+// Taps are a multiple of 8 for the dot kernel
+constexpr Tier kTiers[] = {
+    {24, 32, 6.0},
+    {48, 128, 8.5},
+    {96, 512, 10.5},
+};
+
+// Modified Bessel function of the first kind, order zero
+double besselI0(double x) {
+    double sum = 1.0;
+    double term = 1.0;
+    const double quarter = x * x / 4.0;
+    for (int k = 1; k < 64; ++k) {
+        term *= quarter / (double(k) * k);
+        sum += term;
+        if (term < sum * 1e-17) {
+            break;
+        }
+    }
+    return sum;
+}
+
+} // namespace
+
+Resampler::Resampler() {
+    configure(m_inputRate, m_outputRate, m_channelCount, m_quality);
+}
+
+void Resampler::configure(int inputRate, int outputRate, int channelCount, Quality quality) {
+    m_inputRate = std::max(1, inputRate);
+    m_outputRate = std::max(1, outputRate);
+    m_channelCount = std::clamp(channelCount, 1, kMaxChannels);
+    m_quality = quality;
+    m_ratio = double(m_inputRate) / m_outputRate;
+    m_kernels = &AudioKernels::active();
+
+    // Downsampling lowers the cutoff by out/in, and the filter gets that
+    // much longer so the transition band keeps its width at the output
+    const Tier& tier = kTiers[std::clamp(int(quality), 0, 2)];
+    const double scale = std::min(1.0, double(m_outputRate) / m_inputRate);
+    const int stretched = int(std::ceil(tier.taps / scale));
+    m_taps = std::min(kMaxTaps, (stretched + 7) / 8 * 8);
+    m_phases = tier.phases;
+
+    // Kaiser's estimate of the transition width for this window and length,
+    // in cycles per input sample, placed just below the output Nyquist
+    const double attenuation = tier.beta / 0.1102 + 8.7;
+    const double transition = (attenuation - 7.95) / (2.285 * 2.0 * kPi * (m_taps - 1));
+    const double cutoff = std::max(0.05 * scale, 0.5 * scale - transition / 2.0);
+
+    const int half = m_taps / 2;
+    const double windowNorm = besselI0(tier.beta);
+    m_table.assign(size_t(m_phases + 1) * m_taps, 0.0f);
+    std::vector<double> row(static_cast<size_t>(m_taps));
+    for (int phase = 0; phase <= m_phases; ++phase) {
+        const double offset = double(phase) / m_phases;
+        double sum = 0.0;
+        for (int k = 0; k < m_taps; ++k) {
+            // Distance from input frame k to the output instant
+            const double t = half - 1 + offset - k;
+            const double x = t / half;
+            const double window = std::abs(x) < 1.0 ? besselI0(tier.beta * std::sqrt(1.0 - x * x)) / windowNorm : 0.0;
+            const double arg = 2.0 * cutoff * t;
+            const double sinc = std::abs(arg) < 1e-12 ? 1.0 : std::sin(kPi * arg) / (kPi * arg);
+            row[k] = 2.0 * cutoff * sinc * window;
+            sum += row[k];
+        }
+        // Unity gain at DC for every offset, so the offsets differ only in phase
+        float* coefficients = m_table.data() + size_t(phase) * m_taps;
+        for (int k = 0; k < m_taps; ++k) {
+            coefficients[k] = float(row[k] / sum);
+        }
+    }
+
+    m_capacityFrames = m_taps + kChunkFrames;
+    m_history.assign(size_t(m_capacityFrames) * m_channelCount, 0.0f);
+    m_output.assign(size_t(kBlockFrames) * m_channelCount, 0.0f);
+    reset();
+}
+
+void Resampler::setRatio(double ratio) {
+    m_ratio = std::clamp(ratio, 1.0 / 64.0, 64.0);
+}
+
+void Resampler::reset() {
+    // Leading silence so the first output lines up with the first input
+    const int lead = m_taps / 2 - 1;
+    for (int channel = 0; channel < m_channelCount; ++channel) {
+        float* history = m_history.data() + size_t(channel) * m_capacityFrames;
+        std::fill(history, history + lead, 0.0f);
+    }
+    m_inputFrames = lead;
+    m_position = 0.0;
+    m_outputFrames = 0;
+}
+
+int Resampler::append(const float* input, int frames) {
+    const int count = std::min(frames, m_capacityFrames - m_inputFrames);
+    const int channels = m_channelCount;
+    for (int channel = 0; channel < channels; ++channel) {
+        float* history = m_history.data() + size_t(channel) * m_capacityFrames + m_inputFrames;
+        for (int frame = 0; frame < count; ++frame) {
+            history[frame] = input[frame * channels + channel];
+        }
+    }
+    m_inputFrames += count;
+    return count;
+}
+
+bool Resampler::nextFrame() {
+    const int base = int(m_position);
+    if (base + m_taps > m_inputFrames) {
+        return false;
+    }
+
+    const double scaled = (m_position - base) * m_phases;
+    const int phase = std::min(int(scaled), m_phases - 1);
+    const float fraction = float(scaled - phase);
+    const float* below = m_table.data() + size_t(phase) * m_taps;
+    const float* above = below + m_taps;
+
+    float* out = m_output.data() + size_t(m_outputFrames) * m_channelCount;
+    for (int channel = 0; channel < m_channelCount; ++channel) {
+        const float* history = m_history.data() + size_t(channel) * m_capacityFrames + base;
+        const float a = m_kernels->dot(history, below, m_taps);
+        const float b = m_kernels->dot(history, above, m_taps);
+        out[channel] = a + (b - a) * fraction;
+    }
+    ++m_outputFrames;
+    m_position += m_ratio;
+    return true;
+}
+
+void Resampler::discardConsumed() {
+    const int consumed = std::min(int(m_position), m_inputFrames);
+    if (consumed == 0) {
+        return;
+    }
+    const int kept = m_inputFrames - consumed;
+    for (int channel = 0; channel < m_channelCount; ++channel) {
+        float* history = m_history.data() + size_t(channel) * m_capacityFrames;
+        std::memmove(history, history + consumed, sizeof(float) * size_t(kept));
+    }
+    m_inputFrames = kept;
+    m_position -= consumed;
+}
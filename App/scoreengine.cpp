@@ -0,0 +1,251 @@
+#include "scoreengine.h"
+#include <QDebug>
+#include <QFileInfo>
+#include <QUrl>
+#include <cmath>
+#include "contourfile.h"
+#include "mediaplayer.h"
+
+namespace {
+
+constexpr int kPollIntervalMs = 20;
+constexpr int kEstimatesPerPoll = 64;
+
+// Song time moving back by more than this, or forward by more than this,
+// is a seek rather than estimate jitter
+constexpr qint64 kBackwardSeekMs = 250;
+constexpr qint64 kForwardSeekMs = 2000;
+
+inline double midiNote(double frequency) {
+    return 69.0 + 12.0 * std::log2(frequency / 440.0);
+}
+
+} // namespace
+
+ScoreEngine::ScoreEngine(PitchAnalyzer* analyzer, QObject* parent) : QObject(parent), m_analyzer(analyzer) {
+    m_pollTimer = new QTimer(this);
+    m_pollTimer->setInterval(kPollIntervalMs);
+    connect(m_pollTimer, &QTimer::timeout, this, &ScoreEngine::poll);
+}
+
+void ScoreEngine::setMediaPlayer(MediaPlayer* player) {
+    if (m_mediaPlayer) {
+        disconnect(m_mediaPlayer, nullptr, this, nullptr);
+    }
+    m_mediaPlayer = player;
+    if (player) {
+        connect(player, &MediaPlayer::sourceChanged, this, &ScoreEngine::loadMelodyForSource);
+        loadMelodyForSource();
+    }
+}
+
+void ScoreEngine::setActive(bool active) {
+    if (m_active == active) {
+        return;
+    }
+    m_active = active;
+    if (active) {
+        // Estimates queued before scoring started would land in the past
+        PitchAnalyzer::Estimate stale[kEstimatesPerPoll];
+        while (m_analyzer->takeEstimates(stale, kEstimatesPerPoll) > 0) {
+        }
+        m_analyzer->setBypassed(false);
+        m_lastSongMs = -1;
+        m_pollTimer->start();
+    } else {
+        m_pollTimer->stop();
+        m_analyzer->setBypassed(true);
+    }
+    emit activeChanged();
+}
+
+void ScoreEngine::setMelody(const MelodyTrack& melody) {
+    m_melody = melody;
+    resetScore();
+    emit melodyChanged();
+}
+
+bool ScoreEngine::loadMelody(const QString& path) {
+    MelodyTrack melody;
+    if (!melody.loadMidiFile(path)) {
+        return false;
+    }
+    qDebug() << "Loaded melody" << path << melody.noteCount() << "notes in" << melody.phraseCount() << "phrases";
+    setMelody(melody);
+    return true;
+}
+
+void ScoreEngine::loadMelodyForSource() {
+    const QUrl source = m_mediaPlayer ? m_mediaPlayer->source() : QUrl();
+    if (source.isLocalFile()) {
+        const QFileInfo media(source.toLocalFile());
+        for (const char* suffix : {".kar", ".mid", ".midi"}) {
+            const QString path = media.path() + "/" + media.completeBaseName() + suffix;
+            if (QFileInfo::exists(path) && loadMelody(path)) {
+                return;
+            }
+        }
+
+        const QString contourPath = ContourFile::pathFor(media.absoluteFilePath());
+        ContourFile contour;
+        MelodyTrack melody;
+        if (ContourFile::isCurrent(contourPath, media) && contour.open(contourPath) && melody.loadContour(contour)) {
+            qDebug() << "Loaded melody contour of" << media.fileName() << melody.noteCount() << "notes in"
+                     << melody.phraseCount() << "phrases";
+            setMelody(melody);
+            return;
+        }
+        if (!m_melody.isEmpty()) {
+            setMelody(MelodyTrack());
+        }
+        emit melodyMissing(media.absoluteFilePath());
+        return;
+    }
+    if (!m_melody.isEmpty()) {
+        setMelody(MelodyTrack());
+    }
+}
+
+void ScoreEngine::setLatencyCompensationMs(double latencyMs) {
+    if (m_latencyCompensationMs != latencyMs) {
+        m_latencyCompensationMs = latencyMs;
+        emit latencyCompensationMsChanged();
+    }
+}
+
+void ScoreEngine::resetScore() {
+    m_cursor = 0;
+    m_lastSongMs = -1;
+    m_noteEstimates = 0;
+    m_noteHits = 0;
+    m_noteHasOnset = false;
+    m_phraseAccuracy = 0.0;
+    m_phraseWeight = 0.0;
+    m_weightedAccuracy = 0.0;
+    m_totalWeight = 0.0;
+    m_notesScored = 0;
+    m_lastNoteAccuracy = 0.0;
+    m_lastPhraseAccuracy = 0.0;
+    m_onsetSumMs = 0.0;
+    m_onsetCount = 0;
+    emit scoreChanged();
+}
+
+void ScoreEngine::poll() {
+    PitchAnalyzer::Estimate estimates[kEstimatesPerPoll];
+    const bool scoring = !m_melody.isEmpty() && m_mediaPlayer && m_mediaPlayer->playing();
+
+    // Song time of the newest analysed frame. Everything behind it in the
+    // mic stream is older by its age, scaled to song time by the tempo.
+    const qint64 positionMs = scoring ? m_mediaPlayer->position() : 0;
+    const double rate = scoring ? m_mediaPlayer->playbackRate() : 1.0;
+    const double msPerFrame = 1000.0 / m_analyzer->sampleRate();
+
+    const int targetBefore = m_targetNote;
+    const double sungBefore = m_sungNote;
+    int count = 0;
+    while ((count = m_analyzer->takeEstimates(estimates, kEstimatesPerPoll)) > 0) {
+        if (!scoring) {
+            continue;
+        }
+        // Read after the batch so no estimate in it is newer than the position
+        const qint64 analyzedFrames = m_analyzer->framesAnalyzed();
+        for (int i = 0; i < count; ++i) {
+            const qint64 ageFrames = qMax<qint64>(0, analyzedFrames - estimates[i].frame);
+            const double ageMs = ageFrames * msPerFrame + m_latencyCompensationMs;
+            match(positionMs - qint64(std::lround(ageMs * rate)), estimates[i]);
+        }
+    }
+    if (m_targetNote != targetBefore || m_sungNote != sungBefore) {
+        emit pitchChanged();
+    }
+}
+
+void ScoreEngine::seek(qint64 songMs) {
+    // The interrupted note is not scored, the phrase carries on
+    m_cursor = m_melody.indexAt(songMs);
+    m_noteEstimates = 0;
+    m_noteHits = 0;
+    m_noteHasOnset = false;
+}
+
+void ScoreEngine::match(qint64 songMs, const PitchAnalyzer::Estimate& estimate) {
+    if (m_lastSongMs < 0 || songMs < m_lastSongMs - kBackwardSeekMs || songMs > m_lastSongMs + kForwardSeekMs) {
+        seek(songMs);
+    }
+    m_lastSongMs = songMs;
+
+    // Amortised O(1): each note is passed exactly once
+    while (m_cursor < m_melody.noteCount() && m_melody.note(m_cursor).endMs <= songMs) {
+        finishNote(m_cursor++);
+    }
+
+    const bool voiced = estimate.voiced && estimate.confidence >= kMinConfidence;
+    m_sungNote = voiced ? midiNote(estimate.frequency) : 0.0;
+    if (m_cursor >= m_melody.noteCount()) {
+        m_targetNote = -1;
+        return;
+    }
+
+    const MelodyTrack::Note& note = m_melody.note(m_cursor);
+    bool onPitch = false;
+    if (voiced) {
+        // Distance to the nearest octave of the note
+        double semitones = m_sungNote - note.pitch;
+        semitones -= 12.0 * std::round(semitones / 12.0);
+        onPitch = std::abs(semitones) * 100.0 <= kToleranceCents;
+    }
+
+    if (songMs >= note.startMs) {
+        m_targetNote = note.pitch;
+        ++m_noteEstimates;
+        m_noteHits += onPitch ? 1 : 0;
+    } else {
+        m_targetNote = -1;
+        if (note.startMs - songMs > kEarlyOnsetMs) {
+            return;
+        }
+    }
+    if (onPitch && !m_noteHasOnset) {
+        m_noteHasOnset = true;
+        m_noteOnsetMs = songMs - note.startMs;
+    }
+}
+
+void ScoreEngine::finishNote(int index) {
+    const MelodyTrack::Note& note = m_melody.note(index);
+    const int estimates = m_noteEstimates;
+    const bool hasOnset = m_noteHasOnset;
+    const double offsetMs = double(m_noteOnsetMs);
+    const double accuracy = estimates > 0 ? double(m_noteHits) / estimates : 0.0;
+    m_noteEstimates = 0;
+    m_noteHits = 0;
+    m_noteHasOnset = false;
+
+    // Notes nobody heard (paused, seeked past, shorter than a hop) are skipped
+    if (estimates > 0) {
+        const double weight = double(note.endMs - note.startMs);
+        m_weightedAccuracy += accuracy * weight;
+        m_totalWeight += weight;
+        m_phraseAccuracy += accuracy * weight;
+        m_phraseWeight += weight;
+        ++m_notesScored;
+        m_lastNoteAccuracy = accuracy;
+        if (hasOnset) {
+            m_onsetSumMs += offsetMs;
+            ++m_onsetCount;
+        }
+        emit noteScored(index, accuracy, hasOnset ? offsetMs : 0.0);
+    }
+
+    const bool phraseEnds = index + 1 >= m_melody.noteCount() || m_melody.note(index + 1).phrase != note.phrase;
+    if (phraseEnds && m_phraseWeight > 0.0) {
+        m_lastPhraseAccuracy = m_phraseAccuracy / m_phraseWeight;
+        m_phraseAccuracy = 0.0;
+        m_phraseWeight = 0.0;
+        emit phraseScored(note.phrase, m_lastPhraseAccuracy);
+    }
+    if (estimates > 0 || phraseEnds) {
+        emit scoreChanged();
+    }
+}
@@ -0,0 +1,133 @@
+#ifndef SCOREENGINE_H
+#define SCOREENGINE_H
+
+#include <QObject>
+#include <QPointer>
+#include <QTimer>
+#include "melodytrack.h"
+#include "pitchanalyzer.h"
+
+class MediaPlayer;
+
+// Karaoke scoring: the singer's pitch against the song's reference melody.
+//
+// Estimates from the PitchAnalyzer on the mic chain are placed in song
+// time using the media position, their age in the mic stream and the
+// round-trip latency the singer hears the music with. Each estimate is
+// matched against the note under a cursor that only moves forward, so
+// matching is O(1) per estimate; a seek re-seats the cursor with one
+// binary search.
+//
+// A note scores the share of its estimates within kToleranceCents of the
+// note, an octave off counts as on pitch. Its timing offset is when the
+// singer first hit it, early or late. Phrases and the total are
+// duration-weighted averages of their notes, the total on a 0-100 scale.
+class ScoreEngine : public QObject {
+    Q_OBJECT
+    Q_PROPERTY(bool active READ isActive WRITE setActive NOTIFY activeChanged)
+    Q_PROPERTY(bool hasMelody READ hasMelody NOTIFY melodyChanged)
+    Q_PROPERTY(double tempoBpm READ tempoBpm NOTIFY melodyChanged)
+    Q_PROPERTY(double score READ score NOTIFY scoreChanged)
+    Q_PROPERTY(int notesScored READ notesScored NOTIFY scoreChanged)
+    Q_PROPERTY(double lastNoteAccuracy READ lastNoteAccuracy NOTIFY scoreChanged)
+    Q_PROPERTY(double lastPhraseAccuracy READ lastPhraseAccuracy NOTIFY scoreChanged)
+    Q_PROPERTY(double timingOffsetMs READ timingOffsetMs NOTIFY scoreChanged)
+    Q_PROPERTY(int targetNote READ targetNote NOTIFY pitchChanged)
+    Q_PROPERTY(double sungNote READ sungNote NOTIFY pitchChanged)
+    Q_PROPERTY(double latencyCompensationMs READ latencyCompensationMs WRITE setLatencyCompensationMs NOTIFY latencyCompensationMsChanged)
+
+public:
+    static constexpr double kToleranceCents = 50.0;
+    static constexpr double kMinConfidence = 0.7;
+    static constexpr qint64 kEarlyOnsetMs = 150;
+
+    explicit ScoreEngine(PitchAnalyzer* analyzer, QObject* parent = nullptr);
+
+    // Song clock; a reference melody next to the media file (same name,
+    // .kar/.mid/.midi), or else its analysed contour, is loaded whenever
+    // its source changes. A local file with neither emits melodyMissing().
+    void setMediaPlayer(MediaPlayer* player);
+
+    bool isActive() const { return m_active; }
+    void setActive(bool active);
+
+    bool hasMelody() const { return !m_melody.isEmpty(); }
+    const MelodyTrack& melody() const { return m_melody; }
+    void setMelody(const MelodyTrack& melody);
+
+    // Song tempo from its MIDI file, 0 when the melody has none
+    double tempoBpm() const { return m_melody.tempoBpm(); }
+    Q_INVOKABLE bool loadMelody(const QString& path);
+
+    double score() const { return m_totalWeight > 0.0 ? 100.0 * m_weightedAccuracy / m_totalWeight : 0.0; }
+    int notesScored() const { return m_notesScored; }
+    double lastNoteAccuracy() const { return m_lastNoteAccuracy; }
+    double lastPhraseAccuracy() const { return m_lastPhraseAccuracy; }
+
+    // Mean onset offset of the scored notes, positive when late
+    double timingOffsetMs() const { return m_onsetCount > 0 ? m_onsetSumMs / m_onsetCount : 0.0; }
+
+    // Note under the cursor (-1 in a rest) and the sung pitch as a
+    // fractional MIDI note (0 when unvoiced), for a pitch display
+    int targetNote() const { return m_targetNote; }
+    double sungNote() const { return m_sungNote; }
+
+    // How far behind the music the singer is heard: output plus input
+    // latency, normally the audio manager's mic-to-speaker latency
+    double latencyCompensationMs() const { return m_latencyCompensationMs; }
+    void setLatencyCompensationMs(double latencyMs);
+
+public slots:
+    void resetScore();
+
+    // Reload the melody of the current source, e.g. once its contour exists
+    void loadMelodyForSource();
+
+signals:
+    void activeChanged();
+    void melodyChanged();
+    void scoreChanged();
+    void pitchChanged();
+    void latencyCompensationMsChanged();
+    void noteScored(int index, double accuracy, double offsetMs);
+    // The current source has no MIDI melody and no current contour
+    void melodyMissing(const QString& mediaPath);
+    void phraseScored(int phrase, double accuracy);
+
+private:
+    PitchAnalyzer* m_analyzer;
+    QPointer<MediaPlayer> m_mediaPlayer;
+    QTimer* m_pollTimer = nullptr;
+    MelodyTrack m_melody;
+    bool m_active = false;
+    double m_latencyCompensationMs = 0.0;
+
+    // Cursor and the note being sung
+    int m_cursor = 0;
+    qint64 m_lastSongMs = -1;
+    int m_noteEstimates = 0;
+    int m_noteHits = 0;
+    bool m_noteHasOnset = false;
+    qint64 m_noteOnsetMs = 0;
+
+    // Phrase and running totals
+    double m_phraseAccuracy = 0.0;
+    double m_phraseWeight = 0.0;
+    double m_weightedAccuracy = 0.0;
+    double m_totalWeight = 0.0;
+    int m_notesScored = 0;
+    double m_lastNoteAccuracy = 0.0;
+    double m_lastPhraseAccuracy = 0.0;
+    double m_onsetSumMs = 0.0;
+    int m_onsetCount = 0;
+
+    int m_targetNote = -1;
+    double m_sungNote = 0.0;
+
+    void poll();
+    void match(qint64 songMs, const PitchAnalyzer::Estimate& estimate);
+    void seek(qint64 songMs);
+    void finishNote(int index);
+};
+
+#endif // SCOREENGINE_H
@@ -0,0 +1,74 @@
+#include "smoothedparameter.h"
+#include <algorithm>
+#include <cmath>
+
+SmoothedParameter::SmoothedParameter(float value, Curve curve, double rampMs)
+    : m_target(value), m_curve(curve), m_rampMs(std::max(0.0, rampMs)), m_current(value), m_end(value) {
+    prepare(48000);
+}
+
+void SmoothedParameter::prepare(int sampleRate) {
+    m_rampSamples = std::max(1, int(std::lround(m_rampMs * sampleRate / 1000.0)));
+}
+
+void SmoothedParameter::snap() {
+    m_current = m_end = target();
+    m_remaining = 0;
+}
+
+bool SmoothedParameter::update() {
+    const float target = this->target();
+    if (target == m_end) {
+        return m_remaining > 0;
+    }
+
+    m_end = target;
+    m_remaining = m_rampSamples;
+    if (m_curve == Linear) {
+        m_step = (target - m_current) / float(m_rampSamples);
+    } else {
+        // A ratio cannot leave or reach zero, so both ends stop at the floor
+        const float from = std::max(m_current, kExponentialFloor);
+        const float to = std::max(target, kExponentialFloor);
+        m_current = from;
+        m_step = std::pow(to / from, 1.0f / float(m_rampSamples));
+    }
+    return true;
+}
+
+float SmoothedParameter::advance(int frames) {
+    update();
+    if (m_remaining == 0 || frames <= 0) {
+        return m_current;
+    }
+
+    const int steps = std::min(frames, m_remaining);
+    m_remaining -= steps;
+    if (m_remaining == 0) {
+        m_current = m_end;
+    } else if (m_curve == Linear) {
+        m_current += m_step * float(steps);
+    } else {
+        m_current *= std::pow(m_step, float(steps));
+    }
+    return m_current;
+}
+
+void SmoothedParameter::applyGain(float* data, int frames, int channels) {
+    update();
+    int frame = 0;
+    for (; frame < frames && m_remaining > 0; ++frame) {
+        const float gain = next();
+        for (int channel = 0; channel < channels; ++channel) {
+            data[frame * channels + channel] *= gain;
+        }
+    }
+
+    // The rest of the block is past the ramp
+    if (frame < frames && m_current != 1.0f) {
+        const float gain = m_current;
+        for (int sample = frame * channels; sample < frames * channels; ++sample) {
+            data[sample] *= gain;
+        }
+    }
+}
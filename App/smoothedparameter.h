@@ -0,0 +1,79 @@
+#ifndef SMOOTHEDPARAMETER_H
+#define SMOOTHEDPARAMETER_H
+
+#include <atomic>
+
+// A control value set from any thread and followed on the audio thread
+// with a ramp, so moving a fader or a knob never steps the signal.
+//
+// set() only stores the target in an atomic: the GUI thread never waits
+// and the audio thread never locks. The audio thread picks the target up
+// at its next block and ramps to it over rampMs, restarting from wherever
+// it is when the target moves again mid-ramp. A linear ramp suits mix
+// levels and coefficients; an exponential one moves by a constant ratio
+// per sample, which the ear hears as an even fade, and suits gains. It
+// runs from and to kExponentialFloor in place of zero.
+//
+// Per sample: update() once per block, then next() for every sample.
+// Per block, for values such as filter coefficients that are recomputed
+// once a block: advance(frames). For a gain: applyGain().
+class SmoothedParameter {
+public:
+    enum Curve { Linear, Exponential };
+
+    static constexpr float kExponentialFloor = 1e-4f; // -80 dB
+
+    explicit SmoothedParameter(float value = 0.0f, Curve curve = Linear, double rampMs = 20.0);
+
+    SmoothedParameter(const SmoothedParameter&) = delete;
+    SmoothedParameter& operator=(const SmoothedParameter&) = delete;
+
+    // Ramp length at the stream rate. Not while the audio thread uses it.
+    void prepare(int sampleRate);
+    double rampMs() const { return m_rampMs; }
+
+    // Any thread. Returns whether the target changed.
+    bool set(float value) { return m_target.exchange(value, std::memory_order_relaxed) != value; }
+    float target() const { return m_target.load(std::memory_order_relaxed); }
+
+    // Audio thread, or any thread while the audio thread cannot see it
+
+    // Jump to the target, for reset()
+    void snap();
+
+    // Picks up a new target; true while ramping
+    bool update();
+
+    float current() const { return m_current; }
+    bool isSmoothing() const { return m_remaining > 0; }
+
+    float next() {
+        if (m_remaining > 0) {
+            m_current = m_curve == Linear ? m_current + m_step : m_current * m_step;
+            if (--m_remaining == 0) {
+                m_current = m_end;
+            }
+        }
+        return m_current;
+    }
+
+    // Moves frames samples on and returns the value there
+    float advance(int frames);
+
+    // Scales interleaved frames by the value, sample by sample
+    void applyGain(float* data, int frames, int channels);
+
+private:
+    std::atomic<float> m_target;
+    const Curve m_curve;
+    const double m_rampMs;
+    int m_rampSamples = 1;
+
+    // Audio thread
+    float m_current = 0.0f;
+    float m_end = 0.0f;
+    float m_step = 0.0f;  // added per sample, or the ratio when exponential
+    int m_remaining = 0;
+};
+
+#endif // SMOOTHEDPARAMETER_H
@@ -0,0 +1,177 @@
+#include "songindex.h"
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QStandardPaths>
+#include <QtEndian>
+#include <algorithm>
+#include <cstring>
+
+namespace {
+
+constexpr int kMaxLength = 0xffff;
+
+// Bounds-checked cursor over the index bytes; any overrun sets failed
+struct Reader {
+    const uchar* data;
+    qint64 size;
+    qint64 pos = 0;
+    bool failed = false;
+
+    const uchar* take(qint64 bytes) {
+        if (failed || bytes > size - pos) {
+            failed = true;
+            return nullptr;
+        }
+        const uchar* at = data + pos;
+        pos += bytes;
+        return at;
+    }
+
+    template<typename T>
+    T value() {
+        const uchar* at = take(qint64(sizeof(T)));
+        return at ? qFromLittleEndian<T>(at) : T(0);
+    }
+
+    QByteArray bytes() {
+        const int length = value<quint16>();
+        const uchar* at = take(length);
+        return at ? QByteArray(reinterpret_cast<const char*>(at), length) : QByteArray();
+    }
+};
+
+template<typename T>
+void append(QByteArray& out, T value) {
+    uchar bytes[sizeof(T)];
+    qToLittleEndian<T>(value, bytes);
+    out.append(reinterpret_cast<const char*>(bytes), qsizetype(sizeof(T)));
+}
+
+void appendBytes(QByteArray& out, const QByteArray& bytes) {
+    const QByteArray clipped = bytes.left(kMaxLength);
+    append<quint16>(out, quint16(clipped.size()));
+    out.append(clipped);
+}
+
+} // namespace
+
+QString SongIndex::defaultPath() {
+    return QStandardPaths::writableLocation(QStandardPaths::CacheLocation) + "/library.index";
+}
+
+bool SongIndex::load(const QString& path, QVector<SongInfo>& songs, QStringList& roots) {
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+    const QByteArray contents = file.readAll();
+    Reader reader{reinterpret_cast<const uchar*>(contents.constData()), contents.size()};
+
+    const uchar* magic = reader.take(4);
+    const quint16 version = reader.value<quint16>();
+    const quint16 headerSize = reader.value<quint16>();
+    const quint32 songCount = reader.value<quint32>();
+    const quint32 rootCount = reader.value<quint32>();
+    if (reader.failed || memcmp(magic, "KLIB", 4) != 0 || version != kVersion || headerSize < kHeaderSize) {
+        qWarning() << path << "is not a current song index";
+        return false;
+    }
+    reader.take(headerSize - 16);
+
+    QStringList loadedRoots;
+    for (quint32 i = 0; i < rootCount && !reader.failed; ++i) {
+        loadedRoots.append(QString::fromUtf8(reader.bytes()));
+    }
+
+    // Every record is at least 32 bytes, so a corrupt count cannot make
+    // this reserve more than the file could hold
+    QVector<SongInfo> loaded;
+    loaded.reserve(qsizetype(qMin<qint64>(songCount, contents.size() / 32)));
+    QByteArray previousPath;
+    for (quint32 i = 0; i < songCount && !reader.failed; ++i) {
+        const int shared = reader.value<quint16>();
+        if (shared > previousPath.size()) {
+            reader.failed = true;
+            break;
+        }
+        QByteArray pathBytes = previousPath.left(shared) + reader.bytes();
+
+        SongInfo song;
+        song.path = QString::fromUtf8(pathBytes);
+        song.title = QString::fromUtf8(reader.bytes());
+        song.artist = QString::fromUtf8(reader.bytes());
+        song.size = reader.value<qint64>();
+        song.modifiedMs = reader.value<qint64>();
+        song.durationMs = reader.value<quint32>();
+        song.width = reader.value<quint16>();
+        song.height = reader.value<quint16>();
+        loaded.append(song);
+        previousPath = std::move(pathBytes);
+    }
+    if (reader.failed) {
+        qWarning() << path << "is truncated";
+        return false;
+    }
+
+    songs = std::move(loaded);
+    roots = loadedRoots;
+    return true;
+}
+
+bool SongIndex::save(const QString& path, QVector<SongInfo> songs, const QStringList& roots) {
+    std::sort(songs.begin(), songs.end(), [](const SongInfo& a, const SongInfo& b) { return a.path < b.path; });
+
+    QByteArray out;
+    out.reserve(kHeaderSize + songs.size() * 64);
+    out.append("KLIB", 4);
+    append<quint16>(out, kVersion);
+    append<quint16>(out, kHeaderSize);
+    append<quint32>(out, quint32(songs.size()));
+    append<quint32>(out, quint32(roots.size()));
+    out.append(kHeaderSize - out.size(), '\0');
+
+    for (const QString& root : roots) {
+        appendBytes(out, root.toUtf8());
+    }
+
+    QByteArray previousPath;
+    quint32 written = 0;
+    for (const SongInfo& song : std::as_const(songs)) {
+        QByteArray pathBytes = song.path.toUtf8();
+        int shared = 0;
+        const int limit = int(qMin(qMin(pathBytes.size(), previousPath.size()), qsizetype(kMaxLength)));
+        while (shared < limit && pathBytes[shared] == previousPath[shared]) {
+            ++shared;
+        }
+        // The rest of the path must fit its length field, or it cannot be restored
+        if (pathBytes.size() - shared > kMaxLength) {
+            continue;
+        }
+        append<quint16>(out, quint16(shared));
+        appendBytes(out, pathBytes.mid(shared));
+        appendBytes(out, song.title.toUtf8());
+        appendBytes(out, song.artist.toUtf8());
+        append<qint64>(out, song.size);
+        append<qint64>(out, song.modifiedMs);
+        append<quint32>(out, quint32(qBound<qint64>(0, song.durationMs, 0xffffffff)));
+        append<quint16>(out, quint16(qBound(0, song.width, kMaxLength)));
+        append<quint16>(out, quint16(qBound(0, song.height, kMaxLength)));
+        previousPath = std::move(pathBytes);
+        ++written;
+    }
+    if (written != quint32(songs.size())) {
+        qToLittleEndian<quint32>(written, reinterpret_cast<uchar*>(out.data()) + 8);
+    }
+
+    QDir().mkpath(QFileInfo(path).absolutePath());
+    QSaveFile file(path);
+    if (!file.open(QIODevice::WriteOnly)) {
+        qWarning() << "Cannot write" << path << file.errorString();
+        return false;
+    }
+    file.write(out);
+    return file.commit();
+}
@@ -0,0 +1,64 @@
+#ifndef SONGINDEX_H
+#define SONGINDEX_H
+
+#include <QString>
+#include <QStringList>
+#include <QVector>
+
+// What the song library knows about one media file
+struct SongInfo {
+    QString path;       // absolute
+    QString title;
+    QString artist;
+    qint64 size = 0;        // of the file when it was probed
+    qint64 modifiedMs = 0;  // its modification time, ms since the epoch
+    qint64 durationMs = 0;  // 0 when unknown
+    int width = 0;          // video picture, 0 for audio only
+    int height = 0;
+
+    // True when the file on disk still has the stamps this was made from
+    bool isCurrent(qint64 fileSize, qint64 fileModifiedMs) const {
+        return size == fileSize && modifiedMs == fileModifiedMs;
+    }
+};
+
+// On-disk cache of the song library, so a restart shows the songs at once
+// and only rescans what changed.
+//
+// The file is a 32 byte little-endian header, the scanned roots and then
+// one variable length record per song, sorted by path:
+//
+//   offset  size  field
+//        0     4  magic "KLIB"
+//        4     2  version (kVersion)
+//        6     2  header size in bytes
+//        8     4  song count
+//       12     4  root count
+//       16    16  reserved, zero
+//
+//   root:  u16 length, UTF-8 path
+//   song:  u16 bytes of the path shared with the previous song,
+//          u16 length and UTF-8 of the rest of the path,
+//          u16 length and UTF-8 of the title, the same for the artist,
+//          i64 file size, i64 modification time in ms since the epoch,
+//          u32 duration in ms, u16 video width, u16 video height
+//
+// Sorted paths share long directory prefixes, so front coding keeps a
+// 100k song index to a few MB. A file that fails any check is ignored
+// whole, and the library rebuilds it by scanning.
+class SongIndex {
+public:
+    static constexpr quint16 kVersion = 1;
+    static constexpr int kHeaderSize = 32;
+
+    // Where the index lives unless told otherwise
+    static QString defaultPath();
+
+    // False if the file is missing, truncated or a different version
+    static bool load(const QString& path, QVector<SongInfo>& songs, QStringList& roots);
+
+    // Write atomically (temporary file and rename); sorts songs by path
+    static bool save(const QString& path, QVector<SongInfo> songs, const QStringList& roots);
+};
+
+#endif // SONGINDEX_H
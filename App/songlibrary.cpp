@@ -0,0 +1,358 @@
+#include "songlibrary.h"
+#include "mediaprobe.h"
+#include <QDateTime>
+#include <QDebug>
+#include <QDir>
+#include <QDirIterator>
+#include <QFileInfo>
+#include <QStandardPaths>
+#include <QThread>
+#include <QUrl>
+
+namespace {
+
+QHash<QString, int> rowsOf(const QVector<SongInfo>& songs) {
+    QHash<QString, int> rows;
+    rows.reserve(songs.size());
+    for (int row = 0; row < songs.size(); ++row) {
+        rows.insert(songs[row].path, row);
+    }
+    return rows;
+}
+
+QStringList defaultRoots() {
+    QStringList roots;
+    for (QStandardPaths::StandardLocation location : {QStandardPaths::MusicLocation, QStandardPaths::MoviesLocation}) {
+        const QString root = QStandardPaths::writableLocation(location);
+        if (!root.isEmpty() && !roots.contains(root)) {
+            roots.append(root);
+        }
+    }
+    return roots;
+}
+
+} // namespace
+
+const QStringList& SongLibrary::mediaFilters() {
+    static const QStringList filters = {"*.mp4", "*.mkv", "*.webm", "*.avi", "*.mov",
+                                        "*.mp3", "*.m4a", "*.ogg", "*.flac", "*.wav"};
+    return filters;
+}
+
+SongLibrary::SongLibrary(QObject* parent) : QAbstractListModel(parent), m_indexPath(SongIndex::defaultPath()) {
+    m_pool.setMaxThreadCount(QThread::idealThreadCount());
+    m_pool.setThreadPriority(QThread::LowPriority);
+}
+
+SongLibrary::~SongLibrary() {
+    cancel();
+    m_pool.waitForDone();
+}
+
+void SongLibrary::setRoots(const QStringList& roots) {
+    QStringList cleaned;
+    for (const QString& root : roots) {
+        const QString path = QDir::cleanPath(QFileInfo(root).absoluteFilePath());
+        if (!root.isEmpty() && !cleaned.contains(path)) {
+            cleaned.append(path);
+        }
+    }
+    m_rootsSet = true;
+    if (cleaned == m_roots) {
+        return;
+    }
+    m_roots = cleaned;
+    m_rootsChangedSinceSave = true;
+    emit rootsChanged();
+
+    // The running scan is for the old roots
+    if (m_scanning) {
+        cancel();
+    }
+    if (m_loaded) {
+        rescan();
+    }
+}
+
+double SongLibrary::progress() const {
+    return m_filesQueued > 0 ? double(m_filesDone) / m_filesQueued : 0.0;
+}
+
+void SongLibrary::load() {
+    if (m_loading || m_loaded) {
+        return;
+    }
+    m_loading = true;
+    m_pool.start([this, path = m_indexPath]() {
+        QVector<SongInfo> songs;
+        QStringList roots;
+        SongIndex::load(path, songs, roots);
+        QHash<QString, int> rows = rowsOf(songs);
+        QMetaObject::invokeMethod(
+            this,
+            [this, songs = std::move(songs), rows = std::move(rows), roots]() mutable {
+                indexLoaded(std::move(songs), std::move(rows), roots);
+            },
+            Qt::QueuedConnection);
+    });
+}
+
+void SongLibrary::indexLoaded(QVector<SongInfo> songs, QHash<QString, int> rows, const QStringList& roots) {
+    beginResetModel();
+    m_songs = std::move(songs);
+    m_rows = std::move(rows);
+    endResetModel();
+
+    if (!m_rootsSet) {
+        m_roots = roots.isEmpty() ? defaultRoots() : roots;
+        m_rootsChangedSinceSave = roots.isEmpty();
+        emit rootsChanged();
+    }
+    m_loading = false;
+    m_loaded = true;
+    emit loadedChanged();
+    emit countChanged();
+    rescan();
+}
+
+void SongLibrary::rescan() {
+    if (!m_loaded) {
+        load();
+        return;
+    }
+    if (m_scanning) {
+        m_rescanPending = true;
+        return;
+    }
+
+    m_scanning = true;
+    m_walkDone = false;
+    m_seen.clear();
+    m_batchesQueued = m_batchesDone = 0;
+    m_filesQueued = m_filesDone = 0;
+    m_added = m_updated = 0;
+    emit scanningChanged();
+    emit progressChanged();
+
+    // The copy of the songs is shared until the GUI thread next changes them
+    m_pool.start([this, roots = m_roots, known = m_songs]() { walk(roots, known); });
+}
+
+void SongLibrary::cancel() {
+    if (m_scanning) {
+        // Queued batches still report back, they just skip the work
+        m_cancelled.store(true);
+    }
+}
+
+void SongLibrary::walk(const QStringList& roots, const QVector<SongInfo>& known) {
+    QHash<QString, const SongInfo*> stamps;
+    stamps.reserve(known.size());
+    for (const SongInfo& song : known) {
+        stamps.insert(song.path, &song);
+    }
+
+    QSet<QString> seen;
+    QVector<SongInfo> batch;
+    for (const QString& root : roots) {
+        QDirIterator it(root, mediaFilters(), QDir::Files, QDirIterator::Subdirectories);
+        while (it.hasNext() && !m_cancelled.load(std::memory_order_relaxed)) {
+            const QFileInfo file = it.nextFileInfo();
+            const QString path = file.absoluteFilePath();
+            if (seen.contains(path)) {
+                continue;  // under two roots
+            }
+            seen.insert(path);
+
+            const qint64 size = file.size();
+            const qint64 modifiedMs = file.lastModified().toMSecsSinceEpoch();
+            const SongInfo* song = stamps.value(path);
+            if (song && song->isCurrent(size, modifiedMs)) {
+                continue;
+            }
+            SongInfo info;
+            info.path = path;
+            info.size = size;
+            info.modifiedMs = modifiedMs;
+            batch.append(info);
+            if (batch.size() == kProbeBatch) {
+                queueBatch(std::move(batch));
+                batch.clear();
+            }
+        }
+    }
+    if (!batch.isEmpty()) {
+        queueBatch(std::move(batch));
+    }
+
+    QMetaObject::invokeMethod(this, [this, seen = std::move(seen)]() { walkFinished(seen); },
+                              Qt::QueuedConnection);
+}
+
+void SongLibrary::queueBatch(QVector<SongInfo> batch) {
+    // Counted before the batch can report back
+    const int files = int(batch.size());
+    QMetaObject::invokeMethod(this, [this, files]() { batchQueued(files); }, Qt::QueuedConnection);
+    m_pool.start([this, batch = std::move(batch)]() mutable { probeBatch(std::move(batch)); });
+}
+
+void SongLibrary::probeBatch(QVector<SongInfo> batch) {
+    QVector<SongInfo> songs;
+    int files = 0;
+    for (SongInfo& info : batch) {
+        if (m_cancelled.load(std::memory_order_relaxed)) {
+            break;
+        }
+        if (MediaProbe::probe(info.path, info)) {
+            songs.append(info);
+        }
+        ++files;
+    }
+    QMetaObject::invokeMethod(
+        this, [this, songs = std::move(songs), files]() { batchProbed(songs, files); }, Qt::QueuedConnection);
+}
+
+void SongLibrary::batchQueued(int files) {
+    ++m_batchesQueued;
+    m_filesQueued += files;
+    emit progressChanged();
+}
+
+void SongLibrary::batchProbed(const QVector<SongInfo>& songs, int files) {
+    ++m_batchesDone;
+    m_filesDone += files;
+
+    QVector<SongInfo> added;
+    for (const SongInfo& song : songs) {
+        const int row = m_rows.value(song.path, -1);
+        if (row >= 0) {
+            m_songs[row] = song;
+            emit dataChanged(index(row), index(row));
+            ++m_updated;
+        } else {
+            added.append(song);
+        }
+    }
+    if (!added.isEmpty()) {
+        const int first = int(m_songs.size());
+        beginInsertRows(QModelIndex(), first, first + int(added.size()) - 1);
+        for (const SongInfo& song : std::as_const(added)) {
+            m_rows.insert(song.path, int(m_songs.size()));
+            m_songs.append(song);
+        }
+        endInsertRows();
+        m_added += int(added.size());
+        emit countChanged();
+    }
+    emit progressChanged();
+
+    if (m_walkDone && m_batchesDone == m_batchesQueued) {
+        finishScan();
+    }
+}
+
+void SongLibrary::walkFinished(const QSet<QString>& seen) {
+    m_walkDone = true;
+    m_seen = seen;
+    if (m_batchesDone == m_batchesQueued) {
+        finishScan();
+    }
+}
+
+void SongLibrary::finishScan() {
+    // A cancelled walk has not seen everything, so it cannot tell what is gone
+    int removed = 0;
+    if (!m_cancelled.load()) {
+        for (int row = int(m_songs.size()) - 1; row >= 0; --row) {
+            if (m_seen.contains(m_songs[row].path)) {
+                continue;
+            }
+            int first = row;
+            while (first > 0 && !m_seen.contains(m_songs[first - 1].path)) {
+                --first;
+            }
+            beginRemoveRows(QModelIndex(), first, row);
+            m_songs.remove(first, row - first + 1);
+            endRemoveRows();
+            removed += row - first + 1;
+            row = first;
+        }
+        if (removed > 0) {
+            m_rows = rowsOf(m_songs);
+            emit countChanged();
+        }
+    }
+    m_seen.clear();
+
+    if (m_added > 0 || m_updated > 0 || removed > 0 || m_rootsChangedSinceSave) {
+        save();
+    }
+
+    m_cancelled.store(false);
+    m_scanning = false;
+    emit scanningChanged();
+    emit progressChanged();
+    emit scanFinished(m_added, m_updated, removed);
+
+    if (m_rescanPending) {
+        m_rescanPending = false;
+        rescan();
+    }
+}
+
+void SongLibrary::save() {
+    m_rootsChangedSinceSave = false;
+    m_pool.start([path = m_indexPath, songs = m_songs, roots = m_roots]() {
+        SongIndex::save(path, songs, roots);
+    });
+}
+
+QVariantMap SongLibrary::get(int row) const {
+    QVariantMap song;
+    const QHash<int, QByteArray> names = roleNames();
+    for (auto it = names.cbegin(); it != names.cend(); ++it) {
+        song.insert(QString::fromUtf8(it.value()), data(index(row), it.key()));
+    }
+    return song;
+}
+
+int SongLibrary::rowCount(const QModelIndex& parent) const {
+    return parent.isValid() ? 0 : int(m_songs.size());
+}
+
+QVariant SongLibrary::data(const QModelIndex& index, int role) const {
+    if (!index.isValid() || index.row() >= m_songs.size()) {
+        return QVariant();
+    }
+    const SongInfo& song = m_songs[index.row()];
+    switch (role) {
+    case Qt::DisplayRole:
+    case TitleRole:
+        return song.title;
+    case PathRole:
+        return song.path;
+    case UrlRole:
+        return QUrl::fromLocalFile(song.path);
+    case ArtistRole:
+        return song.artist;
+    case DurationMsRole:
+        return song.durationMs;
+    case VideoWidthRole:
+        return song.width;
+    case VideoHeightRole:
+        return song.height;
+    }
+    return QVariant();
+}
+
+QHash<int, QByteArray> SongLibrary::roleNames() const {
+    return {
+        {PathRole, "path"},
+        {UrlRole, "url"},
+        {TitleRole, "title"},
+        {ArtistRole, "artist"},
+        {DurationMsRole, "durationMs"},
+        {VideoWidthRole, "videoWidth"},
+        {VideoHeightRole, "videoHeight"},
+    };
+}
@@ -0,0 +1,132 @@
+#ifndef SONGLIBRARY_H
+#define SONGLIBRARY_H
+
+#include <QAbstractListModel>
+#include <QHash>
+#include <QSet>
+#include <QStringList>
+#include <QThreadPool>
+#include <QVariantMap>
+#include <QVector>
+#include <atomic>
+#include "songindex.h"
+
+// The songs under the library roots, as a list model for the song screen.
+//
+// load() reads the SongIndex on the worker pool and shows its songs as
+// soon as they arrive, then rescans the roots. The scan walks the roots
+// on one worker and hands files that are new or whose size or mtime
+// changed to the other workers in batches of kProbeBatch for MediaProbe.
+// Results come back to the GUI thread a batch at a time; songs whose file
+// has gone are dropped once the walk is complete, and the index is saved
+// again on the pool when anything changed. Nothing here blocks the GUI
+// thread on the disk. Files that cannot be probed are left out, and tried
+// again by the next scan.
+class SongLibrary : public QAbstractListModel {
+    Q_OBJECT
+    Q_PROPERTY(QStringList roots READ roots WRITE setRoots NOTIFY rootsChanged)
+    Q_PROPERTY(int count READ count NOTIFY countChanged)
+    Q_PROPERTY(bool loaded READ isLoaded NOTIFY loadedChanged)
+    Q_PROPERTY(bool scanning READ isScanning NOTIFY scanningChanged)
+    Q_PROPERTY(double progress READ progress NOTIFY progressChanged)
+
+public:
+    enum Role {
+        PathRole = Qt::UserRole + 1,
+        UrlRole,
+        TitleRole,
+        ArtistRole,
+        DurationMsRole,
+        VideoWidthRole,
+        VideoHeightRole,
+    };
+    Q_ENUM(Role)
+
+    static constexpr int kProbeBatch = 32;
+
+    // File patterns the scan picks up
+    static const QStringList& mediaFilters();
+
+    explicit SongLibrary(QObject* parent = nullptr);
+    ~SongLibrary();
+
+    // Index file, SongIndex::defaultPath() unless set before load()
+    QString indexPath() const { return m_indexPath; }
+    void setIndexPath(const QString& path) { m_indexPath = path; }
+
+    // Directories scanned for songs. Until set, the roots saved in the
+    // index, or the standard music and video locations.
+    QStringList roots() const { return m_roots; }
+    void setRoots(const QStringList& roots);
+
+    int count() const { return int(m_songs.size()); }
+    bool isLoaded() const { return m_loaded; }
+    bool isScanning() const { return m_scanning; }
+
+    // Files probed over files found to need it in this scan, in [0, 1]
+    double progress() const;
+
+    // Show the index, then scan
+    Q_INVOKABLE void load();
+
+    // Walk the roots again; a scan already running restarts when it ends
+    Q_INVOKABLE void rescan();
+
+    // Stop probing; the songs found so far stay, nothing is dropped
+    Q_INVOKABLE void cancel();
+
+    // Every role of a row by name, for QML outside a delegate
+    Q_INVOKABLE QVariantMap get(int row) const;
+
+    int rowCount(const QModelIndex& parent = QModelIndex()) const override;
+    QVariant data(const QModelIndex& index, int role = Qt::DisplayRole) const override;
+    QHash<int, QByteArray> roleNames() const override;
+
+signals:
+    void rootsChanged();
+    void countChanged();
+    void loadedChanged();
+    void scanningChanged();
+    void progressChanged();
+    void scanFinished(int added, int updated, int removed);
+
+private:
+    QThreadPool m_pool;
+    std::atomic<bool> m_cancelled{false};
+    QString m_indexPath;
+    QStringList m_roots;
+    bool m_rootsSet = false;
+    bool m_loading = false;
+    bool m_loaded = false;
+
+    QVector<SongInfo> m_songs;
+    QHash<QString, int> m_rows;   // path to row
+
+    // Scan state, GUI thread
+    bool m_scanning = false;
+    bool m_rescanPending = false;
+    bool m_walkDone = false;
+    QSet<QString> m_seen;
+    int m_batchesQueued = 0;
+    int m_batchesDone = 0;
+    int m_filesQueued = 0;
+    int m_filesDone = 0;
+    int m_added = 0;
+    int m_updated = 0;
+    bool m_rootsChangedSinceSave = false;
+
+    // Worker pool
+    void walk(const QStringList& roots, const QVector<SongInfo>& known);
+    void queueBatch(QVector<SongInfo> batch);
+    void probeBatch(QVector<SongInfo> batch);
+
+    // GUI thread
+    void indexLoaded(QVector<SongInfo> songs, QHash<QString, int> rows, const QStringList& roots);
+    void batchQueued(int files);
+    void batchProbed(const QVector<SongInfo>& songs, int files);
+    void walkFinished(const QSet<QString>& seen);
+    void finishScan();
+    void save();
+};
+
+#endif // SONGLIBRARY_H
@@ -0,0 +1,150 @@
+#ifndef SPSCRINGBUFFER_H
+#define SPSCRINGBUFFER_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstring>
+#include <memory>
+#include <type_traits>
+
+// Cache line size used to keep the producer and consumer indices apart.
+// 64 bytes covers x86 and the Cortex-A72 in the Raspberry Pi 4.
+constexpr std::size_t kCacheLineSize = 64;
+
+// Fixed-capacity, lock-free single-producer/single-consumer ring buffer.
+//
+// Exactly one thread may call the producer functions (write, writeAvailable)
+// and exactly one thread may call the consumer functions (read, skip,
+// skipTo, readAvailable) at the same time. Nothing allocates or blocks after
+// reset().
+template <typename T>
+class SpscRingBuffer {
+    static_assert(std::is_trivially_copyable<T>::value,
+                  "SpscRingBuffer only stores trivially copyable types");
+
+public:
+    explicit SpscRingBuffer(std::size_t capacity = 0) { reset(capacity); }
+
+    SpscRingBuffer(const SpscRingBuffer&) = delete;
+    SpscRingBuffer& operator=(const SpscRingBuffer&) = delete;
+
+    // Reallocates the storage, rounding capacity up to a power of two.
+    // Not thread safe: only call while neither side is running.
+    void reset(std::size_t capacity) {
+        std::size_t size = 1;
+        while (size < capacity) {
+            size <<= 1;
+        }
+        m_data.reset(capacity > 0 ? new T[size]() : nullptr);
+        m_capacity = capacity > 0 ? size : 0;
+        m_mask = m_capacity > 0 ? m_capacity - 1 : 0;
+        m_writeIndex.store(0, std::memory_order_relaxed);
+        m_readIndex.store(0, std::memory_order_relaxed);
+        m_cachedReadIndex = 0;
+        m_cachedWriteIndex = 0;
+    }
+
+    std::size_t capacity() const { return m_capacity; }
+
+    // Producer side: number of elements that can be written without overrun
+    std::size_t writeAvailable() const {
+        const std::size_t write = m_writeIndex.load(std::memory_order_relaxed);
+        const std::size_t read = m_readIndex.load(std::memory_order_acquire);
+        return m_capacity - (write - read);
+    }
+
+    // Consumer side: number of elements ready to be read
+    std::size_t readAvailable() const {
+        const std::size_t read = m_readIndex.load(std::memory_order_relaxed);
+        const std::size_t write = m_writeIndex.load(std::memory_order_acquire);
+        return write - read;
+    }
+
+    // Elements written since reset(), as a position for skipTo(). Any thread.
+    std::size_t writePosition() const { return m_writeIndex.load(std::memory_order_acquire); }
+
+    // Writes up to count elements and returns how many were stored
+    std::size_t write(const T* data, std::size_t count) {
+        const std::size_t write = m_writeIndex.load(std::memory_order_relaxed);
+        std::size_t free = m_capacity - (write - m_cachedReadIndex);
+        if (free < count) {
+            // Only touch the consumer's cache line when we look full
+            m_cachedReadIndex = m_readIndex.load(std::memory_order_acquire);
+            free = m_capacity - (write - m_cachedReadIndex);
+        }
+
+        const std::size_t toWrite = count < free ? count : free;
+        if (toWrite == 0) {
+            return 0;
+        }
+
+        const std::size_t offset = write & m_mask;
+        const std::size_t firstPart = toWrite < m_capacity - offset ? toWrite : m_capacity - offset;
+        std::memcpy(m_data.get() + offset, data, firstPart * sizeof(T));
+        std::memcpy(m_data.get(), data + firstPart, (toWrite - firstPart) * sizeof(T));
+
+        m_writeIndex.store(write + toWrite, std::memory_order_release);
+        return toWrite;
+    }
+
+    // Reads up to count elements and returns how many were copied out
+    std::size_t read(T* data, std::size_t count) {
+        const std::size_t read = m_readIndex.load(std::memory_order_relaxed);
+        std::size_t available = m_cachedWriteIndex - read;
+        if (available < count) {
+            m_cachedWriteIndex = m_writeIndex.load(std::memory_order_acquire);
+            available = m_cachedWriteIndex - read;
+        }
+
+        const std::size_t toRead = count < available ? count : available;
+        if (toRead == 0) {
+            return 0;
+        }
+
+        const std::size_t offset = read & m_mask;
+        const std::size_t firstPart = toRead < m_capacity - offset ? toRead : m_capacity - offset;
+        std::memcpy(data, m_data.get() + offset, firstPart * sizeof(T));
+        std::memcpy(data + firstPart, m_data.get(), (toRead - firstPart) * sizeof(T));
+
+        m_readIndex.store(read + toRead, std::memory_order_release);
+        return toRead;
+    }
+
+    // Discards up to count elements from the consumer side
+    std::size_t skip(std::size_t count) {
+        const std::size_t read = m_readIndex.load(std::memory_order_relaxed);
+        m_cachedWriteIndex = m_writeIndex.load(std::memory_order_acquire);
+        const std::size_t available = m_cachedWriteIndex - read;
+        const std::size_t toSkip = count < available ? count : available;
+        m_readIndex.store(read + toSkip, std::memory_order_release);
+        return toSkip;
+    }
+
+    // Discards whatever precedes position, a writePosition() taken earlier,
+    // rounded down to a multiple of granule elements. Consumer side.
+    std::size_t skipTo(std::size_t position, std::size_t granule = 1) {
+        const std::size_t read = m_readIndex.load(std::memory_order_relaxed);
+        const std::size_t behind = position - read;
+        if (behind == 0 || behind > m_capacity) {
+            // Nothing left before it, or already read past it
+            return 0;
+        }
+        return skip(behind / granule * granule);
+    }
+
+private:
+    // Producer-owned line
+    alignas(kCacheLineSize) std::atomic<std::size_t> m_writeIndex{0};
+    std::size_t m_cachedReadIndex = 0;
+
+    // Consumer-owned line
+    alignas(kCacheLineSize) std::atomic<std::size_t> m_readIndex{0};
+    std::size_t m_cachedWriteIndex = 0;
+
+    // Shared, read-only after reset()
+    alignas(kCacheLineSize) std::unique_ptr<T[]> m_data;
+    std::size_t m_capacity = 0;
+    std::size_t m_mask = 0;
+};
+
+#endif // SPSCRINGBUFFER_H
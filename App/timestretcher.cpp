@@ -0,0 +1,176 @@
+#include "timestretcher.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace {
+
+constexpr double kPi = 3.14159265358979323846;
+
+// 9 ms windows and a +-5 ms search keep the lookahead at 14 ms of input,
+// 28 ms of wall time at half speed. The search spans a full cycle of
+// anything above 100 Hz, which covers the combined period of most
+// chords; a lower bass note is aligned to the nearest cycle that fits.
+constexpr double kWindowMs = 9.0;
+constexpr double kSearchMs = 5.0;
+
+// Room for decoder buffers on top of the working set
+constexpr int kChunkFrames = 4096;
+constexpr int kConvertFrames = 1024;
+
+} // namespace
+
+TimeStretcher::TimeStretcher() {
+    configure(m_sampleRate, m_channelCount);
+}
+
+void TimeStretcher::configure(int sampleRate, int channelCount) {
+    m_sampleRate = sampleRate;
+    m_channelCount = std::max(1, channelCount);
+    m_hopFrames = std::max(32, int(kWindowMs * sampleRate / 2000.0));
+    m_windowFrames = 2 * m_hopFrames;
+    m_searchFrames = std::max(16, int(kSearchMs * sampleRate / 1000.0));
+
+    m_window.resize(size_t(m_windowFrames));
+    for (int i = 0; i < m_windowFrames; ++i) {
+        m_window[i] = float(0.5 - 0.5 * std::cos(2.0 * kPi * i / m_windowFrames));
+    }
+
+    m_capacityFrames = 2 * (m_windowFrames + 3 * m_searchFrames) + kChunkFrames;
+    m_input.assign(size_t(m_capacityFrames) * m_channelCount, 0.0f);
+    m_mono.assign(size_t(m_capacityFrames), 0.0f);
+    m_overlap.assign(size_t(m_windowFrames) * m_channelCount, 0.0f);
+    m_energy.assign(size_t(2 * m_searchFrames + m_hopFrames + 1), 0.0);
+    m_convert.assign(size_t(kConvertFrames) * m_channelCount, 0.0f);
+    reset();
+}
+
+void TimeStretcher::setRate(double rate) {
+    m_rate = std::clamp(rate, kMinRate, kMaxRate);
+}
+
+void TimeStretcher::reset() {
+    // Leading silence gives the first searches somewhere to look backwards
+    std::fill(m_input.begin(), m_input.begin() + size_t(m_searchFrames) * m_channelCount, 0.0f);
+    std::fill(m_mono.begin(), m_mono.begin() + m_searchFrames, 0.0f);
+    std::fill(m_overlap.begin(), m_overlap.end(), 0.0f);
+    m_inputFrames = m_searchFrames;
+    m_nominal = m_searchFrames;
+    m_previous = 0;
+    m_primed = false;
+    m_shiftPending = false;
+}
+
+int TimeStretcher::append(const float* input, int frames) {
+    const int count = std::min(frames, m_capacityFrames - m_inputFrames);
+    const int channels = m_channelCount;
+    std::memcpy(m_input.data() + size_t(m_inputFrames) * channels, input, sizeof(float) * size_t(count) * channels);
+    for (int frame = 0; frame < count; ++frame) {
+        float sum = 0.0f;
+        for (int channel = 0; channel < channels; ++channel) {
+            sum += input[frame * channels + channel];
+        }
+        m_mono[m_inputFrames + frame] = sum;
+    }
+    m_inputFrames += count;
+    return count;
+}
+
+int TimeStretcher::bestOffset(int nominal) {
+    const int natural = m_previous + m_hopFrames;
+    if (nominal == natural) {
+        return 0;
+    }
+
+    // Compare the half of the new segment that overlaps the previous one
+    const int length = m_hopFrames;
+    const int first = nominal - m_searchFrames;
+    const float* reference = m_mono.data() + natural;
+    const int span = 2 * m_searchFrames + length;
+    double* energy = m_energy.data();
+    energy[0] = 0.0;
+    for (int i = 0; i < span; ++i) {
+        const double value = m_mono[first + i];
+        energy[i + 1] = energy[i] + value * value;
+    }
+
+    auto score = [&](int offset) {
+        const float* candidate = m_mono.data() + first + offset;
+        float dot = 0.0f;
+        for (int i = 0; i < length; ++i) {
+            dot += candidate[i] * reference[i];
+        }
+        const double power = energy[offset + length] - energy[offset];
+        return power > 1e-9 ? dot / std::sqrt(power) : 0.0;
+    };
+
+    // Every other lag first, then the neighbours of the best one
+    int best = m_searchFrames;
+    double bestScore = -1e30;
+    for (int offset = 0; offset <= 2 * m_searchFrames; offset += 2) {
+        const double value = score(offset);
+        if (value > bestScore) {
+            bestScore = value;
+            best = offset;
+        }
+    }
+    const int coarse = best;
+    for (int offset : {coarse - 1, coarse + 1}) {
+        if (offset >= 0 && offset <= 2 * m_searchFrames) {
+            const double value = score(offset);
+            if (value > bestScore) {
+                bestScore = value;
+                best = offset;
+            }
+        }
+    }
+    return best - m_searchFrames;
+}
+
+bool TimeStretcher::nextHop() {
+    const int channels = m_channelCount;
+    if (m_shiftPending) {
+        const size_t hopSamples = size_t(m_hopFrames) * channels;
+        std::memmove(m_overlap.data(), m_overlap.data() + hopSamples, sizeof(float) * hopSamples);
+        std::fill(m_overlap.begin() + hopSamples, m_overlap.end(), 0.0f);
+        m_shiftPending = false;
+    }
+
+    const int nominal = int(std::floor(m_nominal));
+    if (nominal + m_searchFrames + m_windowFrames > m_inputFrames) {
+        return false;
+    }
+
+    const int position = m_primed ? nominal + bestOffset(nominal) : nominal;
+    const float* segment = m_input.data() + size_t(position) * channels;
+    float* out = m_overlap.data();
+    for (int frame = 0; frame < m_windowFrames; ++frame) {
+        const float gain = m_window[frame];
+        for (int channel = 0; channel < channels; ++channel) {
+            out[frame * channels + channel] += gain * segment[frame * channels + channel];
+        }
+    }
+
+    m_previous = position;
+    m_primed = true;
+    m_nominal += m_hopFrames * m_rate;
+    m_shiftPending = true;
+    return true;
+}
+
+void TimeStretcher::discardConsumed() {
+    int keep = int(std::floor(m_nominal)) - m_searchFrames;
+    if (m_primed) {
+        keep = std::min(keep, m_previous + m_hopFrames);
+    }
+    if (keep <= 0) {
+        return;
+    }
+    const int channels = m_channelCount;
+    const int remaining = m_inputFrames - keep;
+    std::memmove(m_input.data(), m_input.data() + size_t(keep) * channels, sizeof(float) * size_t(remaining) * channels);
+    std::memmove(m_mono.data(), m_mono.data() + keep, sizeof(float) * size_t(remaining));
+    m_inputFrames = remaining;
+    m_nominal -= keep;
+    m_previous -= keep;
+}
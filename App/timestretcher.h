@@ -0,0 +1,114 @@
+#ifndef TIMESTRETCHER_H
+#define TIMESTRETCHER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Streaming WSOLA time-stretch (Verhelst & Roelands, ICASSP 1993): changes
+// the tempo of interleaved audio without changing its pitch.
+//
+// Output is built from Hann-windowed segments at a fixed hop with 50%
+// overlap, so overlapping windows sum to one. The input position of each
+// segment advances by rate x the output hop, then moves by up to
+// searchFrames to where the input looks most like the natural continuation
+// of the previous segment (normalised cross-correlation of the overlap on
+// the channel sum). Segments therefore join in phase and the only changes
+// are whole waveform cycles being repeated or skipped.
+//
+// At rate 1 the natural continuation is always the chosen segment and the
+// output is the input delayed. Everything is sized in configure(), so
+// process() never allocates.
+class TimeStretcher {
+public:
+    static constexpr double kMinRate = 0.5;
+    static constexpr double kMaxRate = 1.5;
+
+    TimeStretcher();
+
+    void configure(int sampleRate, int channelCount);
+
+    // Input frames consumed per output frame: 0.5 plays at half speed
+    void setRate(double rate);
+    double rate() const { return m_rate; }
+
+    int channelCount() const { return m_channelCount; }
+    int hopFrames() const { return m_hopFrames; }
+
+    // Input buffered ahead of the output, in input frames. Divided by the
+    // rate and sample rate this is the added delay in seconds.
+    int latencyFrames() const { return m_windowFrames + m_searchFrames; }
+
+    // Drop buffered audio, the next input starts a new stream
+    void reset();
+
+    // Push interleaved input; onOutput(const float* frames, int count) runs
+    // with every hop of output that becomes ready
+    template <typename Callback>
+    void process(const float* input, int frames, Callback&& onOutput);
+
+    // Int16 input is scaled to [-1, 1) in blocks, without allocating
+    template <typename Callback>
+    void process(const int16_t* input, int frames, Callback&& onOutput);
+
+private:
+    int m_sampleRate = 48000;
+    int m_channelCount = 2;
+    int m_windowFrames = 0;
+    int m_hopFrames = 0;
+    int m_searchFrames = 0;
+    double m_rate = 1.0;
+
+    std::vector<float> m_window;   // Hann, periodic
+    std::vector<float> m_input;    // interleaved, linear with compaction
+    std::vector<float> m_mono;     // channel sum of m_input, same indexing
+    int m_capacityFrames = 0;
+    int m_inputFrames = 0;
+
+    std::vector<float> m_overlap;  // interleaved output accumulator, one window
+    double m_nominal = 0.0;        // unadjusted input position of the next segment
+    int m_previous = 0;            // input position of the last segment
+    bool m_primed = false;
+    bool m_shiftPending = false;   // last hop was handed out, slide m_overlap
+
+    std::vector<double> m_energy;  // prefix sums of mono^2 over the search range
+
+    std::vector<float> m_convert;
+
+    // Append input, returns how many frames fitted
+    int append(const float* input, int frames);
+    // Produce one hop of output into m_overlap if enough input is buffered
+    bool nextHop();
+    int bestOffset(int nominal);
+    void discardConsumed();
+};
+
+template <typename Callback>
+void TimeStretcher::process(const float* input, int frames, Callback&& onOutput) {
+    while (frames > 0) {
+        const int used = append(input, frames);
+        input += std::size_t(used) * m_channelCount;
+        frames -= used;
+        while (nextHop()) {
+            onOutput(m_overlap.data(), m_hopFrames);
+        }
+        discardConsumed();
+    }
+}
+
+template <typename Callback>
+void TimeStretcher::process(const int16_t* input, int frames, Callback&& onOutput) {
+    const int block = int(m_convert.size()) / m_channelCount;
+    while (frames > 0) {
+        const int count = frames < block ? frames : block;
+        const int samples = count * m_channelCount;
+        for (int i = 0; i < samples; ++i) {
+            m_convert[i] = input[i] * (1.0f / 32768.0f);
+        }
+        process(m_convert.data(), count, onOutput);
+        input += samples;
+        frames -= count;
+    }
+}
+
+#endif // TIMESTRETCHER_H
@@ -0,0 +1,331 @@
+#include "vocalreducer.h"
+#include <QtGlobal>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace {
+
+// On/off ramp and mode crossfade
+constexpr double kRampMs = 30.0;
+constexpr double kFadeMs = 30.0;
+
+// About 20 ms windows: 1024 frames at 44.1 and 48 kHz
+constexpr double kSpectralWindowMs = 20.0;
+constexpr int kSpectralOverlap = 4;
+
+// Share of a new mask value taken per frame, damps musical noise
+constexpr float kMaskSmoothing = 0.5f;
+
+} // namespace
+
+// RBJ cookbook second order sections with Q = 1/sqrt(2) (Butterworth)
+void VocalReducer::designKeepFilters() {
+    const double low = 2.0 * M_PI * kLowCutHz / m_sampleRate;
+    const double high = 2.0 * M_PI * qMin(kHighCutHz, 0.45 * m_sampleRate) / m_sampleRate;
+    for (int section = 0; section < 2; ++section) {
+        Biquad& bass = m_bassKeep[section];
+        double alpha = std::sin(low) / std::sqrt(2.0);
+        double a0 = 1.0 + alpha;
+        bass.b0 = float((1.0 - std::cos(low)) / 2.0 / a0);
+        bass.b1 = float((1.0 - std::cos(low)) / a0);
+        bass.b2 = bass.b0;
+        bass.a1 = float(-2.0 * std::cos(low) / a0);
+        bass.a2 = float((1.0 - alpha) / a0);
+
+        Biquad& treble = m_trebleKeep[section];
+        alpha = std::sin(high) / std::sqrt(2.0);
+        a0 = 1.0 + alpha;
+        treble.b0 = float((1.0 + std::cos(high)) / 2.0 / a0);
+        treble.b1 = float(-(1.0 + std::cos(high)) / a0);
+        treble.b2 = treble.b0;
+        treble.a1 = float(-2.0 * std::cos(high) / a0);
+        treble.a2 = float((1.0 - alpha) / a0);
+    }
+}
+
+VocalReducer::VocalReducer(QObject* parent)
+    : AudioProcessor(parent), m_amount(0.0f, SmoothedParameter::Linear, kRampMs) {
+    m_kernels = &AudioKernels::active();
+    registerParameter(&m_amount);
+}
+
+void VocalReducer::setEnabled(bool enabled) {
+    m_amount.set(enabled ? float(strength()) : 0.0f);
+    if (m_enabled.exchange(enabled, std::memory_order_relaxed) != enabled) {
+        emit enabledChanged();
+    }
+}
+
+void VocalReducer::setMode(Mode mode) {
+    if (m_mode.exchange(mode, std::memory_order_relaxed) != mode) {
+        emit modeChanged();
+    }
+}
+
+void VocalReducer::setStrength(double strength) {
+    strength = qBound(0.0, strength, 1.0);
+    if (m_strength.exchange(strength, std::memory_order_relaxed) != strength) {
+        if (isEnabled()) {
+            m_amount.set(float(strength));
+        }
+        emit strengthChanged();
+    }
+}
+
+int VocalReducer::latencyFrames() const {
+    return m_channelCount == 2 ? m_spectralSize : 0;
+}
+
+void VocalReducer::prepareBuffers() {
+    const size_t frames = size_t(qMax(1, m_maxFrames));
+    for (std::vector<float>* buffer : {&m_left, &m_right, &m_alignedLeft, &m_alignedRight, &m_centre, &m_outLeft, &m_outRight, &m_fadeLeft,
+                                       &m_fadeRight, &m_amounts}) {
+        buffer->assign(frames, 0.0f);
+    }
+
+    m_fadeFrames = qMax(1, int(kFadeMs * m_sampleRate / 1000.0));
+
+    designKeepFilters();
+
+    m_spectralSize = RealFft::nextPowerOfTwo(int(kSpectralWindowMs * m_sampleRate / 1000.0));
+    m_spectralHop = m_spectralSize / kSpectralOverlap;
+    m_spectralKeep = m_spectralSize - m_spectralHop;
+    m_fft.setSize(m_spectralSize);
+    const int bins = m_spectralSize / 2 + 1;
+    m_lowBin = qBound(0, int(std::ceil(kLowCutHz * m_spectralSize / m_sampleRate)), bins);
+    m_highBin = qBound(m_lowBin, int(std::floor(kHighCutHz * m_spectralSize / m_sampleRate)) + 1, bins);
+
+    // Periodic sqrt-Hann, so analysis x synthesis is a Hann window
+    m_window.resize(size_t(m_spectralSize));
+    for (int i = 0; i < m_spectralSize; ++i) {
+        m_window[i] = float(std::sqrt(0.5 - 0.5 * std::cos(2.0 * M_PI * i / m_spectralSize)));
+    }
+    for (int channel = 0; channel < 2; ++channel) {
+        m_inFifo[channel].assign(size_t(m_spectralSize), 0.0f);
+        m_outFifo[channel].assign(size_t(m_spectralHop), 0.0f);
+        m_accumulator[channel].assign(size_t(m_spectralSize), 0.0f);
+        m_spectrum[channel].assign(size_t(m_spectralSize) + 2, 0.0f);
+    }
+    m_frame.assign(size_t(m_spectralSize), 0.0f);
+    m_mask.assign(size_t(bins), 0.0f);
+    for (std::vector<float>& line : m_alignLine) {
+        line.assign(size_t(m_spectralSize), 0.0f);
+    }
+    reset();
+}
+
+void VocalReducer::reset() {
+    m_amount.snap();
+    m_activeMode = m_previousMode = mode();
+    m_fadePosition = m_fadeFrames;
+    for (int section = 0; section < 2; ++section) {
+        m_bassKeep[section].z1 = m_bassKeep[section].z2 = 0.0f;
+        m_trebleKeep[section].z1 = m_trebleKeep[section].z2 = 0.0f;
+    }
+    resetSpectral();
+    for (std::vector<float>& line : m_alignLine) {
+        std::fill(line.begin(), line.end(), 0.0f);
+    }
+    m_alignPosition = 0;
+    m_spectralRunning = m_activeMode == SpectralMask;
+    m_warmup = 0;
+}
+
+void VocalReducer::resetSpectral() {
+    for (int channel = 0; channel < 2; ++channel) {
+        std::fill(m_inFifo[channel].begin(), m_inFifo[channel].end(), 0.0f);
+        std::fill(m_outFifo[channel].begin(), m_outFifo[channel].end(), 0.0f);
+        std::fill(m_accumulator[channel].begin(), m_accumulator[channel].end(), 0.0f);
+    }
+    std::fill(m_mask.begin(), m_mask.end(), 0.0f);
+    m_rover = m_spectralKeep;
+}
+
+void VocalReducer::process(float* data, int frames) {
+    if (m_channelCount != 2) {
+        return;
+    }
+
+    m_amount.update();
+    for (int i = 0; i < frames; ++i) {
+        m_amounts[i] = m_amount.next();
+    }
+
+    // Mode changes wait for the previous crossfade. The spectral path only
+    // runs while it is needed, so switching to it first fills its window
+    // while the old mode keeps playing.
+    const int requested = m_mode.load(std::memory_order_relaxed);
+    if (m_fadePosition >= m_fadeFrames && requested != m_activeMode) {
+        if (requested == SpectralMask && !m_spectralRunning) {
+            resetSpectral();
+            m_spectralRunning = true;
+            m_warmup = m_spectralSize;
+        }
+        if (requested != SpectralMask || m_warmup <= 0) {
+            m_previousMode = m_activeMode;
+            m_activeMode = requested;
+            m_fadePosition = 0;
+        }
+    }
+    const bool fading = m_fadePosition < m_fadeFrames;
+    if (m_activeMode != SpectralMask && !(fading && m_previousMode == SpectralMask) && requested != SpectralMask) {
+        m_spectralRunning = false;
+    }
+
+    m_kernels->deinterleave2(m_left.data(), m_right.data(), data, frames);
+    align(frames);
+
+    // Nothing removed and no spectral path to feed: only the delay
+    if (!fading && !m_spectralRunning && m_amount.current() == 0.0f && m_amounts[0] == 0.0f) {
+        m_kernels->interleave2(data, m_alignedLeft.data(), m_alignedRight.data(), frames);
+        return;
+    }
+
+    render(m_activeMode, m_amounts.data(), m_outLeft.data(), m_outRight.data(), frames);
+
+    if (fading) {
+        render(m_previousMode, m_amounts.data(), m_fadeLeft.data(), m_fadeRight.data(), frames);
+        const float step = 1.0f / m_fadeFrames;
+        for (int i = 0; i < frames; ++i) {
+            const float gain = std::min(1.0f, (m_fadePosition + i) * step);
+            m_outLeft[i] = m_fadeLeft[i] + gain * (m_outLeft[i] - m_fadeLeft[i]);
+            m_outRight[i] = m_fadeRight[i] + gain * (m_outRight[i] - m_fadeRight[i]);
+        }
+        m_fadePosition = std::min(m_fadeFrames, m_fadePosition + frames);
+    } else if (m_spectralRunning && m_activeMode != SpectralMask) {
+        // Warming up, the output is not used yet
+        renderSpectral(m_amounts.data(), m_fadeLeft.data(), m_fadeRight.data(), frames);
+        m_warmup -= frames;
+    }
+
+    m_kernels->interleave2(data, m_outLeft.data(), m_outRight.data(), frames);
+}
+
+// The input delayed by the spectral path's latency
+void VocalReducer::align(int frames) {
+    const int size = m_spectralSize;
+    float* lines[2] = {m_alignLine[0].data(), m_alignLine[1].data()};
+    const float* inputs[2] = {m_left.data(), m_right.data()};
+    float* outputs[2] = {m_alignedLeft.data(), m_alignedRight.data()};
+    int position = m_alignPosition;
+    for (int done = 0; done < frames;) {
+        const int count = std::min(frames - done, size - position);
+        for (int channel = 0; channel < 2; ++channel) {
+            std::memcpy(outputs[channel] + done, lines[channel] + position, sizeof(float) * size_t(count));
+            std::memcpy(lines[channel] + position, inputs[channel] + done, sizeof(float) * size_t(count));
+        }
+        done += count;
+        position = (position + count) % size;
+    }
+    m_alignPosition = position;
+}
+
+void VocalReducer::render(int mode, const float* amounts, float* outLeft, float* outRight, int frames) {
+    if (mode == SpectralMask) {
+        renderSpectral(amounts, outLeft, outRight, frames);
+    } else {
+        renderCentre(mode == BandLimited, amounts, outLeft, outRight, frames);
+    }
+}
+
+void VocalReducer::renderCentre(bool bandLimited, const float* amounts, float* outLeft, float* outRight, int frames) {
+    float* centre = m_centre.data();
+    const float* channels[2] = {m_alignedLeft.data(), m_alignedRight.data()};
+    const float halves[2] = {0.5f, 0.5f};
+    m_kernels->mix(centre, channels, halves, 2, frames);
+
+    if (bandLimited) {
+        // The filters pick what to keep and the centre estimate is the
+        // rest, so the voice band cancels exactly whatever the filter phase
+        for (int i = 0; i < frames; ++i) {
+            const float x = centre[i];
+            const float low = m_bassKeep[1].process(m_bassKeep[0].process(x));
+            const float high = m_trebleKeep[1].process(m_trebleKeep[0].process(x));
+            centre[i] = x - low - high;
+        }
+    }
+
+    if (amounts[0] == amounts[frames - 1]) {
+        const float gains[2] = {1.0f, -amounts[0]};
+        const float* left[2] = {m_alignedLeft.data(), centre};
+        const float* right[2] = {m_alignedRight.data(), centre};
+        m_kernels->mix(outLeft, left, gains, 2, frames);
+        m_kernels->mix(outRight, right, gains, 2, frames);
+    } else {
+        for (int i = 0; i < frames; ++i) {
+            outLeft[i] = m_alignedLeft[i] - amounts[i] * centre[i];
+            outRight[i] = m_alignedRight[i] - amounts[i] * centre[i];
+        }
+    }
+}
+
+void VocalReducer::renderSpectral(const float* amounts, float* outLeft, float* outRight, int frames) {
+    float* inLeft = m_inFifo[0].data();
+    float* inRight = m_inFifo[1].data();
+    for (int i = 0; i < frames; ++i) {
+        inLeft[m_rover] = m_left[i];
+        inRight[m_rover] = m_right[i];
+        outLeft[i] = m_outFifo[0][m_rover - m_spectralKeep];
+        outRight[i] = m_outFifo[1][m_rover - m_spectralKeep];
+        if (++m_rover >= m_spectralSize) {
+            m_rover = m_spectralKeep;
+            spectralFrame(amounts[i]);
+        }
+    }
+}
+
+void VocalReducer::spectralFrame(float amount) {
+    const int size = m_spectralSize;
+    const int hop = m_spectralHop;
+
+    for (int channel = 0; channel < 2; ++channel) {
+        const float* input = m_inFifo[channel].data();
+        for (int i = 0; i < size; ++i) {
+            m_frame[i] = input[i] * m_window[i];
+        }
+        m_fft.forward(m_frame.data(), m_spectrum[channel].data());
+    }
+
+    // Mid energy over mid + side energy is 1 for a centred bin, 1/2 for a
+    // bin panned hard to one side and 0 in antiphase; only the part above
+    // 1/2 counts as centred
+    float* left = m_spectrum[0].data();
+    float* right = m_spectrum[1].data();
+    const int bins = size / 2 + 1;
+    for (int bin = 0; bin < bins; ++bin) {
+        const float midRe = 0.5f * (left[2 * bin] + right[2 * bin]);
+        const float midIm = 0.5f * (left[2 * bin + 1] + right[2 * bin + 1]);
+        float target = 0.0f;
+        if (bin >= m_lowBin && bin < m_highBin) {
+            const float sideRe = 0.5f * (left[2 * bin] - right[2 * bin]);
+            const float sideIm = 0.5f * (left[2 * bin + 1] - right[2 * bin + 1]);
+            const float mid = midRe * midRe + midIm * midIm;
+            const float side = sideRe * sideRe + sideIm * sideIm;
+            const float centred = std::clamp(2.0f * mid / (mid + side + 1e-12f) - 1.0f, 0.0f, 1.0f);
+            target = centred * centred;
+        }
+        m_mask[bin] += kMaskSmoothing * (target - m_mask[bin]);
+        const float gain = amount * m_mask[bin];
+        left[2 * bin] -= gain * midRe;
+        left[2 * bin + 1] -= gain * midIm;
+        right[2 * bin] -= gain * midRe;
+        right[2 * bin + 1] -= gain * midIm;
+    }
+
+    // Hann windows at a quarter-window hop sum to 2
+    const float scale = 2.0f / kSpectralOverlap;
+    for (int channel = 0; channel < 2; ++channel) {
+        m_fft.inverse(m_spectrum[channel].data(), m_frame.data());
+        float* accumulator = m_accumulator[channel].data();
+        for (int i = 0; i < size; ++i) {
+            accumulator[i] += m_frame[i] * m_window[i] * scale;
+        }
+        std::memcpy(m_outFifo[channel].data(), accumulator, sizeof(float) * size_t(hop));
+        std::memmove(accumulator, accumulator + hop, sizeof(float) * size_t(size - hop));
+        std::fill(accumulator + size - hop, accumulator + size, 0.0f);
+
+        float* input = m_inFifo[channel].data();
+        std::memmove(input, input + hop, sizeof(float) * size_t(m_spectralKeep));
+    }
+}
@@ -0,0 +1,147 @@
+#ifndef VOCALREDUCER_H
+#define VOCALREDUCER_H
+
+#include <atomic>
+#include <vector>
+#include "audiokernels.h"
+#include "audioprocessor.h"
+#include "realfft.h"
+#include "smoothedparameter.h"
+
+// Removes the centre-panned lead vocal from a stereo backing track.
+//
+// Lead vocals are almost always mixed to the centre, identical in both
+// channels, while most instruments have some stereo spread. Every mode
+// estimates the centre content and subtracts it from both channels:
+//
+//  - MidSide: the whole mid signal (L + R) / 2, which leaves the side
+//    signal in antiphase. Strongest, but bass and kick go with the voice.
+//  - BandLimited: the mid signal band-passed to the voice range, so the
+//    bass, kick and cymbals stay.
+//  - SpectralMask: per STFT bin, the share of the mid that is centred
+//    (left and right alike in level and phase) inside the voice range.
+//    Spread instruments survive even where they overlap the voice, at the
+//    cost of one analysis window of latency (about 21 ms).
+//
+// The other modes, and the stream while nothing is removed, are delayed
+// by the same window, so the latency of a stereo stream stays constant
+// whatever the mode and the video never shifts against the audio.
+// Switching on and off ramps the removed amount, and a mode change
+// crossfades the two time-aligned modes, so neither clicks. Mono streams
+// pass through.
+class VocalReducer : public AudioProcessor {
+    Q_OBJECT
+    Q_PROPERTY(bool enabled READ isEnabled WRITE setEnabled NOTIFY enabledChanged)
+    Q_PROPERTY(Mode mode READ mode WRITE setMode NOTIFY modeChanged)
+    Q_PROPERTY(double strength READ strength WRITE setStrength NOTIFY strengthChanged)
+
+public:
+    enum Mode { MidSide, BandLimited, SpectralMask };
+    Q_ENUM(Mode)
+
+    static constexpr double kLowCutHz = 150.0;
+    static constexpr double kHighCutHz = 8000.0;
+
+    explicit VocalReducer(QObject* parent = nullptr);
+
+    bool isEnabled() const { return m_enabled.load(std::memory_order_relaxed); }
+    void setEnabled(bool enabled);
+
+    Mode mode() const { return Mode(m_mode.load(std::memory_order_relaxed)); }
+    void setMode(Mode mode);
+
+    // Share of the centre estimate removed when enabled, in [0, 1]
+    double strength() const { return m_strength.load(std::memory_order_relaxed); }
+    void setStrength(double strength);
+
+    int latencyFrames() const override;
+    void reset() override;
+
+signals:
+    void enabledChanged();
+    void modeChanged();
+    void strengthChanged();
+
+protected:
+    void prepareBuffers() override;
+    void process(float* data, int frames) override;
+
+private:
+    // Transposed direct form II
+    struct Biquad {
+        float b0 = 1.0f, b1 = 0.0f, b2 = 0.0f, a1 = 0.0f, a2 = 0.0f;
+        float z1 = 0.0f, z2 = 0.0f;
+
+        float process(float x) {
+            const float y = b0 * x + z1;
+            z1 = b1 * x - a1 * y + z2;
+            z2 = b2 * x - a2 * y;
+            return y;
+        }
+    };
+
+    std::atomic<bool> m_enabled{false};
+    std::atomic<int> m_mode{BandLimited};
+    std::atomic<double> m_strength{1.0};
+    SmoothedParameter m_amount;   // removed share: strength while enabled, else 0
+
+    const AudioKernels::KernelSet* m_kernels = nullptr;
+
+    // Audio thread state
+    int m_activeMode = BandLimited;
+    int m_previousMode = BandLimited;
+    int m_fadeFrames = 0;         // mode crossfade length
+    int m_fadePosition = 0;       // == m_fadeFrames when not fading
+
+    // BandLimited keeps what these pass of the mid signal, two sections
+    // each (fourth order) so little of the voice band leaks into the keep
+    Biquad m_bassKeep[2];
+    Biquad m_trebleKeep[2];
+
+    // Planar scratch, m_maxFrames each: the input as it arrives, for the
+    // spectral path, and delayed by its latency, for everything else
+    std::vector<float> m_left;
+    std::vector<float> m_right;
+    std::vector<float> m_alignedLeft;
+    std::vector<float> m_alignedRight;
+    std::vector<float> m_centre;
+    std::vector<float> m_outLeft;
+    std::vector<float> m_outRight;
+    std::vector<float> m_fadeLeft;
+    std::vector<float> m_fadeRight;
+    std::vector<float> m_amounts;
+
+    // SpectralMask: sqrt-Hann analysis and synthesis at 75% overlap. The
+    // input FIFO keeps the last window per channel, the output FIFO one hop.
+    RealFft m_fft;
+    int m_spectralSize = 0;
+    int m_spectralHop = 0;
+    int m_spectralKeep = 0;      // input frames carried over between windows
+    int m_rover = 0;
+    int m_lowBin = 0;
+    int m_highBin = 0;
+    std::vector<float> m_window;
+    std::vector<float> m_inFifo[2];
+    std::vector<float> m_outFifo[2];
+    std::vector<float> m_accumulator[2];
+    std::vector<float> m_spectrum[2];
+    std::vector<float> m_frame;
+    std::vector<float> m_mask;    // per bin, smoothed over frames
+
+    // Delay lines for the aligned input, m_spectralSize frames each
+    std::vector<float> m_alignLine[2];
+    int m_alignPosition = 0;
+
+    bool m_spectralRunning = false;
+    int m_warmup = 0;             // frames until a cold spectral path is usable
+
+    void designKeepFilters();
+    void resetSpectral();
+    void align(int frames);
+    void render(int mode, const float* amounts, float* outLeft, float* outRight, int frames);
+    void renderCentre(bool bandLimited, const float* amounts, float* outLeft, float* outRight, int frames);
+    void renderSpectral(const float* amounts, float* outLeft, float* outRight, int frames);
+    void spectralFrame(float amount);
+};
+
+#endif // VOCALREDUCER_H
@@ -0,0 +1,189 @@
+#include "voiceeq.h"
+#include <QtGlobal>
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+constexpr double kRampMs = 30.0;
+constexpr double kGlideMs = 20.0;
+
+constexpr double kBodyQ = 0.8;
+constexpr double kPresenceQ = 1.0;
+
+} // namespace
+
+VoiceEq::VoiceEq(QObject* parent)
+    : AudioProcessor(parent),
+      m_settings{SmoothedParameter(80.0f, SmoothedParameter::Exponential, kGlideMs),
+                 SmoothedParameter(0.0f, SmoothedParameter::Linear, kGlideMs),
+                 SmoothedParameter(0.0f, SmoothedParameter::Linear, kGlideMs),
+                 SmoothedParameter(0.0f, SmoothedParameter::Linear, kGlideMs)},
+      m_mix(1.0f, SmoothedParameter::Linear, kRampMs) {
+    for (SmoothedParameter& setting : m_settings) {
+        registerParameter(&setting);
+    }
+    registerParameter(&m_mix);
+}
+
+void VoiceEq::setEnabled(bool enabled) {
+    m_mix.set(enabled ? 1.0f : 0.0f);
+    if (m_enabled.exchange(enabled, std::memory_order_relaxed) != enabled) {
+        emit enabledChanged();
+    }
+}
+
+void VoiceEq::setLowCutHz(double hz) {
+    hz = qBound(20.0, hz, 400.0);
+    if (m_settings[LowCut].set(float(hz))) {
+        emit parametersChanged();
+    }
+}
+
+void VoiceEq::setBodyDb(double db) {
+    db = qBound(-kMaxBandDb, db, kMaxBandDb);
+    if (m_settings[Body].set(float(db))) {
+        emit parametersChanged();
+    }
+}
+
+void VoiceEq::setPresenceDb(double db) {
+    db = qBound(-kMaxBandDb, db, kMaxBandDb);
+    if (m_settings[Presence].set(float(db))) {
+        emit parametersChanged();
+    }
+}
+
+void VoiceEq::setAirDb(double db) {
+    db = qBound(-kMaxBandDb, db, kMaxBandDb);
+    if (m_settings[Air].set(float(db))) {
+        emit parametersChanged();
+    }
+}
+
+void VoiceEq::prepareBuffers() {
+    m_dry.assign(size_t(m_maxFrames) * m_channelCount, 0.0f);
+    reset();
+}
+
+void VoiceEq::reset() {
+    for (SmoothedParameter& setting : m_settings) {
+        setting.snap();
+    }
+    m_mix.snap();
+    design();
+    for (auto& channel : m_state) {
+        std::fill(std::begin(channel), std::end(channel), State());
+    }
+    m_idle = !isEnabled();
+}
+
+// RBJ cookbook sections
+void VoiceEq::design() {
+    const double nyquistGuard = 0.45 * m_sampleRate;
+    auto normalise = [](Coefficients& c, double b0, double b1, double b2, double a0, double a1, double a2) {
+        c.b0 = float(b0 / a0);
+        c.b1 = float(b1 / a0);
+        c.b2 = float(b2 / a0);
+        c.a1 = float(a1 / a0);
+        c.a2 = float(a2 / a0);
+    };
+
+    // Butterworth high-pass
+    double w = 2.0 * M_PI * m_settings[LowCut].current() / m_sampleRate;
+    double cosW = std::cos(w);
+    double alpha = std::sin(w) / std::sqrt(2.0);
+    normalise(m_coefficients[LowCut], (1.0 + cosW) / 2.0, -(1.0 + cosW), (1.0 + cosW) / 2.0,
+              1.0 + alpha, -2.0 * cosW, 1.0 - alpha);
+
+    auto peak = [&](Coefficients& c, double hz, double q, double db) {
+        const double a = std::pow(10.0, db / 40.0);
+        const double pw = 2.0 * M_PI * qMin(hz, nyquistGuard) / m_sampleRate;
+        const double pAlpha = std::sin(pw) / (2.0 * q);
+        const double pCos = std::cos(pw);
+        normalise(c, 1.0 + pAlpha * a, -2.0 * pCos, 1.0 - pAlpha * a, 1.0 + pAlpha / a, -2.0 * pCos,
+                  1.0 - pAlpha / a);
+    };
+    peak(m_coefficients[Body], kBodyHz, kBodyQ, m_settings[Body].current());
+    peak(m_coefficients[Presence], kPresenceHz, kPresenceQ, m_settings[Presence].current());
+
+    // High shelf with slope 1
+    const double a = std::pow(10.0, m_settings[Air].current() / 40.0);
+    w = 2.0 * M_PI * qMin(kAirHz, nyquistGuard) / m_sampleRate;
+    cosW = std::cos(w);
+    alpha = std::sin(w) / std::sqrt(2.0);
+    const double shelf = 2.0 * std::sqrt(a) * alpha;
+    normalise(m_coefficients[Air], a * ((a + 1.0) + (a - 1.0) * cosW + shelf), -2.0 * a * ((a - 1.0) + (a + 1.0) * cosW),
+              a * ((a + 1.0) + (a - 1.0) * cosW - shelf), (a + 1.0) - (a - 1.0) * cosW + shelf,
+              2.0 * ((a - 1.0) - (a + 1.0) * cosW), (a + 1.0) - (a - 1.0) * cosW - shelf);
+}
+
+void VoiceEq::process(float* data, int frames) {
+    const bool enabled = isEnabled();
+    if (m_idle) {
+        if (!enabled) {
+            return;
+        }
+        m_idle = false;
+        for (auto& channel : m_state) {
+            std::fill(std::begin(channel), std::end(channel), State());
+        }
+    }
+
+    // Glide the band settings, redesigning once per block while they move
+    bool moved = false;
+    for (SmoothedParameter& setting : m_settings) {
+        const float before = setting.current();
+        moved |= setting.advance(frames) != before;
+    }
+    if (moved) {
+        design();
+    }
+
+    // Flat bands are skipped
+    bool active[kSections];
+    for (int section = 0; section < kSections; ++section) {
+        active[section] = section == LowCut || m_settings[section].current() != 0.0f;
+    }
+
+    const int channels = m_channelCount;
+    const bool blending = m_mix.update() || m_mix.current() < 1.0f;
+    if (blending) {
+        std::copy(data, data + frames * channels, m_dry.begin());
+    }
+
+    for (int channel = 0; channel < qMin(channels, int(kMaxChannels)); ++channel) {
+        for (int section = 0; section < kSections; ++section) {
+            if (!active[section]) {
+                continue;
+            }
+            const Coefficients c = m_coefficients[section];
+            State& s = m_state[channel][section];
+            float z1 = s.z1;
+            float z2 = s.z2;
+            for (int frame = 0; frame < frames; ++frame) {
+                float& sample = data[frame * channels + channel];
+                const float x = sample;
+                const float y = c.b0 * x + z1;
+                z1 = c.b1 * x - c.a1 * y + z2;
+                z2 = c.b2 * x - c.a2 * y;
+                sample = y;
+            }
+            s.z1 = z1;
+            s.z2 = z2;
+        }
+    }
+
+    if (blending) {
+        for (int frame = 0; frame < frames; ++frame) {
+            const float mix = m_mix.next();
+            for (int channel = 0; channel < channels; ++channel) {
+                const int i = frame * channels + channel;
+                data[i] = m_dry[i] + mix * (data[i] - m_dry[i]);
+            }
+        }
+        if (!enabled && m_mix.current() == 0.0f) {
+            m_idle = true;
+        }
+    }
+}
@@ -0,0 +1,92 @@
+#ifndef VOICEEQ_H
+#define VOICEEQ_H
+
+#include <atomic>
+#include <vector>
+#include "audioprocessor.h"
+#include "smoothedparameter.h"
+
+// Channel-strip EQ for a vocal mic.
+//
+// A 12 dB/octave low cut takes out handling noise, stand rumble and the
+// proximity boost of a mic held close, followed by three bands voiced for
+// singing: body (a peak at 250 Hz, where a boxy or thin voice lives),
+// presence (a peak at 3 kHz, for words to cut through the music) and air
+// (a shelf from 10 kHz). Every band is flat by default, so only the low
+// cut acts until someone turns a knob.
+//
+// Band settings glide to new values over about 20 ms instead of jumping,
+// the corner by an even ratio and the gains in dB, and the filters are
+// redesigned once a block while they move. Switching the EQ on or off
+// crossfades with the dry signal.
+class VoiceEq : public AudioProcessor {
+    Q_OBJECT
+    Q_PROPERTY(bool enabled READ isEnabled WRITE setEnabled NOTIFY enabledChanged)
+    Q_PROPERTY(double lowCutHz READ lowCutHz WRITE setLowCutHz NOTIFY parametersChanged)
+    Q_PROPERTY(double bodyDb READ bodyDb WRITE setBodyDb NOTIFY parametersChanged)
+    Q_PROPERTY(double presenceDb READ presenceDb WRITE setPresenceDb NOTIFY parametersChanged)
+    Q_PROPERTY(double airDb READ airDb WRITE setAirDb NOTIFY parametersChanged)
+
+public:
+    static constexpr double kBodyHz = 250.0;
+    static constexpr double kPresenceHz = 3000.0;
+    static constexpr double kAirHz = 10000.0;
+    static constexpr double kMaxBandDb = 12.0;
+    static constexpr int kMaxChannels = 2;
+
+    explicit VoiceEq(QObject* parent = nullptr);
+
+    bool isEnabled() const { return m_enabled.load(std::memory_order_relaxed); }
+    void setEnabled(bool enabled);
+
+    // Low cut corner, 20 to 400 Hz
+    double lowCutHz() const { return m_settings[LowCut].target(); }
+    void setLowCutHz(double hz);
+
+    // Band gains, within +-kMaxBandDb
+    double bodyDb() const { return m_settings[Body].target(); }
+    void setBodyDb(double db);
+    double presenceDb() const { return m_settings[Presence].target(); }
+    void setPresenceDb(double db);
+    double airDb() const { return m_settings[Air].target(); }
+    void setAirDb(double db);
+
+    void reset() override;
+
+signals:
+    void enabledChanged();
+    void parametersChanged();
+
+protected:
+    void prepareBuffers() override;
+    void process(float* data, int frames) override;
+
+private:
+    enum Section { LowCut, Body, Presence, Air, kSections };
+
+    struct Coefficients {
+        float b0 = 1.0f, b1 = 0.0f, b2 = 0.0f, a1 = 0.0f, a2 = 0.0f;
+    };
+
+    // Transposed direct form II state
+    struct State {
+        float z1 = 0.0f, z2 = 0.0f;
+    };
+
+    std::atomic<bool> m_enabled{true};
+
+    // Per section: low cut corner in Hz, then the band gains in dB. The
+    // coefficients are designed for their current values.
+    SmoothedParameter m_settings[kSections];
+    SmoothedParameter m_mix;      // wet share, 1 while enabled
+
+    // Audio thread state
+    Coefficients m_coefficients[kSections];
+    State m_state[kMaxChannels][kSections];
+    bool m_idle = true;
+    std::vector<float> m_dry;
+
+    void design();
+};
+
+#endif // VOICEEQ_H
@@ -0,0 +1,181 @@
+#include "yinpitchtracker.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace {
+
+// Int16 input is converted in blocks of this many samples
+constexpr int kConvertBlock = 256;
+
+// Below this mean square the window is treated as silence
+constexpr double kSilenceMeanSquare = 1e-10;
+
+} // namespace
+
+YinPitchTracker::YinPitchTracker() {
+    configure(44100);
+}
+
+int YinPitchTracker::hopForInterval(int sampleRate, double intervalMs) {
+    return std::max(1, int(std::lround(sampleRate * intervalMs / 1000.0)));
+}
+
+void YinPitchTracker::configure(int sampleRate, int windowFrames, int hopFrames,
+                                double minFrequency, double maxFrequency) {
+    m_sampleRate = std::max(1, sampleRate);
+    m_windowFrames = std::max(64, windowFrames);
+    m_hopFrames = std::clamp(hopFrames, 1, m_windowFrames);
+
+    // The longest period needs two of itself inside the window
+    m_maxTau = std::min(m_windowFrames / 2, int(std::ceil(m_sampleRate / std::max(1.0, minFrequency))));
+    m_minTau = std::clamp(int(std::floor(m_sampleRate / std::max(1.0, maxFrequency))), 2, m_maxTau - 1);
+
+    // Linear correlation of the window with its head never wraps as long
+    // as the FFT covers the window
+    m_fft.setSize(RealFft::nextPowerOfTwo(m_windowFrames));
+    const size_t fftSize = size_t(m_fft.size());
+    m_padded.assign(fftSize, 0.0f);
+    m_spectrumHead.assign(fftSize + 2, 0.0f);
+    m_spectrumFull.assign(fftSize + 2, 0.0f);
+    m_correlation.assign(fftSize, 0.0f);
+    m_energy.assign(size_t(m_windowFrames) + 1, 0.0);
+    m_difference.assign(size_t(m_maxTau) + 1, 0.0f);
+    m_convert.assign(kConvertBlock, 0.0f);
+
+    // Room for a hop past the window, so the history slides only now and then
+    m_history.assign(size_t(m_windowFrames) * 2, 0.0f);
+    reset();
+}
+
+void YinPitchTracker::reset() {
+    m_historyFill = 0;
+    m_writePosition = 0;
+    m_sinceLastHop = 0;
+    m_streamFrames = 0;
+}
+
+bool YinPitchTracker::push(const float* samples, int frames, int& consumed) {
+    const int capacity = int(m_history.size());
+    if (m_writePosition == capacity) {
+        std::memmove(m_history.data(), m_history.data() + capacity - m_windowFrames,
+                     size_t(m_windowFrames) * sizeof(float));
+        m_writePosition = m_windowFrames;
+    }
+
+    const bool primed = m_historyFill >= m_windowFrames;
+    int count = std::min(frames, capacity - m_writePosition);
+    count = primed ? std::min(count, m_hopFrames - m_sinceLastHop)
+                   : std::min(count, m_windowFrames - m_historyFill);
+
+    std::memcpy(m_history.data() + m_writePosition, samples, size_t(count) * sizeof(float));
+    m_writePosition += count;
+    m_streamFrames += count;
+    consumed = count;
+
+    if (!primed) {
+        // The first estimate comes as soon as one full window is in
+        m_historyFill += count;
+        return m_historyFill == m_windowFrames;
+    }
+
+    m_sinceLastHop += count;
+    if (m_sinceLastHop == m_hopFrames) {
+        m_sinceLastHop = 0;
+        return true;
+    }
+    return false;
+}
+
+YinPitchTracker::Estimate YinPitchTracker::analyzeHistory() {
+    Estimate estimate = analyze(m_history.data() + m_writePosition - m_windowFrames);
+    estimate.frame = m_streamFrames - m_windowFrames / 2;
+    return estimate;
+}
+
+YinPitchTracker::Estimate YinPitchTracker::analyze(const float* window) {
+    Estimate estimate;
+    const int fftSize = m_fft.size();
+    const int length = m_windowFrames - m_maxTau; // integration length, >= W/2
+
+    // Energy prefix sums in double: d(tau) subtracts nearly equal terms
+    m_energy[0] = 0.0;
+    for (int i = 0; i < m_windowFrames; ++i) {
+        m_energy[i + 1] = m_energy[i] + double(window[i]) * window[i];
+    }
+    const double headEnergy = m_energy[length];
+    if (headEnergy < kSilenceMeanSquare * length) {
+        return estimate;
+    }
+
+    // r(tau) = sum over j < length of x[j] x[j + tau], as IFFT(conj(A) B)
+    std::copy(window, window + length, m_padded.begin());
+    std::fill(m_padded.begin() + length, m_padded.end(), 0.0f);
+    m_fft.forward(m_padded.data(), m_spectrumHead.data());
+
+    std::copy(window, window + m_windowFrames, m_padded.begin());
+    std::fill(m_padded.begin() + m_windowFrames, m_padded.end(), 0.0f);
+    m_fft.forward(m_padded.data(), m_spectrumFull.data());
+
+    float* head = m_spectrumHead.data();
+    const float* full = m_spectrumFull.data();
+    for (int k = 0; k <= fftSize / 2; ++k) {
+        const float ar = head[2 * k];
+        const float ai = head[2 * k + 1];
+        const float br = full[2 * k];
+        const float bi = full[2 * k + 1];
+        head[2 * k] = ar * br + ai * bi;
+        head[2 * k + 1] = ar * bi - ai * br;
+    }
+    m_fft.inverse(head, m_correlation.data());
+
+    // Steps 1 and 2: d(tau) = e(0) + e(tau) - 2 r(tau), then d'(tau)
+    float* difference = m_difference.data();
+    difference[0] = 1.0f;
+    double runningSum = 0.0;
+    for (int tau = 1; tau <= m_maxTau; ++tau) {
+        const double shiftedEnergy = m_energy[tau + length] - m_energy[tau];
+        const double d = std::max(0.0, headEnergy + shiftedEnergy - 2.0 * m_correlation[tau]);
+        runningSum += d;
+        difference[tau] = runningSum > 0.0 ? float(d * tau / runningSum) : 1.0f;
+    }
+
+    // Step 3: first dip under the threshold, else the global minimum
+    int tau = -1;
+    for (int candidate = m_minTau; candidate < m_maxTau; ++candidate) {
+        if (difference[candidate] < m_threshold) {
+            while (candidate + 1 < m_maxTau && difference[candidate + 1] < difference[candidate]) {
+                ++candidate;
+            }
+            tau = candidate;
+            estimate.voiced = true;
+            break;
+        }
+    }
+    if (tau < 0) {
+        tau = int(std::min_element(difference + m_minTau, difference + m_maxTau) - difference);
+    }
+
+    estimate.confidence = std::clamp(1.0 - difference[tau], 0.0, 1.0);
+    if (estimate.voiced) {
+        // Step 4: sub-sample period
+        estimate.frequency = m_sampleRate / interpolate(tau);
+    }
+    return estimate;
+}
+
+double YinPitchTracker::interpolate(int tau) const {
+    const float* difference = m_difference.data();
+    if (tau <= 1 || tau >= m_maxTau) {
+        return tau;
+    }
+
+    const double s0 = difference[tau - 1];
+    const double s1 = difference[tau];
+    const double s2 = difference[tau + 1];
+    const double denominator = 2.0 * (2.0 * s1 - s2 - s0);
+    if (std::abs(denominator) < 1e-12) {
+        return tau;
+    }
+    return tau + (s2 - s0) / denominator;
+}
@@ -0,0 +1,119 @@
+#ifndef YINPITCHTRACKER_H
+#define YINPITCHTRACKER_H
+
+#include <cstdint>
+#include <vector>
+#include "realfft.h"
+
+// Streaming YIN fundamental frequency estimator (de Cheveigne & Kawahara,
+// JASA 2002), the engine version of the Arduino port in ref/Yin.cpp.
+//
+// Mono samples are pushed in any block size. Every hopFrames frames, once
+// a full window has been seen, the latest window is analysed:
+//
+//  1. difference function d(tau), with the cross term computed through a
+//     real FFT so a window costs O(N log N) rather than O(N^2)
+//  2. cumulative mean normalised difference d'(tau)
+//  3. first dip of d' under the threshold, followed down to its minimum
+//  4. parabolic interpolation of the dip for a sub-sample period
+//
+// Confidence is 1 - d'(tau) at the chosen period: close to 1 for a clean
+// periodic signal and near 0 for noise. Everything is sized in configure(),
+// so process() never allocates and can run on an audio thread.
+class YinPitchTracker {
+public:
+    struct Estimate {
+        double frequency = 0.0;  // Hz, 0 when unvoiced
+        double confidence = 0.0; // 1 - d'(tau), in [0, 1]
+        bool voiced = false;     // d'(tau) fell under the threshold
+        int64_t frame = 0;       // stream position of the window centre
+    };
+
+    YinPitchTracker();
+
+    // windowFrames is the analysis length; the longest period it can see is
+    // half of it, further limited by minFrequency
+    void configure(int sampleRate, int windowFrames = 2048, int hopFrames = 441,
+                   double minFrequency = 60.0, double maxFrequency = 1200.0);
+
+    // Hop for the given interval at the configured rate, e.g. 10 ms
+    static int hopForInterval(int sampleRate, double intervalMs);
+
+    // Absolute threshold on d', 0.10 - 0.20 works for voice
+    void setThreshold(double threshold) { m_threshold = threshold; }
+    double threshold() const { return m_threshold; }
+
+    int sampleRate() const { return m_sampleRate; }
+    int windowFrames() const { return m_windowFrames; }
+    int hopFrames() const { return m_hopFrames; }
+
+    // Forget buffered audio and restart the stream position at 0
+    void reset();
+
+    // Push mono samples; onEstimate(const Estimate&) runs once per hop
+    template <typename Callback>
+    void process(const float* samples, int frames, Callback&& onEstimate);
+
+    // Int16 samples are scaled to [-1, 1) in blocks, without allocating
+    template <typename Callback>
+    void process(const int16_t* samples, int frames, Callback&& onEstimate);
+
+    // Analyse one window of windowFrames samples outside of the stream
+    Estimate analyze(const float* window);
+
+private:
+    int m_sampleRate = 44100;
+    int m_windowFrames = 2048;
+    int m_hopFrames = 441;
+    int m_minTau = 2;
+    int m_maxTau = 1024;
+    double m_threshold = 0.15;
+
+    RealFft m_fft;
+    std::vector<float> m_history;   // window plus room to slide
+    int m_historyFill = 0;
+    int m_writePosition = 0;
+    int m_sinceLastHop = 0;
+    int64_t m_streamFrames = 0;
+
+    std::vector<float> m_padded;
+    std::vector<float> m_spectrumHead;
+    std::vector<float> m_spectrumFull;
+    std::vector<float> m_correlation;
+    std::vector<double> m_energy;   // prefix sums of x^2
+    std::vector<float> m_difference;
+    std::vector<float> m_convert;
+
+    // Append samples, true when a hop is due; consumed says how many were used
+    bool push(const float* samples, int frames, int& consumed);
+    Estimate analyzeHistory();
+    double interpolate(int tau) const;
+};
+
+template <typename Callback>
+void YinPitchTracker::process(const float* samples, int frames, Callback&& onEstimate) {
+    while (frames > 0) {
+        int consumed = 0;
+        if (push(samples, frames, consumed)) {
+            onEstimate(analyzeHistory());
+        }
+        samples += consumed;
+        frames -= consumed;
+    }
+}
+
+template <typename Callback>
+void YinPitchTracker::process(const int16_t* samples, int frames, Callback&& onEstimate) {
+    const int block = int(m_convert.size());
+    while (frames > 0) {
+        const int count = frames < block ? frames : block;
+        for (int i = 0; i < count; ++i) {
+            m_convert[i] = samples[i] * (1.0f / 32768.0f);
+        }
+        process(m_convert.data(), count, onEstimate);
+        samples += count;
+        frames -= count;
+    }
+}
+
+#endif // YINPITCHTRACKER_H
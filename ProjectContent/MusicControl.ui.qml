@@ -74,7 +74,31 @@ Rectangle {
             }
         }
 
+        // Gain reduction of the mic dynamics and the output limiter; the
+        // meters are plain reads, so poll them
+        Column {
+            id: dynamicsMeters
+            anchors.left: parent.left
+            anchors.bottom: parent.bottom
+            anchors.leftMargin: 20
+            anchors.bottomMargin: 20
+            spacing: 4
+
+            Text { id: gateMeter; text: "Gate: 0.0 dB" }
+            Text { id: compressorMeter; text: "Compressor: 0.0 dB" }
+            Text { id: limiterMeter; text: "Limiter: 0.0 dB" }
 
+            Timer {
+                interval: 100
+                running: true
+                repeat: true
+                onTriggered: {
+                    gateMeter.text = "Gate: " + noiseGate.gainReductionDb().toFixed(1) + " dB"
+                    compressorMeter.text = "Compressor: " + compressor.gainReductionDb().toFixed(1) + " dB"
+                    limiterMeter.text = "Limiter: " + limiter.gainReductionDb().toFixed(1) + " dB"
+                }
+            }
+        }
     }
 
     // Right panel for media player
@@ -258,21 +282,74 @@ Rectangle {
                 onClicked: mediaPlayerBackend.stop()
             }
 
+            // Tempo in 5% steps, the backend keeps the pitch
+            Button {
+                text: "-"
+                enabled: mediaPlayerBackend.playbackRate > 0.5
+                onClicked: mediaPlayerBackend.playbackRate = mediaPlayerBackend.playbackRate - 0.05
+            }
+
             Button {
                 id: speedButton
-                text: "Speed: " + mediaPlayerBackend.playbackRate + "x"
+                text: "Speed: " + mediaPlayerBackend.playbackRate.toFixed(2) + "x"
+                onClicked: mediaPlayerBackend.playbackRate = 1.0
+            }
+
+            Button {
+                text: "+"
+                enabled: mediaPlayerBackend.playbackRate < 1.5
+                onClicked: mediaPlayerBackend.playbackRate = mediaPlayerBackend.playbackRate + 0.05
+            }
+
+            // Removes the centre-panned lead vocal of original recordings
+            Button {
+                text: vocalReducer.enabled ? "Vocals off" : "Vocals on"
+                onClicked: vocalReducer.enabled = !vocalReducer.enabled
+            }
+
+            // Notches out speaker-to-mic howl; on unless the room needs none
+            Button {
+                text: feedbackSuppressor.enabled ? "Howl guard on" : "Howl guard off"
+                onClicked: feedbackSuppressor.enabled = !feedbackSuppressor.enabled
+            }
+
+            // Voice effects: each click steps to the next preset, then off
+            Button {
+                text: reverb.enabled ? ["Room", "Hall", "Plate", "Cathedral", "Custom"][reverb.preset] : "Reverb off"
+                onClicked: {
+                    if (!reverb.enabled) {
+                        reverb.preset = 0
+                        reverb.enabled = true
+                    } else if (reverb.preset < 3) {
+                        reverb.preset = reverb.preset + 1
+                    } else {
+                        reverb.enabled = false
+                    }
+                }
+            }
+
+            Button {
+                text: echoDelay.enabled ? ["Slapback", "Echo 1/4", "Echo 3/16", "Echo 1/8", "Echo"][echoDelay.preset] : "Echo off"
                 onClicked: {
-                    // Cycle through speeds: 0.5x -> 1x -> 1.5x -> 0.5x
-                    if (mediaPlayerBackend.playbackRate === 0.5) {
-                        mediaPlayerBackend.playbackRate = 1.0
-                    } else if (mediaPlayerBackend.playbackRate === 1.0) {
-                        mediaPlayerBackend.playbackRate = 1.5
+                    if (!echoDelay.enabled) {
+                        echoDelay.preset = 0
+                        echoDelay.enabled = true
+                    } else if (echoDelay.preset < 3) {
+                        echoDelay.preset = echoDelay.preset + 1
                     } else {
-                        mediaPlayerBackend.playbackRate = 0.5
+                        echoDelay.enabled = false
                     }
                 }
             }
 
+            // Needs a .kar/.mid melody next to the song or, for songs
+            // without one, its analysed contour (ready shortly after loading)
+            Button {
+                text: scoreEngine.active ? "Score: " + Math.round(scoreEngine.score) : "Score off"
+                enabled: scoreEngine.hasMelody
+                onClicked: scoreEngine.active = !scoreEngine.active
+            }
+
             Button {
                 text: "Back"
                 onClicked: {
@@ -26,64 +26,32 @@ Rectangle {
         color: "#333333"
     }
 
-    GridLayout {
-        id: videoGrid
-        anchors.centerIn: parent
-        columns: 3
-        rowSpacing: 30
-        columnSpacing: 30
-
-        // Video 1: nuathapki.mp4
-        Rectangle {
-            id: video1Container
-            width: 200
-            height: 180
-            color: "#f0f0f0"
-            border.color: "#cccccc"
-            border.width: 2
-            radius: 10
-
-            Column {
-                anchors.centerIn: parent
-                spacing: 10
-
-                Rectangle {
-                    id: thumbnail1
-                    width: 160
-                    height: 120
-                    color: "#333333"
-                    radius: 8
-                    anchors.horizontalCenter: parent.horizontalCenter
-
-                    Text {
-                        anchors.centerIn: parent
-                        text: "🎵"
-                        font.pixelSize: 40
-                        color: "white"
-                    }
-                }
-
-                Text {
-                    text: "Nua Thap Ki"
-                    anchors.horizontalCenter: parent.horizontalCenter
-                    font.pixelSize: 14
-                    font.bold: true
-                    color: "#333333"
-                }
-            }
-
-            MouseArea {
-                anchors.fill: parent
-                onClicked: {
-                    mediaPlayerBackend.source = "/home/karaoke/nuathapki.mp4"
-                    startView.state = "Mediaplayer"
-                }
-            }
-        }
+    Text {
+        id: libraryStatus
+        text: songLibrary.scanning ? "Scanning library... " + songLibrary.count + " songs"
+                                   : songLibrary.count + " songs"
+        anchors.top: titleText.bottom
+        anchors.horizontalCenter: parent.horizontalCenter
+        anchors.topMargin: 10
+        font.pixelSize: 14
+        color: "#666666"
+    }
 
-        // Video 2: codontrensofa.mp4
-        Rectangle {
-            id: video2Container
+    GridView {
+        id: videoGrid
+        anchors.top: libraryStatus.bottom
+        anchors.bottom: parent.bottom
+        anchors.horizontalCenter: parent.horizontalCenter
+        anchors.topMargin: 30
+        anchors.bottomMargin: 30
+        width: Math.max(cellWidth, Math.floor(parent.width * 0.9 / cellWidth) * cellWidth)
+        cellWidth: 230
+        cellHeight: 210
+        clip: true
+        model: songLibrary
+
+        delegate: Rectangle {
+            id: videoContainer
             width: 200
             height: 180
             color: "#f0f0f0"
@@ -93,12 +61,12 @@ Rectangle {
 
             Column {
                 anchors.centerIn: parent
-                spacing: 10
+                spacing: 6
 
                 Rectangle {
-                    id: thumbnail2
+                    id: thumbnail
                     width: 160
-                    height: 120
+                    height: 110
                     color: "#333333"
                     radius: 8
                     anchors.horizontalCenter: parent.horizontalCenter
@@ -112,66 +80,29 @@ Rectangle {
                 }
 
                 Text {
-                    text: "Co Don Tren Sofa"
-                    anchors.horizontalCenter: parent.horizontalCenter
+                    width: 180
+                    text: model.title
+                    horizontalAlignment: Text.AlignHCenter
+                    elide: Text.ElideRight
                     font.pixelSize: 14
                     font.bold: true
                     color: "#333333"
                 }
-            }
-
-            MouseArea {
-                anchors.fill: parent
-                onClicked: {
-                    mediaPlayerBackend.source = "/home/karaoke/codontrensofa.mp4"
-                    startView.state = "Mediaplayer"
-                }
-            }
-        }
-
-        // Video 3: taivisao.mp4
-        Rectangle {
-            id: video3Container
-            width: 200
-            height: 180
-            color: "#f0f0f0"
-            border.color: "#cccccc"
-            border.width: 2
-            radius: 10
-
-            Column {
-                anchors.centerIn: parent
-                spacing: 10
-
-                Rectangle {
-                    id: thumbnail3
-                    width: 160
-                    height: 120
-                    color: "#333333"
-                    radius: 8
-                    anchors.horizontalCenter: parent.horizontalCenter
-
-                    Text {
-                        anchors.centerIn: parent
-                        text: "🎵"
-                        font.pixelSize: 40
-                        color: "white"
-                    }
-                }
 
                 Text {
-                    text: "Tai Vi Sao"
-                    anchors.horizontalCenter: parent.horizontalCenter
-                    font.pixelSize: 14
-                    font.bold: true
-                    color: "#333333"
+                    width: 180
+                    text: model.artist
+                    horizontalAlignment: Text.AlignHCenter
+                    elide: Text.ElideRight
+                    font.pixelSize: 12
+                    color: "#666666"
                 }
             }
 
             MouseArea {
                 anchors.fill: parent
                 onClicked: {
-                    mediaPlayerBackend.source = "/home/karaoke/taivisao.mp4"
+                    mediaPlayerBackend.source = model.url
                     startView.state = "Mediaplayer"
                 }
             }